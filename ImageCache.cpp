@@ -0,0 +1,213 @@
+/*
+Copyright (C) 2012 MoSync AB
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License,
+version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+*/
+
+/**
+ * @file ImageCache.cpp
+ *
+ * Cache of decoded images, keyed by path or URL.
+ */
+
+#include <mastring.h>		// C string functions
+
+#include "ImageCache.h"
+#include "StringHash.h"
+
+using namespace MAUtil;
+
+/**
+ * Constructor.
+ */
+ImageCache::ImageCache(int byteBudget) :
+	mByteBudget(byteBudget),
+	mByteCount(0),
+	mUseCounter(0),
+	mHitCount(0),
+	mMissCount(0)
+{
+}
+
+/**
+ * Destructor.
+ */
+ImageCache::~ImageCache()
+{
+	// Images in use are left to their users.
+	for (int i = 0; i < mEntries.size(); ++i)
+	{
+		if (0 == mEntries[i].mRefCount)
+		{
+			maDestroyObject(mEntries[i].mImage);
+		}
+	}
+}
+
+/**
+ * Get the image with the given key, and mark it as in use.
+ */
+MAHandle ImageCache::acquire(const char* key)
+{
+	int index = findHashedString(
+		mEntries,
+		&Entry::mKey,
+		key,
+		hashString(key));
+	if (index < 0)
+	{
+		++mMissCount;
+		return 0;
+	}
+
+	++mHitCount;
+	Entry& entry = mEntries[index];
+	++entry.mRefCount;
+	entry.mLastUse = ++mUseCounter;
+	return entry.mImage;
+}
+
+/**
+ * Add an image, marked as in use.
+ */
+void ImageCache::add(const char* key, MAHandle image, int refCount)
+{
+	// Four bytes per pixel is what most platforms use for
+	// decoded images.
+	MAExtent size = maGetImageSize(image);
+	int bytes = EXTENT_X(size) * EXTENT_Y(size) * 4;
+
+	Entry entry;
+	entry.mKey = key;
+	entry.mHash = hashString(key);
+	entry.mImage = image;
+	entry.mBytes = bytes;
+	entry.mRefCount = refCount;
+	entry.mLastUse = ++mUseCounter;
+	mEntries.add(entry);
+	mByteCount += bytes;
+
+	evict();
+}
+
+/**
+ * Mark an image as also used by the caller.
+ */
+bool ImageCache::retain(MAHandle image)
+{
+	for (int i = 0; i < mEntries.size(); ++i)
+	{
+		if (image == mEntries[i].mImage)
+		{
+			++mEntries[i].mRefCount;
+			mEntries[i].mLastUse = ++mUseCounter;
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * Mark an image as no longer used by the caller.
+ */
+bool ImageCache::release(MAHandle image)
+{
+	for (int i = 0; i < mEntries.size(); ++i)
+	{
+		if (image == mEntries[i].mImage)
+		{
+			if (mEntries[i].mRefCount > 0)
+			{
+				--mEntries[i].mRefCount;
+			}
+			evict();
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * Set the memory budget, and evict images if needed.
+ */
+void ImageCache::setByteBudget(int byteBudget)
+{
+	mByteBudget = byteBudget;
+	evict();
+}
+
+/**
+ * @return Decoded size of the cached images in bytes.
+ */
+int ImageCache::getByteCount()
+{
+	return mByteCount;
+}
+
+/**
+ * @return Number of cached images.
+ */
+int ImageCache::getImageCount()
+{
+	return mEntries.size();
+}
+
+/**
+ * @return Number of calls to acquire that found the image.
+ */
+int ImageCache::getHitCount()
+{
+	return mHitCount;
+}
+
+/**
+ * @return Number of calls to acquire that did not find
+ * the image.
+ */
+int ImageCache::getMissCount()
+{
+	return mMissCount;
+}
+
+/**
+ * Destroy the least recently used images that are not in
+ * use, until the images fit in the budget.
+ */
+void ImageCache::evict()
+{
+	while (mByteCount > mByteBudget)
+	{
+		int oldest = -1;
+		for (int i = 0; i < mEntries.size(); ++i)
+		{
+			if (0 == mEntries[i].mRefCount
+				&& (oldest < 0
+					|| mEntries[i].mLastUse < mEntries[oldest].mLastUse))
+			{
+				oldest = i;
+			}
+		}
+
+		// All remaining images are in use.
+		if (oldest < 0)
+		{
+			return;
+		}
+
+		maDestroyObject(mEntries[oldest].mImage);
+		mByteCount -= mEntries[oldest].mBytes;
+		mEntries.remove(oldest);
+	}
+}
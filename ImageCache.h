@@ -0,0 +1,187 @@
+/*
+Copyright (C) 2012 MoSync AB
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License,
+version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+*/
+
+/**
+ * @file ImageCache.h
+ *
+ * Cache of decoded images, keyed by path or URL.
+ */
+
+#ifndef IMAGE_CACHE_H_
+#define IMAGE_CACHE_H_
+
+#include <ma.h>
+#include <MAUtil/String.h>
+#include <MAUtil/Vector.h>
+
+/**
+ * Default memory budget of the image cache in bytes.
+ */
+#define IMAGE_CACHE_DEFAULT_BUDGET (4 * 1024 * 1024)
+
+/**
+ * Keeps decoded images, so that loading the same image again
+ * returns the existing handle without reading or decoding the
+ * file.
+ *
+ * Each image has a reference count. An image is in use from
+ * the time it is added or acquired until it is released. When
+ * the decoded size of the images exceeds the budget, the least
+ * recently used images that are not in use are destroyed.
+ * Images in use are never destroyed, so the budget can be
+ * exceeded while they are.
+ */
+class ImageCache
+{
+public:
+	/**
+	 * Constructor.
+	 * @param byteBudget Memory budget for the decoded images.
+	 */
+	ImageCache(int byteBudget = IMAGE_CACHE_DEFAULT_BUDGET);
+
+	/**
+	 * Destructor. Destroys the images that are not in use.
+	 */
+	virtual ~ImageCache();
+
+	/**
+	 * Get the image with the given key, and mark it as in use.
+	 *
+	 * @param key Path or URL of the image.
+	 * @return The image handle, 0 if the image is not cached.
+	 */
+	MAHandle acquire(const char* key);
+
+	/**
+	 * Add an image, marked as in use.
+	 *
+	 * @param key Path or URL of the image.
+	 * @param image Handle of the decoded image. The cache
+	 * takes ownership of the image.
+	 * @param refCount Number of users of the image, each
+	 * of which releases it.
+	 */
+	void add(const char* key, MAHandle image, int refCount = 1);
+
+	/**
+	 * Mark an image that the caller got from someone else as
+	 * also used by the caller, for example when it is shown by
+	 * a widget.
+	 *
+	 * @param image The image handle.
+	 * @return true if the image is in the cache, only then
+	 * must it be released.
+	 */
+	bool retain(MAHandle image);
+
+	/**
+	 * Mark an image as no longer used by the caller. When no
+	 * one uses the image, it can be evicted.
+	 *
+	 * @param image The image handle.
+	 * @return true if the image is in the cache.
+	 */
+	bool release(MAHandle image);
+
+	/**
+	 * Set the memory budget, and evict images if needed.
+	 * @param byteBudget Memory budget for the decoded images.
+	 */
+	void setByteBudget(int byteBudget);
+
+	/**
+	 * @return Decoded size of the cached images in bytes.
+	 */
+	int getByteCount();
+
+	/**
+	 * @return Number of cached images.
+	 */
+	int getImageCount();
+
+	/**
+	 * @return Number of calls to acquire that found the image.
+	 */
+	int getHitCount();
+
+	/**
+	 * @return Number of calls to acquire that did not find
+	 * the image.
+	 */
+	int getMissCount();
+
+private:
+	/**
+	 * A cached image.
+	 */
+	struct Entry
+	{
+		MAUtil::String mKey;
+		unsigned int mHash;
+		MAHandle mImage;
+		int mBytes;
+		int mRefCount;
+		int mLastUse;
+	};
+
+	/**
+	 * Destroy the least recently used images that are not in
+	 * use, until the images fit in the budget.
+	 */
+	void evict();
+
+	/**
+	 * Not copyable.
+	 */
+	ImageCache(const ImageCache&);
+	ImageCache& operator=(const ImageCache&);
+
+private:
+	/**
+	 * The cached images.
+	 */
+	MAUtil::Vector<Entry> mEntries;
+
+	/**
+	 * Memory budget in bytes.
+	 */
+	int mByteBudget;
+
+	/**
+	 * Decoded size of the cached images.
+	 */
+	int mByteCount;
+
+	/**
+	 * Counter used to order the entries by last use.
+	 */
+	int mUseCounter;
+
+	/**
+	 * Number of hits.
+	 */
+	int mHitCount;
+
+	/**
+	 * Number of misses.
+	 */
+	int mMissCount;
+};
+
+#endif
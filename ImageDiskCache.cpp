@@ -0,0 +1,669 @@
+/*
+Copyright (C) 2012 MoSync AB
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License,
+version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+*/
+
+/**
+ * @file ImageDiskCache.cpp
+ *
+ * Cache of downloaded image files in local storage.
+ */
+
+#include <mastdlib.h>		// C string conversion functions
+#include <mastring.h>		// C string functions
+#include <maheap.h>			// C memory allocation
+#include <mavsprintf.h>		// sprintf
+#include <conprint.h>
+
+#include "ImageDiskCache.h"
+#include "StringHash.h"
+
+using namespace MAUtil;
+
+/**
+ * Name of the index file in the cache directory.
+ */
+#define IMAGE_DISK_CACHE_INDEX "index"
+
+/**
+ * Open a file, creating it if it does not exist.
+ * @return The file handle, or a negative error code.
+ */
+static MAHandle openOrCreate(const char* path)
+{
+	MAHandle file = maFileOpen(path, MA_ACCESS_READ_WRITE);
+	if (file < 0)
+	{
+		return file;
+	}
+
+	if (!maFileExists(file))
+	{
+		int result = maFileCreate(file);
+		if (result < 0)
+		{
+			maFileClose(file);
+			return result;
+		}
+	}
+
+	return file;
+}
+
+/**
+ * Split a line of the index into tab separated fields, in
+ * place. The last field gets the rest of the line.
+ * @return The number of fields.
+ */
+static int splitFields(char* line, char** fields, int maxFields)
+{
+	int numFields = 0;
+	fields[numFields++] = line;
+	for (char* p = line; *p && numFields < maxFields; ++p)
+	{
+		if ('\t' == *p)
+		{
+			*p = 0;
+			fields[numFields++] = p + 1;
+		}
+	}
+	return numFields;
+}
+
+/**
+ * Constructor.
+ */
+ImageDiskCache::ImageDiskCache(int byteBudget) :
+	mIndexChanged(false),
+	mByteBudget(byteBudget),
+	mByteCount(0),
+	mConnection(this),
+	mRevalidationData(0),
+	mHitCount(0),
+	mMissCount(0),
+	mNotModifiedCount(0),
+	mUpdatedCount(0)
+{
+}
+
+/**
+ * Destructor. Writes the index if it has changed.
+ */
+ImageDiskCache::~ImageDiskCache()
+{
+	if (mConnection.isOpen())
+	{
+		mConnection.close();
+	}
+
+	if (0 != mRevalidationData)
+	{
+		maDestroyObject(mRevalidationData);
+	}
+
+	if (mIndexChanged)
+	{
+		writeIndex();
+	}
+}
+
+/**
+ * Open the cache, creating the directory if needed, and
+ * read the index.
+ */
+bool ImageDiskCache::open(const char* path)
+{
+	MAHandle dir = openOrCreate(path);
+	if (dir < 0)
+	{
+		lprintfln("@@@ ImageDiskCache: cannot create %s: %d", path, dir);
+		return false;
+	}
+	maFileClose(dir);
+
+	mPath = path;
+	readIndex();
+	evict();
+
+	return true;
+}
+
+/**
+ * @return true if the cache has been opened.
+ */
+bool ImageDiskCache::isOpen()
+{
+	return mPath.length() > 0;
+}
+
+/**
+ * Read the stored bytes of an image.
+ */
+MAHandle ImageDiskCache::read(const char* url)
+{
+	int index = find(url);
+	if (index < 0)
+	{
+		++mMissCount;
+		return 0;
+	}
+
+	Entry& entry = mEntries[index];
+
+	MAHandle file = maFileOpen(
+		getFilePath(entry.mHash).c_str(),
+		MA_ACCESS_READ);
+	if (file < 0)
+	{
+		++mMissCount;
+		remove(index);
+		return 0;
+	}
+
+	// A file that does not match the index is not used.
+	int size = maFileSize(file);
+	if (size != entry.mSize)
+	{
+		maFileClose(file);
+		++mMissCount;
+		remove(index);
+		return 0;
+	}
+
+	MAHandle data = maCreatePlaceholder();
+	if (RES_OK != maCreateData(data, size))
+	{
+		maFileClose(file);
+		maDestroyObject(data);
+		return 0;
+	}
+
+	int result = maFileReadToData(file, data, 0, size);
+	maFileClose(file);
+	if (result < 0)
+	{
+		maDestroyObject(data);
+		++mMissCount;
+		remove(index);
+		return 0;
+	}
+
+	++mHitCount;
+	entry.mLastUse = maTime();
+	mIndexChanged = true;
+
+	if (!entry.mRevalidated)
+	{
+		entry.mRevalidated = true;
+		mRevalidationQueue.add(entry.mURL);
+		revalidateNext();
+	}
+
+	return data;
+}
+
+/**
+ * Store the bytes of an image, and evict files if needed.
+ */
+bool ImageDiskCache::write(
+	const char* url,
+	MAHandle data,
+	const char* etag,
+	const char* lastModified)
+{
+	if (!isOpen())
+	{
+		return false;
+	}
+
+	unsigned int urlHash = hashString(url);
+	int size = maGetDataSize(data);
+
+	// Do not let one image push out everything else.
+	if (size > mByteBudget / 2)
+	{
+		return false;
+	}
+
+	// Drop the old version, and any entry whose file has the
+	// same name because the URL hashes are equal.
+	for (int i = mEntries.size() - 1; i >= 0; --i)
+	{
+		if (urlHash == mEntries[i].mHash)
+		{
+			remove(i);
+		}
+	}
+
+	MAHandle file = openOrCreate(getFilePath(urlHash).c_str());
+	if (file < 0)
+	{
+		return false;
+	}
+
+	int result = maFileTruncate(file, 0);
+	if (result >= 0)
+	{
+		result = maFileWriteFromData(file, data, 0, size);
+	}
+	maFileClose(file);
+	if (result < 0)
+	{
+		lprintfln("@@@ ImageDiskCache: cannot write %s: %d", url, result);
+		return false;
+	}
+
+	Entry entry;
+	entry.mURL = url;
+	entry.mHash = urlHash;
+	entry.mSize = size;
+	entry.mLastUse = maTime();
+	entry.mETag = NULL != etag ? etag : "";
+	entry.mLastModified = NULL != lastModified ? lastModified : "";
+	entry.mRevalidated = true;
+	mEntries.add(entry);
+	mByteCount += size;
+
+	evict();
+	writeIndex();
+
+	return true;
+}
+
+/**
+ * Set the size budget, and evict files if needed.
+ */
+void ImageDiskCache::setByteBudget(int byteBudget)
+{
+	mByteBudget = byteBudget;
+	evict();
+}
+
+/**
+ * @return Size of the stored files in bytes.
+ */
+int ImageDiskCache::getByteCount()
+{
+	return mByteCount;
+}
+
+/**
+ * @return Number of stored files.
+ */
+int ImageDiskCache::getEntryCount()
+{
+	return mEntries.size();
+}
+
+/**
+ * @return Number of calls to read that found the image.
+ */
+int ImageDiskCache::getHitCount()
+{
+	return mHitCount;
+}
+
+/**
+ * @return Number of calls to read that did not find
+ * the image.
+ */
+int ImageDiskCache::getMissCount()
+{
+	return mMissCount;
+}
+
+/**
+ * @return Number of revalidations where the server
+ * reported the stored file as current.
+ */
+int ImageDiskCache::getNotModifiedCount()
+{
+	return mNotModifiedCount;
+}
+
+/**
+ * @return Number of revalidations that replaced the
+ * stored file.
+ */
+int ImageDiskCache::getUpdatedCount()
+{
+	return mUpdatedCount;
+}
+
+/**
+ * Called when the headers of a revalidation request
+ * have been received.
+ */
+void ImageDiskCache::httpFinished(HttpConnection* connection, int result)
+{
+	if (304 == result)
+	{
+		++mNotModifiedCount;
+		finishRevalidation();
+		return;
+	}
+
+	if (200 != result)
+	{
+		lprintfln(
+			"@@@ ImageDiskCache: revalidation of %s failed: %d",
+			mRevalidationURL.c_str(),
+			result);
+		finishRevalidation();
+		return;
+	}
+
+	// A new version, read it if the size is known.
+	String contentLength;
+	int size = 0;
+	if (mConnection.getResponseHeader("content-length", &contentLength) > 0)
+	{
+		size = atoi(contentLength.c_str());
+	}
+	if (size <= 0 || size > mByteBudget / 2)
+	{
+		finishRevalidation();
+		return;
+	}
+
+	mNewETag.clear();
+	mNewLastModified.clear();
+	mConnection.getResponseHeader("etag", &mNewETag);
+	mConnection.getResponseHeader("last-modified", &mNewLastModified);
+
+	mRevalidationData = maCreatePlaceholder();
+	if (RES_OK != maCreateData(mRevalidationData, size))
+	{
+		maDestroyObject(mRevalidationData);
+		mRevalidationData = 0;
+		finishRevalidation();
+		return;
+	}
+
+	mConnection.readToData(mRevalidationData, 0, size);
+}
+
+/**
+ * Called when the body of a revalidation request has
+ * been read.
+ */
+void ImageDiskCache::connReadFinished(Connection* connection, int result)
+{
+	if (result > 0)
+	{
+		// Keep the validators that the server did not send.
+		int index = find(mRevalidationURL.c_str());
+		if (index >= 0)
+		{
+			if (0 == mNewETag.length())
+			{
+				mNewETag = mEntries[index].mETag;
+			}
+			if (0 == mNewLastModified.length())
+			{
+				mNewLastModified = mEntries[index].mLastModified;
+			}
+		}
+
+		if (write(
+			mRevalidationURL.c_str(),
+			mRevalidationData,
+			mNewETag.c_str(),
+			mNewLastModified.c_str()))
+		{
+			++mUpdatedCount;
+		}
+	}
+
+	maDestroyObject(mRevalidationData);
+	mRevalidationData = 0;
+	finishRevalidation();
+}
+
+/**
+ * Read the index file.
+ */
+void ImageDiskCache::readIndex()
+{
+	mEntries.clear();
+	mByteCount = 0;
+
+	String path = mPath;
+	path += IMAGE_DISK_CACHE_INDEX;
+	MAHandle file = maFileOpen(path.c_str(), MA_ACCESS_READ);
+	if (file < 0)
+	{
+		return;
+	}
+
+	int size = maFileExists(file) ? maFileSize(file) : 0;
+	if (size <= 0)
+	{
+		maFileClose(file);
+		return;
+	}
+
+	char* buffer = (char*) malloc(size + 1);
+	if (NULL == buffer)
+	{
+		maFileClose(file);
+		return;
+	}
+
+	int result = maFileRead(file, buffer, size);
+	maFileClose(file);
+	if (result < 0)
+	{
+		free(buffer);
+		return;
+	}
+	buffer[size] = 0;
+
+	// Each line is: size, last use, ETag, Last-Modified and
+	// URL, separated by tabs.
+	char* line = buffer;
+	char* end = buffer + size;
+	while (line < end)
+	{
+		char* lineEnd = line;
+		while (lineEnd < end && '\n' != *lineEnd)
+		{
+			++lineEnd;
+		}
+		*lineEnd = 0;
+
+		char* fields[5];
+		int numFields = splitFields(line, fields, 5);
+		line = lineEnd + 1;
+		if (numFields < 5 || 0 == *fields[4])
+		{
+			continue;
+		}
+
+		Entry entry;
+		entry.mSize = atoi(fields[0]);
+		entry.mLastUse = atoi(fields[1]);
+		entry.mETag = fields[2];
+		entry.mLastModified = fields[3];
+		entry.mURL = fields[4];
+		entry.mHash = hashString(fields[4]);
+		entry.mRevalidated = false;
+		mEntries.add(entry);
+		mByteCount += entry.mSize;
+	}
+
+	free(buffer);
+	mIndexChanged = false;
+}
+
+/**
+ * Write the index file.
+ */
+void ImageDiskCache::writeIndex()
+{
+	if (!isOpen())
+	{
+		return;
+	}
+
+	String index;
+	char number[32];
+	for (int i = 0; i < mEntries.size(); ++i)
+	{
+		const Entry& entry = mEntries[i];
+		sprintf(number, "%d\t%d\t", entry.mSize, entry.mLastUse);
+		index += number;
+		index += entry.mETag;
+		index += "\t";
+		index += entry.mLastModified;
+		index += "\t";
+		index += entry.mURL;
+		index += "\n";
+	}
+
+	String path = mPath;
+	path += IMAGE_DISK_CACHE_INDEX;
+	MAHandle file = openOrCreate(path.c_str());
+	if (file < 0)
+	{
+		return;
+	}
+
+	int result = maFileTruncate(file, 0);
+	if (result >= 0 && index.length() > 0)
+	{
+		result = maFileWrite(file, index.c_str(), index.length());
+	}
+	maFileClose(file);
+
+	mIndexChanged = result < 0;
+}
+
+/**
+ * Delete the least recently used files until the files
+ * fit in the budget.
+ */
+void ImageDiskCache::evict()
+{
+	while (mByteCount > mByteBudget && mEntries.size() > 0)
+	{
+		int oldest = 0;
+		for (int i = 1; i < mEntries.size(); ++i)
+		{
+			if (mEntries[i].mLastUse < mEntries[oldest].mLastUse)
+			{
+				oldest = i;
+			}
+		}
+		remove(oldest);
+	}
+}
+
+/**
+ * Remove an entry and delete its file.
+ */
+void ImageDiskCache::remove(int index)
+{
+	MAHandle file = maFileOpen(
+		getFilePath(mEntries[index].mHash).c_str(),
+		MA_ACCESS_READ_WRITE);
+	if (file >= 0)
+	{
+		if (maFileExists(file))
+		{
+			maFileDelete(file);
+		}
+		maFileClose(file);
+	}
+
+	mByteCount -= mEntries[index].mSize;
+	mEntries.remove(index);
+	mIndexChanged = true;
+}
+
+/**
+ * Start the next queued revalidation, if none is running.
+ */
+void ImageDiskCache::revalidateNext()
+{
+	while (0 == mRevalidationURL.length()
+		&& mRevalidationQueue.size() > 0)
+	{
+		mRevalidationURL = mRevalidationQueue[0];
+		mRevalidationQueue.remove(0);
+
+		int index = find(mRevalidationURL.c_str());
+		if (index < 0)
+		{
+			// Evicted while it was queued.
+			mRevalidationURL.clear();
+			continue;
+		}
+
+		int result = mConnection.create(mRevalidationURL.c_str(), HTTP_GET);
+		if (result < 0)
+		{
+			mRevalidationURL.clear();
+			continue;
+		}
+
+		const Entry& entry = mEntries[index];
+		if (entry.mETag.length() > 0)
+		{
+			mConnection.setRequestHeader(
+				"If-None-Match",
+				entry.mETag.c_str());
+		}
+		if (entry.mLastModified.length() > 0)
+		{
+			mConnection.setRequestHeader(
+				"If-Modified-Since",
+				entry.mLastModified.c_str());
+		}
+		mConnection.finish();
+	}
+}
+
+/**
+ * Close the revalidation request and start the next one.
+ */
+void ImageDiskCache::finishRevalidation()
+{
+	mConnection.close();
+	mRevalidationURL.clear();
+	revalidateNext();
+}
+
+/**
+ * @return The path of the file of a URL hash.
+ */
+String ImageDiskCache::getFilePath(unsigned int hash)
+{
+	char name[16];
+	sprintf(name, "%08x", hash);
+	String path = mPath;
+	path += name;
+	return path;
+}
+
+/**
+ * @return Index of the entry with the given URL, -1 if
+ * there is none.
+ */
+int ImageDiskCache::find(const char* url)
+{
+	return findHashedString(mEntries, &Entry::mURL, url, hashString(url));
+}
@@ -0,0 +1,289 @@
+/*
+Copyright (C) 2012 MoSync AB
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License,
+version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+*/
+
+/**
+ * @file ImageDiskCache.h
+ *
+ * Cache of downloaded image files in local storage.
+ */
+
+#ifndef IMAGE_DISK_CACHE_H_
+#define IMAGE_DISK_CACHE_H_
+
+#include <ma.h>
+#include <MAUtil/String.h>
+#include <MAUtil/Vector.h>
+#include <MAUtil/Connection.h>
+
+/**
+ * Default size budget of the disk cache in bytes.
+ */
+#define IMAGE_DISK_CACHE_DEFAULT_BUDGET (8 * 1024 * 1024)
+
+/**
+ * Keeps the bytes of downloaded images in files, so that they
+ * are not downloaded again when the app is restarted.
+ *
+ * Each image is stored in a file named by the hash of its URL.
+ * An index file holds the URL, the size, the time of last use
+ * and the ETag and Last-Modified validators of each file. When
+ * the files exceed the budget, the least recently used files
+ * are deleted.
+ *
+ * The first time an image is read in a session, it is queued
+ * for revalidation. Revalidation runs in the background, one
+ * request at a time, and sends a conditional request with the
+ * stored validators. If the server has a new version, the file
+ * and the validators are replaced, and the new version is used
+ * the next time the image is read. Images stored without
+ * validators get them from the first revalidation.
+ */
+class ImageDiskCache :
+	public MAUtil::HttpConnectionListener
+{
+public:
+	/**
+	 * Constructor.
+	 * @param byteBudget Size budget for the files.
+	 */
+	ImageDiskCache(int byteBudget = IMAGE_DISK_CACHE_DEFAULT_BUDGET);
+
+	/**
+	 * Destructor. Writes the index if it has changed.
+	 */
+	virtual ~ImageDiskCache();
+
+	/**
+	 * Open the cache, creating the directory if needed, and
+	 * read the index.
+	 *
+	 * @param path The directory of the cache, ending with
+	 * a slash.
+	 * @return true on success, false if the directory could
+	 * not be created.
+	 */
+	bool open(const char* path);
+
+	/**
+	 * @return true if the cache has been opened.
+	 */
+	bool isOpen();
+
+	/**
+	 * Read the stored bytes of an image, and queue the image
+	 * for revalidation if it has not been revalidated in this
+	 * session.
+	 *
+	 * @param url URL of the image.
+	 * @return A data object with the bytes of the image, owned
+	 * by the caller. 0 if the image is not stored.
+	 */
+	MAHandle read(const char* url);
+
+	/**
+	 * Store the bytes of an image, and evict files if needed.
+	 *
+	 * @param url URL of the image.
+	 * @param data Data object with the bytes of the image.
+	 * @param etag ETag validator, NULL if there is none.
+	 * @param lastModified Last-Modified validator, NULL if
+	 * there is none.
+	 * @return true on success.
+	 */
+	bool write(
+		const char* url,
+		MAHandle data,
+		const char* etag = NULL,
+		const char* lastModified = NULL);
+
+	/**
+	 * Set the size budget, and evict files if needed.
+	 * @param byteBudget Size budget for the files.
+	 */
+	void setByteBudget(int byteBudget);
+
+	/**
+	 * @return Size of the stored files in bytes.
+	 */
+	int getByteCount();
+
+	/**
+	 * @return Number of stored files.
+	 */
+	int getEntryCount();
+
+	/**
+	 * @return Number of calls to read that found the image.
+	 */
+	int getHitCount();
+
+	/**
+	 * @return Number of calls to read that did not find
+	 * the image.
+	 */
+	int getMissCount();
+
+	/**
+	 * @return Number of revalidations where the server
+	 * reported the stored file as current.
+	 */
+	int getNotModifiedCount();
+
+	/**
+	 * @return Number of revalidations that replaced the
+	 * stored file.
+	 */
+	int getUpdatedCount();
+
+	/**
+	 * Called when the headers of a revalidation request
+	 * have been received.
+	 */
+	void httpFinished(MAUtil::HttpConnection* connection, int result);
+
+	/**
+	 * Called when the body of a revalidation request has
+	 * been read.
+	 */
+	void connReadFinished(MAUtil::Connection* connection, int result);
+
+private:
+	/**
+	 * A stored file.
+	 */
+	struct Entry
+	{
+		MAUtil::String mURL;
+		unsigned int mHash;
+		int mSize;
+		int mLastUse;
+		MAUtil::String mETag;
+		MAUtil::String mLastModified;
+		bool mRevalidated;
+	};
+
+	/**
+	 * Read the index file.
+	 */
+	void readIndex();
+
+	/**
+	 * Write the index file.
+	 */
+	void writeIndex();
+
+	/**
+	 * Delete the least recently used files until the files
+	 * fit in the budget.
+	 */
+	void evict();
+
+	/**
+	 * Remove an entry and delete its file.
+	 */
+	void remove(int index);
+
+	/**
+	 * Start the next queued revalidation, if none is running.
+	 */
+	void revalidateNext();
+
+	/**
+	 * Close the revalidation request and start the next one.
+	 */
+	void finishRevalidation();
+
+	/**
+	 * @return The path of the file of a URL hash.
+	 */
+	MAUtil::String getFilePath(unsigned int hash);
+
+	/**
+	 * @return Index of the entry with the given URL, -1 if
+	 * there is none.
+	 */
+	int find(const char* url);
+
+	/**
+	 * Not copyable.
+	 */
+	ImageDiskCache(const ImageDiskCache&);
+	ImageDiskCache& operator=(const ImageDiskCache&);
+
+private:
+	/**
+	 * The directory of the cache, empty until opened.
+	 */
+	MAUtil::String mPath;
+
+	/**
+	 * The stored files.
+	 */
+	MAUtil::Vector<Entry> mEntries;
+
+	/**
+	 * true if the index has changed since it was written.
+	 */
+	bool mIndexChanged;
+
+	/**
+	 * Size budget in bytes.
+	 */
+	int mByteBudget;
+
+	/**
+	 * Size of the stored files.
+	 */
+	int mByteCount;
+
+	/**
+	 * Connection used for revalidation.
+	 */
+	MAUtil::HttpConnection mConnection;
+
+	/**
+	 * URLs waiting for revalidation.
+	 */
+	MAUtil::Vector<MAUtil::String> mRevalidationQueue;
+
+	/**
+	 * URL being revalidated, empty if none.
+	 */
+	MAUtil::String mRevalidationURL;
+
+	/**
+	 * Validators of the new version of the file being read.
+	 */
+	MAUtil::String mNewETag;
+	MAUtil::String mNewLastModified;
+
+	/**
+	 * Data object the new version of a file is read into.
+	 */
+	MAHandle mRevalidationData;
+
+	/**
+	 * Statistics.
+	 */
+	int mHitCount;
+	int mMissCount;
+	int mNotModifiedCount;
+	int mUpdatedCount;
+};
+
+#endif
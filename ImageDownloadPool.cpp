@@ -0,0 +1,500 @@
+/*
+Copyright (C) 2012 MoSync AB
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License,
+version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+*/
+
+/**
+ * @file ImageDownloadPool.cpp
+ *
+ * Pool of image downloads with a priority queue and sharing
+ * of downloads of the same URL.
+ */
+
+#include <mastring.h>		// C string functions
+#include <mastdlib.h>		// C string conversion functions
+#include <conprint.h>
+
+#include "ImageDownloadPool.h"
+#include "StringHash.h"
+
+using namespace MAUtil;
+using namespace Wormhole;
+
+/**
+ * Constructor.
+ */
+ImageDownloadPool::ImageDownloadPool(
+	ImageDownloadPoolListener* listener,
+	int size) :
+	mListener(listener),
+	mSequence(0),
+	mQueueLength(0)
+{
+	resetCounters();
+
+	for (int i = 0; i < size; ++i)
+	{
+		HttpConnection* connection = new HttpConnection(this);
+		mConnections.add(connection);
+		mFreeConnections.add(connection);
+	}
+}
+
+/**
+ * Destructor. Closes the running downloads.
+ */
+ImageDownloadPool::~ImageDownloadPool()
+{
+	for (int i = 0; i < mRequests.size(); ++i)
+	{
+		if (0 != mRequests[i].mData)
+		{
+			maDestroyObject(mRequests[i].mData);
+		}
+	}
+
+	// A closed connection does not call the listener.
+	for (int i = 0; i < mConnections.size(); ++i)
+	{
+		mConnections[i]->close();
+		delete mConnections[i];
+	}
+}
+
+/**
+ * Request an image.
+ */
+MAHandle ImageDownloadPool::request(const char* url, int priority)
+{
+	unsigned int urlHash = hashString(url);
+
+	// Share a download of the same URL.
+	int index = findHashedString(mRequests, &Request::mURL, url, urlHash);
+	if (index >= 0)
+	{
+		++mSharedCount;
+
+		// A queued request is started as early as the most
+		// urgent of the requests that share it.
+		if (NULL == mRequests[index].mConnection
+			&& priority > mRequests[index].mPriority)
+		{
+			mRequests[index].mPriority = priority;
+		}
+		return mRequests[index].mImage;
+	}
+
+	Request request;
+	request.mURL = url;
+	request.mHash = urlHash;
+	request.mImage = maCreatePlaceholder();
+	request.mPriority = priority;
+	request.mSequence = ++mSequence;
+	request.mRequestTime = maGetMilliSecondCount();
+	request.mConnection = NULL;
+	request.mData = 0;
+	mRequests.add(request);
+
+	if (mFreeConnections.size() > 0)
+	{
+		int result = start(mRequests.size() - 1);
+		if (result < 0)
+		{
+			// The caller has not seen the handle yet, so
+			// report the error as the result instead of
+			// through the listener.
+			maDestroyObject(request.mImage);
+			mRequests.remove(mRequests.size() - 1);
+			++mFailedCount;
+			return result;
+		}
+		return request.mImage;
+	}
+
+	++mQueueLength;
+	if (mQueueLength > mMaxQueueLength)
+	{
+		mMaxQueueLength = mQueueLength;
+	}
+
+	return request.mImage;
+}
+
+/**
+ * @return Number of requests waiting for a connection.
+ */
+int ImageDownloadPool::getQueueLength()
+{
+	return mQueueLength;
+}
+
+/**
+ * @return Largest number of requests that have been
+ * waiting for a connection at the same time.
+ */
+int ImageDownloadPool::getMaxQueueLength()
+{
+	return mMaxQueueLength;
+}
+
+/**
+ * @return Number of downloads running.
+ */
+int ImageDownloadPool::getActiveCount()
+{
+	return mConnections.size() - mFreeConnections.size();
+}
+
+/**
+ * @return Largest number of downloads that have been
+ * running at the same time.
+ */
+int ImageDownloadPool::getMaxActiveCount()
+{
+	return mMaxActiveCount;
+}
+
+/**
+ * @return Number of requests that shared a download
+ * already queued or running.
+ */
+int ImageDownloadPool::getSharedCount()
+{
+	return mSharedCount;
+}
+
+/**
+ * @return Number of downloads that completed.
+ */
+int ImageDownloadPool::getFinishedCount()
+{
+	return mFinishedCount;
+}
+
+/**
+ * @return Number of downloads that failed.
+ */
+int ImageDownloadPool::getFailedCount()
+{
+	return mFailedCount;
+}
+
+/**
+ * @return Time in milliseconds from request to completion
+ * of the last download.
+ */
+int ImageDownloadPool::getLastLatency()
+{
+	return mLastLatency;
+}
+
+/**
+ * @return Average time in milliseconds from request to
+ * completion of the finished downloads.
+ */
+int ImageDownloadPool::getAverageLatency()
+{
+	if (0 == mFinishedCount)
+	{
+		return 0;
+	}
+	return mTotalLatency / mFinishedCount;
+}
+
+/**
+ * @return Longest time in milliseconds from request to
+ * completion of a finished download.
+ */
+int ImageDownloadPool::getMaxLatency()
+{
+	return mMaxLatency;
+}
+
+/**
+ * Set the counters to zero.
+ */
+void ImageDownloadPool::resetCounters()
+{
+	mMaxQueueLength = mQueueLength;
+	mMaxActiveCount = 0;
+	mSharedCount = 0;
+	mFinishedCount = 0;
+	mFailedCount = 0;
+	mLastLatency = 0;
+	mTotalLatency = 0;
+	mMaxLatency = 0;
+}
+
+/**
+ * Write the counters as a JSON object.
+ */
+void ImageDownloadPool::writeStats(ScriptBuilder& json)
+{
+	json.append("{");
+	MessageStats::appendKey(json, "queue");
+	json.append(getQueueLength()).append(",");
+	MessageStats::appendKey(json, "maxQueue");
+	json.append(mMaxQueueLength).append(",");
+	MessageStats::appendKey(json, "active");
+	json.append(getActiveCount()).append(",");
+	MessageStats::appendKey(json, "maxActive");
+	json.append(mMaxActiveCount).append(",");
+	MessageStats::appendKey(json, "shared");
+	json.append(mSharedCount).append(",");
+	MessageStats::appendKey(json, "finished");
+	json.append(mFinishedCount).append(",");
+	MessageStats::appendKey(json, "failed");
+	json.append(mFailedCount).append(",");
+	MessageStats::appendKey(json, "lastLatency");
+	json.append(mLastLatency).append(",");
+	MessageStats::appendKey(json, "averageLatency");
+	json.append(getAverageLatency()).append(",");
+	MessageStats::appendKey(json, "maxLatency");
+	json.append(mMaxLatency).append("}");
+}
+
+/**
+ * Set the counters to zero.
+ */
+void ImageDownloadPool::resetStats()
+{
+	resetCounters();
+}
+
+/**
+ * Called by the connections when the headers of a response
+ * have been received.
+ */
+void ImageDownloadPool::httpFinished(HttpConnection* connection, int result)
+{
+	int index = -1;
+	for (int i = 0; i < mRequests.size(); ++i)
+	{
+		if (connection == mRequests[i].mConnection)
+		{
+			index = i;
+			break;
+		}
+	}
+	if (index < 0)
+	{
+		return;
+	}
+
+	if (200 != result)
+	{
+		lprintfln("@@@ ImageDownloadPool: download error %d", result);
+		complete(connection, 0, result < 0 ? result : CONNERR_GENERIC);
+		return;
+	}
+
+	// The body is read in one go, so the size must be known.
+	String contentLength;
+	int size = 0;
+	if (connection->getResponseHeader("content-length", &contentLength) > 0)
+	{
+		size = atoi(contentLength.c_str());
+	}
+	if (size <= 0 || size > IMAGE_DOWNLOAD_POOL_MAX_SIZE)
+	{
+		lprintfln(
+			"@@@ ImageDownloadPool: bad size %d of %s",
+			size,
+			mRequests[index].mURL.c_str());
+		complete(connection, 0, CONNERR_GENERIC);
+		return;
+	}
+
+	// Keep the validators for the disk cache.
+	Request& request = mRequests[index];
+	connection->getResponseHeader("etag", &request.mETag);
+	connection->getResponseHeader("last-modified", &request.mLastModified);
+
+	request.mData = maCreatePlaceholder();
+	if (RES_OK != maCreateData(request.mData, size))
+	{
+		maDestroyObject(request.mData);
+		request.mData = 0;
+		complete(connection, 0, RES_OUT_OF_MEMORY);
+		return;
+	}
+
+	connection->readToData(request.mData, 0, size);
+}
+
+/**
+ * Called by the connections when the body of a response has
+ * been read.
+ */
+void ImageDownloadPool::connReadFinished(Connection* connection, int result)
+{
+	for (int i = 0; i < mRequests.size(); ++i)
+	{
+		if (connection == mRequests[i].mConnection)
+		{
+			// The request owns the data until it is complete.
+			MAHandle data = mRequests[i].mData;
+			mRequests[i].mData = 0;
+			if (result <= 0)
+			{
+				lprintfln("@@@ ImageDownloadPool: read error %d", result);
+				maDestroyObject(data);
+				complete(connection, 0, result < 0 ? result : CONNERR_GENERIC);
+				return;
+			}
+			complete(connection, data, 0);
+			return;
+		}
+	}
+}
+
+/**
+ * Start queued requests while there are free connections.
+ */
+void ImageDownloadPool::startQueued()
+{
+	while (mQueueLength > 0 && mFreeConnections.size() > 0)
+	{
+		// Highest priority first, then oldest first.
+		int next = -1;
+		for (int i = 0; i < mRequests.size(); ++i)
+		{
+			const Request& request = mRequests[i];
+			if (NULL == request.mConnection
+				&& (next < 0
+					|| request.mPriority > mRequests[next].mPriority
+					|| (request.mPriority == mRequests[next].mPriority
+						&& request.mSequence < mRequests[next].mSequence)))
+			{
+				next = i;
+			}
+		}
+
+		--mQueueLength;
+		int result = start(next);
+		if (result < 0)
+		{
+			complete(next, 0, result);
+		}
+	}
+}
+
+/**
+ * Start a request on a free connection.
+ */
+int ImageDownloadPool::start(int index)
+{
+	Request& request = mRequests[index];
+	HttpConnection* connection = mFreeConnections[mFreeConnections.size() - 1];
+
+	int result = connection->create(request.mURL.c_str(), HTTP_GET);
+	if (result < 0)
+	{
+		lprintfln(
+			"@@@ ImageDownloadPool: could not download %s: %d",
+			request.mURL.c_str(),
+			result);
+		return result;
+	}
+	connection->finish();
+
+	mFreeConnections.remove(mFreeConnections.size() - 1);
+	request.mConnection = connection;
+
+	int active = getActiveCount();
+	if (active > mMaxActiveCount)
+	{
+		mMaxActiveCount = active;
+	}
+
+	return result;
+}
+
+/**
+ * Remove the request of a connection, close and free the
+ * connection, and notify the listener.
+ */
+void ImageDownloadPool::complete(
+	Connection* connection,
+	MAHandle data,
+	int code)
+{
+	for (int i = 0; i < mRequests.size(); ++i)
+	{
+		if (connection == mRequests[i].mConnection)
+		{
+			HttpConnection* http = mRequests[i].mConnection;
+			http->close();
+			mFreeConnections.add(http);
+			complete(i, data, code);
+			break;
+		}
+	}
+
+	startQueued();
+}
+
+/**
+ * Remove a request, decode the image and notify the listener.
+ */
+void ImageDownloadPool::complete(int index, MAHandle data, int code)
+{
+	// Keep the URL and validators, the request is removed
+	// before the listener is called.
+	String url = mRequests[index].mURL;
+	String etag = mRequests[index].mETag;
+	String lastModified = mRequests[index].mLastModified;
+	MAHandle image = mRequests[index].mImage;
+	int requestTime = mRequests[index].mRequestTime;
+
+	// Remove the request before calling the listener, so
+	// that a new request for the URL starts a new download.
+	mRequests.remove(index);
+
+	if (0 != data)
+	{
+		code = maCreateImageFromData(image, data, 0, maGetDataSize(data));
+	}
+
+	if (RES_OK == code && 0 != data)
+	{
+		int latency = maGetMilliSecondCount() - requestTime;
+		mLastLatency = latency;
+		mTotalLatency += latency;
+		if (latency > mMaxLatency)
+		{
+			mMaxLatency = latency;
+		}
+		++mFinishedCount;
+
+		mListener->imageDownloadFinished(
+			url.c_str(),
+			image,
+			data,
+			etag.c_str(),
+			lastModified.c_str());
+	}
+	else
+	{
+		++mFailedCount;
+		mListener->imageDownloadFailed(url.c_str(), image, code);
+	}
+
+	if (0 != data)
+	{
+		maDestroyObject(data);
+	}
+}
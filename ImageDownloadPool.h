@@ -0,0 +1,324 @@
+/*
+Copyright (C) 2012 MoSync AB
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License,
+version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+*/
+
+/**
+ * @file ImageDownloadPool.h
+ *
+ * Pool of image downloads with a priority queue and sharing
+ * of downloads of the same URL.
+ */
+
+#ifndef IMAGE_DOWNLOAD_POOL_H_
+#define IMAGE_DOWNLOAD_POOL_H_
+
+#include <ma.h>
+#include <MAUtil/String.h>
+#include <MAUtil/Vector.h>
+#include <MAUtil/String.h>
+#include <MAUtil/Connection.h>
+#include "MessageStats.h"
+
+/**
+ * Default number of downloads that run at the same time.
+ */
+#define IMAGE_DOWNLOAD_POOL_DEFAULT_SIZE 4
+
+/**
+ * Largest image file that is downloaded, in bytes.
+ */
+#define IMAGE_DOWNLOAD_POOL_MAX_SIZE (8 * 1024 * 1024)
+
+/**
+ * Receives the results of the downloads started by an
+ * ImageDownloadPool.
+ */
+class ImageDownloadPoolListener
+{
+public:
+	/**
+	 * Called when an image has been downloaded and decoded.
+	 * @param url URL of the image.
+	 * @param image The image handle returned by request.
+	 * @param data The downloaded bytes of the image. The data
+	 * is destroyed when this method returns.
+	 * @param etag The ETag header of the response, empty if
+	 * there was none.
+	 * @param lastModified The Last-Modified header of the
+	 * response, empty if there was none.
+	 */
+	virtual void imageDownloadFinished(
+		const char* url,
+		MAHandle image,
+		MAHandle data,
+		const char* etag,
+		const char* lastModified) = 0;
+
+	/**
+	 * Called when a download failed or was cancelled, or the
+	 * image could not be decoded.
+	 * @param url URL of the image.
+	 * @param image The image handle returned by request.
+	 * The handle is an empty placeholder.
+	 * @param code The error code of the connection, or
+	 * CONNERR_GENERIC if the server did not send the image.
+	 */
+	virtual void imageDownloadFailed(
+		const char* url,
+		MAHandle image,
+		int code) = 0;
+};
+
+/**
+ * Downloads images with a fixed number of connections.
+ *
+ * Requests that do not get a connection at once wait in a queue.
+ * The queue is ordered by priority, highest first, and requests
+ * with the same priority are started in the order they were
+ * made. A request for a URL that is already queued or being
+ * downloaded does not start a new download, it returns the
+ * handle of the existing one. The caller maps the handle to
+ * everything that waits for it.
+ *
+ * The images are downloaded as data with HttpConnection and
+ * decoded by the pool, so that the listener gets the bytes and
+ * the validators of the response as well as the image, to
+ * store them in a disk cache. Only responses that have a
+ * Content-Length are read.
+ *
+ * The pool records the queue length, the number of downloads
+ * running at the same time and the time each download takes,
+ * from request to completion. These are written with the
+ * message statistics, as a MessageStatsSource.
+ */
+class ImageDownloadPool :
+	public MAUtil::HttpConnectionListener,
+	public Wormhole::MessageStatsSource
+{
+public:
+	/**
+	 * Constructor.
+	 * @param listener Receives the results of the downloads.
+	 * @param size Maximum number of downloads that run at
+	 * the same time, the number of connections.
+	 */
+	ImageDownloadPool(
+		ImageDownloadPoolListener* listener,
+		int size = IMAGE_DOWNLOAD_POOL_DEFAULT_SIZE);
+
+	/**
+	 * Destructor. Closes the running downloads.
+	 */
+	virtual ~ImageDownloadPool();
+
+	/**
+	 * Request an image. The download is started at once if a
+	 * connection is free, else the request is queued.
+	 *
+	 * @param url URL of the image.
+	 * @param priority Requests with higher priority are
+	 * started first.
+	 * @return The handle the image will be created in. It is
+	 * the same for all requests of a URL made before the
+	 * download completes. A negative error code if the
+	 * download could not be started.
+	 */
+	MAHandle request(const char* url, int priority = 0);
+
+	/**
+	 * @return Number of requests waiting for a connection.
+	 */
+	int getQueueLength();
+
+	/**
+	 * @return Largest number of requests that have been
+	 * waiting for a connection at the same time.
+	 */
+	int getMaxQueueLength();
+
+	/**
+	 * @return Number of downloads running.
+	 */
+	int getActiveCount();
+
+	/**
+	 * @return Largest number of downloads that have been
+	 * running at the same time.
+	 */
+	int getMaxActiveCount();
+
+	/**
+	 * @return Number of requests that shared a download
+	 * already queued or running.
+	 */
+	int getSharedCount();
+
+	/**
+	 * @return Number of downloads that completed.
+	 */
+	int getFinishedCount();
+
+	/**
+	 * @return Number of downloads that failed.
+	 */
+	int getFailedCount();
+
+	/**
+	 * @return Time in milliseconds from request to completion
+	 * of the last download.
+	 */
+	int getLastLatency();
+
+	/**
+	 * @return Average time in milliseconds from request to
+	 * completion of the finished downloads.
+	 */
+	int getAverageLatency();
+
+	/**
+	 * @return Longest time in milliseconds from request to
+	 * completion of a finished download.
+	 */
+	int getMaxLatency();
+
+	/**
+	 * Set the counters to zero.
+	 */
+	void resetCounters();
+
+	/**
+	 * Write the counters as a JSON object:
+	 * {"queue":0,"maxQueue":12,"active":1,"maxActive":4,
+	 *  "shared":3,"finished":20,"failed":1,"lastLatency":310,
+	 *  "averageLatency":420,"maxLatency":1210}
+	 */
+	virtual void writeStats(Wormhole::ScriptBuilder& json);
+
+	/**
+	 * Set the counters to zero, see resetCounters.
+	 */
+	virtual void resetStats();
+
+	/**
+	 * Called by the connections when the headers of a
+	 * response have been received.
+	 */
+	void httpFinished(MAUtil::HttpConnection* connection, int result);
+
+	/**
+	 * Called by the connections when the body of a response
+	 * has been read.
+	 */
+	void connReadFinished(MAUtil::Connection* connection, int result);
+
+private:
+	/**
+	 * A queued or running download.
+	 */
+	struct Request
+	{
+		MAUtil::String mURL;
+		unsigned int mHash;
+		MAHandle mImage;
+		int mPriority;
+		int mSequence;
+		int mRequestTime;
+		MAUtil::HttpConnection* mConnection;
+		MAHandle mData;
+		MAUtil::String mETag;
+		MAUtil::String mLastModified;
+	};
+
+	/**
+	 * Start queued requests while there are free connections.
+	 */
+	void startQueued();
+
+	/**
+	 * Start a request on a free connection.
+	 * @param index Index of the request.
+	 * @return A negative error code if the download could not
+	 * be started, the request is then not changed.
+	 */
+	int start(int index);
+
+	/**
+	 * Remove the request of a connection, close and free the
+	 * connection, and notify the listener.
+	 * @param data The downloaded data, 0 if the download failed.
+	 * @param code An error code if the download failed.
+	 */
+	void complete(MAUtil::Connection* connection, MAHandle data, int code);
+
+	/**
+	 * Remove a request, decode the image and notify the listener.
+	 * @param data The downloaded data, 0 if the download failed.
+	 */
+	void complete(int index, MAHandle data, int code);
+
+	/**
+	 * Not copyable.
+	 */
+	ImageDownloadPool(const ImageDownloadPool&);
+	ImageDownloadPool& operator=(const ImageDownloadPool&);
+
+private:
+	/**
+	 * Receives the results of the downloads.
+	 */
+	ImageDownloadPoolListener* mListener;
+
+	/**
+	 * All connections of the pool.
+	 */
+	MAUtil::Vector<MAUtil::HttpConnection*> mConnections;
+
+	/**
+	 * Connections that are not running a download.
+	 */
+	MAUtil::Vector<MAUtil::HttpConnection*> mFreeConnections;
+
+	/**
+	 * Queued and running requests.
+	 */
+	MAUtil::Vector<Request> mRequests;
+
+	/**
+	 * Counter used to keep requests with the same priority
+	 * in the order they were made.
+	 */
+	int mSequence;
+
+	/**
+	 * Number of queued requests.
+	 */
+	int mQueueLength;
+
+	/**
+	 * Statistics.
+	 */
+	int mMaxQueueLength;
+	int mMaxActiveCount;
+	int mSharedCount;
+	int mFinishedCount;
+	int mFailedCount;
+	int mLastLatency;
+	int mTotalLatency;
+	int mMaxLatency;
+};
+
+#endif
@@ -0,0 +1,248 @@
+/*
+Copyright (C) 2012 MoSync AB
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License,
+version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+*/
+
+/**
+ * @file ImageFileLoader.cpp
+ *
+ * Loads image files in chunks, between the events of the
+ * event loop.
+ */
+
+#include <mastring.h>		// C string functions
+#include <conprint.h>
+
+#include "ImageFileLoader.h"
+
+using namespace MAUtil;
+
+/**
+ * Constructor.
+ */
+ImageFileLoader::ImageFileLoader(
+	ImageFileLoaderListener* listener,
+	ScratchDataPool* dataPool) :
+	mListener(listener),
+	mDataPool(dataPool),
+	mFile(0),
+	mData(0),
+	mSize(0),
+	mOffset(0),
+	mIdleListening(false)
+{
+}
+
+/**
+ * Destructor. Abandons the loads in progress.
+ */
+ImageFileLoader::~ImageFileLoader()
+{
+	if (mIdleListening)
+	{
+		Environment::getEnvironment().removeIdleListener(this);
+	}
+
+	close();
+
+	for (int i = 0; i < mLoads.size(); ++i)
+	{
+		delete mLoads[i];
+	}
+}
+
+/**
+ * Request an image file.
+ */
+void ImageFileLoader::load(const char* key, const char* path, const char* id)
+{
+	// Join a load of the same key.
+	for (int i = 0; i < mLoads.size(); ++i)
+	{
+		if (0 == strcmp(key, mLoads[i]->mKey.c_str()))
+		{
+			if (NULL != id)
+			{
+				mLoads[i]->mIDs.add(id);
+			}
+			return;
+		}
+	}
+
+	Load* load = new Load();
+	load->mKey = key;
+	load->mPath = path;
+	if (NULL != id)
+	{
+		load->mIDs.add(id);
+	}
+	mLoads.add(load);
+
+	if (!mIdleListening)
+	{
+		Environment::getEnvironment().addIdleListener(this);
+		mIdleListening = true;
+	}
+}
+
+/**
+ * @return true if the image is queued or being read.
+ */
+bool ImageFileLoader::isLoading(const char* key)
+{
+	for (int i = 0; i < mLoads.size(); ++i)
+	{
+		if (0 == strcmp(key, mLoads[i]->mKey.c_str()))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * @return Number of files queued or being read.
+ */
+int ImageFileLoader::getPendingCount()
+{
+	return mLoads.size();
+}
+
+/**
+ * Read the next chunk of the current file.
+ */
+void ImageFileLoader::idle()
+{
+	if (0 == mLoads.size())
+	{
+		// Stop being called when there is nothing to do,
+		// an idle listener keeps the event loop spinning.
+		Environment::getEnvironment().removeIdleListener(this);
+		mIdleListening = false;
+		return;
+	}
+
+	// Opening the file is one step, so that a queue of
+	// small files is not read in one iteration.
+	if (0 == mFile)
+	{
+		int result = open();
+		if (result < 0)
+		{
+			finish(result);
+		}
+		return;
+	}
+
+	int length = mSize - mOffset;
+	if (length > IMAGE_FILE_LOADER_CHUNK_SIZE)
+	{
+		length = IMAGE_FILE_LOADER_CHUNK_SIZE;
+	}
+
+	int result = maFileReadToData(mFile, mData, mOffset, length);
+	if (result < 0)
+	{
+		finish(result);
+		return;
+	}
+
+	mOffset += length;
+	if (mOffset >= mSize)
+	{
+		finish(RES_OK);
+	}
+}
+
+/**
+ * Open the file of the first load, and get a data
+ * object for it from the pool.
+ */
+int ImageFileLoader::open()
+{
+	MAHandle file = maFileOpen(mLoads[0]->mPath.c_str(), MA_ACCESS_READ);
+	if (file < 0)
+	{
+		return file;
+	}
+	mFile = file;
+
+	mSize = maFileSize(mFile);
+	if (mSize < 0)
+	{
+		return mSize;
+	}
+
+	// The pool rejects empty and unreasonably large files.
+	MAHandle data = mDataPool->acquire(mSize);
+	if (data < 0)
+	{
+		return data;
+	}
+	mData = data;
+
+	mOffset = 0;
+	return RES_OK;
+}
+
+/**
+ * Decode the data, release the file and the data, remove
+ * the first load and notify the listener.
+ */
+void ImageFileLoader::finish(int result)
+{
+	MAHandle image = result;
+	if (result >= 0)
+	{
+		image = maCreatePlaceholder();
+		result = maCreateImageFromData(image, mData, 0, mSize);
+		if (RES_OK != result)
+		{
+			maDestroyObject(image);
+			image = result;
+		}
+	}
+
+	close();
+
+	// Remove the load before calling the listener, so that
+	// a new request for the key starts a new load.
+	Load* load = mLoads[0];
+	mLoads.remove(0);
+	mListener->imageFileLoaded(load->mKey.c_str(), image, load->mIDs);
+	delete load;
+}
+
+/**
+ * Close the file and return the data to the pool, if any.
+ */
+void ImageFileLoader::close()
+{
+	if (0 != mFile)
+	{
+		maFileClose(mFile);
+		mFile = 0;
+	}
+
+	if (0 != mData)
+	{
+		mDataPool->release(mData);
+		mData = 0;
+	}
+
+	mSize = 0;
+	mOffset = 0;
+}
@@ -0,0 +1,199 @@
+/*
+Copyright (C) 2012 MoSync AB
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License,
+version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+*/
+
+/**
+ * @file ImageFileLoader.h
+ *
+ * Loads image files in chunks, between the events of the
+ * event loop.
+ */
+
+#ifndef IMAGE_FILE_LOADER_H_
+#define IMAGE_FILE_LOADER_H_
+
+#include <ma.h>
+#include <MAUtil/String.h>
+#include <MAUtil/Vector.h>
+#include <MAUtil/Environment.h>
+#include "ScratchDataPool.h"
+
+/**
+ * Number of bytes read from a file per iteration of the
+ * event loop.
+ */
+#define IMAGE_FILE_LOADER_CHUNK_SIZE (32 * 1024)
+
+/**
+ * Receives the images loaded by an ImageFileLoader.
+ */
+class ImageFileLoaderListener
+{
+public:
+	/**
+	 * Called when an image has been loaded.
+	 *
+	 * @param key The key the image was requested with.
+	 * @param image The image handle, or a negative error code.
+	 * @param ids The IDs of all the requests for the image,
+	 * empty if the image was loaded without a request.
+	 */
+	virtual void imageFileLoaded(
+		const char* key,
+		MAHandle image,
+		const MAUtil::Vector<MAUtil::String>& ids) = 0;
+};
+
+/**
+ * Loads image files without blocking the event loop.
+ *
+ * A file is read in chunks of IMAGE_FILE_LOADER_CHUNK_SIZE
+ * bytes, one chunk each time the event loop is idle, so that
+ * events, such as messages from the WebView, are handled while
+ * the file is read. When the whole file has been read, the
+ * image is decoded and the listener is called.
+ *
+ * Files are loaded one at a time, in the order they were
+ * requested. Requests for a key that is already being loaded
+ * are added to that load, and the listener gets the IDs of
+ * all of them.
+ */
+class ImageFileLoader :
+	public MAUtil::IdleListener
+{
+public:
+	/**
+	 * Constructor.
+	 * @param listener Receives the loaded images.
+	 * @param dataPool Provides the data objects the files
+	 * are read into.
+	 */
+	ImageFileLoader(
+		ImageFileLoaderListener* listener,
+		ScratchDataPool* dataPool);
+
+	/**
+	 * Destructor. Abandons the loads in progress.
+	 */
+	virtual ~ImageFileLoader();
+
+	/**
+	 * Request an image file.
+	 *
+	 * @param key Key of the image, passed to the listener.
+	 * @param path Full path of the file.
+	 * @param id ID of the request, passed to the listener.
+	 * NULL to load the image without a request, such as when
+	 * preloading it.
+	 */
+	void load(const char* key, const char* path, const char* id);
+
+	/**
+	 * @param key Key of an image.
+	 * @return true if the image is queued or being read.
+	 */
+	bool isLoading(const char* key);
+
+	/**
+	 * @return Number of files queued or being read.
+	 */
+	int getPendingCount();
+
+	/**
+	 * Read the next chunk of the current file.
+	 */
+	void idle();
+
+private:
+	/**
+	 * A queued or running load.
+	 */
+	struct Load
+	{
+		MAUtil::String mKey;
+		MAUtil::String mPath;
+		MAUtil::Vector<MAUtil::String> mIDs;
+	};
+
+	/**
+	 * Open the file of the first load, and get a data
+	 * object for it from the pool.
+	 * @return A negative error code on failure.
+	 */
+	int open();
+
+	/**
+	 * Decode the data, release the file and the data,
+	 * remove the first load and notify the listener.
+	 * @param result A negative error code if the load failed.
+	 */
+	void finish(int result);
+
+	/**
+	 * Close the file and return the data to the pool, if any.
+	 */
+	void close();
+
+	/**
+	 * Not copyable.
+	 */
+	ImageFileLoader(const ImageFileLoader&);
+	ImageFileLoader& operator=(const ImageFileLoader&);
+
+private:
+	/**
+	 * Receives the loaded images.
+	 */
+	ImageFileLoaderListener* mListener;
+
+	/**
+	 * Provides the data objects the files are read into.
+	 */
+	ScratchDataPool* mDataPool;
+
+	/**
+	 * Queued loads, the first one is being read.
+	 */
+	MAUtil::Vector<Load*> mLoads;
+
+	/**
+	 * The file being read, 0 if none.
+	 */
+	MAHandle mFile;
+
+	/**
+	 * Data object the file is read into, from the pool.
+	 */
+	MAHandle mData;
+
+	/**
+	 * Size of the file being read.
+	 */
+	int mSize;
+
+	/**
+	 * Number of bytes read.
+	 */
+	int mOffset;
+
+	/**
+	 * true while registered as an idle listener.
+	 */
+	bool mIdleListening;
+};
+
+#endif
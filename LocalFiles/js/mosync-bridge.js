@@ -92,6 +92,53 @@ var mosync = (function()
 				+ " ";
 		};
 
+		/**
+		 * Encode an integer for the binary protocol. The value
+		 * is written as a 24 bit two's complement number, in four
+		 * characters of six bits each, least significant first.
+		 * Each character is the six bit value plus '0' (48), so
+		 * that the data stays printable ASCII.
+		 */
+		encoder.encodeInt = function(i)
+		{
+			var n = i & 0xFFFFFF;
+			return String.fromCharCode(
+				48 + (n & 63),
+				48 + ((n >> 6) & 63),
+				48 + ((n >> 12) & 63),
+				48 + ((n >> 18) & 63));
+		};
+
+		/**
+		 * @return The length in bytes of a string, as sent to
+		 * C++ in UTF-8.
+		 */
+		encoder.byteLength = function(s)
+		{
+			return unescape(encodeURIComponent(s)).length;
+		};
+
+		/**
+		 * Encode a string for the binary protocol. The string is
+		 * written as its length in bytes, as sent to C++ in UTF-8,
+		 * followed by the string and a separator character.
+		 *
+		 * @param s The string.
+		 * @param byteLength Optional length of the string in
+		 * bytes, if the caller already has it.
+		 */
+		encoder.encodeBinaryString = function(s, byteLength)
+		{
+			if (undefined == byteLength)
+			{
+				byteLength = encoder.byteLength(s);
+			}
+			return ""
+				+ encoder.encodeInt(byteLength)
+				+ s
+				+ " ";
+		};
+
 		return encoder;
 	}
 	)();
@@ -105,10 +152,63 @@ var mosync = (function()
 		var callbackIdCounter = 0;
 		var messageQueue = [];
 		var messageSender = null;
-		var messageQueueJSON = [];
-		var messageSenderJSON = null;
 		var rawMessageQueue = [];
 
+		// Callback ids are sent as 24 bit integers in the
+		// binary protocol, so the counter wraps before that.
+		var maxCallbackId = 0x7FFFFF;
+
+		/**
+		 * Messages must reach C++ in the order they were sent,
+		 * whatever protocol they use. The queue is a list of
+		 * runs of messages of the same protocol, "ms", "ma" or
+		 * "mb", in the order they were sent. A message of the
+		 * same protocol as the last run is added to that run.
+		 * A single timer sends all runs in order, one chunk per
+		 * run.
+		 *
+		 * @param protocol The protocol of the values.
+		 * @param values The values to add to the queue.
+		 */
+		function queueMessage(protocol, values)
+		{
+			var run = messageQueue[messageQueue.length - 1];
+			if (undefined == run || protocol != run.protocol)
+			{
+				run = { protocol: protocol, values: [] };
+				messageQueue.push(run);
+			}
+
+			for (var i = 0; i < values.length; ++i)
+			{
+				run.values.push(values[i]);
+			}
+
+			// Start timer for sender function.
+			// This will get called once sequential
+			// execution of JS code is done.
+			if (null == messageSender)
+			{
+				messageSender = setTimeout(function()
+				{
+					messageSender = null;
+					bridge.sendAll();
+				},
+				1);
+			}
+		}
+
+		/**
+		 * Create a callbackId for a callback function and
+		 * add it to the callback table.
+		 */
+		function addCallback(callbackFun)
+		{
+			callbackIdCounter = (callbackIdCounter % maxCallbackId) + 1;
+			callbackTable[callbackIdCounter] = callbackFun;
+			return callbackIdCounter;
+		}
+
 		/**
 		 * Send message strings to C++. If a callback function is
 		 * supplied, a callbackId parameter will be added to
@@ -136,36 +236,23 @@ var mosync = (function()
 			// a callbackId and add it to the callback table.
 			if (undefined != callbackFun)
 			{
-				callbackIdCounter = callbackIdCounter + 1;
-				callbackTable[callbackIdCounter] = callbackFun;
-				callbackId = callbackIdCounter;
+				callbackId = addCallback(callbackFun);
 			}
 
 			// Add message strings to queue.
+			var values = [];
 			for (var i in messageStrings)
 			{
-				messageQueue.push(messageStrings[i]);
+				values.push(messageStrings[i]);
 			}
 
 			// If we have a callbackId, push that too, as a string value.
 			if (null != callbackId)
 			{
-				messageQueue.push("" + callbackId);
+				values.push("" + callbackId);
 			}
 
-
-			// Start timer for sender function.
-			// This will get called once sequential
-			// execution of JS code is done.
-			if (null == messageSender)
-			{
-				messageSender = setTimeout(function()
-				{
-					messageSender = null;
-					bridge.sendAll();
-				},
-				1);
-			}
+			queueMessage("ms", values);
 		};
 
 		/**
@@ -194,67 +281,122 @@ var mosync = (function()
 			// a callbackId and add it to the callback table.
 			if (undefined != callbackFun)
 			{
-				callbackIdCounter = callbackIdCounter + 1;
-				callbackTable[callbackIdCounter] = callbackFun;
-				message["callbackId"] = callbackIdCounter;
+				message["callbackId"] = addCallback(callbackFun);
 			}
 
 			// Add message to queue.
-			messageQueueJSON.push(message);
+			queueMessage("ma", [message]);
+		};
 
-			// Start timer for sender function.
-			// This will get called once sequential
-			// execution of JS code is done.
-			if (null == messageSenderJSON)
+		/**
+		 * Send a message to C++ using the binary protocol.
+		 * Numbers in the message are sent as fixed-width integers
+		 * and strings as length-prefixed strings, so the receiving
+		 * C++ code must read the values in the same order and
+		 * with the same types. Module and action names are sent
+		 * as integer opcodes.
+		 *
+		 * The id of the callback function, or 0 if there is none,
+		 * is always added after the message values. The message
+		 * is preceded by its length in bytes, so that C++ can
+		 * skip a message it does not know.
+		 *
+		 * Like send, this method queues messages and sends all
+		 * queued messages in one chunk.
+		 *
+		 * @param message An array of numbers and strings.
+		 *
+		 * @param callbackFun An optional function to receive the
+		 * result of the message asynchronosly.
+		 */
+		bridge.sendBinary = function(message, callbackFun)
+		{
+			var callbackId = 0;
+
+			if (undefined != callbackFun)
+			{
+				callbackId = addCallback(callbackFun);
+			}
+
+			// Integers take four bytes, and strings four bytes
+			// for the length, the string and a separator.
+			var data = "";
+			var byteLength = 4;
+			for (var i = 0; i < message.length; ++i)
 			{
-				messageSenderJSON = setTimeout(function()
+				var value = message[i];
+				if ("number" == typeof value)
 				{
-					messageSenderJSON = null;
-					bridge.sendAllJSON();
-				},
-				1);
+					data += mosync.encoder.encodeInt(value);
+					byteLength += 4;
+				}
+				else if (undefined == value)
+				{
+					// Missing handles are sent as 0, like
+					// Number("undefined") in the text protocol.
+					data += mosync.encoder.encodeInt(0);
+					byteLength += 4;
+				}
+				else
+				{
+					var s = String(value);
+					var stringLength = mosync.encoder.byteLength(s);
+					data += mosync.encoder.encodeBinaryString(s, stringLength);
+					byteLength += 5 + stringLength;
+				}
 			}
+			data += mosync.encoder.encodeInt(callbackId);
+
+			queueMessage("mb", [mosync.encoder.encodeInt(byteLength) + data]);
 		};
 
 		/**
-		 * Send all queued message strings.
+		 * Send all queued messages, in the order they were sent.
+		 * Each run of messages of the same protocol is sent as
+		 * one chunk.
 		 */
 		bridge.sendAll = function()
 		{
-			// Check that messageQueue is not empty!
-			if (messageQueue.length > 0)
+			var runs = messageQueue;
+			messageQueue = [];
+
+			for (var i = 0; i < runs.length; ++i)
 			{
-				// Add the "ms:" token to the beginning of the data
-				// to signify that this as a message array. This is
-				// used by the C++ message parser to handle different
-				// types of message formats.
-				var data = "ms:";
-				for (var i in messageQueue)
+				var run = runs[i];
+				var data;
+				if ("ms" == run.protocol)
 				{
-					data += mosync.encoder.encodeString(String(messageQueue[i]));
+					// Add the "ms:" token to the beginning of the data
+					// to signify that this as a message array. This is
+					// used by the C++ message parser to handle different
+					// types of message formats.
+					data = "ms:";
+					for (var j = 0; j < run.values.length; ++j)
+					{
+						data += mosync.encoder.encodeString(String(run.values[j]));
+					}
+				}
+				else if ("ma" == run.protocol)
+				{
+					data = "ma:" + JSON.stringify(run.values);
+				}
+				else
+				{
+					// The "mb:" token tells the C++ side that this
+					// is a binary message stream.
+					data = "mb:" + run.values.join("");
 				}
-
-				messageQueue = [];
 				bridge.sendRaw(data);
 			}
 		};
 
 		/**
-		 * Send all queued JSON messages.
+		 * Send all queued messages. JSON messages are queued with
+		 * the other messages, so this is the same as sendAll.
 		 */
 		bridge.sendAllJSON = function()
 		{
-			// Check that messageQueue is not empty!
-			if (messageQueueJSON.length > 0)
-			{
-				// Add the "ma:" token to the beginning of the data
-				// to signify that this as a message array. This is
-				// used by the C++ message parser to handle different
-				// types of message formats.
-				var data = "ma:" + JSON.stringify(messageQueueJSON);
-				messageQueueJSON = [];
-				bridge.sendRaw(data);
-			}
+			bridge.sendAll();
 		};
 
 		/**
@@ -291,10 +433,65 @@ var mosync = (function()
 				//return an empty string so the runtime knows we don't have anything
 				return "";
 			}
-			var message = rawMessageQueue.pop();
+			// Messages are delivered in the order they were sent.
+			var message = rawMessageQueue.shift();
 			return message;
 		};
 
+		/**
+		 * Get the statistics of the messages handled by C++ since
+		 * the last call: calls and latency histograms of each module
+		 * and action, messages and bytes in, scripts and bytes out,
+		 * and the time spent in the widget API, building replies and
+		 * evaluating them. The statistics are reset by the call.
+		 *
+		 * Example:
+		 *
+		 *   mosync.bridge.getStats(function(stats)
+		 *   {
+		 *       console.log(JSON.stringify(stats));
+		 *   });
+		 *
+		 * @param callbackFun Function called with the statistics
+		 * as an object, see MessageStats.h for the fields. Without
+		 * it the statistics are only reset.
+		 */
+		bridge.getStats = function(callbackFun)
+		{
+			// C++ always reads a callback id, 0 means none.
+			if (undefined == callbackFun)
+			{
+				bridge.send(["Stats", "0"]);
+			}
+			else
+			{
+				bridge.send(["Stats"], callbackFun);
+			}
+		};
+
+		/**
+		 * Write the trace of the messages handled by C++ to the
+		 * file message-trace.bin in the local files directory. Only
+		 * available in builds with MESSAGE_TRACE defined, such as
+		 * Debug builds, other builds reply -1000. See MessageTrace.h
+		 * for the file format.
+		 *
+		 * @param callbackFun Optional function called with the
+		 * number of records written, or a negative error code.
+		 */
+		bridge.dumpTrace = function(callbackFun)
+		{
+			// C++ always reads a callback id, 0 means none.
+			if (undefined == callbackFun)
+			{
+				bridge.send(["Trace", "0"]);
+			}
+			else
+			{
+				bridge.send(["Trace"], callbackFun);
+			}
+		};
+
 		/**
 		 * This function is meant to be used to call back from C++ to
 		 * JavaScript. The function takes a variable number of parameters.
@@ -20,6 +20,39 @@ mosync.nativeui = {};
  */
 mosync.nativeui.callBackTable = {};
 
+/**
+ * Registers the callbacks of an operation and returns the callback ID
+ * to send with it. If there is no success callback, the ID is prefixed
+ * with "!", which tells C++ to only reply if the operation fails, and
+ * if there are no callbacks at all nothing is registered.
+ *
+ * @param callbackID ID of the callback
+ * @param successCallback The function that would be called when the
+ * operation is done
+ * @param errorCallback The function that would be called if an error
+ * happens
+ * @returns The callback ID to send to C++
+ */
+mosync.nativeui.addCallbacks = function(
+		callbackID,
+		successCallback,
+		errorCallback)
+{
+	if(!successCallback)
+	{
+		callbackID = "!" + callbackID;
+	}
+	if(successCallback || errorCallback)
+	{
+		mosync.nativeui.callBackTable[callbackID] =
+			{
+				success: successCallback,
+				error: errorCallback
+			};
+	}
+	return callbackID;
+};
+
 /**
  * List of registered callback functions for WidgetEvents
  */
@@ -30,10 +63,95 @@ mosync.nativeui.eventCallBackTable = {};
  */
 mosync.nativeui.widgetCounter = 0;
 
+/**
+ * Used to generate the references that identify widgets in
+ * messages to C++ until their handles are known.
+ */
+mosync.nativeui.widgetRefCounter = 0;
+
+/**
+ * Returns a new widget reference. References are negative, so
+ * that C++ can tell them from widget handles, which are positive.
+ * C++ maps a reference to the handle of the widget that was
+ * created with it, so operations on a widget can be sent right
+ * after the message that creates it, without waiting for the
+ * handle.
+ */
+mosync.nativeui.newWidgetRef = function()
+{
+	mosync.nativeui.widgetRefCounter--;
+	return mosync.nativeui.widgetRefCounter;
+};
+
+/**
+ * Set to true to send NativeUI messages using the binary
+ * protocol, which is smaller and faster to parse than the
+ * text protocol. See mosync.bridge.sendBinary.
+ */
+mosync.nativeui.useBinaryProtocol = true;
+
+/**
+ * Opcode of the NativeUI module in the binary protocol.
+ * Must match ModuleOpcode in main.cpp.
+ */
+mosync.nativeui.moduleOpcode = 1;
+
+/**
+ * Opcodes of the NativeUI actions in the binary protocol.
+ * Must match NativeUIOpcode in NativeUIMessageHandler.h.
+ */
+mosync.nativeui.opcodes = {
+	maWidgetCreate: 1,
+	maWidgetDestroy: 2,
+	maWidgetAddChild: 3,
+	maWidgetInsertChild: 4,
+	maWidgetRemoveChild: 5,
+	maWidgetModalDialogShow: 6,
+	maWidgetModalDialogHide: 7,
+	maWidgetScreenShow: 8,
+	maWidgetStackScreenPush: 9,
+	maWidgetStackScreenPop: 10,
+	maWidgetSetProperty: 11,
+	maWidgetGetProperty: 12,
+	maWidgetCreateTree: 13,
+	maWidgetSubscribeEvent: 14,
+	maWidgetUnsubscribeEvent: 15
+};
+
+/**
+ * Sends a NativeUI message to C++, using the binary protocol
+ * if it is enabled. Widget handles, indexes and counts in the
+ * message must be numbers and all other values strings, so
+ * that they are encoded with the types that C++ expects.
+ *
+ * @param message An array with the action name followed by
+ * the parameters of the action.
+ * @param processedCallback optional call back for knowing that the message is processed
+ */
+mosync.nativeui.send = function(message, processedCallback)
+{
+	if(mosync.nativeui.useBinaryProtocol)
+	{
+		var binaryMessage = message.slice(0);
+		binaryMessage[0] = mosync.nativeui.opcodes[message[0]];
+		binaryMessage.unshift(mosync.nativeui.moduleOpcode);
+		mosync.bridge.sendBinary(binaryMessage, processedCallback);
+	}
+	else
+	{
+		mosync.bridge.send(["NativeUI"].concat(message), processedCallback);
+	}
+};
+
 
 /**
  * Creates a mosync.nativeui Widget and registers it callback for return of the handle
  *
+ * The widget gets a reference that is used as its handle until the
+ * real handle is returned, so other operations on it can be sent at
+ * once. If the widget can not be created, errorCallback is called and
+ * all later operations on it fail.
+ *
  * @param widgetType A string that includes type of the widget defined in MoSync Api reference
  * @param widgetID An ID set by the user for high level access to the widget
  * @param successCallback The function that would be called when the widget is created
@@ -51,11 +169,13 @@ mosync.nativeui.maWidgetCreate = function(
 {
 
 	callbackID = "create" + widgetID;
+	var widgetRef = mosync.nativeui.newWidgetRef();
+	mosync.nativeui.widgetIDList[widgetID] = widgetRef;
 	var message = [
-     				"NativeUI",
     				"maWidgetCreate",
     				widgetType,
     				widgetID,
+    				widgetRef,
     				callbackID
     				];
 	if(properties)
@@ -69,15 +189,15 @@ mosync.nativeui.maWidgetCreate = function(
 			params[ii] = String(mosync.nativeui.getNativeAttrValue(properties[key]));
 			ii++;
 		}
-		message.push(String(params.length));
+		message.push(params.length);
 		message = message.concat(params);
 	}
 	else
 	{
-		message.push("0");
+		message.push(0);
 	}
 
-	mosync.bridge.send(message, processedCallback);
+	mosync.nativeui.send(message, processedCallback);
 	mosync.nativeui.callBackTable[callbackID] =
 		{
 			success: successCallback,
@@ -85,6 +205,65 @@ mosync.nativeui.maWidgetCreate = function(
 		};
 };
 
+/**
+ * Creates a tree of widgets with a single message. The widgets are
+ * created, given their properties and added to their parents in one
+ * go, and all the handles are returned in one callback.
+ *
+ * @param nodes Array of nodes in preorder, a parent must come before
+ * its children. Each node is an object with the fields type, id,
+ * parentIndex (index of the parent node in the array, -1 for none)
+ * and properties (optional). Like maWidgetCreate, operations on the
+ * widgets can be sent without waiting for the callback.
+ * @param successCallback The function that would be called with the
+ * array of handles, in node order. A node that could not be created
+ * has a negative error code instead of a handle.
+ * @param errorCallback The function that would be called if the
+ * message could not be processed
+ * @param processedCallback optional call back for knowing that the message is processed
+ */
+mosync.nativeui.maWidgetCreateTree = function(
+		nodes,
+		successCallback,
+		errorCallback,
+		processedCallback)
+{
+	var callbackID = "createTree" + mosync.nativeui.widgetCounter;
+	mosync.nativeui.widgetCounter++;
+	var message = [
+					"maWidgetCreateTree",
+					callbackID,
+					nodes.length
+					];
+	for(var i = 0; i < nodes.length; i++)
+	{
+		var node = nodes[i];
+		var params = [];
+		for(var key in node.properties)
+		{
+			params.push(String(mosync.nativeui.getNativeAttrName(key)));
+			params.push(String(mosync.nativeui.getNativeAttrValue(node.properties[key])));
+		}
+		var widgetRef = mosync.nativeui.newWidgetRef();
+		mosync.nativeui.widgetIDList[node.id] = widgetRef;
+		message.push(
+			node.type,
+			node.id,
+			widgetRef,
+			node.parentIndex,
+			params.length);
+		message = message.concat(params);
+	}
+
+	mosync.nativeui.send(message, processedCallback);
+	mosync.nativeui.callBackTable[callbackID] =
+		{
+			success: successCallback,
+			error: errorCallback,
+			nodes: nodes
+		};
+};
+
 /**
  * Destroys a widget
  *
@@ -94,24 +273,29 @@ mosync.nativeui.maWidgetCreate = function(
  */
 mosync.nativeui.maWidgetDestroy = function(
 		widgetID,
-		successCallBack,
+		successCallback,
 		errorCallback,
 		processedCallback)
 {
-	callbackID = "destroy" + widgetID;
+	var callbackID = mosync.nativeui.addCallbacks(
+			"destroy" + widgetID,
+			successCallback,
+			errorCallback);
 	var mosyncWidgetHandle = mosync.nativeui.widgetIDList[widgetID];
-	mosync.bridge.send(
+
+	// Forget the widget, so that a late createCallback does not
+	// register the handle again.
+	delete mosync.nativeui.widgetIDList[widgetID];
+
+	// C++ forgets the event subscriptions of the widget, since
+	// the handle can be reused, so forget the listeners too.
+	mosync.nativeui.moveEventListeners(mosyncWidgetHandle, null);
+	mosync.nativeui.send(
 			[
-				"NativeUI",
 				"maWidgetDestroy",
-				mosyncWidgetHandle + "",
+				mosyncWidgetHandle,
 				callbackID
 			], processedCallback);
-	mosync.nativeui.callBackTable[callbackID] =
-		{
-			success: successCallback,
-			error:errorCallback
-		};
 };
 
 /**
@@ -130,22 +314,19 @@ mosync.nativeui.maWidgetAddChild = function(
 		errorCallback,
 		processedCallback)
 {
-	callbackID = "addChild" + widgetID + childID;
+	var callbackID = mosync.nativeui.addCallbacks(
+			"addChild" + widgetID + childID,
+			successCallback,
+			errorCallback);
 	var mosyncWidgetHandle = mosync.nativeui.widgetIDList[widgetID];
 	var mosyncChildHandle = mosync.nativeui.widgetIDList[childID];
-	mosync.bridge.send(
+	mosync.nativeui.send(
 			[
-				"NativeUI",
 				"maWidgetAddChild",
-				mosyncWidgetHandle + "",
-				mosyncChildHandle + "",
+				mosyncWidgetHandle,
+				mosyncChildHandle,
 				callbackID
 			], processedCallback);
-	mosync.nativeui.callBackTable[callbackID] =
-		{
-			success: successCallback,
-			error:errorCallback
-		};
 };
 
 
@@ -167,23 +348,20 @@ mosync.nativeui.maWidgetInsertChild = function(
 		errorCallback,
 		processedCallback)
 {
-	callbackID = "insertChild" + widgetID;
+	var callbackID = mosync.nativeui.addCallbacks(
+			"insertChild" + widgetID,
+			successCallback,
+			errorCallback);
 	var mosyncWidgetHandle = mosync.nativeui.widgetIDList[widgetID];
 	var mosyncChildHandle = mosync.nativeui.widgetIDList[childID];
-	mosync.bridge.send(
+	mosync.nativeui.send(
 			[
-				"NativeUI",
 				"maWidgetInsertChild",
-				mosyncWidgetHandle + "",
-				mosyncChildHandle + "",
-				index,
+				mosyncWidgetHandle,
+				mosyncChildHandle,
+				Number(index),
 				callbackID
 			], processedCallback);
-	mosync.nativeui.callBackTable[callbackID] =
-		{
-			success: successCallback,
-			error:errorCallback
-		};
 };
 
 /**
@@ -200,20 +378,17 @@ mosync.nativeui.maWidgetRemoveChild = function(
 		errorCallback,
 		processedCallback)
 {
-	callbackID = "removeChild" + childID;
+	var callbackID = mosync.nativeui.addCallbacks(
+			"removeChild" + childID,
+			successCallback,
+			errorCallback);
 	var mosyncChildHandle = mosync.nativeui.widgetIDList[childID];
-	mosync.bridge.send(
+	mosync.nativeui.send(
 			[
-				"NativeUI",
 				"maWidgetRemoveChild",
-				mosyncChildHandle +"",
+				mosyncChildHandle,
 				callbackID
 			], processedCallback);
-	mosync.nativeui.callBackTable[callbackID] =
-		{
-			success: successCallback,
-			error:errorCallback
-		};
 };
 
 /**
@@ -230,20 +405,17 @@ mosync.nativeui.maWidgetScreenShow = function(
 		errorCallback,
 		processedCallback)
 {
-	callbackID = "screenShow" + screenID;
+	var callbackID = mosync.nativeui.addCallbacks(
+			"screenShow" + screenID,
+			successCallback,
+			errorCallback);
 	var mosyncScreenHandle = mosync.nativeui.widgetIDList[screenID];
-	mosync.bridge.send(
+	mosync.nativeui.send(
 			[
-				"NativeUI",
 				"maWidgetScreenShow",
-				mosyncScreenHandle + "",
+				mosyncScreenHandle,
 				callbackID
 			], processedCallback);
-	mosync.nativeui.callBackTable[callbackID] =
-		{
-			success: successCallback,
-			error:errorCallback
-		};
 };
 
 /**
@@ -259,20 +431,17 @@ mosync.nativeui.maWidgetModalDialogShow = function(
 		errorCallback,
 		processedCallback)
 {
-	callbackID = "dialogShow" + dialogID;
+	var callbackID = mosync.nativeui.addCallbacks(
+			"dialogShow" + dialogID,
+			successCallback,
+			errorCallback);
 	var mosyncDialogHandle = mosync.nativeui.widgetIDList[dialogID];
-	mosync.bridge.send(
+	mosync.nativeui.send(
 			[
-				"NativeUI",
 				"maWidgetModalDialogShow",
-				mosyncDialogHandle + "",
+				mosyncDialogHandle,
 				callbackID
 			], processedCallback);
-	mosync.nativeui.callBackTable[callbackID] =
-		{
-			success: successCallback,
-			error:errorCallback
-		};
 };
 
 /**
@@ -288,20 +457,17 @@ mosync.nativeui.maWidgetModalDialogHide = function(
 		errorCallback,
 		processedCallback)
 {
-	callbackID = "dialogHide" + dialogID;
+	var callbackID = mosync.nativeui.addCallbacks(
+			"dialogHide" + dialogID,
+			successCallback,
+			errorCallback);
 	var mosyncDialogHandle = mosync.nativeui.widgetIDList[dialogID];
-	mosync.bridge.send(
+	mosync.nativeui.send(
 			[
-				"NativeUI",
 				"maWidgetModalDialogHide",
-				mosyncDialogHandle + "",
+				mosyncDialogHandle,
 				callbackID
 			], processedCallback);
-	mosync.nativeui.callBackTable[callbackID] =
-		{
-			success: successCallback,
-			error:errorCallback
-		};
 };
 
 /**
@@ -322,22 +488,19 @@ mosync.nativeui.maWidgetStackScreenPush = function(
 		errorCallback,
 		processedCallback)
 {
-	callbackID = "StackScreenPush" + screenID;
+	var callbackID = mosync.nativeui.addCallbacks(
+			"StackScreenPush" + screenID,
+			successCallback,
+			errorCallback);
 	var mosyncStackScreenHandle = mosync.nativeui.widgetIDList[stackScreenID];
 	var mosyncScreenHandle = mosync.nativeui.widgetIDList[screenID];
-	mosync.bridge.send(
+	mosync.nativeui.send(
 			[
-				"NativeUI",
 				"maWidgetStackScreenPush",
-				mosyncStackScreenHandle + "",
-				mosyncScreenHandle + "",
+				mosyncStackScreenHandle,
+				mosyncScreenHandle,
 				callbackID
 			], processedCallback);
-	mosync.nativeui.callBackTable[callbackID] =
-		{
-			success: successCallback,
-			error:errorCallback
-		};
 };
 
 /**
@@ -356,22 +519,19 @@ mosync.nativeui.maWidgetStackScreenPop = function(
 		errorCallback,
 		processedCallback)
 {
-	callbackID = "StackScreenPop" +
-		stackScreenID +
-		Math.round(Math.random()*100);
+	var callbackID = mosync.nativeui.addCallbacks(
+			"StackScreenPop" +
+				stackScreenID +
+				Math.round(Math.random()*100),
+			successCallback,
+			errorCallback);
 	var mosyncStackScreenHandle = mosync.nativeui.widgetIDList[stackScreenID];
-	mosync.bridge.send(
+	mosync.nativeui.send(
 			[
-				"NativeUI",
 				"maWidgetStackScreenPop",
 				mosyncStackScreenHandle,
 				callbackID
 			], processedCallback);
-	mosync.nativeui.callBackTable[callbackID] =
-		{
-			success: successCallback,
-			error:errorCallback
-		};
 };
 
 mosync.nativeui.widgetPropertyIndexNo = 0;
@@ -395,22 +555,19 @@ mosync.nativeui.maWidgetSetProperty = function(
 {
 
 	//make sure the id is unique for this call
-	callbackID = "setProperty" + widgetID + property + mosync.nativeui.widgetPropertyIndexNo++;
+	var callbackID = mosync.nativeui.addCallbacks(
+			"setProperty" + widgetID + property + mosync.nativeui.widgetPropertyIndexNo++,
+			successCallback,
+			errorCallback);
 	var widgetHandle = mosync.nativeui.widgetIDList[widgetID];
-	mosync.bridge.send(
+	mosync.nativeui.send(
 			[
-				"NativeUI",
 				"maWidgetSetProperty",
-				widgetHandle + "",
+				widgetHandle,
 				property,
 				value + "",
 				callbackID
 			], processedCallback);
-	mosync.nativeui.callBackTable[callbackID] =
-		{
-			success: successCallback,
-			error:errorCallback
-		};
 };
 
 /**
@@ -429,21 +586,18 @@ mosync.nativeui.maWidgetGetProperty = function(
 		errorCallback,
 		processedCallback)
 {
-	callbackID = "getProperty" + widgetID + property;
+	var callbackID = mosync.nativeui.addCallbacks(
+			"getProperty" + widgetID + property,
+			successCallback,
+			errorCallback);
 	var widgetHandle = mosync.nativeui.widgetIDList[widgetID];
-	mosync.bridge.send(
+	mosync.nativeui.send(
 			[
-				"NativeUI",
 				"maWidgetGetProperty",
-				widgetHandle +"",
+				widgetHandle,
 				property,
 				callbackID
 			], processedCallback);
-	mosync.nativeui.callBackTable[callbackID] =
-		{
-			success: successCallback,
-			error:errorCallback
-		};
 };
 
 
@@ -457,9 +611,17 @@ mosync.nativeui.maWidgetGetProperty = function(
 mosync.nativeui.createCallback = function(callbackID, widgetID, handle)
 {
 	var callBack = mosync.nativeui.callBackTable[callbackID];
-	mosync.nativeui.widgetIDList[widgetID] = handle;
 
-	if(callBack.success)
+	// Use the handle instead of the reference from now on, unless
+	// the widget has already been destroyed or replaced.
+	var widgetRef = mosync.nativeui.widgetIDList[widgetID];
+	if(widgetRef < 0)
+	{
+		mosync.nativeui.widgetIDList[widgetID] = handle;
+		mosync.nativeui.moveEventListeners(widgetRef, handle);
+	}
+
+	if(callBack && callBack.success)
 	{
 		var args = Array.prototype.slice.call(arguments);
 		args.shift();
@@ -467,11 +629,63 @@ mosync.nativeui.createCallback = function(callbackID, widgetID, handle)
 	}
 };
 
-mosync.nativeui.success = function(callbackID)
+/**
+ * This function is called by C++ when a tree of widgets has been
+ * created by maWidgetCreateTree. It stores the handles and tells the
+ * NativeWidgetElement objects of the nodes that they are created.
+ *
+ * @param callbackID Javascript Id of the callback
+ * @param handles The widget handles or error codes, in node order
+ */
+mosync.nativeui.createTreeCallback = function(callbackID, handles)
 {
 	var callBack = mosync.nativeui.callBackTable[callbackID];
+	delete mosync.nativeui.callBackTable[callbackID];
+	var nodes = callBack.nodes;
+	var elements = [];
+
+	// Register all handles first, so that the success callbacks
+	// of the widgets can refer to the other widgets in the tree.
+	// Failed widgets keep their references, C++ fails all
+	// operations on them.
+	for(var i = 0; i < nodes.length; i++)
+	{
+		var widgetRef = mosync.nativeui.widgetIDList[nodes[i].id];
+		if(handles[i] > 0 && widgetRef < 0)
+		{
+			mosync.nativeui.widgetIDList[nodes[i].id] = handles[i];
+			mosync.nativeui.moveEventListeners(widgetRef, handles[i]);
+		}
+		elements[i] = mosync.nativeui.NativeElementsTable[nodes[i].id];
+	}
+
+	for(var i = 0; i < nodes.length; i++)
+	{
+		if(elements[i] == undefined)
+		{
+			continue;
+		}
+		if(handles[i] > 0)
+		{
+			elements[i].createSucceeded(handles[i]);
+		}
+		else
+		{
+			elements[i].createFailed(handles[i]);
+		}
+	}
 
 	if(callBack.success)
+	{
+		callBack.success.apply(null, [handles]);
+	}
+};
+
+mosync.nativeui.success = function(callbackID)
+{
+	var callBack = mosync.nativeui.callBackTable[callbackID];
+
+	if(callBack && callBack.success)
 	{
 		var args = Array.prototype.slice.call(arguments);
 		//remove the callbakID from the argument list
@@ -481,20 +695,20 @@ mosync.nativeui.success = function(callbackID)
 };
 
 /**
- * The callback function for getting the widgetProperty.
- * If a property callback is registered it will be called
+ * Is called by C++ when an operation has failed. If an error
+ * callback is registered it will be called with the error code.
+ * Operations sent without callbacks have no entry, and their
+ * errors are ignored.
  *
- * @param widgetHandle C++ ID of the widget sent from C++
- * @param property retrieved property's name
- * @param value value for the retrieved property
+ * @param callbackID Javascript Id of the callback
  */
 mosync.nativeui.error = function(callbackID)
 {
 	var callBack = mosync.nativeui.callBackTable[callbackID];
-	var args = Array.prototype.slice.call(arguments);
-	args.shift();
-	if(callBack.error != undefined){
+	if(callBack && callBack.error != undefined){
 		var args = Array.prototype.slice.call(arguments);
+		//remove the callbakID from the argument list
+		args.shift();
 		callBack.error.apply(null, args);
 	}
 };
@@ -527,8 +741,106 @@ mosync.nativeui.event = function(widgetHandle, eventType)
 	}
 };
 
+/**
+ * Moves the event listeners of a widget from the reference it
+ * was created with to its handle, once the handle is known, since
+ * C++ sends the events with the handle. Listeners that are left
+ * under the handle belong to a widget that has been destroyed,
+ * maybe together with its parent, and are dropped.
+ *
+ * @param widgetRef The reference or handle the listeners are
+ * registered with.
+ * @param handle The handle to register them with, null to drop
+ * the listeners.
+ */
+mosync.nativeui.moveEventListeners = function(widgetRef, handle)
+{
+	var table = mosync.nativeui.eventCallBackTable;
+	var refPrefix = String(widgetRef);
+	var handlePrefix = String(handle);
+
+	// Keys are the handle followed by the event type, which
+	// starts with a letter.
+	for(var key in table)
+	{
+		if((handle != null) &&
+			(key.indexOf(handlePrefix) == 0) &&
+			isNaN(key.charAt(handlePrefix.length)))
+		{
+			delete table[key];
+		}
+	}
+	for(var key in table)
+	{
+		if((key.indexOf(refPrefix) == 0) &&
+			isNaN(key.charAt(refPrefix.length)))
+		{
+			if(handle != null)
+			{
+				table[handlePrefix + key.substr(refPrefix.length)] = table[key];
+			}
+			delete table[key];
+		}
+	}
+};
+
 mosync.nativeui.NativeElementsTable = {};
 
+/**
+ * Tells C++ to send events of a type from a widget. C++ only
+ * sends the events that have been subscribed to.
+ *
+ * @param widgetID JavaScript ID of the widget.
+ * @param eventType Type of the events.
+ */
+mosync.nativeui.maWidgetSubscribeEvent = function(
+		widgetID,
+		eventType,
+		successCallback,
+		errorCallback,
+		processedCallback)
+{
+	var callbackID = mosync.nativeui.addCallbacks(
+			"subscribeEvent" + widgetID + eventType,
+			successCallback,
+			errorCallback);
+	var widgetHandle = mosync.nativeui.widgetIDList[widgetID];
+	mosync.nativeui.send(
+			[
+				"maWidgetSubscribeEvent",
+				widgetHandle,
+				eventType,
+				callbackID
+			], processedCallback);
+};
+
+/**
+ * Tells C++ to stop sending events of a type from a widget.
+ *
+ * @param widgetID JavaScript ID of the widget.
+ * @param eventType Type of the events.
+ */
+mosync.nativeui.maWidgetUnsubscribeEvent = function(
+		widgetID,
+		eventType,
+		successCallback,
+		errorCallback,
+		processedCallback)
+{
+	var callbackID = mosync.nativeui.addCallbacks(
+			"unsubscribeEvent" + widgetID + eventType,
+			successCallback,
+			errorCallback);
+	var widgetHandle = mosync.nativeui.widgetIDList[widgetID];
+	mosync.nativeui.send(
+			[
+				"maWidgetUnsubscribeEvent",
+				widgetHandle,
+				eventType,
+				callbackID
+			], processedCallback);
+};
+
 /**
  * Registers a callback function for receiving widget events.
  *
@@ -551,10 +863,54 @@ mosync.nativeui.registerEventListener = function(
 	else
 	{
 		mosync.nativeui.eventCallBackTable[callbackID] = [listenerFunction];
+
+		// The first listener for this event of this widget,
+		// ask C++ to start sending it.
+		mosync.nativeui.maWidgetSubscribeEvent(widgetID, eventType);
 	}
 
 };
 
+/**
+ * Removes a callback function registered with
+ * registerEventListener.
+ *
+ * @param widgetID JavaScript ID of the widget.
+ * @param eventType Type of the events.
+ * @param listenerFunction The function to remove.
+ */
+mosync.nativeui.unregisterEventListener = function(
+		widgetID,
+		eventType,
+		listenerFunction)
+{
+	var widgetHandle = mosync.nativeui.widgetIDList[widgetID];
+	var callbackID = widgetHandle + eventType;
+	var listeners = mosync.nativeui.eventCallBackTable[callbackID];
+	if(!listeners)
+	{
+		return;
+	}
+
+	for(var i = 0; i < listeners.length; i++)
+	{
+		if(listeners[i] == listenerFunction)
+		{
+			listeners.splice(i, 1);
+			break;
+		}
+	}
+
+	if(listeners.length == 0)
+	{
+		delete mosync.nativeui.eventCallBackTable[callbackID];
+
+		// The last listener for this event of this widget,
+		// ask C++ to stop sending it.
+		mosync.nativeui.maWidgetUnsubscribeEvent(widgetID, eventType);
+	}
+};
+
 
 /**
  *
@@ -563,6 +919,12 @@ mosync.nativeui.registerEventListener = function(
  * @class represents a widget that can be manipulated
  * @param widgetType Type of the widget that has been created
  * @param widgetID ID of the widget used for identifying the widget(can be ignored by the user)
+ * @param deferCreate (optional) if true, the widget is not created by
+ * this object, but as part of a tree by maWidgetCreateTree, and must
+ * not be used before the tree has been sent
+ *
+ * Operations are sent at once, also before the widget has been created,
+ * since C++ knows the widget by the reference it was created with.
  *
  */
 mosync.nativeui.NativeWidgetElement = function(
@@ -570,46 +932,16 @@ mosync.nativeui.NativeWidgetElement = function(
 		widgetID,
 		params,
 		successCallback,
-		errorCallback)
+		errorCallback,
+		deferCreate)
 {
 	var self = this;
 
-	self.commandQueue = [];
-
 	self.params = params;
 
 	self.eventQueue = [];
 
 	var type = widgetType;
-	/**
-	 * Internal function used for synchronizing the widget operations.
-	 * It makes sure that the widget is created before calling any other functions.
-	 *
-	 */
-	this.processedMessage = function()
-	{
-		function clone(obj) {
-		    if (null == obj || "object" != typeof obj) return obj;
-		    var copy = obj.constructor();
-		    for (var attr in obj) {
-		        if (obj.hasOwnProperty(attr)) copy[attr] = obj[attr];
-		    }
-		    return copy;
-		}
-		//Clone the command Queue and try to send everything at once.
-		var newCommandQueue = clone(self.commandQueue);
-		self.commandQueue = [];
-		if(newCommandQueue.length > 0)
-		{
-			for(var i = 0; i < newCommandQueue.length; i++)
-			{
-				newCommandQueue[i].func.apply(
-						null,
-						newCommandQueue[i].args);
-			}
-		}
-
-	};
 
 	//Detect to see if the current widget is a screen
 	this.isScreen = ((type == "Screen") ||
@@ -669,16 +1001,37 @@ mosync.nativeui.NativeWidgetElement = function(
 		}
 
 	};
+	/**
+	 * Called by createTreeCallback when the widget has been
+	 * created as part of a tree.
+	 */
+	this.createSucceeded = function(widgetHandle)
+	{
+		onSuccess(self.id, widgetHandle);
+	};
+
+	/**
+	 * Called by createTreeCallback when the widget could not
+	 * be created as part of a tree.
+	 */
+	this.createFailed = function(errorCode)
+	{
+		onError(errorCode);
+	};
+
 	/*
 	 * Create the widget in the Native Side
 	 */
-	mosync.nativeui.maWidgetCreate(
-			widgetType,
-			self.id,
-			onSuccess,
-			onError,
-			self.processedMessage,
-			self.params);
+	if(!deferCreate)
+	{
+		mosync.nativeui.maWidgetCreate(
+				widgetType,
+				self.id,
+				onSuccess,
+				onError,
+				null,
+				self.params);
+	}
 
 	/**
 	 * sets a property to the widget in question
@@ -689,25 +1042,12 @@ mosync.nativeui.NativeWidgetElement = function(
 			successCallback,
 			errorCallback)
 	{
-		if(self.created)
-		{
-			mosync.nativeui.maWidgetSetProperty(
-					self.id,
-					property,
-					value,
-					successCallback,
-					errorCallback,
-					self.processedMessage);
-		}
-		else
-		{
-					self.commandQueue.push(
-							{func:self.setProperty,
-							args:[property,
-							      value,
-							      successCallback,
-							      errorCallback]});
-		}
+		mosync.nativeui.maWidgetSetProperty(
+				self.id,
+				property,
+				value,
+				successCallback,
+				errorCallback);
 	};
 
 	/**
@@ -722,23 +1062,11 @@ mosync.nativeui.NativeWidgetElement = function(
 			successCallback,
 			errorCallback)
 	{
-		if(self.created)
-		{
-			mosync.nativeui.maWidgetGetProperty(
-				self.id,
-				property,
-				successCallback,
-				errorCallback,
-				self.processedMessage);
-		}
-		else
-		{
-			self.commandQueue.push(
-					{func:self.getProperty,
-					args:[property,
-					successCallback,
-					errorCallback]});
-		}
+		mosync.nativeui.maWidgetGetProperty(
+			self.id,
+			property,
+			successCallback,
+			errorCallback);
 	};
 
 	/**
@@ -750,6 +1078,8 @@ mosync.nativeui.NativeWidgetElement = function(
 	 */
 	this.addEventListener = function(eventType, listenerFunction)
 	{
+		// Listeners are registered by handle, which is only
+		// known when the widget has been created.
 		if(self.created)
 		{
 			mosync.nativeui.registerEventListener(
@@ -768,6 +1098,34 @@ mosync.nativeui.NativeWidgetElement = function(
 
 	};
 
+	/**
+	 * Removes an event listener added with addEventListener.
+	 *
+	 * @param eventType type of the event
+	 * @param listenerFunction the function to remove
+	 */
+	this.removeEventListener = function(eventType, listenerFunction)
+	{
+		if(self.created)
+		{
+			mosync.nativeui.unregisterEventListener(
+					self.id,
+					eventType,
+					listenerFunction);
+			return;
+		}
+
+		for(var i = 0; i < self.eventQueue.length; i++)
+		{
+			if(self.eventQueue[i].event == eventType &&
+				self.eventQueue[i].callback == listenerFunction)
+			{
+				self.eventQueue.splice(i, 1);
+				return;
+			}
+		}
+	};
+
 	/**
 	 * Adds a child widget to the cureent widget
 	 *
@@ -778,24 +1136,11 @@ mosync.nativeui.NativeWidgetElement = function(
 	 */
 	this.addChild = function(childID, successCallback, errorCallback)
 	{
-
-		if((self.created) &&(childID != undefined))
-		{
-			mosync.nativeui.maWidgetAddChild(
-					self.id,
-					childID,
-					successCallback,
-					errorCallback,
-					self.processedMessage);
-		}
-		else
-		{
-			self.commandQueue.push(
-					{func:self.addChild,
-					args:[childID,
-						successCallback,
-						errorCallback]});
-		}
+		mosync.nativeui.maWidgetAddChild(
+				self.id,
+				childID,
+				successCallback,
+				errorCallback);
 	};
 
 	/**
@@ -808,25 +1153,12 @@ mosync.nativeui.NativeWidgetElement = function(
 	 */
 	this.insertChild = function(childID, index, successCallback, errorCallback)
 	{
-		if((self.created) &&(childID != undefined))
-		{
-			mosync.nativeui.maWidgetInsertChild(
-					self.id,
-					childID,
-					index,
-					successCallback,
-					errorCallback,
-					self.processedMessage);
-		}
-		else
-		{
-			self.commandQueue.push(
-					{func:self.insertChild,
-					args:[childID,
-						index,
-						successCallback,
-						errorCallback]});
-		}
+		mosync.nativeui.maWidgetInsertChild(
+				self.id,
+				childID,
+				index,
+				successCallback,
+				errorCallback);
 	};
 
 	/**
@@ -839,22 +1171,10 @@ mosync.nativeui.NativeWidgetElement = function(
 	 */
 	this.removeChild = function(childID, successCallback, errorCallback)
 	{
-		if((self.created) &&(childID != undefined))
-		{
-			mosync.nativeui.maWidgetRemoveChild(
-					childID,
-					successCallback,
-					errorCallback,
-					self.processedMessage);
-		}
-		else
-		{
-			self.commandQueue.push(
-					{func:self.removeChild,
-					args:[childID,
-						successCallback,
-						errorCallback]});
-		}
+		mosync.nativeui.maWidgetRemoveChild(
+				childID,
+				successCallback,
+				errorCallback);
 	};
 
 	/**
@@ -867,30 +1187,11 @@ mosync.nativeui.NativeWidgetElement = function(
 	 */
 	this.addTo = function(parentId, successCallback, errorCallback)
 	{
-		var parent = document.getNativeElementById(parentId);
-		if((self.created) &&
-				(parent != undefined) &&
-				(parent.created) &&
-				(self.created != undefined))
-		{
-			mosync.nativeui.maWidgetAddChild(
-					parentId,
-					self.id,
-					successCallback,
-					errorCallback,
-					self.processedMessage);
-		}
-		else
-		{
-			self.commandQueue.push(
-					{func:self.addTo,
-					args:[
-							parentId,
-							successCallback,
-							errorCallback
-						]
-					});
-		}
+		mosync.nativeui.maWidgetAddChild(
+				parentId,
+				self.id,
+				successCallback,
+				errorCallback);
 	};
 	/*
 	 * Only create screen related functions if the widget is a screen
@@ -907,20 +1208,9 @@ mosync.nativeui.NativeWidgetElement = function(
 		 */
 		this.show = function(successCallback, errorCallback)
 		{
-			if(self.created)
-			{
-					mosync.nativeui.maWidgetScreenShow(self.id,
-							successCallback,
-							errorCallback,
-							self.processedMessage);
-			}
-			else
-			{
-				self.commandQueue.push(
-						{func:self.show,
-						args:[successCallback,
-							errorCallback]});
-			}
+			mosync.nativeui.maWidgetScreenShow(self.id,
+					successCallback,
+					errorCallback);
 		};
 
 		/**
@@ -932,30 +1222,11 @@ mosync.nativeui.NativeWidgetElement = function(
 		 */
 		this.pushTo = function(stackScreenID, successCallback, errorCallback)
 		{
-			var stackScreen = document.getNativeElementById(stackScreenID);
-			if((self.created) &&
-					(stackScreen != undefined) &&
-					(stackScreen.created) &&
-					(self.created != undefined))
-			{
-				mosync.nativeui.maWidgetStackScreenPush(
-						stackScreenID,
-						self.id,
-						successCallback,
-						errorCallback,
-						self.processedMessage);
-			}
-			else
-			{
-				self.commandQueue.push(
-						{func:self.pushTo,
-						args:[
-								stackScreenID,
-								successCallback,
-								errorCallback
-							]
-						});
-			}
+			mosync.nativeui.maWidgetStackScreenPush(
+					stackScreenID,
+					self.id,
+					successCallback,
+					errorCallback);
 		};
 
 		/**
@@ -966,24 +1237,10 @@ mosync.nativeui.NativeWidgetElement = function(
 		 */
 		this.pop = function(successCallback, errorCallback)
 		{
-			if(self.created)
-			{
-				mosync.nativeui.maWidgetStackScreenPop(
-						self.id,
-						successCallback,
-						errorCallback,
-						self.processedMessage);
-			}
-			else
-			{
-				self.commandQueue.push(
-						{func:self.pop,
-						args:[
-								successCallback,
-								errorCallback
-							]
-						});
-			}
+			mosync.nativeui.maWidgetStackScreenPop(
+					self.id,
+					successCallback,
+					errorCallback);
 		};
 	}
 	/*
@@ -1000,24 +1257,10 @@ mosync.nativeui.NativeWidgetElement = function(
 		 */
 		this.showDialog = function(successCallback, errorCallback)
 		{
-			if(self.created)
-			{
-				mosync.nativeui.maWidgetModalDialogShow(
-						self.id,
-						successCallback,
-						errorCallback,
-						self.processedMessage);
-			}
-			else
-			{
-				self.commandQueue.push(
-						{func:self.showDialog,
-						args:[
-								successCallback,
-								errorCallback
-							]
-						});
-			}
+			mosync.nativeui.maWidgetModalDialogShow(
+					self.id,
+					successCallback,
+					errorCallback);
 		};
 
 		/**
@@ -1029,24 +1272,10 @@ mosync.nativeui.NativeWidgetElement = function(
 		 */
 		this.hideDialog = function(successCallback, errorCallback)
 		{
-			if(self.created)
-			{
-				mosync.nativeui.maWidgetModalDialogHide(
-						self.id,
-						successCallback,
-						errorCallback,
-						self.processedMessage);
-			}
-			else
-			{
-				self.commandQueue.push(
-						{func:self.hideDialog,
-						args:[
-								successCallback,
-								errorCallback
-							]
-						});
-			}
+			mosync.nativeui.maWidgetModalDialogHide(
+					self.id,
+					successCallback,
+					errorCallback);
 		};
 
 	}
@@ -1079,6 +1308,8 @@ document.getNativeElementById = function(widgetID)
  * @param widgetID ID that will be used for refrencing to the widget
  * @param successCallback (optional) a function that will be called when the operation is done successfully
  * @param errorCallback (optional) a function that will be called when the operation encounters an error
+ * @param deferCreate (optional) if true, the widget is created later
+ * as part of a tree, see mosync.nativeui.maWidgetCreateTree
  *
  * @returns {mosync.nativeui.NativeWidgetElement}
  */
@@ -1087,14 +1318,16 @@ mosync.nativeui.create = function(
 		widgetID,
 		params,
 		successCallback,
-		errorCallback)
+		errorCallback,
+		deferCreate)
 {
 	var widget = new mosync.nativeui.NativeWidgetElement(
 			widgetType,
 			widgetID,
 			params,
 			successCallback,
-			errorCallback);
+			errorCallback,
+			deferCreate);
 	return widget;
 };
 
@@ -1285,8 +1518,13 @@ mosync.nativeui.getNativeAttrValue = function(value)
  * Creates a widget, sets its property and adds it to its parent.
  * @param widgetID ID of the widget in question
  * @param parentID Id of the parentWidget
+ * @param treeNodes (optional) if given, the widget is not created at
+ * once but added as a node to this array, to be created with
+ * mosync.nativeui.maWidgetCreateTree
+ * @param parentIndex index of the parent node in treeNodes, -1 for none
+ * @returns the index of the node in treeNodes
  */
-mosync.nativeui.createWidget = function(widget, parent)
+mosync.nativeui.createWidget = function(widget, parent, treeNodes, parentIndex)
 {
 	var widgetNode = widget;
 	var widgetID = widget.id;
@@ -1359,7 +1597,18 @@ mosync.nativeui.createWidget = function(widget, parent)
 				{
 					thisWidget.addEventListener(eventList.type, eventList.func);
 				}
-			}, null);
+			}, null, (treeNodes != undefined));
+	if(treeNodes != undefined)
+	{
+		treeNodes.push(
+			{
+				type: widgetType,
+				id: widgetID,
+				parentIndex: parentIndex,
+				properties: propertyList
+			});
+		return treeNodes.length - 1;
+	}
 	if(parent != null)
 	{
 		currentWidget.addTo(parent.id);
@@ -1385,14 +1634,22 @@ mosync.nativeui.UIReady = function()
  *
  * @param parentid ID of the parent Widget
  * @param id ID of the currewnt widget
+ * @param treeNodes (optional) array that collects the widgets as
+ * nodes for mosync.nativeui.maWidgetCreateTree instead of creating
+ * them one by one
+ * @param parentIndex index of the parent node in treeNodes
  */
-mosync.nativeui.createChilds = function(parent, widget)
+mosync.nativeui.createChilds = function(parent, widget, treeNodes, parentIndex)
 {
 	if(widget != undefined)
 	{
   		var node = widget;
   		var nodeChilds = node.childNodes;
-  		mosync.nativeui.createWidget(node, parent);
+  		var nodeIndex = mosync.nativeui.createWidget(
+  				node,
+  				parent,
+  				treeNodes,
+  				parentIndex);
   		if(nodeChilds !=null)
   		{
 	  		for(var i=0; i<nodeChilds.length;i++)
@@ -1408,7 +1665,11 @@ mosync.nativeui.createChilds = function(parent, widget)
 	  					nodeChilds[i].id = "widget" + mosync.nativeui.widgetCounter;
 	  					mosync.nativeui.widgetCounter++;
 	  				}
-		  			mosync.nativeui.createChilds(node, nodeChilds[i]);
+		  			mosync.nativeui.createChilds(
+		  					node,
+		  					nodeChilds[i],
+		  					treeNodes,
+		  					nodeIndex);
 	  			}
   			}
   		}
@@ -1467,6 +1728,8 @@ mosync.nativeui.initUI = function()
 	var MoSyncDiv = document.getElementById("NativeUI");
 	MoSyncDiv.style.display = "none"; //hide the Native Container
 	var MoSyncNodes = document.getElementById("NativeUI").childNodes;
+	// Collect all widgets and create them with a single message.
+	var treeNodes = [];
 	for(var i = 1; i<MoSyncNodes.length; i++)
 	{
 		if((MoSyncNodes[i] != null) &&(MoSyncNodes[i].tagName != undefined))
@@ -1476,9 +1739,13 @@ mosync.nativeui.initUI = function()
 				MoSyncNodes[i].id = "widget" + mosync.nativeui.widgetCounter;
 				mosync.nativeui.widgetCounter++;
 			}
-			mosync.nativeui.createChilds( null, MoSyncNodes[i]);
+			mosync.nativeui.createChilds( null, MoSyncNodes[i], treeNodes, -1);
 		}
 	}
+	if(treeNodes.length > 0)
+	{
+		mosync.nativeui.maWidgetCreateTree(treeNodes, null, null, null);
+	}
 	mosync.nativeui.showInterval = self.setInterval(
 			"mosync.nativeui.CheckUIStatus()",
 			100);
@@ -20,9 +20,16 @@ mosync.resource = {};
  */
 mosync.resource.imageCallBackTable = {};
 
-mosync.resource.imageIDTable = {};
+/**
+ * A Hash containing the error callbacks of loadRemoteImage.
+ */
+mosync.resource.imageErrorCallBackTable = {};
 
-mosync.resource.imageDownloadQueue = [];
+/**
+ * Maps the handle of a download to the IDs of all the images
+ * waiting for it.
+ */
+mosync.resource.imageIDTable = {};
 
 /**
  * Loads images into image handles for use in MoSync UI systems.
@@ -42,6 +49,50 @@ mosync.resource.loadImage = function(imagePath, imageID, successCallback) {
 			], null);
 };
 
+/**
+ * Loads images into image handles like loadImage, but without
+ * blocking other calls to C++ while the file is read, which is
+ * better for large images. The callback is called in the same
+ * way as for loadImage.
+ *
+ *  @param imagePath relative path to the image file.
+ *  @param imageID a custom ID used for refering to the image in JavaScript
+ *  @param callBackFunction a function that will be called when the image is ready.
+ */
+mosync.resource.loadImageAsync = function(imagePath, imageID, successCallback) {
+	mosync.resource.imageCallBackTable[imageID] = successCallback;
+	mosync.bridge.send(
+			[
+				"Resource",
+				"loadImageAsync",
+				imagePath,
+				imageID
+			], null);
+};
+
+/**
+ * Tells C++ that an image loaded with loadImage is no longer used.
+ * Loading the same image again returns the same handle until C++
+ * needs the memory and destroys the image, so the handle must not
+ * be used after it has been released.
+ *
+ * This is called when the callback of loadImage, loadImageAsync
+ * or loadRemoteImage returns. Widgets keep the images they show in use, so an image
+ * that the callback sets as a widget property stays until the
+ * property is changed or the widget is destroyed. An image that
+ * is used later should be loaded again.
+ *
+ *  @param imageHandle C++ handle of the image.
+ */
+mosync.resource.releaseImage = function(imageHandle) {
+	mosync.bridge.send(
+			[
+				"Resource",
+				"releaseImage",
+				imageHandle + ""
+			], null);
+};
+
 /**
  * A function that is called by C++ to pass the loaded image information.
  *
@@ -57,59 +108,141 @@ mosync.resource.imageLoaded = function(imageID, imageHandle) {
 		// Call the function.
 		callbackFun.apply(null, args);
 	}
+
+	// The messages the callback sent, like setting the image
+	// of a widget, reach C++ before the release.
+	if (imageHandle > 0)
+	{
+		mosync.resource.releaseImage(imageHandle);
+	}
 };
 
 /**
  * Loads images into image handles from a remote URL for use in MoSync UI systems.
  *
+ * Requests are sent at once, C++ runs a few downloads at a time
+ * and queues the rest. Requests for a URL that is already being
+ * downloaded share the download, and the callbacks of all of them
+ * are called when it finishes.
+ *
  *  @param imageURL URL to the image file.
  *  @param imageID a custom ID used for refering to the image in JavaScript
  *  @param callBackFunction a function that will be called when the image is ready.
+ *  @param errorCallback optional function that is called with the image ID
+ *  and an error code if the download fails.
+ *  @param priority optional priority of the download, images with a higher
+ *  priority are downloaded first. Default is 0.
  */
-mosync.resource.loadRemoteImage = function(imageURL, imageID, callBackFunction) {
+mosync.resource.loadRemoteImage = function(
+	imageURL,
+	imageID,
+	callBackFunction,
+	errorCallback,
+	priority)
+{
 	mosync.resource.imageCallBackTable[imageID] = callBackFunction;
-	var message = [
-		"Resource",
-		"loadRemoteImage",
-		imageURL,
-		imageID
-	];
-	// Add message to queue.
-	mosync.resource.imageDownloadQueue.push(message);
-
-	if (1 == mosync.resource.imageDownloadQueue.length)
+	if (undefined != errorCallback)
 	{
-		mosync.bridge.send(message, null);
+		mosync.resource.imageErrorCallBackTable[imageID] = errorCallback;
 	}
-
+	mosync.bridge.send(
+			[
+				"Resource",
+				"loadRemoteImage",
+				imageURL,
+				imageID,
+				(priority ? priority : 0) + ""
+			], null);
 };
 
+/**
+ * Called by C++ when a download has been requested.
+ *
+ * @param imageID JavaScript ID of the image.
+ * @param imageHandle C++ handle the image is downloaded to, shared
+ * by all requests for the same URL. A negative error code if the
+ * download could not be started.
+ */
 mosync.resource.imageDownloadStarted = function(imageID, imageHandle)
 {
-	mosync.resource.imageIDTable[imageHandle] = imageID;
+	if (imageHandle < 0)
+	{
+		mosync.resource.callImageError(imageID, imageHandle);
+		return;
+	}
+
+	var imageIDs = mosync.resource.imageIDTable[imageHandle];
+	if (undefined == imageIDs)
+	{
+		imageIDs = mosync.resource.imageIDTable[imageHandle] = [];
+	}
+	imageIDs.push(imageID);
 };
 
+/**
+ * Called by C++ when a download has finished, or when the image
+ * was cached. Calls the callbacks of all the images waiting for
+ * it, then releases the image like imageLoaded does.
+ *
+ * @param imageHandle C++ handle of the downloaded image.
+ */
 mosync.resource.imageDownloadFinished = function(imageHandle)
 {
-	var imageID = mosync.resource.imageIDTable[imageHandle];
-	var callbackFun = mosync.resource.imageCallBackTable[imageID];
-	if (undefined != callbackFun)
+	var imageIDs = mosync.resource.imageIDTable[imageHandle];
+	delete mosync.resource.imageIDTable[imageHandle];
+
+	for (var i = 0; undefined != imageIDs && i < imageIDs.length; ++i)
 	{
-		// Call the function.
-		callbackFun(imageID, imageHandle);
+		var imageID = imageIDs[i];
+		var callbackFun = mosync.resource.imageCallBackTable[imageID];
+		delete mosync.resource.imageErrorCallBackTable[imageID];
+		if (undefined != callbackFun)
+		{
+			// Call the function.
+			callbackFun(imageID, imageHandle);
+		}
 	}
-	// Remove first message.
-	if (mosync.resource.imageDownloadQueue.length > 0)
+
+	// The messages the callbacks sent reach C++ before the
+	// release.
+	mosync.resource.releaseImage(imageHandle);
+};
+
+/**
+ * Called by C++ when a download has failed. Calls the error
+ * callbacks of all the images waiting for the download.
+ *
+ * @param imageHandle C++ handle of the download. It is not valid
+ * after the download has failed.
+ * @param errorCode The error code of the download.
+ */
+mosync.resource.imageDownloadFailed = function(imageHandle, errorCode)
+{
+	var imageIDs = mosync.resource.imageIDTable[imageHandle];
+	if (undefined == imageIDs)
 	{
-		mosync.resource.imageDownloadQueue.shift();
+		return;
 	}
+	delete mosync.resource.imageIDTable[imageHandle];
 
-	// If there are more messages, send the next
-	// message in the queue.
-	if (mosync.resource.imageDownloadQueue.length > 0)
+	for (var i = 0; i < imageIDs.length; ++i)
+	{
+		mosync.resource.callImageError(imageIDs[i], errorCode);
+	}
+};
+
+/**
+ * Calls the error callback of an image, if it has one.
+ *
+ * @param imageID JavaScript ID of the image.
+ * @param errorCode The error code.
+ */
+mosync.resource.callImageError = function(imageID, errorCode)
+{
+	var errorFun = mosync.resource.imageErrorCallBackTable[imageID];
+	delete mosync.resource.imageErrorCallBackTable[imageID];
+	if (undefined != errorFun)
 	{
-		mosync.bridge.send(
-				mosync.resource.imageDownloadQueue[0],
-				null);
+		errorFun(imageID, errorCode);
 	}
 };
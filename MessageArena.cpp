@@ -0,0 +1,195 @@
+/*
+Copyright (C) 2012 MoSync AB
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License,
+version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+*/
+
+/**
+ * @file MessageArena.cpp
+ *
+ * Bump allocator for the data of one message stream.
+ */
+
+#include <ma.h>				// MoSync API
+#include <maheap.h>			// C memory allocation
+#include <mastring.h>		// C string functions
+
+#include "MessageArena.h"
+
+namespace Wormhole
+{
+	/**
+	 * Round a size up to the alignment of allocations.
+	 */
+	static inline int alignSize(int size)
+	{
+		return (size + 7) & ~7;
+	}
+
+	/**
+	 * Constructor.
+	 */
+	MessageArena::MessageArena() :
+		mCurrent(-1),
+		mUsed(0)
+	{
+	}
+
+	/**
+	 * Destructor.
+	 */
+	MessageArena::~MessageArena()
+	{
+		freeChunks();
+	}
+
+	/**
+	 * Allocate memory.
+	 */
+	void* MessageArena::alloc(int size)
+	{
+		size = alignSize(size);
+
+		if (mCurrent < 0 || mUsed + size > mChunks[mCurrent].mSize)
+		{
+			// Use the next chunk if it was kept by rewind
+			// and is large enough, otherwise add one.
+			if (mCurrent + 1 < mChunks.size()
+				&& size <= mChunks[mCurrent + 1].mSize)
+			{
+				++mCurrent;
+				mUsed = 0;
+			}
+			else if (!addChunk(size))
+			{
+				return NULL;
+			}
+		}
+
+		void* p = mChunks[mCurrent].mData + mUsed;
+		mUsed += size;
+		return p;
+	}
+
+	/**
+	 * Copy a string into the arena.
+	 */
+	char* MessageArena::copy(const char* s, int length)
+	{
+		char* p = (char*) alloc(length + 1);
+		if (NULL != p)
+		{
+			memcpy(p, s, length);
+			p[length] = 0;
+		}
+		return p;
+	}
+
+	/**
+	 * @return The current position.
+	 */
+	MessageArenaMark MessageArena::getMark()
+	{
+		MessageArenaMark mark;
+		mark.mChunk = mCurrent;
+		mark.mUsed = mUsed;
+		return mark;
+	}
+
+	/**
+	 * Free everything allocated since a position was taken.
+	 */
+	void MessageArena::rewind(const MessageArenaMark& mark)
+	{
+		mCurrent = mark.mChunk;
+		mUsed = mark.mUsed;
+	}
+
+	/**
+	 * Free everything allocated in the arena.
+	 */
+	void MessageArena::reset()
+	{
+		// Replace several chunks with one that holds as much,
+		// so that the next stream of this size fits in it.
+		if (mChunks.size() > 1)
+		{
+			int size = getCapacity();
+			freeChunks();
+			addChunk(size);
+		}
+
+		mCurrent = mChunks.size() > 0 ? 0 : -1;
+		mUsed = 0;
+	}
+
+	/**
+	 * @return Number of bytes allocated for the chunks.
+	 */
+	int MessageArena::getCapacity()
+	{
+		int capacity = 0;
+		for (int i = 0; i < mChunks.size(); ++i)
+		{
+			capacity += mChunks[i].mSize;
+		}
+		return capacity;
+	}
+
+	/**
+	 * Add a chunk after the current one.
+	 */
+	bool MessageArena::addChunk(int minSize)
+	{
+		// Grow by doubling, like MessageBuffer.
+		int size = MESSAGE_ARENA_INITIAL_SIZE;
+		if (mCurrent >= 0)
+		{
+			size = mChunks[mCurrent].mSize * 2;
+		}
+		while (size < minSize)
+		{
+			size *= 2;
+		}
+
+		Chunk chunk;
+		chunk.mData = (char*) malloc(size);
+		if (NULL == chunk.mData)
+		{
+			return false;
+		}
+		chunk.mSize = size;
+
+		mChunks.insert(mCurrent + 1, chunk);
+		++mCurrent;
+		mUsed = 0;
+		return true;
+	}
+
+	/**
+	 * Free all chunks.
+	 */
+	void MessageArena::freeChunks()
+	{
+		for (int i = 0; i < mChunks.size(); ++i)
+		{
+			free(mChunks[i].mData);
+		}
+		mChunks.clear();
+		mCurrent = -1;
+		mUsed = 0;
+	}
+
+} // namespace
@@ -0,0 +1,170 @@
+/*
+Copyright (C) 2012 MoSync AB
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License,
+version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+*/
+
+/*! \addtogroup WormHoleGroup
+ *  @{
+ */
+
+/** @defgroup WormHoleGroup Wormhole Library
+ *  @{
+ */
+
+/**
+ * @file MessageArena.h
+ *
+ * Bump allocator for the data of one message stream.
+ */
+
+#ifndef MESSAGE_ARENA_H_
+#define MESSAGE_ARENA_H_
+
+#include <ma.h>
+#include <MAUtil/Vector.h>
+
+/**
+ * Size of the first chunk of an arena, in bytes.
+ */
+#define MESSAGE_ARENA_INITIAL_SIZE 4096
+
+namespace Wormhole
+{
+
+/**
+ * Position in an arena, see MessageArena::getMark.
+ */
+struct MessageArenaMark
+{
+	int mChunk;
+	int mUsed;
+};
+
+/**
+ * Allocates memory by moving a pointer forward in a chunk, and
+ * frees all of it at once with reset. Used for the JSON tree and
+ * the strings of a message stream, which are all freed together
+ * when the stream is done.
+ *
+ * When a chunk is full, a chunk twice as large is added. reset
+ * replaces several chunks with one chunk as large as all of them,
+ * so an arena that is reused for every message stream allocates
+ * nothing once it has grown to the size of the largest stream.
+ *
+ * Allocations are aligned to 8 bytes.
+ */
+class MessageArena
+{
+public:
+	/**
+	 * Constructor. No memory is allocated until the
+	 * first allocation.
+	 */
+	MessageArena();
+
+	/**
+	 * Destructor. Frees all chunks.
+	 */
+	virtual ~MessageArena();
+
+	/**
+	 * Allocate memory.
+	 * @param size Number of bytes.
+	 * @return The memory, NULL if out of memory.
+	 */
+	void* alloc(int size);
+
+	/**
+	 * Copy a string into the arena.
+	 * @param s The string, need not be zero terminated.
+	 * @param length Length of the string.
+	 * @return The copy, zero terminated, NULL if out of memory.
+	 */
+	char* copy(const char* s, int length);
+
+	/**
+	 * @return The current position, for rewinding to it later.
+	 */
+	MessageArenaMark getMark();
+
+	/**
+	 * Free everything allocated since a position was taken
+	 * with getMark. The chunks are kept for later allocations.
+	 * @param mark The position.
+	 */
+	void rewind(const MessageArenaMark& mark);
+
+	/**
+	 * Free everything allocated in the arena.
+	 */
+	void reset();
+
+	/**
+	 * @return Number of bytes allocated for the chunks.
+	 */
+	int getCapacity();
+
+private:
+	/**
+	 * Add a chunk of at least minSize bytes after the
+	 * current one, and make it current.
+	 * @return true on success, false if out of memory.
+	 */
+	bool addChunk(int minSize);
+
+	/**
+	 * Free all chunks.
+	 */
+	void freeChunks();
+
+	/**
+	 * Not copyable.
+	 */
+	MessageArena(const MessageArena&);
+	MessageArena& operator=(const MessageArena&);
+
+private:
+	/**
+	 * A block of memory that allocations are taken from.
+	 */
+	struct Chunk
+	{
+		char* mData;
+		int mSize;
+	};
+
+	/**
+	 * The chunks, in the order they are used.
+	 */
+	MAUtil::Vector<Chunk> mChunks;
+
+	/**
+	 * Index of the chunk allocations are taken from,
+	 * -1 if there is none.
+	 */
+	int mCurrent;
+
+	/**
+	 * Number of bytes used in the current chunk.
+	 */
+	int mUsed;
+};
+
+} // namespace
+
+#endif
+
+/*! @} */
@@ -0,0 +1,1072 @@
+/*
+Copyright (C) 2012 MoSync AB
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License,
+version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+*/
+
+/**
+ * @file MessageBenchmark.cpp
+ *
+ * Microbenchmarks of the message layer.
+ */
+
+#ifdef MESSAGE_BENCHMARK
+
+#include <ma.h>
+#include <maheap.h>
+#include <mastring.h>
+#include <mavsprintf.h>
+#include <conprint.h>
+
+#include <MAUtil/String.h>
+
+#include "MessageBenchmark.h"
+#include "MessageBuffer.h"
+#include "MessageStream.h"
+#include "MessageStreamBinary.h"
+#include "MessageStreamJSON.h"
+#include "ScriptBatch.h"
+#include "NativeUIMessageHandler.h"
+
+// Number of lengths in the stream given to the decoders.
+#define BENCHMARK_NUM_LENGTHS 4096
+
+// Number of passes over the stream.
+#define BENCHMARK_NUM_PASSES 2000
+
+// Number of rounds of passes of each length decoder, the
+// fastest round is reported.
+#define BENCHMARK_DECODE_ROUNDS 10
+
+// Number of messages in each synthetic corpus, about the
+// size of a batch sent by mosync-nativeui.js when a screen
+// is updated.
+#define BENCHMARK_CORPUS_SIZE 100
+
+// Number of passes over each corpus.
+#define BENCHMARK_CORPUS_PASSES 200
+
+// Number of widgets the corpus messages refer to.
+#define BENCHMARK_NUM_WIDGETS 16
+
+// Module opcode of NativeUI in binary streams, must match
+// ModuleOpcode in main.cpp.
+#define BENCHMARK_MODULE_NATIVEUI 1
+
+// Number of characters shown before and after the first
+// difference of a replayed script.
+#define REPLAY_EXCERPT_SIZE 32
+
+/**
+ * Number of calls to operator new.
+ */
+static int sAllocationCount = 0;
+
+/**
+ * Count allocations, so that the benchmarks can report the
+ * number of allocations per message.
+ */
+void* operator new(size_t size)
+{
+	++sAllocationCount;
+	return malloc(size);
+}
+
+void* operator new[](size_t size)
+{
+	++sAllocationCount;
+	return malloc(size);
+}
+
+void operator delete(void* p)
+{
+	free(p);
+}
+
+void operator delete[](void* p)
+{
+	free(p);
+}
+
+using namespace MAUtil;
+
+namespace Wormhole
+{
+	/**
+	 * Protocols of the corpora.
+	 */
+	enum CorpusType
+	{
+		CORPUS_TEXT,
+		CORPUS_BINARY,
+		CORPUS_JSON
+	};
+
+	/**
+	 * @return Number of calls to operator new since the
+	 * start of the program.
+	 */
+	int getAllocationCount()
+	{
+		return sAllocationCount;
+	}
+	/**
+	 * Linear congruential generator, so that every run
+	 * decodes the same stream.
+	 */
+	static unsigned int sSeed = 12345;
+
+	static int nextRandom(int max)
+	{
+		sSeed = sSeed * 1103515245u + 12345u;
+		return (int) ((sSeed >> 16) % (unsigned int) max);
+	}
+
+	/**
+	 * The length decoder used before decodeLength, kept
+	 * here as the reference.
+	 */
+	static int referenceRaise(int base, int e)
+	{
+		int pow = 1;
+		if (e > 4)
+		{
+			return 0;
+		}
+		while (e--)
+		{
+			pow *= base;
+		}
+		return pow;
+	}
+
+	static int referenceXtoi(char* s, char** newPos)
+	{
+		int firstChar = 33;
+		int lastChar = 126;
+		int base = lastChar - firstChar;
+
+		int n = 0;
+		int i;
+		for (i = 0; s[i] != ' '; ++i)
+		{
+			if (i > 4)
+			{
+				return 0;
+			}
+			n += referenceRaise(base, i) * (s[i] - firstChar);
+		}
+
+		*newPos = s + i;
+
+		return n;
+	}
+
+	/**
+	 * Pick a string length. Most values in a NativeUI message
+	 * are names, handles, property names and short values, one
+	 * digit lengths (below 93). Some are texts of a few hundred
+	 * characters, two digits, and rarely a long text or URL list
+	 * needs three digits.
+	 */
+	static int randomLength()
+	{
+		int r = nextRandom(1000);
+		if (r < 970)
+		{
+			// "NativeUI", "maWidgetSetProperty", handles,
+			// "text", "fontColor", callback ids.
+			return 1 + nextRandom(24);
+		}
+		if (r < 999)
+		{
+			return 93 + nextRandom(1000);
+		}
+		return 8649 + nextRandom(2000);
+	}
+
+	/**
+	 * Write a length the way mosync.encoder.itox does,
+	 * followed by a space.
+	 */
+	static char* writeLength(char* p, int n)
+	{
+		while (n > 93)
+		{
+			*p++ = (char) (33 + n % 93);
+			n /= 93;
+		}
+		*p++ = (char) (33 + n);
+		*p++ = ' ';
+		return p;
+	}
+
+	/**
+	 * Append a string the way mosync.encoder.encodeString does.
+	 */
+	static void appendText(String& corpus, const char* value)
+	{
+		char length[8];
+		int valueLength = strlen(value);
+		char* end = writeLength(length, valueLength);
+		corpus.append(length, end - length);
+		corpus.append(value, valueLength);
+		corpus.append(" ", 1);
+	}
+
+	/**
+	 * Append an integer the way mosync.encoder.encodeInt does.
+	 */
+	static void appendBinaryInt(String& corpus, int value)
+	{
+		char digits[MESSAGE_BINARY_INT_SIZE];
+		int n = value & 0xFFFFFF;
+		for (int i = 0; i < MESSAGE_BINARY_INT_SIZE; ++i)
+		{
+			digits[i] = (char) ('0' + ((n >> (6 * i)) & 63));
+		}
+		corpus.append(digits, MESSAGE_BINARY_INT_SIZE);
+	}
+
+	/**
+	 * Append a string the way mosync.encoder.encodeBinaryString
+	 * does. The strings used are ASCII.
+	 */
+	static void appendBinaryString(String& corpus, const char* value)
+	{
+		int valueLength = strlen(value);
+		appendBinaryInt(corpus, valueLength);
+		corpus.append(value, valueLength);
+		corpus.append(" ", 1);
+	}
+
+	/**
+	 * Build a NativeUI corpus in the text or binary protocol.
+	 * The mix of messages follows what mosync-nativeui.js sends
+	 * when a screen is updated: mostly maWidgetSetProperty, of
+	 * which a part re-sets unchanged values, and some
+	 * maWidgetGetProperty. Every message is followed by the id
+	 * of the bridge callback, as when a processed callback is
+	 * given.
+	 */
+	static void buildNativeUICorpus(
+		String& corpus,
+		bool binary,
+		MAWidgetHandle* widgets)
+	{
+		char value[32];
+		char callbackID[32];
+
+		corpus = binary ? "mb:" : "ms:";
+		for (int i = 0; i < BENCHMARK_CORPUS_SIZE; ++i)
+		{
+			MAWidgetHandle widget = widgets[i % BENCHMARK_NUM_WIDGETS];
+			const char* action;
+			int opcode;
+			const char* property;
+			switch (i % 4)
+			{
+				case 0:
+					action = "maWidgetSetProperty";
+					opcode = NATIVEUI_OP_WIDGET_SET_PROPERTY;
+					property = "text";
+					sprintf(value, "Item %d", i);
+					break;
+				case 1:
+					action = "maWidgetSetProperty";
+					opcode = NATIVEUI_OP_WIDGET_SET_PROPERTY;
+					property = "visible";
+					sprintf(value, "true");
+					break;
+				case 2:
+					action = "maWidgetSetProperty";
+					opcode = NATIVEUI_OP_WIDGET_SET_PROPERTY;
+					property = "fontColor";
+					sprintf(value, "0x%06X", (i * 0x10101) & 0xFFFFFF);
+					break;
+				default:
+					action = "maWidgetGetProperty";
+					opcode = NATIVEUI_OP_WIDGET_GET_PROPERTY;
+					property = "text";
+					value[0] = 0;
+					break;
+			}
+			sprintf(callbackID, "property%d%s%d", widget, property, i);
+
+			if (binary)
+			{
+				// The message is built first, since it is
+				// preceded by its length.
+				String message;
+				appendBinaryInt(message, BENCHMARK_MODULE_NATIVEUI);
+				appendBinaryInt(message, opcode);
+				appendBinaryInt(message, widget);
+				appendBinaryString(message, property);
+				if (NATIVEUI_OP_WIDGET_SET_PROPERTY == opcode)
+				{
+					appendBinaryString(message, value);
+				}
+				appendBinaryString(message, callbackID);
+				appendBinaryInt(message, i + 1);
+				appendBinaryInt(corpus, message.length());
+				corpus += message;
+			}
+			else
+			{
+				char handle[16];
+				sprintf(handle, "%d", widget);
+				appendText(corpus, "NativeUI");
+				appendText(corpus, action);
+				appendText(corpus, handle);
+				appendText(corpus, property);
+				if (NATIVEUI_OP_WIDGET_SET_PROPERTY == opcode)
+				{
+					appendText(corpus, value);
+				}
+				appendText(corpus, callbackID);
+				sprintf(handle, "%d", i + 1);
+				appendText(corpus, handle);
+			}
+		}
+	}
+
+	/**
+	 * Build a corpus in the JSON protocol, with the messages
+	 * sent by index.html.
+	 */
+	static void buildJSONCorpus(String& corpus)
+	{
+		char message[128];
+
+		corpus = "ma:[";
+		for (int i = 0; i < BENCHMARK_CORPUS_SIZE; ++i)
+		{
+			sprintf(message,
+				"%s{\"messageName\":\"%s\",\"index\":%d,\"text\":\"Hello %d\"}",
+				i > 0 ? "," : "",
+				i + 1 < BENCHMARK_CORPUS_SIZE
+					? "JSONMessage" : "JSONMessageEnd",
+				i,
+				i);
+			corpus.append(message, strlen(message));
+		}
+		corpus.append("]", 1);
+	}
+
+	/**
+	 * Process the message in the buffer, as the moblet does.
+	 */
+	static void processCorpus(
+		int corpusType,
+		MessageBuffer& buffer,
+		MessageArena& arena,
+		NativeUIMessageHandler& handler,
+		ScriptBatch& batch)
+	{
+		if (CORPUS_JSON == corpusType)
+		{
+			MessageStreamJSON message(
+				NULL,
+				buffer.getData(),
+				buffer.getSize(),
+				true,
+				&arena);
+			while (message.next())
+			{
+				if (message.is("JSONMessageEnd"))
+				{
+					batch.add("JSONMessageEnd()");
+				}
+				else if (message.is("JSONMessage"))
+				{
+					message.getParamInt("index");
+					message.getParamPointer("text", NULL);
+				}
+			}
+			return;
+		}
+
+		// The module is read here instead of by the moblet's
+		// dispatcher, all messages in the corpus are NativeUI.
+		if (CORPUS_BINARY == corpusType)
+		{
+			MessageStreamBinary stream(
+				NULL,
+				buffer.getData(),
+				buffer.getSize());
+			while (stream.nextMessage())
+			{
+				stream.getNextInt();
+				handler.handleMessage(stream);
+			}
+			return;
+		}
+
+		MessageStream stream(
+			NULL,
+			buffer.getData(),
+			buffer.getSize());
+		while (stream.hasNext())
+		{
+			stream.getNextView();
+			handler.handleMessage(stream);
+		}
+	}
+
+	/**
+	 * Feed a corpus through the message layer and log the
+	 * results.
+	 */
+	static void runCorpus(
+		const char* name,
+		int corpusType,
+		const String& corpus,
+		NativeUIMessageHandler& handler,
+		ScriptBatch& batch)
+	{
+		// The corpus is put in a data object, so that it is
+		// read the same way as a message from the WebView.
+		MAHandle data = maCreatePlaceholder();
+		if (RES_OK != maCreateData(data, corpus.length()))
+		{
+			lprintfln("@@@ %s: could not create data", name);
+			return;
+		}
+		maWriteData(data, corpus.c_str(), 0, corpus.length());
+
+		MessageBuffer buffer;
+		MessageArena arena;
+		batch.resetCounters();
+		int allocations = getAllocationCount();
+		int time = maGetMilliSecondCount();
+
+		for (int pass = 0; pass < BENCHMARK_CORPUS_PASSES; ++pass)
+		{
+			buffer.read(data);
+			batch.begin();
+			processCorpus(corpusType, buffer, arena, handler, batch);
+			batch.end();
+		}
+
+		time = maGetMilliSecondCount() - time;
+		allocations = getAllocationCount() - allocations;
+		int numMessages = BENCHMARK_CORPUS_SIZE * BENCHMARK_CORPUS_PASSES;
+
+		// Allocations per message with two decimals.
+		int allocationsPerMessage = allocations * 100 / numMessages;
+
+		lprintfln("@@@ %s: %d bytes, %d messages in %d ms, %d messages/s",
+			name,
+			corpus.length(),
+			numMessages,
+			time,
+			time > 0 ? numMessages * 1000 / time : 0);
+		lprintfln("@@@ %s: %d.%02d allocations/message, "
+				"%d JS bytes/message, %d callJS/pass",
+			name,
+			allocationsPerMessage / 100,
+			allocationsPerMessage % 100,
+			batch.getByteCount() / numMessages,
+			batch.getEvaluationCount() / BENCHMARK_CORPUS_PASSES);
+
+		maDestroyObject(data);
+	}
+
+	/**
+	 * Run all message benchmarks and log the results.
+	 */
+	void runMessageBenchmarks()
+	{
+		benchmarkDecodeLength();
+		benchmarkMessageCorpora();
+	}
+
+	/**
+	 * Feed the synthetic corpora through the message layer.
+	 */
+	void benchmarkMessageCorpora()
+	{
+		// The scripts are counted but not evaluated.
+		ScriptBatch batch(NULL);
+		NativeUIMessageHandler handler(NULL, &batch);
+
+		// Widgets for the messages to refer to. If NativeUI
+		// is not available, for example in MoRE, the calls to
+		// the widgets fail, but the message layer does the
+		// same work.
+		MAWidgetHandle widgets[BENCHMARK_NUM_WIDGETS];
+		for (int i = 0; i < BENCHMARK_NUM_WIDGETS; ++i)
+		{
+			widgets[i] = maWidgetCreate("Label");
+			if (widgets[i] <= 0)
+			{
+				widgets[i] = 1000 + i;
+			}
+		}
+
+		String corpus;
+		buildNativeUICorpus(corpus, false, widgets);
+		runCorpus("NativeUI text", CORPUS_TEXT, corpus, handler, batch);
+
+		buildNativeUICorpus(corpus, true, widgets);
+		runCorpus("NativeUI binary", CORPUS_BINARY, corpus, handler, batch);
+
+		buildJSONCorpus(corpus);
+		runCorpus("JSON", CORPUS_JSON, corpus, handler, batch);
+
+		for (int i = 0; i < BENCHMARK_NUM_WIDGETS; ++i)
+		{
+			if (widgets[i] < 1000)
+			{
+				maWidgetDestroy(widgets[i]);
+			}
+		}
+	}
+
+	/**
+	 * Copy the lengths of the strings in the text messages of
+	 * a capture to data, each followed by its space, until
+	 * maxLengths lengths are copied. The lengths of the capture
+	 * are repeated if there are fewer.
+	 *
+	 * @return The number of lengths copied, 0 if the capture
+	 * could not be read or has no text messages.
+	 */
+	static int readCaptureLengths(
+		const char* fileName,
+		char* data,
+		int maxLengths,
+		char** dataEnd)
+	{
+		char path[1024];
+		if (!MessageCapture::getLocalPath(fileName, path, sizeof(path)))
+		{
+			return 0;
+		}
+
+		MAHandle file = maFileOpen(path, MA_ACCESS_READ);
+		if (file < 0)
+		{
+			return 0;
+		}
+
+		int size = maFileExists(file) ? maFileSize(file) : -1;
+		char* capture = size > 0 ? (char*) malloc(size) : NULL;
+		if (NULL == capture || maFileRead(file, capture, size) < 0)
+		{
+			free(capture);
+			maFileClose(file);
+			return 0;
+		}
+		maFileClose(file);
+
+		int numLengths = 0;
+		char* out = data;
+		int captureLengths = 0;
+		do
+		{
+			captureLengths = 0;
+			const char* record = capture + sizeof(int);
+			const char* captureEnd = capture + size;
+			while (numLengths < maxLengths
+				&& captureEnd - record >= (int) sizeof(MessageCaptureRecord))
+			{
+				MessageCaptureRecord header;
+				memcpy(&header, record, sizeof(header));
+				const char* p = record + sizeof(header);
+				if (header.mLength < 0 || header.mLength > captureEnd - p)
+				{
+					break;
+				}
+				record = p + header.mLength;
+
+				if (MESSAGE_CAPTURE_MESSAGE != header.mType
+					|| MESSAGE_CAPTURE_PROTOCOL_STREAM != header.mProtocol)
+				{
+					continue;
+				}
+
+				// Skip "ms:", then each string is a length, a
+				// space, the string and a space.
+				const char* end = p + header.mLength;
+				p += 3;
+				while (numLengths < maxLengths && p < end)
+				{
+					int length;
+					const char* lengthEnd;
+					if (MESSAGE_STREAM_OK != MessageStream::decodeLength(
+						p, end, &length, &lengthEnd))
+					{
+						break;
+					}
+					memcpy(out, p, lengthEnd + 1 - p);
+					out += lengthEnd + 1 - p;
+					++numLengths;
+					++captureLengths;
+					p = lengthEnd + 1 + length + 1;
+				}
+			}
+		}
+		while (numLengths < maxLengths && captureLengths > 0);
+
+		free(capture);
+		*dataEnd = out;
+		return numLengths;
+	}
+
+	/**
+	 * Compare decodeLength with the reference decoder. Only the
+	 * lengths are stored in the stream, the strings themselves
+	 * are skipped by both decoders in the same way and would
+	 * only add cache misses to the measurement.
+	 *
+	 * The lengths are taken from the text messages of the
+	 * newest capture in the local files directory, see
+	 * MessageCapture::openNew. Without a capture, lengths are
+	 * drawn from randomLength.
+	 */
+	void benchmarkDecodeLength()
+	{
+		// At most 5 digits and a space per length.
+		char* data = (char*) malloc(BENCHMARK_NUM_LENGTHS * 6 + 1);
+		if (NULL == data)
+		{
+			return;
+		}
+
+		char* p = data;
+		int numLengths = 0;
+		char captureName[256];
+		if (MessageCapture::findNewest(captureName, sizeof(captureName)))
+		{
+			numLengths = readCaptureLengths(
+				captureName,
+				data,
+				BENCHMARK_NUM_LENGTHS,
+				&p);
+		}
+
+		if (numLengths > 0)
+		{
+			lprintfln("@@@ decodeLength: lengths from %s", captureName);
+		}
+		else
+		{
+			lprintfln("@@@ decodeLength: no capture, random lengths");
+			sSeed = 12345;
+			for (numLengths = 0; numLengths < BENCHMARK_NUM_LENGTHS; ++numLengths)
+			{
+				p = writeLength(p, randomLength());
+			}
+		}
+		*p = 0;
+		const char* end = p;
+
+		int digits[MESSAGE_STREAM_MAX_LENGTH_DIGITS + 1] = { 0 };
+		for (const char* s = data; s < end; ++s)
+		{
+			const char* start = s;
+			while (' ' != *s)
+			{
+				++s;
+			}
+			++digits[s - start];
+		}
+
+		lprintfln("@@@ decodeLength: %d lengths, 1/2/3 digits: %d/%d/%d",
+			numLengths, digits[1], digits[2], digits[3]);
+
+		// The decoders take turns, and the fastest round of
+		// each is logged, so that other work on the device
+		// affects both the same way. The sums are logged, so
+		// that the loops are not optimised away, and must be
+		// equal.
+		int referenceSum = 0;
+		int referenceTime = 0;
+		int sum = 0;
+		int errors = 0;
+		int time = 0;
+		for (int round = 0; round < BENCHMARK_DECODE_ROUNDS; ++round)
+		{
+			referenceSum = 0;
+			int start = maGetMilliSecondCount();
+			for (int pass = 0; pass < BENCHMARK_NUM_PASSES; ++pass)
+			{
+				char* s = data;
+				while (s < end)
+				{
+					referenceSum += referenceXtoi(s, &s);
+					++s;
+				}
+			}
+			start = maGetMilliSecondCount() - start;
+			if (0 == round || start < referenceTime)
+			{
+				referenceTime = start;
+			}
+
+			sum = 0;
+			errors = 0;
+			start = maGetMilliSecondCount();
+			for (int pass = 0; pass < BENCHMARK_NUM_PASSES; ++pass)
+			{
+				const char* s = data;
+				while (s < end)
+				{
+					int length;
+					if (MESSAGE_STREAM_OK !=
+						MessageStream::decodeLength(s, end, &length, &s))
+					{
+						++errors;
+						break;
+					}
+					sum += length;
+					++s;
+				}
+			}
+			start = maGetMilliSecondCount() - start;
+			if (0 == round || start < time)
+			{
+				time = start;
+			}
+		}
+
+		lprintfln("@@@ decodeLength: reference %d ms (sum %d)",
+			referenceTime, referenceSum);
+		lprintfln("@@@ decodeLength: new %d ms (sum %d, errors %d)",
+			time, sum, errors);
+
+		free(data);
+	}
+
+
+	/**
+	 * Copy the text around an offset of a script, for logging.
+	 */
+	static void getExcerpt(
+		const char* script,
+		int length,
+		int offset,
+		char* excerpt)
+	{
+		int start = offset > REPLAY_EXCERPT_SIZE
+			? offset - REPLAY_EXCERPT_SIZE : 0;
+		int end = offset + REPLAY_EXCERPT_SIZE < length
+			? offset + REPLAY_EXCERPT_SIZE : length;
+		int n = 0;
+		for (int i = start; i < end; ++i)
+		{
+			// Keep each excerpt on one log line.
+			char c = script[i];
+			excerpt[n++] = (c < ' ') ? ' ' : c;
+		}
+		excerpt[n] = 0;
+	}
+
+	/**
+	 * Constructor.
+	 */
+	MessageReplay::MessageReplay(ScriptBatch* batch) :
+		mBatch(batch),
+		mWebView(NULL),
+		mCapture(NULL),
+		mFile(0),
+		mFileSize(0),
+		mPosition(0),
+		mMessage(0),
+		mMessageIndex(-1),
+		mMessageTime(0),
+		mMessagePending(false),
+		mNextScript(0),
+		mNumRecorded(0),
+		mNumDiffering(0),
+		mTotalTime(0),
+		mTotalEqual(0),
+		mTotalDiffering(0),
+		mTotalRecordedOnly(0),
+		mTotalReplayedOnly(0)
+	{
+	}
+
+	/**
+	 * Destructor.
+	 */
+	MessageReplay::~MessageReplay()
+	{
+		finish();
+	}
+
+	/**
+	 * Open a capture.
+	 */
+	bool MessageReplay::start(const char* fileName)
+	{
+		char path[1024];
+		if (!getLocalPath(fileName, path, sizeof(path)))
+		{
+			return false;
+		}
+
+		MAHandle file = maFileOpen(path, MA_ACCESS_READ);
+		if (file < 0)
+		{
+			return false;
+		}
+		if (!maFileExists(file))
+		{
+			maFileClose(file);
+			return false;
+		}
+
+		mFile = file;
+		mFileSize = maFileSize(file);
+		mPosition = 0;
+
+		int magic = 0;
+		if (!read(&magic, sizeof(magic)) || MESSAGE_CAPTURE_MAGIC != magic)
+		{
+			lprintfln("@@@ Replay: %s is not a capture", path);
+			maFileClose(mFile);
+			mFile = 0;
+			return false;
+		}
+
+		lprintfln("@@@ Replay: %s, %d bytes", path, mFileSize);
+
+		// Collect the scripts instead of evaluating them.
+		mWebView = mBatch->getWebView();
+		mCapture = mBatch->getCapture();
+		mBatch->setWebView(NULL);
+		mBatch->setCapture(this);
+
+		return true;
+	}
+
+	/**
+	 * Go to the next message of the capture.
+	 */
+	bool MessageReplay::nextMessage()
+	{
+		if (0 == mFile)
+		{
+			return false;
+		}
+
+		while (mPosition < mFileSize)
+		{
+			MessageCaptureRecord record;
+			if (!read(&record, sizeof(record))
+				|| record.mLength < 0
+				|| record.mLength > mFileSize - mPosition)
+			{
+				lprintfln("@@@ Replay: bad record at %d", mPosition);
+				break;
+			}
+
+			if (MESSAGE_CAPTURE_SCRIPT == record.mType)
+			{
+				mRecorded.resize(record.mLength);
+				if (!read(mRecorded.pointer(), record.mLength))
+				{
+					break;
+				}
+				compareScript(mRecorded);
+				continue;
+			}
+
+			// Scripts recorded before the first message, for
+			// example from event listeners, are not replayed.
+			logMessage();
+
+			mMessage = maCreatePlaceholder();
+			if (RES_OK != maCreateData(mMessage, record.mLength))
+			{
+				lprintfln("@@@ Replay: could not create data");
+				maDestroyPlaceholder(mMessage);
+				mMessage = 0;
+				break;
+			}
+			if (record.mLength > 0 && maFileReadToData(
+				mFile, mMessage, 0, record.mLength) < 0)
+			{
+				lprintfln("@@@ Replay: read failed at %d", mPosition);
+				maDestroyObject(mMessage);
+				mMessage = 0;
+				break;
+			}
+			mPosition += record.mLength;
+
+			mRecord = record;
+			++mMessageIndex;
+			mScripts.clear();
+			mNextScript = 0;
+			mNumRecorded = 0;
+			mNumDiffering = 0;
+			mMessagePending = true;
+			mMessageTime = maGetMilliSecondCount();
+			return true;
+		}
+
+		logMessage();
+		return false;
+	}
+
+	/**
+	 * @return Data object with the current message.
+	 */
+	MAHandle MessageReplay::getMessage()
+	{
+		return mMessage;
+	}
+
+	/**
+	 * Stop timing the current message.
+	 */
+	void MessageReplay::endMessage()
+	{
+		mMessageTime = maGetMilliSecondCount() - mMessageTime;
+		mTotalTime += mMessageTime;
+
+		if (0 != mMessage)
+		{
+			maDestroyObject(mMessage);
+			mMessage = 0;
+		}
+	}
+
+	/**
+	 * Close the capture, log the totals, and restore the batch.
+	 */
+	void MessageReplay::finish()
+	{
+		if (0 == mFile)
+		{
+			return;
+		}
+
+		maFileClose(mFile);
+		mFile = 0;
+
+		mBatch->setWebView(mWebView);
+		mBatch->setCapture(mCapture);
+
+		lprintfln("@@@ Replay: %d messages in %d ms",
+			mMessageIndex + 1,
+			mTotalTime);
+		lprintfln("@@@ Replay: scripts %d equal, %d differ, "
+				"%d recorded only, %d replayed only",
+			mTotalEqual,
+			mTotalDiffering,
+			mTotalRecordedOnly,
+			mTotalReplayedOnly);
+	}
+
+	/**
+	 * Collect a script sent back by the handlers.
+	 */
+	void MessageReplay::addScript(const char* script, int length)
+	{
+		mScripts.add(String(script, length));
+	}
+
+	/**
+	 * Read bytes from the capture.
+	 */
+	bool MessageReplay::read(void* dst, int size)
+	{
+		if (size > mFileSize - mPosition)
+		{
+			return false;
+		}
+		int result = maFileRead(mFile, dst, size);
+		if (result < 0)
+		{
+			lprintfln("@@@ Replay: read failed at %d, %d",
+				mPosition, result);
+			return false;
+		}
+		mPosition += size;
+		return true;
+	}
+
+	/**
+	 * Compare a recorded script with the next replayed one.
+	 */
+	void MessageReplay::compareScript(const String& recorded)
+	{
+		if (mMessageIndex < 0 || mNextScript >= mScripts.size())
+		{
+			++mTotalRecordedOnly;
+			return;
+		}
+
+		++mNumRecorded;
+		const String& replayed = mScripts[mNextScript++];
+		int length = recorded.length() < replayed.length()
+			? recorded.length() : replayed.length();
+		int offset = 0;
+		while (offset < length && recorded[offset] == replayed[offset])
+		{
+			++offset;
+		}
+		if (offset == length && recorded.length() == replayed.length())
+		{
+			++mTotalEqual;
+			return;
+		}
+
+		++mNumDiffering;
+		++mTotalDiffering;
+
+		char excerpt[REPLAY_EXCERPT_SIZE * 2 + 1];
+		lprintfln("@@@ Replay %d: script %d differs at %d",
+			mMessageIndex, mNextScript - 1, offset);
+		getExcerpt(recorded.c_str(), recorded.length(), offset, excerpt);
+		lprintfln("@@@   recorded: %s", excerpt);
+		getExcerpt(replayed.c_str(), replayed.length(), offset, excerpt);
+		lprintfln("@@@   replayed: %s", excerpt);
+	}
+
+	/**
+	 * Log the result of the current message, once all the
+	 * scripts recorded for it have been compared.
+	 */
+	void MessageReplay::logMessage()
+	{
+		if (!mMessagePending)
+		{
+			return;
+		}
+		mMessagePending = false;
+
+		int replayedOnly = mScripts.size() - mNextScript;
+		mTotalReplayedOnly += replayedOnly;
+		mNextScript = mScripts.size();
+
+		lprintfln("@@@ Replay %d: %s, %d bytes, at %d ms, %d ms, "
+				"scripts %d compared, %d differ, %d replayed only",
+			mMessageIndex,
+			getProtocolName(mRecord.mProtocol),
+			mRecord.mLength,
+			mRecord.mTime,
+			mMessageTime,
+			mNumRecorded,
+			mNumDiffering,
+			replayedOnly);
+	}
+
+} // namespace
+
+#endif // MESSAGE_BENCHMARK
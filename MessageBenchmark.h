@@ -0,0 +1,253 @@
+/*
+Copyright (C) 2012 MoSync AB
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License,
+version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+*/
+
+/*! \addtogroup WormHoleGroup
+ *  @{
+ */
+
+/** @defgroup WormHoleGroup Wormhole Library
+ *  @{
+ */
+
+/**
+ * @file MessageBenchmark.h
+ *
+ * Benchmarks of the message layer. They are compiled only
+ * when MESSAGE_BENCHMARK is defined, and run when the moblet
+ * starts. Results are written to the log, so the benchmarks
+ * can be run in the MoRE emulator on a desktop machine as well
+ * as on a device. The host build in the host directory runs
+ * them without MoSync, against a stub of the MoSync API.
+ *
+ * MessageReplay feeds a capture written by MessageCapture back
+ * through the message handlers, see there.
+ */
+
+#ifndef MESSAGE_BENCHMARK_H_
+#define MESSAGE_BENCHMARK_H_
+
+#ifdef MESSAGE_BENCHMARK
+
+#include <ma.h>
+#include <MAUtil/String.h>
+#include <MAUtil/Vector.h>
+
+#include "MessageCapture.h"
+#include "ScriptBatch.h"
+
+namespace Wormhole
+{
+
+/**
+ * Run all message benchmarks and log the results. Must be
+ * called after the moblet has been created, since the message
+ * handlers need the environment.
+ */
+void runMessageBenchmarks();
+
+/**
+ * Feed synthetic message corpora in the text, binary and JSON
+ * protocols through the message layer, and log messages per
+ * second, allocations per message and bytes of JavaScript
+ * produced per message for each of them.
+ */
+void benchmarkMessageCorpora();
+
+/**
+ * @return Number of calls to operator new since the start of
+ * the program.
+ */
+int getAllocationCount();
+
+/**
+ * Compare MessageStream::decodeLength with the decoder it
+ * replaced, over the string lengths of the ms: messages in the
+ * newest capture written by MessageCapture. Without a capture,
+ * random lengths distributed like those of the messages sent by
+ * mosync-nativeui.js are used.
+ */
+void benchmarkDecodeLength();
+
+/**
+ * Replays a capture written by MessageCapture, to reproduce the
+ * performance of traffic recorded in the field. The messages of
+ * the capture are handed one at a time to the moblet, which
+ * handles them as if they came from the WebView. The time each
+ * message takes is logged, and the scripts the handlers send
+ * back are compared with the recorded ones. For every script
+ * that differs, the offset of the first difference is logged
+ * with the text around it from both scripts.
+ *
+ * While replaying, the scripts of the batch are not evaluated.
+ * The replay runs only in the host build, see host/Makefile,
+ * whose stub widget API gives the same results every time,
+ * while the message layer does the same work as on the device.
+ * Replaying on a device would create and show real widgets.
+ * Scripts that contain widget handles may differ from the
+ * recording, which shows where they do.
+ *
+ * Usage:
+ *
+ *   MessageReplay replay(batch);
+ *   if (replay.start(captureName))
+ *   {
+ *       while (replay.nextMessage())
+ *       {
+ *           handleWebViewMessage(NULL, replay.getMessage());
+ *           replay.endMessage();
+ *       }
+ *       replay.finish();
+ *   }
+ */
+class MessageReplay : public MessageCapture
+{
+public:
+	/**
+	 * Constructor.
+	 * @param batch The batch the handlers add their scripts to.
+	 */
+	MessageReplay(ScriptBatch* batch);
+
+	/**
+	 * Destructor.
+	 */
+	virtual ~MessageReplay();
+
+	/**
+	 * Open a capture, and start collecting the scripts of
+	 * the batch instead of evaluating them.
+	 *
+	 * @param fileName Name of the file in the local files
+	 * directory.
+	 * @return true on success, false if there is no capture.
+	 */
+	bool start(const char* fileName);
+
+	/**
+	 * Go to the next message of the capture, comparing the
+	 * recorded scripts up to it, and start timing it.
+	 *
+	 * @return true if there is a message, false at the end
+	 * of the capture.
+	 */
+	bool nextMessage();
+
+	/**
+	 * @return Data object with the current message, valid
+	 * until endMessage is called.
+	 */
+	MAHandle getMessage();
+
+	/**
+	 * Stop timing the current message.
+	 */
+	void endMessage();
+
+	/**
+	 * Close the capture, log the totals, and restore the batch.
+	 */
+	void finish();
+
+	/**
+	 * Collect a script sent back by the handlers.
+	 */
+	virtual void addScript(const char* script, int length);
+
+private:
+	/**
+	 * Read bytes from the capture.
+	 * @return true on success.
+	 */
+	bool read(void* dst, int size);
+
+	/**
+	 * Compare a recorded script with the next replayed one.
+	 */
+	void compareScript(const MAUtil::String& recorded);
+
+	/**
+	 * Log the result of the current message.
+	 */
+	void logMessage();
+
+	/**
+	 * Not copyable.
+	 */
+	MessageReplay(const MessageReplay&);
+	MessageReplay& operator=(const MessageReplay&);
+
+private:
+	ScriptBatch* mBatch;
+	NativeUI::WebView* mWebView;
+	MessageCapture* mCapture;
+
+	/**
+	 * The capture file, its size and the read position.
+	 */
+	MAHandle mFile;
+	int mFileSize;
+	int mPosition;
+
+	/**
+	 * The current message.
+	 */
+	MAHandle mMessage;
+	MessageCaptureRecord mRecord;
+	int mMessageIndex;
+	int mMessageTime;
+
+	/**
+	 * true until the result of the current message is logged.
+	 */
+	bool mMessagePending;
+
+	/**
+	 * Scripts sent back for the current message, and the
+	 * index of the next one to compare.
+	 */
+	MAUtil::Vector<MAUtil::String> mScripts;
+	int mNextScript;
+
+	/**
+	 * Buffer for recorded scripts.
+	 */
+	MAUtil::String mRecorded;
+
+	/**
+	 * Script counts of the current message.
+	 */
+	int mNumRecorded;
+	int mNumDiffering;
+
+	/**
+	 * Totals of the replay.
+	 */
+	int mTotalTime;
+	int mTotalEqual;
+	int mTotalDiffering;
+	int mTotalRecordedOnly;
+	int mTotalReplayedOnly;
+};
+
+} // namespace
+
+#endif // MESSAGE_BENCHMARK
+
+#endif
+
+/*! @} */
@@ -0,0 +1,142 @@
+/*
+Copyright (C) 2012 MoSync AB
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License,
+version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+*/
+
+/**
+ * @file MessageBuffer.cpp
+ *
+ * Reusable receive buffer for messages sent from a WebView.
+ */
+
+#include <ma.h>				// MoSync API
+#include <maheap.h>			// C memory allocation
+
+#include "MessageBuffer.h"
+
+namespace Wormhole
+{
+	/**
+	 * Constructor.
+	 */
+	MessageBuffer::MessageBuffer(int initialCapacity) :
+		mData(NULL),
+		mSize(0),
+		mCapacity(0)
+	{
+		reserve(initialCapacity);
+	}
+
+	/**
+	 * Destructor.
+	 */
+	MessageBuffer::~MessageBuffer()
+	{
+		if (NULL != mData)
+		{
+			free(mData);
+			mData = NULL;
+		}
+	}
+
+	/**
+	 * Read the contents of a data object into the buffer.
+	 */
+	bool MessageBuffer::read(MAHandle dataHandle)
+	{
+		mSize = 0;
+
+		// We must have data.
+		if (0 == dataHandle)
+		{
+			return false;
+		}
+
+		// Get length of the data, it is not zero terminated.
+		int dataSize = maGetDataSize(dataHandle);
+
+		if (!reserve(dataSize))
+		{
+			return false;
+		}
+
+		// Get the data.
+		maReadData(dataHandle, mData, 0, dataSize);
+
+		// Zero terminate.
+		mData[dataSize] = 0;
+		mSize = dataSize;
+
+		return true;
+	}
+
+	/**
+	 * @return Pointer to the buffer data.
+	 */
+	char* MessageBuffer::getData()
+	{
+		return mData;
+	}
+
+	/**
+	 * @return Size of the current data in bytes.
+	 */
+	int MessageBuffer::getSize()
+	{
+		return mSize;
+	}
+
+	/**
+	 * @return Number of bytes allocated for the buffer.
+	 */
+	int MessageBuffer::getCapacity()
+	{
+		return mCapacity;
+	}
+
+	/**
+	 * Make sure the buffer can hold size bytes plus
+	 * a terminating zero.
+	 */
+	bool MessageBuffer::reserve(int size)
+	{
+		// One extra byte for the terminating zero.
+		if (size + 1 <= mCapacity)
+		{
+			return true;
+		}
+
+		// Grow by doubling, so that a slowly growing message
+		// size does not cause a reallocation for every message.
+		int capacity = mCapacity > 0 ? mCapacity : 256;
+		while (capacity < size + 1)
+		{
+			capacity *= 2;
+		}
+
+		char* data = (char*) realloc(mData, capacity);
+		if (NULL == data)
+		{
+			return false;
+		}
+
+		mData = data;
+		mCapacity = capacity;
+
+		return true;
+	}
+
+} // namespace
@@ -0,0 +1,128 @@
+/*
+Copyright (C) 2012 MoSync AB
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License,
+version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+*/
+
+/*! \addtogroup WormHoleGroup
+ *  @{
+ */
+
+/** @defgroup WormHoleGroup Wormhole Library
+ *  @{
+ */
+
+/**
+ * @file MessageBuffer.h
+ *
+ * Reusable receive buffer for messages sent from a WebView.
+ */
+
+#ifndef MESSAGE_BUFFER_H_
+#define MESSAGE_BUFFER_H_
+
+#include <ma.h>
+
+namespace Wormhole
+{
+
+/**
+ * Growable buffer that holds the data of the message currently
+ * being processed. The buffer is owned by the moblet and reused
+ * for every MAW_EVENT_WEB_VIEW_HOOK_INVOKED event, so that the
+ * message data is read once and no memory is allocated per
+ * message once the buffer has grown to the size of the largest
+ * message seen.
+ *
+ * The data in the buffer is always zero terminated. The
+ * terminating zero is not included in the size.
+ */
+class MessageBuffer
+{
+public:
+	/**
+	 * Constructor.
+	 * @param initialCapacity Initial size of the buffer in bytes.
+	 */
+	MessageBuffer(int initialCapacity = 1024);
+
+	/**
+	 * Destructor.
+	 */
+	virtual ~MessageBuffer();
+
+	/**
+	 * Read the contents of a data object into the buffer,
+	 * replacing any previous contents. The buffer grows
+	 * if needed.
+	 *
+	 * @param dataHandle Data object to read.
+	 * @return true on success, false if there is no data
+	 * or if memory could not be allocated.
+	 */
+	bool read(MAHandle dataHandle);
+
+	/**
+	 * @return Pointer to the buffer data, NULL if no
+	 * data has been read.
+	 */
+	char* getData();
+
+	/**
+	 * @return Size of the current data in bytes.
+	 */
+	int getSize();
+
+	/**
+	 * @return Number of bytes allocated for the buffer.
+	 */
+	int getCapacity();
+
+private:
+	/**
+	 * Make sure the buffer can hold size bytes plus
+	 * a terminating zero.
+	 * @return true on success, false if out of memory.
+	 */
+	bool reserve(int size);
+
+	/**
+	 * Not copyable.
+	 */
+	MessageBuffer(const MessageBuffer&);
+	MessageBuffer& operator=(const MessageBuffer&);
+
+private:
+	/**
+	 * The buffer.
+	 */
+	char* mData;
+
+	/**
+	 * Size of the current data.
+	 */
+	int mSize;
+
+	/**
+	 * Allocated size of the buffer.
+	 */
+	int mCapacity;
+};
+
+} // namespace
+
+#endif
+
+/*! @} */
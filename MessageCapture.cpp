@@ -0,0 +1,293 @@
+/*
+Copyright (C) 2012 MoSync AB
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License,
+version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+*/
+
+/**
+ * @file MessageCapture.cpp
+ *
+ * Log of the messages from a WebView and the scripts sent
+ * back, for replaying them later.
+ */
+
+#include <ma.h>				// MoSync API
+#include <mastring.h>		// C string functions
+#include <mavsprintf.h>		// sprintf
+#include <conprint.h>
+
+#include "MessageCapture.h"
+#include "MessageProtocol.h"
+
+namespace Wormhole
+{
+	/**
+	 * Names of the protocols, for logging.
+	 */
+	static const char* sProtocolNames[] =
+	{
+		"none",
+		"ms",
+		"mb",
+		"ma",
+		"other"
+	};
+
+	/**
+	 * Constructor.
+	 */
+	MessageCapture::MessageCapture() :
+		mFile(0),
+		mStartTime(0)
+	{
+	}
+
+	/**
+	 * Destructor.
+	 */
+	MessageCapture::~MessageCapture()
+	{
+		close();
+	}
+
+	/**
+	 * Start a capture.
+	 */
+	bool MessageCapture::open(const char* fileName)
+	{
+		close();
+
+		char path[1024];
+		if (!getLocalPath(fileName, path, sizeof(path)))
+		{
+			return false;
+		}
+
+		MAHandle file = maFileOpen(path, MA_ACCESS_READ_WRITE);
+		if (file < 0)
+		{
+			lprintfln("@@@ MessageCapture: could not open %s, %d",
+				path, file);
+			return false;
+		}
+
+		int result = maFileExists(file)
+			? maFileTruncate(file, 0)
+			: maFileCreate(file);
+		int magic = MESSAGE_CAPTURE_MAGIC;
+		if (result >= 0)
+		{
+			result = maFileWrite(file, &magic, sizeof(magic));
+		}
+		if (result < 0)
+		{
+			lprintfln("@@@ MessageCapture: could not write %s, %d",
+				path, result);
+			maFileClose(file);
+			return false;
+		}
+
+		lprintfln("@@@ MessageCapture: capturing to %s", path);
+		mFile = file;
+		mStartTime = maGetMilliSecondCount();
+		return true;
+	}
+
+	/**
+	 * Start a capture in a new file named by the time.
+	 */
+	bool MessageCapture::openNew()
+	{
+		char fileName[64];
+		sprintf(fileName,
+			MESSAGE_CAPTURE_PREFIX "%010d" MESSAGE_CAPTURE_SUFFIX,
+			maTime());
+		return open(fileName);
+	}
+
+	/**
+	 * Stop the capture and close the file.
+	 */
+	void MessageCapture::close()
+	{
+		if (0 != mFile)
+		{
+			maFileClose(mFile);
+			mFile = 0;
+		}
+	}
+
+	/**
+	 * @return true if a capture is open.
+	 */
+	bool MessageCapture::isOpen()
+	{
+		return 0 != mFile;
+	}
+
+	/**
+	 * Add a message from the WebView.
+	 */
+	void MessageCapture::addMessage(const char* data, int size)
+	{
+		if (0 != mFile)
+		{
+			write(
+				MESSAGE_CAPTURE_MESSAGE,
+				getProtocol(data, size),
+				data,
+				size);
+		}
+	}
+
+	/**
+	 * Add a script evaluated in the WebView.
+	 */
+	void MessageCapture::addScript(const char* script, int length)
+	{
+		if (0 != mFile)
+		{
+			write(
+				MESSAGE_CAPTURE_SCRIPT,
+				MESSAGE_CAPTURE_PROTOCOL_NONE,
+				script,
+				length);
+		}
+	}
+
+	/**
+	 * @return The MessageCaptureProtocol of a message.
+	 */
+	int MessageCapture::getProtocol(const char* data, int size)
+	{
+		MessageProtocol protocol(data, size);
+		if (protocol.isMessageStream())
+		{
+			return MESSAGE_CAPTURE_PROTOCOL_STREAM;
+		}
+		if (protocol.isMessageBinary())
+		{
+			return MESSAGE_CAPTURE_PROTOCOL_BINARY;
+		}
+		if (protocol.isMessageArrayJSON())
+		{
+			return MESSAGE_CAPTURE_PROTOCOL_JSON;
+		}
+		return MESSAGE_CAPTURE_PROTOCOL_OTHER;
+	}
+
+	/**
+	 * @return Name of a MessageCaptureProtocol.
+	 */
+	const char* MessageCapture::getProtocolName(int protocol)
+	{
+		if (protocol < MESSAGE_CAPTURE_PROTOCOL_NONE
+			|| protocol > MESSAGE_CAPTURE_PROTOCOL_OTHER)
+		{
+			protocol = MESSAGE_CAPTURE_PROTOCOL_OTHER;
+		}
+		return sProtocolNames[protocol];
+	}
+
+	/**
+	 * Get the path of a file in the local files directory.
+	 */
+	bool MessageCapture::getLocalPath(
+		const char* fileName,
+		char* path,
+		int size)
+	{
+		int length = maGetSystemProperty("mosync.path.local", path, size);
+		if (length <= 0
+			|| length + (int) strlen(fileName) > size)
+		{
+			lprintfln("@@@ MessageCapture: no path for %s", fileName);
+			return false;
+		}
+
+		// The length includes the terminating zero.
+		strcpy(path + length - 1, fileName);
+		return true;
+	}
+
+	/**
+	 * Find the newest capture started with openNew.
+	 */
+	bool MessageCapture::findNewest(char* fileName, int size)
+	{
+		char path[1024];
+		if (!getLocalPath("", path, sizeof(path)))
+		{
+			return false;
+		}
+
+		MAHandle list = maFileListStart(
+			path,
+			MESSAGE_CAPTURE_PREFIX "*" MESSAGE_CAPTURE_SUFFIX,
+			MA_FL_SORT_NONE);
+		if (list < 0)
+		{
+			return false;
+		}
+
+		// The names have the same length, the greatest is
+		// the newest.
+		bool found = false;
+		char name[256];
+		int length;
+		while ((length = maFileListNext(list, name, sizeof(name))) > 0)
+		{
+			if (length >= (int) sizeof(name) || length >= size)
+			{
+				continue;
+			}
+			if (!found || strcmp(name, fileName) > 0)
+			{
+				strcpy(fileName, name);
+				found = true;
+			}
+		}
+		maFileListClose(list);
+		return found;
+	}
+
+	/**
+	 * Write a record.
+	 */
+	void MessageCapture::write(
+		int type,
+		int protocol,
+		const char* data,
+		int length)
+	{
+		MessageCaptureRecord record;
+		record.mType = type;
+		record.mTime = maGetMilliSecondCount() - mStartTime;
+		record.mProtocol = protocol;
+		record.mLength = length;
+
+		int result = maFileWrite(mFile, &record, sizeof(record));
+		if (result >= 0 && length > 0)
+		{
+			result = maFileWrite(mFile, data, length);
+		}
+		if (result < 0)
+		{
+			lprintfln("@@@ MessageCapture: write failed, %d", result);
+			close();
+		}
+	}
+
+} // namespace
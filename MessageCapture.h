@@ -0,0 +1,247 @@
+/*
+Copyright (C) 2012 MoSync AB
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License,
+version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+*/
+
+/*! \addtogroup WormHoleGroup
+ *  @{
+ */
+
+/** @defgroup WormHoleGroup Wormhole Library
+ *  @{
+ */
+
+/**
+ * @file MessageCapture.h
+ *
+ * Log of the messages from a WebView and the scripts sent
+ * back, for replaying them later.
+ */
+
+#ifndef MESSAGE_CAPTURE_H_
+#define MESSAGE_CAPTURE_H_
+
+#include <ma.h>
+
+/**
+ * First bytes of a capture file, "MCP1".
+ */
+#define MESSAGE_CAPTURE_MAGIC 0x3150434D
+
+/**
+ * Captures started with MessageCapture::openNew are named by
+ * the prefix, the start time in seconds padded to ten digits,
+ * and the suffix, so that the names sort by time.
+ */
+#define MESSAGE_CAPTURE_PREFIX "message-capture-"
+#define MESSAGE_CAPTURE_SUFFIX ".bin"
+
+namespace Wormhole
+{
+
+/**
+ * Kinds of records in a capture file.
+ */
+enum MessageCaptureType
+{
+	/**
+	 * A message from the WebView, with its protocol prefix.
+	 */
+	MESSAGE_CAPTURE_MESSAGE = 1,
+
+	/**
+	 * A script evaluated in the WebView.
+	 */
+	MESSAGE_CAPTURE_SCRIPT = 2
+};
+
+/**
+ * Protocols of the captured messages.
+ */
+enum MessageCaptureProtocol
+{
+	MESSAGE_CAPTURE_PROTOCOL_NONE = 0,
+	MESSAGE_CAPTURE_PROTOCOL_STREAM = 1,
+	MESSAGE_CAPTURE_PROTOCOL_BINARY = 2,
+	MESSAGE_CAPTURE_PROTOCOL_JSON = 3,
+	MESSAGE_CAPTURE_PROTOCOL_OTHER = 4
+};
+
+/**
+ * Header of a record in a capture file. The record data
+ * follows the header.
+ */
+struct MessageCaptureRecord
+{
+	/**
+	 * A MessageCaptureType.
+	 */
+	int mType;
+
+	/**
+	 * Time of the record, in milliseconds since the
+	 * capture was started.
+	 */
+	int mTime;
+
+	/**
+	 * A MessageCaptureProtocol, MESSAGE_CAPTURE_PROTOCOL_NONE
+	 * for scripts.
+	 */
+	int mProtocol;
+
+	/**
+	 * Number of bytes of data.
+	 */
+	int mLength;
+};
+
+/**
+ * Writes the messages received from a WebView and the scripts
+ * evaluated in it to a file in the local files directory, so
+ * that a problem seen in the field can be replayed with the
+ * same traffic, see MessageReplay in MessageBenchmark.h.
+ *
+ * The file starts with MESSAGE_CAPTURE_MAGIC, followed by the
+ * records in the order they happened. Each record is a
+ * MessageCaptureRecord followed by the data. All ints are in
+ * the byte order of the device.
+ *
+ * Messages are added by the moblet, scripts by a ScriptBatch
+ * that the capture has been set on with ScriptBatch::setCapture.
+ * Writing every message to a file is slow, so the moblet only
+ * captures when MESSAGE_CAPTURE is defined.
+ */
+class MessageCapture
+{
+public:
+	/**
+	 * Constructor.
+	 */
+	MessageCapture();
+
+	/**
+	 * Destructor. Closes the file.
+	 */
+	virtual ~MessageCapture();
+
+	/**
+	 * Start a capture.
+	 *
+	 * @param fileName Name of the file in the local files
+	 * directory. The file is replaced.
+	 * @return true on success, false if the file could not
+	 * be written.
+	 */
+	bool open(const char* fileName);
+
+	/**
+	 * Start a capture in a new file in the local files
+	 * directory, named by the current time, so that the
+	 * captures of earlier runs are kept.
+	 *
+	 * @return true on success, false if the file could not
+	 * be written.
+	 */
+	bool openNew();
+
+	/**
+	 * Stop the capture and close the file.
+	 */
+	void close();
+
+	/**
+	 * @return true if a capture is open.
+	 */
+	bool isOpen();
+
+	/**
+	 * Add a message from the WebView.
+	 *
+	 * @param data The message data, starting with the
+	 * protocol prefix.
+	 * @param size Size of the data.
+	 */
+	virtual void addMessage(const char* data, int size);
+
+	/**
+	 * Add a script evaluated in the WebView.
+	 *
+	 * @param script The script.
+	 * @param length Length of the script in bytes.
+	 */
+	virtual void addScript(const char* script, int length);
+
+	/**
+	 * @return The MessageCaptureProtocol of a message.
+	 */
+	static int getProtocol(const char* data, int size);
+
+	/**
+	 * @return Name of a MessageCaptureProtocol, for logging.
+	 */
+	static const char* getProtocolName(int protocol);
+
+	/**
+	 * Get the path of a file in the local files directory.
+	 *
+	 * @param fileName Name of the file.
+	 * @param path Set to the full path.
+	 * @param size Size of path, in bytes.
+	 * @return true on success, false if the path does not fit.
+	 */
+	static bool getLocalPath(const char* fileName, char* path, int size);
+
+	/**
+	 * Find the newest capture started with openNew.
+	 *
+	 * @param fileName Set to the name of the file in the local
+	 * files directory.
+	 * @param size Size of fileName, in bytes.
+	 * @return true if a capture was found.
+	 */
+	static bool findNewest(char* fileName, int size);
+
+private:
+	/**
+	 * Write a record. Stops the capture if the file cannot
+	 * be written.
+	 */
+	void write(int type, int protocol, const char* data, int length);
+
+	/**
+	 * Not copyable.
+	 */
+	MessageCapture(const MessageCapture&);
+	MessageCapture& operator=(const MessageCapture&);
+
+private:
+	/**
+	 * The capture file, 0 if no capture is open.
+	 */
+	MAHandle mFile;
+
+	/**
+	 * Time the capture was started.
+	 */
+	int mStartTime;
+};
+
+} // namespace
+
+#endif
+
+/*! @} */
@@ -0,0 +1,401 @@
+/*
+Copyright (C) 2012 MoSync AB
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License,
+version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+*/
+
+/*! \addtogroup WormHoleGroup
+ *  @{
+ */
+
+/** @defgroup WormHoleGroup Wormhole Library
+ *  @{
+ */
+
+/**
+ * @file MessageDispatcher.h
+ *
+ * Table based dispatch of messages to handler methods.
+ */
+
+#ifndef MESSAGE_DISPATCHER_H_
+#define MESSAGE_DISPATCHER_H_
+
+#include <ma.h>
+#include <mastring.h>
+#include <conprint.h>
+#include "MessageStream.h"
+#include "MessageStats.h"
+#include "StringHash.h"
+
+namespace Wormhole
+{
+
+/**
+ * Maps message names and opcodes to handler methods of an object.
+ *
+ * Handlers are registered once, typically in the constructor
+ * of the object that implements them. The names are stored in
+ * an open addressing hash table with a fixed size, so looking
+ * up a name costs one hash of the name plus, in the rare case of
+ * a collision, a few extra comparisons, regardless of how many
+ * names are registered. Opcodes, used by binary message streams,
+ * index a table directly.
+ *
+ * Usage:
+ *
+ *   mDispatcher.add("maWidgetCreate", OP_CREATE, &MyHandler::widgetCreate);
+ *   ...
+ *   while (stream.nextMessage())
+ *   {
+ *       mDispatcher.dispatchNext(stream);
+ *   }
+ *
+ * If a MessageStats object is set with setStats, every call of
+ * a handler is counted and timed under the message name.
+ *
+ * @param T The class that implements the handler methods.
+ * @param TABLE_SIZE Size of the hash table, must be a power of
+ * two. At most half of the table can be filled, and opcodes
+ * must be less than TABLE_SIZE.
+ */
+template <class T, int TABLE_SIZE = 32>
+class MessageDispatcher
+{
+public:
+	/**
+	 * Type of the handler methods.
+	 */
+	typedef void (T::*Handler)(MessageStream& stream);
+
+	/**
+	 * Constructor.
+	 * @param owner The object the handler methods are called on.
+	 */
+	MessageDispatcher(T* owner) :
+		mOwner(owner),
+		mNumEntries(0),
+		mUnknownCount(0),
+		mStats(NULL)
+	{
+		for (int i = 0; i < TABLE_SIZE; ++i)
+		{
+			mTable[i].mName = NULL;
+			mTable[i].mLength = 0;
+			mTable[i].mHandler = NULL;
+			mTable[i].mOpcode = 0;
+			mTable[i].mStatsIndex = -1;
+			mOpcodeTable[i] = NULL;
+			mOpcodeStatsIndex[i] = -1;
+		}
+	}
+
+	/**
+	 * Set the statistics that the calls of the handlers are
+	 * counted in. Registers all names with the statistics.
+	 *
+	 * @param stats The statistics, NULL to stop counting.
+	 */
+	void setStats(MessageStats* stats)
+	{
+		mStats = stats;
+		for (int i = 0; i < TABLE_SIZE; ++i)
+		{
+			mTable[i].mStatsIndex = -1;
+			mOpcodeStatsIndex[i] = -1;
+		}
+		if (NULL == stats)
+		{
+			return;
+		}
+
+		for (int i = 0; i < TABLE_SIZE; ++i)
+		{
+			if (NULL == mTable[i].mName)
+			{
+				continue;
+			}
+			int statsIndex = stats->addAction(mTable[i].mName);
+			mTable[i].mStatsIndex = statsIndex;
+			mOpcodeStatsIndex[mTable[i].mOpcode] = statsIndex;
+		}
+	}
+
+	/**
+	 * Register a handler for a message name and opcode.
+	 *
+	 * @param name The message name. The string is not copied
+	 * and must stay valid, normally it is a string literal.
+	 * @param opcode The opcode of the message in binary streams.
+	 * @param handler The method to call for the message.
+	 * @return true on success, false if the name or opcode is
+	 * already registered or the table is full.
+	 */
+	bool add(const char* name, int opcode, Handler handler)
+	{
+		if (opcode < 0 || opcode >= TABLE_SIZE
+			|| NULL != mOpcodeTable[opcode])
+		{
+			lprintfln("@@@ MessageDispatcher: bad opcode %d", opcode);
+			return false;
+		}
+
+		// Keep the load factor at or below one half, so that
+		// probe sequences stay short.
+		if ((mNumEntries + 1) * 2 > TABLE_SIZE)
+		{
+			lprintfln("@@@ MessageDispatcher: table full, %s", name);
+			return false;
+		}
+
+		int length = strlen(name);
+		int index = hashString(name, length) & (TABLE_SIZE - 1);
+		while (NULL != mTable[index].mName)
+		{
+			if (MessageView(name, length).equals(mTable[index].mName))
+			{
+				lprintfln("@@@ MessageDispatcher: duplicate %s", name);
+				return false;
+			}
+			index = (index + 1) & (TABLE_SIZE - 1);
+		}
+
+		int statsIndex = NULL != mStats ? mStats->addAction(name) : -1;
+		mTable[index].mName = name;
+		mTable[index].mLength = length;
+		mTable[index].mHandler = handler;
+		mTable[index].mOpcode = opcode;
+		mTable[index].mStatsIndex = statsIndex;
+		mOpcodeTable[opcode] = handler;
+		mOpcodeStatsIndex[opcode] = statsIndex;
+		++mNumEntries;
+
+		return true;
+	}
+
+	/**
+	 * Read the name or opcode of the next message from the
+	 * stream, and call the handler registered for it.
+	 *
+	 * Handlers may dispatch the rest of a message with a
+	 * dispatcher of their own, so this does not move to the
+	 * next message. The loop over the stream does, with
+	 * MessageStream::nextMessage.
+	 *
+	 * @param stream The stream to read the message from.
+	 * @return true if a handler was called, false if the
+	 * message is unknown or could not be read.
+	 */
+	bool dispatchNext(MessageStream& stream)
+	{
+		if (stream.isBinary())
+		{
+			return dispatch(stream.getNextInt(), stream);
+		}
+
+		// A malformed stream ends with a failed read, which
+		// is not an unknown message.
+		MessageView name = stream.getNextView();
+		if (name.isNull())
+		{
+			return false;
+		}
+		return dispatch(name, stream);
+	}
+
+	/**
+	 * Call the handler registered for a message name.
+	 *
+	 * @param name The message name.
+	 * @param stream The stream the handler reads its
+	 * parameters from.
+	 * @return true if a handler was called, false if the
+	 * name is unknown.
+	 */
+	bool dispatch(const MessageView& name, MessageStream& stream)
+	{
+		const Entry* entry = findEntry(name);
+		if (NULL == entry)
+		{
+			++mUnknownCount;
+			if (NULL != mStats)
+			{
+				mStats->addUnknownMessage();
+			}
+			lprintfln(
+				"@@@ MessageDispatcher: unknown message %.*s",
+				name.getLength(),
+				name.isNull() ? "" : name.getData());
+			return false;
+		}
+
+		call(entry->mHandler, entry->mStatsIndex, stream);
+
+		return true;
+	}
+
+	/**
+	 * Call the handler registered for an opcode.
+	 *
+	 * @param opcode The message opcode.
+	 * @param stream The stream the handler reads its
+	 * parameters from.
+	 * @return true if a handler was called, false if the
+	 * opcode is unknown.
+	 */
+	bool dispatch(int opcode, MessageStream& stream)
+	{
+		if (opcode < 0 || opcode >= TABLE_SIZE
+			|| NULL == mOpcodeTable[opcode])
+		{
+			++mUnknownCount;
+			if (NULL != mStats)
+			{
+				mStats->addUnknownMessage();
+			}
+			lprintfln("@@@ MessageDispatcher: unknown opcode %d", opcode);
+			return false;
+		}
+
+		call(mOpcodeTable[opcode], mOpcodeStatsIndex[opcode], stream);
+
+		return true;
+	}
+
+	/**
+	 * Find the handler registered for a message name.
+	 * @return The handler, NULL if the name is unknown.
+	 */
+	Handler find(const MessageView& name)
+	{
+		const Entry* entry = findEntry(name);
+		return NULL != entry ? entry->mHandler : NULL;
+	}
+
+	/**
+	 * @return The number of messages with an unknown name
+	 * or opcode passed to dispatch.
+	 */
+	int getUnknownCount()
+	{
+		return mUnknownCount;
+	}
+
+private:
+	/**
+	 * Hash table entry.
+	 */
+	struct Entry
+	{
+		const char* mName;
+		int mLength;
+		Handler mHandler;
+		int mOpcode;
+		int mStatsIndex;
+	};
+
+	/**
+	 * Find the entry of a message name.
+	 * @return The entry, NULL if the name is unknown.
+	 */
+	const Entry* findEntry(const MessageView& name)
+	{
+		if (name.isNull())
+		{
+			return NULL;
+		}
+
+		int index = hashString(name.getData(), name.getLength())
+			& (TABLE_SIZE - 1);
+		while (NULL != mTable[index].mName)
+		{
+			if (mTable[index].mLength == name.getLength()
+				&& name.equals(mTable[index].mName))
+			{
+				return &mTable[index];
+			}
+			index = (index + 1) & (TABLE_SIZE - 1);
+		}
+
+		return NULL;
+	}
+
+	/**
+	 * Call a handler, and count the call if there are
+	 * statistics.
+	 */
+	void call(Handler handler, int statsIndex, MessageStream& stream)
+	{
+		if (NULL == mStats)
+		{
+			(mOwner->*handler)(stream);
+			return;
+		}
+
+		int start = maGetMilliSecondCount();
+		(mOwner->*handler)(stream);
+		mStats->addActionTime(
+			statsIndex,
+			maGetMilliSecondCount() - start);
+	}
+
+	/**
+	 * Not copyable.
+	 */
+	MessageDispatcher(const MessageDispatcher&);
+	MessageDispatcher& operator=(const MessageDispatcher&);
+
+private:
+	/**
+	 * The object the handlers are called on.
+	 */
+	T* mOwner;
+
+	/**
+	 * The hash table.
+	 */
+	Entry mTable[TABLE_SIZE];
+
+	/**
+	 * Handlers indexed by opcode.
+	 */
+	Handler mOpcodeTable[TABLE_SIZE];
+
+	/**
+	 * Statistics indexes of the handlers, indexed by opcode.
+	 */
+	int mOpcodeStatsIndex[TABLE_SIZE];
+
+	/**
+	 * Number of registered handlers.
+	 */
+	int mNumEntries;
+
+	/**
+	 * Number of unknown messages.
+	 */
+	int mUnknownCount;
+
+	/**
+	 * Statistics the calls are counted in, NULL if none.
+	 */
+	MessageStats* mStats;
+};
+
+} // namespace
+
+#endif
+
+/*! @} */
@@ -0,0 +1,477 @@
+/*
+Copyright (C) 2012 MoSync AB
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License,
+version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+*/
+
+/**
+ * @file MessageJSON.cpp
+ *
+ * JSON tree allocated in a MessageArena.
+ */
+
+#include <ma.h>				// MoSync API
+#include <mastring.h>		// C string functions
+#include <mastdlib.h>		// C string conversion functions
+#include <yajl/yajl_parse.h>
+
+#include "MessageJSON.h"
+
+// Memory blocks given to yajl start with their size, which
+// realloc needs. The header keeps the alignment of arena
+// allocations.
+#define MESSAGE_JSON_BLOCK_HEADER 8
+
+using namespace MAUtil;
+
+namespace Wormhole
+{
+	/**
+	 * State of a parse, the context of the yajl callbacks.
+	 */
+	struct MessageJSONContext
+	{
+		MessageArena* mArena;
+
+		/**
+		 * The first value parsed.
+		 */
+		MessageJSONValue* mRoot;
+
+		/**
+		 * The map or array that values are added to,
+		 * NULL at the top level.
+		 */
+		MessageJSONValue* mContainer;
+
+		/**
+		 * Key of the next value in a map.
+		 */
+		const char* mKey;
+		int mKeyLength;
+	};
+
+	/**
+	 * @return The type of the value.
+	 */
+	MessageJSONValue::Type MessageJSONValue::getType() const
+	{
+		return mType;
+	}
+
+	/**
+	 * @return The value as an int.
+	 */
+	int MessageJSONValue::toInt() const
+	{
+		if (NUMBER == mType || STRING == mType)
+		{
+			return atoi(mText);
+		}
+		if (BOOLEAN == mType)
+		{
+			return mLength;
+		}
+		return 0;
+	}
+
+	/**
+	 * @return The value as a double.
+	 */
+	double MessageJSONValue::toDouble() const
+	{
+		if (NUMBER == mType || STRING == mType)
+		{
+			return strtod(mText, NULL);
+		}
+		if (BOOLEAN == mType)
+		{
+			return mLength;
+		}
+		return 0;
+	}
+
+	/**
+	 * @return true for the boolean true.
+	 */
+	bool MessageJSONValue::toBoolean() const
+	{
+		return BOOLEAN == mType && 0 != mLength;
+	}
+
+	/**
+	 * @return The value as a string.
+	 */
+	String MessageJSONValue::toString() const
+	{
+		switch (mType)
+		{
+			case NUL:
+				return "null";
+			case BOOLEAN:
+				return 0 != mLength ? "true" : "false";
+			case NUMBER:
+			case STRING:
+				return String(mText, mLength);
+			default:
+				return "";
+		}
+	}
+
+	/**
+	 * @return Pointer to the text of a string or number.
+	 */
+	const char* MessageJSONValue::getCharPointer() const
+	{
+		return (NUMBER == mType || STRING == mType) ? mText : NULL;
+	}
+
+	/**
+	 * @return Length of the text of a string or number.
+	 */
+	int MessageJSONValue::getLength() const
+	{
+		return (NUMBER == mType || STRING == mType) ? mLength : 0;
+	}
+
+	/**
+	 * @return Key of a member of a map, NULL otherwise.
+	 */
+	const char* MessageJSONValue::getKey() const
+	{
+		return mKey;
+	}
+
+	/**
+	 * @return Length of the key, 0 if there is none.
+	 */
+	int MessageJSONValue::getKeyLength() const
+	{
+		return mKeyLength;
+	}
+
+	/**
+	 * @return Number of children of a map or array.
+	 */
+	int MessageJSONValue::getNumChildValues() const
+	{
+		return mNumChildren;
+	}
+
+	/**
+	 * @return The first child of a map or array.
+	 */
+	MessageJSONValue* MessageJSONValue::getFirstChild() const
+	{
+		return mFirstChild;
+	}
+
+	/**
+	 * @return The next child of the parent.
+	 */
+	MessageJSONValue* MessageJSONValue::getNext() const
+	{
+		return mNext;
+	}
+
+	/**
+	 * Get a child of an array by index.
+	 */
+	MessageJSONValue* MessageJSONValue::getValueByIndex(int index) const
+	{
+		MessageJSONValue* child = mFirstChild;
+		while (NULL != child && index > 0)
+		{
+			child = child->mNext;
+			--index;
+		}
+		return index < 0 ? NULL : child;
+	}
+
+	/**
+	 * Get the value of a key in a map.
+	 */
+	MessageJSONValue* MessageJSONValue::getValueForKey(const char* key) const
+	{
+		return getValueForKey(key, strlen(key));
+	}
+
+	/**
+	 * Get the value of a key of known length in a map.
+	 */
+	MessageJSONValue* MessageJSONValue::getValueForKey(
+		const char* key,
+		int keyLength) const
+	{
+		if (MAP != mType)
+		{
+			return NULL;
+		}
+
+		// Messages have a handful of keys, a linear
+		// search is faster than building an index.
+		for (MessageJSONValue* child = mFirstChild;
+			NULL != child;
+			child = child->mNext)
+		{
+			if (keyLength == child->mKeyLength
+				&& 0 == memcmp(key, child->mKey, keyLength))
+			{
+				return child;
+			}
+		}
+		return NULL;
+	}
+
+	/**
+	 * Parse a JSON value.
+	 */
+	MessageJSONValue* MessageJSON::parse(
+		const char* data,
+		int length,
+		MessageArena& arena)
+	{
+		static const yajl_callbacks callbacks =
+		{
+			onNull,
+			onBoolean,
+			NULL,			// Numbers are read by onNumber.
+			NULL,
+			onNumber,
+			onString,
+			onStartMap,
+			onMapKey,
+			onEnd,
+			onStartArray,
+			onEnd
+		};
+
+		// The messages are written by JSON.stringify, so
+		// they need no comments or UTF-8 check.
+		yajl_parser_config config = { 0, 0 };
+
+		yajl_alloc_funcs allocFuncs =
+		{
+			onMalloc,
+			onRealloc,
+			onFree,
+			&arena
+		};
+
+		MessageJSONContext context;
+		context.mArena = &arena;
+		context.mRoot = NULL;
+		context.mContainer = NULL;
+		context.mKey = NULL;
+		context.mKeyLength = 0;
+
+		yajl_handle parser = yajl_alloc(
+			&callbacks,
+			&config,
+			&allocFuncs,
+			&context);
+		if (NULL == parser)
+		{
+			return NULL;
+		}
+
+		yajl_status status = yajl_parse(
+			parser,
+			(const unsigned char*) data,
+			length);
+		if (yajl_status_ok == status
+			|| yajl_status_insufficient_data == status)
+		{
+			status = yajl_parse_complete(parser);
+		}
+
+		yajl_free(parser);
+
+		return yajl_status_ok == status ? context.mRoot : NULL;
+	}
+
+	/**
+	 * Add a value to the tree being built.
+	 */
+	MessageJSONValue* MessageJSON::addValue(
+		void* context,
+		MessageJSONValue::Type type)
+	{
+		MessageJSONContext* c = (MessageJSONContext*) context;
+
+		MessageJSONValue* value = (MessageJSONValue*)
+			c->mArena->alloc(sizeof(MessageJSONValue));
+		if (NULL == value)
+		{
+			return NULL;
+		}
+
+		value->mType = type;
+		value->mText = NULL;
+		value->mLength = 0;
+		value->mKey = c->mKey;
+		value->mKeyLength = c->mKeyLength;
+		value->mParent = c->mContainer;
+		value->mNext = NULL;
+		value->mFirstChild = NULL;
+		value->mLastChild = NULL;
+		value->mNumChildren = 0;
+
+		c->mKey = NULL;
+		c->mKeyLength = 0;
+
+		MessageJSONValue* parent = c->mContainer;
+		if (NULL == parent)
+		{
+			c->mRoot = value;
+		}
+		else
+		{
+			if (NULL == parent->mLastChild)
+			{
+				parent->mFirstChild = value;
+			}
+			else
+			{
+				parent->mLastChild->mNext = value;
+			}
+			parent->mLastChild = value;
+			++parent->mNumChildren;
+		}
+
+		return value;
+	}
+
+	int MessageJSON::onNull(void* context)
+	{
+		return NULL != addValue(context, MessageJSONValue::NUL);
+	}
+
+	int MessageJSON::onBoolean(void* context, int value)
+	{
+		MessageJSONValue* v = addValue(context, MessageJSONValue::BOOLEAN);
+		if (NULL == v)
+		{
+			return 0;
+		}
+		v->mLength = value ? 1 : 0;
+		return 1;
+	}
+
+	int MessageJSON::onNumber(void* context, const char* s, unsigned int length)
+	{
+		MessageJSONValue* v = addValue(context, MessageJSONValue::NUMBER);
+		if (NULL == v)
+		{
+			return 0;
+		}
+		v->mText = ((MessageJSONContext*) context)->mArena->copy(s, length);
+		v->mLength = length;
+		return NULL != v->mText;
+	}
+
+	int MessageJSON::onString(
+		void* context,
+		const unsigned char* s,
+		unsigned int length)
+	{
+		MessageJSONValue* v = addValue(context, MessageJSONValue::STRING);
+		if (NULL == v)
+		{
+			return 0;
+		}
+		// The string is only valid during the callback.
+		v->mText = ((MessageJSONContext*) context)->mArena->copy(
+			(const char*) s,
+			length);
+		v->mLength = length;
+		return NULL != v->mText;
+	}
+
+	int MessageJSON::onStartMap(void* context)
+	{
+		MessageJSONValue* v = addValue(context, MessageJSONValue::MAP);
+		if (NULL == v)
+		{
+			return 0;
+		}
+		((MessageJSONContext*) context)->mContainer = v;
+		return 1;
+	}
+
+	int MessageJSON::onMapKey(
+		void* context,
+		const unsigned char* s,
+		unsigned int length)
+	{
+		MessageJSONContext* c = (MessageJSONContext*) context;
+		c->mKey = c->mArena->copy((const char*) s, length);
+		c->mKeyLength = length;
+		return NULL != c->mKey;
+	}
+
+	int MessageJSON::onStartArray(void* context)
+	{
+		MessageJSONValue* v = addValue(context, MessageJSONValue::ARRAY);
+		if (NULL == v)
+		{
+			return 0;
+		}
+		((MessageJSONContext*) context)->mContainer = v;
+		return 1;
+	}
+
+	/**
+	 * End of a map or an array.
+	 */
+	int MessageJSON::onEnd(void* context)
+	{
+		MessageJSONContext* c = (MessageJSONContext*) context;
+		c->mContainer = c->mContainer->mParent;
+		return 1;
+	}
+
+	void* MessageJSON::onMalloc(void* context, unsigned int size)
+	{
+		MessageArena* arena = (MessageArena*) context;
+		char* p = (char*) arena->alloc(size + MESSAGE_JSON_BLOCK_HEADER);
+		if (NULL == p)
+		{
+			return NULL;
+		}
+		*((unsigned int*) p) = size;
+		return p + MESSAGE_JSON_BLOCK_HEADER;
+	}
+
+	void* MessageJSON::onRealloc(void* context, void* p, unsigned int size)
+	{
+		void* block = onMalloc(context, size);
+		if (NULL != block && NULL != p)
+		{
+			unsigned int oldSize = *((unsigned int*)
+				((char*) p - MESSAGE_JSON_BLOCK_HEADER));
+			memcpy(block, p, oldSize < size ? oldSize : size);
+		}
+		return block;
+	}
+
+	/**
+	 * Memory is freed with the arena.
+	 */
+	void MessageJSON::onFree(void* context, void* p)
+	{
+	}
+
+} // namespace
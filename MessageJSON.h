@@ -0,0 +1,259 @@
+/*
+Copyright (C) 2012 MoSync AB
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License,
+version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+*/
+
+/*! \addtogroup WormHoleGroup
+ *  @{
+ */
+
+/** @defgroup WormHoleGroup Wormhole Library
+ *  @{
+ */
+
+/**
+ * @file MessageJSON.h
+ *
+ * JSON tree allocated in a MessageArena.
+ */
+
+#ifndef MESSAGE_JSON_H_
+#define MESSAGE_JSON_H_
+
+#include <ma.h>
+#include <MAUtil/String.h>
+#include "MessageArena.h"
+
+namespace Wormhole
+{
+
+/**
+ * A node of a JSON tree parsed by MessageJSON::parse. Nodes,
+ * keys and strings are all allocated in the arena given to
+ * parse, and are freed with it, there is no delete.
+ *
+ * The interface follows YAJLDom::Value, which this replaces
+ * in MessageStreamJSON, but the types are in one class: a
+ * string or number keeps its text, and a map or array keeps
+ * its children in a list. Numbers are kept as text and are
+ * converted when read, which is what the messages need.
+ */
+class MessageJSONValue
+{
+public:
+	/**
+	 * Types of values.
+	 */
+	enum Type
+	{
+		NUL,
+		BOOLEAN,
+		NUMBER,
+		STRING,
+		ARRAY,
+		MAP
+	};
+
+	/**
+	 * @return The type of the value.
+	 */
+	Type getType() const;
+
+	/**
+	 * @return The value of a number, string or boolean
+	 * as an int, 0 for other types.
+	 */
+	int toInt() const;
+
+	/**
+	 * @return The value of a number or string as a double,
+	 * 0 for other types.
+	 */
+	double toDouble() const;
+
+	/**
+	 * @return true for the boolean true, false otherwise.
+	 */
+	bool toBoolean() const;
+
+	/**
+	 * @return The text of a string or number, "true",
+	 * "false" or "null" for the literals, and an empty
+	 * string for maps and arrays.
+	 */
+	MAUtil::String toString() const;
+
+	/**
+	 * @return Pointer to the text of a string or number,
+	 * zero terminated, NULL for other types.
+	 */
+	const char* getCharPointer() const;
+
+	/**
+	 * @return Length in bytes of the text of a string or
+	 * number, 0 for other types.
+	 */
+	int getLength() const;
+
+	/**
+	 * @return Key of a member of a map, NULL otherwise.
+	 * The key is not zero terminated.
+	 */
+	const char* getKey() const;
+
+	/**
+	 * @return Length in bytes of the key, 0 if there is none.
+	 */
+	int getKeyLength() const;
+
+	/**
+	 * @return Number of children of a map or array.
+	 */
+	int getNumChildValues() const;
+
+	/**
+	 * @return The first child of a map or array, NULL if
+	 * there is none.
+	 */
+	MessageJSONValue* getFirstChild() const;
+
+	/**
+	 * @return The next child of the parent map or array,
+	 * NULL if this is the last one.
+	 */
+	MessageJSONValue* getNext() const;
+
+	/**
+	 * Get a child of an array by index. Walks the list, use
+	 * getFirstChild and getNext to visit all children.
+	 * @return The child, NULL if out of range.
+	 */
+	MessageJSONValue* getValueByIndex(int index) const;
+
+	/**
+	 * Get the value of a key in a map.
+	 * @return The value, NULL if the key is missing.
+	 */
+	MessageJSONValue* getValueForKey(const char* key) const;
+
+	/**
+	 * Get the value of a key of known length in a map.
+	 * @return The value, NULL if the key is missing.
+	 */
+	MessageJSONValue* getValueForKey(const char* key, int keyLength) const;
+
+private:
+	friend class MessageJSON;
+
+	Type mType;
+
+	/**
+	 * Text of a string or number. For a boolean the length
+	 * is 1 for true and 0 for false.
+	 */
+	const char* mText;
+	int mLength;
+
+	/**
+	 * Key of a member of a map, NULL otherwise.
+	 */
+	const char* mKey;
+	int mKeyLength;
+
+	/**
+	 * Map or array this value is in.
+	 */
+	MessageJSONValue* mParent;
+
+	/**
+	 * Next child of the parent.
+	 */
+	MessageJSONValue* mNext;
+
+	/**
+	 * Children of a map or array.
+	 */
+	MessageJSONValue* mFirstChild;
+	MessageJSONValue* mLastChild;
+	int mNumChildren;
+};
+
+/**
+ * Parses JSON with the yajl parser into a tree of
+ * MessageJSONValue nodes allocated in a MessageArena, so
+ * that a tree takes no heap allocations of its own and is
+ * freed in one step with the arena. The memory the parser
+ * uses internally is taken from the arena as well.
+ */
+class MessageJSON
+{
+public:
+	/**
+	 * Parse a JSON value.
+	 *
+	 * @param data The JSON text, need not be zero terminated.
+	 * @param length Length of the text.
+	 * @param arena The arena to allocate the tree in.
+	 * @return The root of the tree, NULL if the text is not
+	 * valid JSON or if the arena is out of memory.
+	 */
+	static MessageJSONValue* parse(
+		const char* data,
+		int length,
+		MessageArena& arena);
+
+private:
+	/**
+	 * Add a value to the tree being built.
+	 * @return The value, NULL if out of memory.
+	 */
+	static MessageJSONValue* addValue(
+		void* context,
+		MessageJSONValue::Type type);
+
+	/**
+	 * Callbacks of the yajl parser. They return 0 to stop
+	 * the parser when out of memory.
+	 */
+	static int onNull(void* context);
+	static int onBoolean(void* context, int value);
+	static int onNumber(void* context, const char* s, unsigned int length);
+	static int onString(
+		void* context,
+		const unsigned char* s,
+		unsigned int length);
+	static int onStartMap(void* context);
+	static int onMapKey(
+		void* context,
+		const unsigned char* s,
+		unsigned int length);
+	static int onStartArray(void* context);
+	static int onEnd(void* context);
+
+	/**
+	 * Memory functions of the yajl parser, taking the
+	 * memory from the arena.
+	 */
+	static void* onMalloc(void* context, unsigned int size);
+	static void* onRealloc(void* context, void* p, unsigned int size);
+	static void onFree(void* context, void* p);
+};
+
+} // namespace
+
+#endif
+
+/*! @} */
@@ -40,6 +40,21 @@ namespace Wormhole
 		maReadData(dataHandle, mProtocol, 0, 3);
 	}
 
+	MessageProtocol::MessageProtocol(const char* data, int dataSize)
+	{
+		// Messages shorter than the prefix get an empty protocol
+		// that matches nothing.
+		if (NULL == data || dataSize < 3)
+		{
+			mProtocol[0] = mProtocol[1] = mProtocol[2] = 0;
+			return;
+		}
+
+		mProtocol[0] = data[0];
+		mProtocol[1] = data[1];
+		mProtocol[2] = data[2];
+	}
+
 	MessageProtocol::~MessageProtocol()
 	{
 	}
@@ -67,4 +82,12 @@ namespace Wormhole
 			(mProtocol[1] == 'a') &&
 			(mProtocol[2] == ':');
 	}
+
+	bool MessageProtocol::isMessageBinary()
+	{
+		return
+			(mProtocol[0] == 'm') &&
+			(mProtocol[1] == 'b') &&
+			(mProtocol[2] == ':');
+	}
 } // namespace
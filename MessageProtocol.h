@@ -54,6 +54,8 @@ namespace Wormhole
  *
  *   "ms:" MessageStream (sent width function mosync.bridge.send)
  *
+ *   "mb:" MessageStreamBinary (sent with function mosync.bridge.sendBinary)
+ *
  * You can also use your own prefix and send the message string
  * using function mosync.bridge.sendRaw. The prefix must be two
  * characters plus a colon if you wish to use this class.
@@ -65,8 +67,18 @@ namespace Wormhole
 class MessageProtocol
 {
 public:
+	/**
+	 * Read the protocol from a data object.
+	 */
 	MessageProtocol(MAHandle dataHandle);
 
+	/**
+	 * Read the protocol from message data that has already
+	 * been read into memory, for example by a MessageBuffer.
+	 * This avoids a second read of the data object.
+	 */
+	MessageProtocol(const char* data, int dataSize);
+
 	virtual ~MessageProtocol();
 
 	bool matches(const char* protocol);
@@ -75,6 +87,8 @@ public:
 
 	bool isMessageArrayJSON();
 
+	bool isMessageBinary();
+
 private:
 	char mProtocol[3];
 };
@@ -0,0 +1,314 @@
+/*
+Copyright (C) 2012 MoSync AB
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License,
+version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+*/
+
+/**
+ * @file MessageStats.cpp
+ *
+ * Counters and latency histograms for the message layer.
+ */
+
+#include <ma.h>				// MoSync API
+#include <mastring.h>		// C string functions
+#include <conprint.h>
+
+#include "MessageStats.h"
+
+namespace Wormhole
+{
+	/**
+	 * Names of the kinds of work in the JSON output.
+	 */
+	static const char* sTimeNames[MESSAGE_TIME_COUNT] =
+	{
+		"native",
+		"format",
+		"evaluate"
+	};
+
+	/**
+	 * Constructor.
+	 */
+	MessageStats::MessageStats() :
+		mNumActions(0),
+		mNumSources(0)
+	{
+		reset();
+	}
+
+	/**
+	 * Destructor.
+	 */
+	MessageStats::~MessageStats()
+	{
+	}
+
+	/**
+	 * Register an action or module.
+	 */
+	int MessageStats::addAction(const char* name)
+	{
+		// Called once per handler at startup, so a linear
+		// search is fine.
+		for (int i = 0; i < mNumActions; ++i)
+		{
+			if (0 == strcmp(name, mActions[i].mName))
+			{
+				return i;
+			}
+		}
+
+		if (mNumActions >= MESSAGE_STATS_MAX_ACTIONS)
+		{
+			lprintfln("@@@ MessageStats: table full, %s", name);
+			return -1;
+		}
+
+		Action& action = mActions[mNumActions];
+		memset(&action, 0, sizeof(action));
+		action.mName = name;
+
+		return mNumActions++;
+	}
+
+	/**
+	 * Count a call of an action.
+	 */
+	void MessageStats::addActionTime(int action, int milliseconds)
+	{
+		if (action < 0 || action >= mNumActions)
+		{
+			return;
+		}
+
+		Action& a = mActions[action];
+		++a.mCount;
+		a.mTime += milliseconds;
+		if (milliseconds > a.mMaxTime)
+		{
+			a.mMaxTime = milliseconds;
+		}
+
+		// Bucket n holds times below 2^n ms.
+		int bucket = 0;
+		while (bucket < MESSAGE_STATS_HISTOGRAM_SIZE - 1
+			&& milliseconds >= (1 << bucket))
+		{
+			++bucket;
+		}
+		++a.mHistogram[bucket];
+	}
+
+	/**
+	 * Count a message stream from JavaScript.
+	 */
+	void MessageStats::addStream(
+		int numBytes,
+		int numMessages,
+		int milliseconds)
+	{
+		++mStreamCount;
+		mMessageCount += numMessages;
+		if (numMessages > mMaxMessageCount)
+		{
+			mMaxMessageCount = numMessages;
+		}
+		mBytesIn += numBytes;
+		mStreamTime += milliseconds;
+	}
+
+	/**
+	 * Count a message that no handler was registered for.
+	 */
+	void MessageStats::addUnknownMessage()
+	{
+		++mUnknownCount;
+	}
+
+	/**
+	 * Count a call to callJS.
+	 */
+	void MessageStats::addEvaluation(int numBytes, int milliseconds)
+	{
+		++mEvaluationCount;
+		mBytesOut += numBytes;
+		mTimes[MESSAGE_TIME_EVALUATE] += milliseconds;
+	}
+
+	/**
+	 * Add to the time spent on a kind of work.
+	 */
+	void MessageStats::addTime(MessageStatsTime time, int milliseconds)
+	{
+		mTimes[time] += milliseconds;
+	}
+
+	/**
+	 * Add a component whose counters are written with the
+	 * statistics.
+	 */
+	bool MessageStats::addSource(const char* name, MessageStatsSource* source)
+	{
+		if (mNumSources >= MESSAGE_STATS_MAX_SOURCES)
+		{
+			lprintfln("@@@ MessageStats: source table full, %s", name);
+			return false;
+		}
+
+		mSources[mNumSources].mName = name;
+		mSources[mNumSources].mSource = source;
+		++mNumSources;
+		return true;
+	}
+
+	/**
+	 * Write the statistics as a JSON object.
+	 */
+	void MessageStats::writeJSON(ScriptBuilder& json)
+	{
+		json.append("{");
+		appendKey(json, "elapsed");
+		json.append(maGetMilliSecondCount() - mResetTime);
+
+		json.append(",");
+		appendKey(json, "streams");
+		json.append("{");
+		appendKey(json, "count");
+		json.append(mStreamCount).append(",");
+		appendKey(json, "messages");
+		json.append(mMessageCount).append(",");
+		appendKey(json, "maxMessages");
+		json.append(mMaxMessageCount).append(",");
+		appendKey(json, "unknown");
+		json.append(mUnknownCount).append(",");
+		appendKey(json, "bytes");
+		json.append(mBytesIn).append(",");
+		appendKey(json, "time");
+		json.append(mStreamTime).append("}");
+
+		json.append(",");
+		appendKey(json, "scripts");
+		json.append("{");
+		appendKey(json, "count");
+		json.append(mEvaluationCount).append(",");
+		appendKey(json, "bytes");
+		json.append(mBytesOut).append(",");
+		appendKey(json, "time");
+		json.append(mTimes[MESSAGE_TIME_EVALUATE]).append("}");
+
+		json.append(",");
+		appendKey(json, "time");
+		json.append("{");
+		for (int i = 0; i < MESSAGE_TIME_COUNT; ++i)
+		{
+			if (i > 0)
+			{
+				json.append(",");
+			}
+			appendKey(json, sTimeNames[i]);
+			json.append(mTimes[i]);
+		}
+		json.append("}");
+
+		for (int i = 0; i < mNumSources; ++i)
+		{
+			json.append(",");
+			appendKey(json, mSources[i].mName);
+			mSources[i].mSource->writeStats(json);
+		}
+
+		json.append(",");
+		appendKey(json, "actions");
+		json.append("{");
+		bool first = true;
+		for (int i = 0; i < mNumActions; ++i)
+		{
+			const Action& a = mActions[i];
+			if (0 == a.mCount)
+			{
+				continue;
+			}
+			if (!first)
+			{
+				json.append(",");
+			}
+			first = false;
+
+			appendKey(json, a.mName);
+			json.append("{");
+			appendKey(json, "count");
+			json.append(a.mCount).append(",");
+			appendKey(json, "time");
+			json.append(a.mTime).append(",");
+			appendKey(json, "max");
+			json.append(a.mMaxTime).append(",");
+			appendKey(json, "histogram");
+			json.append("[");
+			for (int j = 0; j < MESSAGE_STATS_HISTOGRAM_SIZE; ++j)
+			{
+				if (j > 0)
+				{
+					json.append(",");
+				}
+				json.append(a.mHistogram[j]);
+			}
+			json.append("]}");
+		}
+		json.append("}}");
+	}
+
+	/**
+	 * Set all counters to zero.
+	 */
+	void MessageStats::reset()
+	{
+		for (int i = 0; i < mNumActions; ++i)
+		{
+			Action& a = mActions[i];
+			a.mCount = 0;
+			a.mTime = 0;
+			a.mMaxTime = 0;
+			memset(a.mHistogram, 0, sizeof(a.mHistogram));
+		}
+
+		mResetTime = maGetMilliSecondCount();
+		mStreamCount = 0;
+		mMessageCount = 0;
+		mMaxMessageCount = 0;
+		mUnknownCount = 0;
+		mBytesIn = 0;
+		mStreamTime = 0;
+		mEvaluationCount = 0;
+		mBytesOut = 0;
+		memset(mTimes, 0, sizeof(mTimes));
+
+		for (int i = 0; i < mNumSources; ++i)
+		{
+			mSources[i].mSource->resetStats();
+		}
+	}
+
+	/**
+	 * Append a name in double quotes, followed by a colon.
+	 * The names are identifiers, and need no escapes.
+	 */
+	void MessageStats::appendKey(ScriptBuilder& json, const char* name)
+	{
+		json.append("\"").append(name).append("\":");
+	}
+
+} // namespace
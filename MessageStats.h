@@ -0,0 +1,394 @@
+/*
+Copyright (C) 2012 MoSync AB
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License,
+version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+*/
+
+/*! \addtogroup WormHoleGroup
+ *  @{
+ */
+
+/** @defgroup WormHoleGroup Wormhole Library
+ *  @{
+ */
+
+/**
+ * @file MessageStats.h
+ *
+ * Counters and latency histograms for the message layer.
+ */
+
+#ifndef MESSAGE_STATS_H_
+#define MESSAGE_STATS_H_
+
+#include <ma.h>
+#include "ScriptBuilder.h"
+
+/**
+ * Maximum number of actions and modules that are counted.
+ */
+#define MESSAGE_STATS_MAX_ACTIONS 64
+
+/**
+ * Number of buckets in a latency histogram. Bucket 0 counts
+ * times below 1 ms, bucket n times from 2^(n-1) up to 2^n ms,
+ * and the last bucket all longer times.
+ */
+#define MESSAGE_STATS_HISTOGRAM_SIZE 10
+
+/**
+ * Maximum number of components whose counters are written
+ * with the statistics.
+ */
+#define MESSAGE_STATS_MAX_SOURCES 8
+
+namespace Wormhole
+{
+
+/**
+ * A component that keeps counters of its own, such as a cache,
+ * which are written with the statistics, see
+ * MessageStats::addSource.
+ */
+class MessageStatsSource
+{
+public:
+	/**
+	 * Destructor.
+	 */
+	virtual ~MessageStatsSource() {}
+
+	/**
+	 * Write the counters as a JSON object, like
+	 * {"hits":12,"misses":3}. MessageStats::appendKey writes
+	 * the names.
+	 *
+	 * @param json The builder to append the object to.
+	 */
+	virtual void writeStats(ScriptBuilder& json) = 0;
+
+	/**
+	 * Set the counters to zero, called when the statistics
+	 * are reset.
+	 */
+	virtual void resetStats() = 0;
+};
+
+/**
+ * Kinds of work whose time is summed over all actions.
+ */
+enum MessageStatsTime
+{
+	/**
+	 * Time spent in maWidget* syscalls.
+	 */
+	MESSAGE_TIME_NATIVE = 0,
+
+	/**
+	 * Time spent building replies to JavaScript.
+	 */
+	MESSAGE_TIME_FORMAT = 1,
+
+	/**
+	 * Time spent in callJS.
+	 */
+	MESSAGE_TIME_EVALUATE = 2,
+
+	/**
+	 * Number of kinds.
+	 */
+	MESSAGE_TIME_COUNT = 3
+};
+
+/**
+ * Collects statistics about the messages from JavaScript and the
+ * scripts sent back: the number of calls of each module and action
+ * with their latencies, the number of messages per stream, the
+ * bytes in and out, and the time spent in the widget API, building
+ * replies and evaluating them.
+ *
+ * Times are measured with maGetMilliSecondCount. A single call is
+ * often shorter than a millisecond, but since the clock ticks at a
+ * random point of each call, the sums over many calls are still
+ * accurate on average.
+ *
+ * MessageDispatcher and ScriptBatch report to a MessageStats object
+ * set with their setStats methods. The statistics are written as a
+ * JSON object by writeJSON, see there for the format.
+ */
+class MessageStats
+{
+public:
+	/**
+	 * Constructor.
+	 */
+	MessageStats();
+
+	/**
+	 * Destructor.
+	 */
+	virtual ~MessageStats();
+
+	/**
+	 * Register an action or module.
+	 *
+	 * @param name Name of the action. The string is not copied
+	 * and must stay valid, normally it is a string literal.
+	 * @return Index of the action, the same for all calls with
+	 * the same name, or -1 if the table is full.
+	 */
+	int addAction(const char* name);
+
+	/**
+	 * Count a call of an action.
+	 *
+	 * @param action Index of the action, from addAction. Negative
+	 * indexes are ignored.
+	 * @param milliseconds Time the call took.
+	 */
+	void addActionTime(int action, int milliseconds);
+
+	/**
+	 * Count a message stream from JavaScript.
+	 *
+	 * @param numBytes Size of the stream.
+	 * @param numMessages Number of messages in the stream.
+	 * @param milliseconds Time it took to handle the stream.
+	 */
+	void addStream(int numBytes, int numMessages, int milliseconds);
+
+	/**
+	 * Count a message that no handler was registered for.
+	 */
+	void addUnknownMessage();
+
+	/**
+	 * Count a call to callJS.
+	 *
+	 * @param numBytes Length of the script.
+	 * @param milliseconds Time the call took.
+	 */
+	void addEvaluation(int numBytes, int milliseconds);
+
+	/**
+	 * Add to the time spent on a kind of work.
+	 *
+	 * @param time The kind of work.
+	 * @param milliseconds The time to add.
+	 */
+	void addTime(MessageStatsTime time, int milliseconds);
+
+	/**
+	 * Add a component whose counters are written with the
+	 * statistics, and reset with them.
+	 *
+	 * @param name Name of the counters in the JSON object. The
+	 * string is not copied, normally it is a string literal.
+	 * @param source The component.
+	 * @return false if the table is full.
+	 */
+	bool addSource(const char* name, MessageStatsSource* source);
+
+	/**
+	 * Write the statistics as a JSON object:
+	 *
+	 *   {"elapsed":12034,
+	 *    "streams":{"count":4,"messages":130,"maxMessages":90,
+	 *      "unknown":0,"bytes":8402,"time":61},
+	 *    "scripts":{"count":6,"bytes":2950,"time":20},
+	 *    "time":{"native":31,"format":3,"evaluate":20},
+	 *    "propertyCache":{"hits":210,"misses":12,"skippedSets":48},
+	 *    "downloads":{"queue":0,"maxQueue":12,...},
+	 *    "scratchData":{"bytes":262144,"highWaterMark":524288,...},
+	 *    "actions":{"maWidgetCreate":{"count":40,"time":25,"max":3,
+	 *      "histogram":[31,7,2,0,0,0,0,0,0,0]},...}}
+	 *
+	 * elapsed is the time since the statistics were reset. unknown
+	 * counts the messages and actions that no handler was
+	 * registered for, by any dispatcher. The counters of each
+	 * source come after time, under the name it was added with.
+	 * Only actions that have been called are included. The time
+	 * of a module includes the time of its actions.
+	 *
+	 * @param json The builder to append the object to.
+	 */
+	void writeJSON(ScriptBuilder& json);
+
+	/**
+	 * Set all counters to zero. Registered actions are kept.
+	 */
+	void reset();
+
+	/**
+	 * Append a name in double quotes, followed by a colon.
+	 */
+	static void appendKey(ScriptBuilder& json, const char* name);
+
+private:
+	/**
+	 * Not copyable.
+	 */
+	MessageStats(const MessageStats&);
+	MessageStats& operator=(const MessageStats&);
+
+private:
+	/**
+	 * Counters of an action.
+	 */
+	struct Action
+	{
+		const char* mName;
+		int mCount;
+		int mTime;
+		int mMaxTime;
+		int mHistogram[MESSAGE_STATS_HISTOGRAM_SIZE];
+	};
+
+	/**
+	 * The registered actions.
+	 */
+	Action mActions[MESSAGE_STATS_MAX_ACTIONS];
+
+	/**
+	 * Number of registered actions.
+	 */
+	int mNumActions;
+
+	/**
+	 * A component with counters of its own.
+	 */
+	struct Source
+	{
+		const char* mName;
+		MessageStatsSource* mSource;
+	};
+
+	/**
+	 * The added sources.
+	 */
+	Source mSources[MESSAGE_STATS_MAX_SOURCES];
+
+	/**
+	 * Number of added sources.
+	 */
+	int mNumSources;
+
+	/**
+	 * Time of the last reset.
+	 */
+	int mResetTime;
+
+	/**
+	 * Number of message streams.
+	 */
+	int mStreamCount;
+
+	/**
+	 * Number of messages in all streams.
+	 */
+	int mMessageCount;
+
+	/**
+	 * Largest number of messages in a stream.
+	 */
+	int mMaxMessageCount;
+
+	/**
+	 * Number of messages without a handler.
+	 */
+	int mUnknownCount;
+
+	/**
+	 * Number of bytes in all streams.
+	 */
+	int mBytesIn;
+
+	/**
+	 * Time spent handling streams.
+	 */
+	int mStreamTime;
+
+	/**
+	 * Number of calls to callJS.
+	 */
+	int mEvaluationCount;
+
+	/**
+	 * Number of bytes of JavaScript evaluated.
+	 */
+	int mBytesOut;
+
+	/**
+	 * Time spent on each kind of work.
+	 */
+	int mTimes[MESSAGE_TIME_COUNT];
+};
+
+/**
+ * Adds the time from its construction to its destruction to
+ * one of the kinds of work of a MessageStats object. Does not
+ * read the clock if there is no MessageStats object.
+ *
+ * Usage:
+ *
+ *   {
+ *       MessageStatsTimer timer(mStats, MESSAGE_TIME_NATIVE);
+ *       res = maWidgetSetProperty(widget, property, value);
+ *   }
+ */
+class MessageStatsTimer
+{
+public:
+	/**
+	 * Constructor. Starts the timer.
+	 * @param stats The statistics to add the time to, can be NULL.
+	 * @param time The kind of work that is timed.
+	 */
+	MessageStatsTimer(MessageStats* stats, MessageStatsTime time) :
+		mStats(stats),
+		mTime(time),
+		mStart(NULL != stats ? maGetMilliSecondCount() : 0)
+	{
+	}
+
+	/**
+	 * Destructor. Adds the time.
+	 */
+	~MessageStatsTimer()
+	{
+		if (NULL != mStats)
+		{
+			mStats->addTime(mTime, maGetMilliSecondCount() - mStart);
+		}
+	}
+
+private:
+	/**
+	 * Not copyable.
+	 */
+	MessageStatsTimer(const MessageStatsTimer&);
+	MessageStatsTimer& operator=(const MessageStatsTimer&);
+
+private:
+	MessageStats* mStats;
+	MessageStatsTime mTime;
+	int mStart;
+};
+
+} // namespace
+
+#endif
+
+/*! @} */
@@ -34,6 +34,100 @@ MA 02110-1301, USA.
 
 namespace Wormhole
 {
+	/**
+	 * Constructor. Creates an empty view.
+	 */
+	MessageView::MessageView() :
+		mData(NULL),
+		mLength(0)
+	{
+	}
+
+	/**
+	 * Constructor.
+	 */
+	MessageView::MessageView(const char* data, int length) :
+		mData(data),
+		mLength(length)
+	{
+	}
+
+	/**
+	 * @return true if the view does not refer to any string.
+	 */
+	bool MessageView::isNull() const
+	{
+		return NULL == mData;
+	}
+
+	/**
+	 * @return Pointer to the first character of the string.
+	 */
+	const char* MessageView::getData() const
+	{
+		return mData;
+	}
+
+	/**
+	 * @return Length of the string.
+	 */
+	int MessageView::getLength() const
+	{
+		return mLength;
+	}
+
+	/**
+	 * Compare the view to a zero terminated string.
+	 */
+	bool MessageView::equals(const char* s) const
+	{
+		if (NULL == mData || NULL == s)
+		{
+			return false;
+		}
+
+		int i;
+		for (i = 0; i < mLength; ++i)
+		{
+			// A zero in s before mLength means s is shorter.
+			if (s[i] != mData[i])
+			{
+				return false;
+			}
+		}
+
+		// s must end where the view ends.
+		return 0 == s[i];
+	}
+
+	/**
+	 * Parse the string as a decimal integer.
+	 */
+	int MessageView::toInt() const
+	{
+		int i = 0;
+		bool negative = false;
+
+		if (i < mLength && ('-' == mData[i] || '+' == mData[i]))
+		{
+			negative = '-' == mData[i];
+			++i;
+		}
+
+		int n = 0;
+		for (; i < mLength; ++i)
+		{
+			char c = mData[i];
+			if (c < '0' || c > '9')
+			{
+				break;
+			}
+			n = n * 10 + (c - '0');
+		}
+
+		return negative ? -n : n;
+	}
+
 	/**
 	 * Constructor.
 	 */
@@ -45,16 +139,37 @@ namespace Wormhole
 		initialize(dataHandle);
 	}
 
+	/**
+	 * Constructor. Parses data that is already in memory.
+	 */
+	MessageStream::MessageStream(
+		NativeUI::WebView* webView,
+		char* data,
+		int dataSize)
+	{
+		mWebView = webView;
+		initialize(data, dataSize);
+	}
+
+	/**
+	 * Constructor for subclasses.
+	 */
+	MessageStream::MessageStream(NativeUI::WebView* webView)
+	{
+		mWebView = webView;
+		initialize(NULL, 0);
+	}
+
 	/**
 	 * Destructor.
 	 */
 	MessageStream::~MessageStream()
 	{
-		if (NULL != mData)
+		if (mOwnsData && NULL != mData)
 		{
 			free(mData);
-			mData = NULL;
 		}
+		mData = NULL;
 	}
 
 	/**
@@ -65,6 +180,48 @@ namespace Wormhole
 		return NULL != mData;
 	}
 
+	/**
+	 * @return The status of the last read.
+	 */
+	int MessageStream::getStatus()
+	{
+		return mStatus;
+	}
+
+	/**
+	 * @return false, this is a text stream.
+	 */
+	bool MessageStream::isBinary()
+	{
+		return false;
+	}
+
+	/**
+	 * @return true if there is another string in the stream.
+	 */
+	bool MessageStream::hasNext()
+	{
+		// Only check that there are bytes left, the next
+		// string is decoded once, by the read that follows.
+		// A malformed string makes that read fail and sets
+		// the status, which ends the stream.
+		if (NULL == mData || mStatus < 0)
+		{
+			return false;
+		}
+
+		int next = (NULL == mEnd) ? 3 : (mEnd + 1) - mData;
+		return next < mDataSize;
+	}
+
+	/**
+	 * Move to the start of the next message.
+	 */
+	bool MessageStream::nextMessage()
+	{
+		return hasNext();
+	}
+
 	/**
 	 * Get the WebView widget associated with this message.
 	 * @return Pointer to WebView object.
@@ -84,120 +241,190 @@ namespace Wormhole
 	 */
 	const char* MessageStream::getNext(int* length)
 	{
-		char* p;
+		if (!advance())
+		{
+			return NULL;
+		}
 
-		// If first call then start at beginning of data,
-		// else move forward one character.
-		if (NULL == mEnd)
+		// Set length parameter.
+		if (NULL != length)
 		{
-			// Move past the protocol specifier.
-			p = mData + 3;
+			*length = mEnd - mStart;
 		}
-		else
+
+		// Zero terminate string. This overwrites the space
+		// that separates strings in the stream.
+		*mEnd = 0;
+
+		// Return string start.
+		return mStart;
+	}
+
+	/**
+	 * Get a view of the next string in the message stream.
+	 * @return View of the string, a null view if there are
+	 * no more strings in the message.
+	 */
+	MessageView MessageStream::getNextView()
+	{
+		if (!advance())
 		{
-			p = mEnd + 1;
+			return MessageView();
 		}
 
-//		lprintfln("value of p: %i", (int)p);
+		return MessageView(mStart, mEnd - mStart);
+	}
 
-		// Check boundary.
-		if (p - mData >= mDataSize)
+	/**
+	 * Get the next value in the stream as an integer.
+	 */
+	int MessageStream::getNextInt()
+	{
+		return getNextView().toInt();
+	}
+
+	/**
+	 * Move to the next string in the stream.
+	 */
+	bool MessageStream::advance()
+	{
+		char* p;
+
+		if (NULL == mData)
 		{
-//			lprintfln("1: p - mData >= mDataSize");
-			return NULL;
+			mStatus = MESSAGE_STREAM_END;
+			return false;
 		}
 
-		// Get string length and updated pointer.
-		int len = xtoi(p, &p);
+		// Do not move on after an error.
+		if (mStatus < 0)
+		{
+			return false;
+		}
 
-		if (len == 0)
+		// If first call then start at beginning of data,
+		// else move forward one character.
+		if (NULL == mEnd)
 		{
-//			lprintfln("len == 0");
-			return NULL;
+			// Move past the protocol specifier.
+			p = mData + 3;
+		}
+		else
+		{
+			p = mEnd + 1;
 		}
 
 		// Check boundary.
 		if (p - mData >= mDataSize)
 		{
-//			lprintfln("2: p - mData >= mDataSize");
-			return NULL;
+			mStatus = MESSAGE_STREAM_END;
+			return false;
 		}
 
-		// Set length parameter.
-		if (NULL != length)
+		// Get string length and the position of the space
+		// that follows it.
+		int len;
+		const char* lengthEnd;
+		mStatus = decodeLength(p, mData + mDataSize, &len, &lengthEnd);
+		if (MESSAGE_STREAM_OK != mStatus)
 		{
-			*length = len;
+			return false;
 		}
 
-//		lprintfln("String length: %i", len);
-
-		// Point p to start of string data.
-		mStart = p + 1;
+		p = (char*) lengthEnd;
 
-		// Point to end of string.
-		mEnd = mStart + len;
+		// Point to start and end of string. The character
+		// before the start is the space after the length.
+		char* start = p + 1;
+		char* end = start + len;
 
-		// Check boundary.
-		if (mEnd - mData >= mDataSize)
+		// Check boundary, the space after the string must
+		// be inside the data.
+		if (end - mData >= mDataSize)
 		{
-//			lprintfln("3: mEnd - mData >= mDataSize");
-			return NULL;
+			mStatus = MESSAGE_STREAM_ERROR_TRUNCATED;
+			return false;
 		}
 
-		// Zero terminate string.
-		*mEnd = 0;
-
-//		lprintfln("@@@ mStart: %s", mStart);
+		mStart = start;
+		mEnd = end;
 
-		// Return string start.
-		return mStart;
+		return true;
 	}
 
 	/**
-	 * TODO: Add error handling.
+	 * Decode the length of a string, checking every digit.
 	 */
-	int MessageStream::xtoi(char* s, char** newPos)
+	int MessageStream::decodeLengthChecked(
+		const char* s,
+		const char* end,
+		int* length,
+		const char** newPos)
 	{
-		int firstChar = 33;
-		int lastChar = 126;
-		int base = lastChar - firstChar;
-
+		// Digits are the characters 33..126, written by
+		// mosync.encoder.itox with base 126 - 33.
+		static const int firstChar = 33;
+		static const int lastChar = 126;
+		static const int base = lastChar - firstChar;
+
+		// The last digit is handled separately below, the
+		// first ones cannot overflow an int.
+		const int fastDigits = MESSAGE_STREAM_MAX_LENGTH_DIGITS - 1;
+		const char* limit = end - s > fastDigits ? s + fastDigits : end;
+		const char* p = s;
 		int n = 0;
-		int i;
-		for (i = 0; s[i] != ' '; ++i)
+		int scale = 1;
+
+		while (p < limit && ' ' != *p)
 		{
-			// Sanity check.
-			if (i > 4)
+			unsigned int digit = (unsigned char) *p - firstChar;
+			if (digit > (unsigned int) (lastChar - firstChar))
 			{
-				return 0;
+				return MESSAGE_STREAM_ERROR_INVALID_DIGIT;
 			}
-
-			n += raise(base, i) * (s[i] - firstChar);
+			n += scale * digit;
+			scale *= base;
+			++p;
 		}
 
-		*newPos = s + i;
+		if (p < end && ' ' != *p && p - s == fastDigits)
+		{
+			unsigned int digit = (unsigned char) *p - firstChar;
+			if (digit > (unsigned int) (lastChar - firstChar))
+			{
+				return MESSAGE_STREAM_ERROR_INVALID_DIGIT;
+			}
 
-		return n;
-	}
+			// The length can never exceed the remaining data,
+			// a larger value would also overflow an int.
+			if ((int) digit > ((end - s) - n) / scale)
+			{
+				return MESSAGE_STREAM_ERROR_TRUNCATED;
+			}
+			n += scale * digit;
+			++p;
 
-	/**
-	 * TODO: Add error handling.
-	 */
-	int MessageStream::raise(int base, int e)
-	{
-		int pow = 1;
+			if (p < end && ' ' != *p)
+			{
+				return MESSAGE_STREAM_ERROR_LENGTH_TOO_LONG;
+			}
+		}
 
-		// Sanity check.
-		if (e > 4)
+		if (p >= end)
 		{
-			return 0;
+			return MESSAGE_STREAM_ERROR_TRUNCATED;
 		}
 
-		while (e--)
+		// There must be at least one digit.
+		if (p == s)
 		{
-			pow *= base;
+			return MESSAGE_STREAM_ERROR_INVALID_DIGIT;
 		}
-		return pow;
+
+		*length = n;
+		*newPos = p;
+
+		return MESSAGE_STREAM_OK;
 	}
 
 	/**
@@ -206,9 +433,11 @@ namespace Wormhole
 	void MessageStream::initialize(MAHandle dataHandle)
 	{
 		mData = NULL;
+		mOwnsData = false;
+		mStatus = MESSAGE_STREAM_OK;
 
 		// We must have data.
-		if (NULL == dataHandle)
+		if (0 == dataHandle)
 		{
 			return;
 		}
@@ -224,6 +453,35 @@ namespace Wormhole
 
 		data[dataSize] = 0;
 
+		initialize(data, dataSize);
+
+		if (NULL == mData)
+		{
+			free(data);
+			return;
+		}
+
+		mOwnsData = true;
+	}
+
+	/**
+	 * Initialise the stream with data in memory.
+	 */
+	void MessageStream::initialize(char* data, int dataSize)
+	{
+		mData = NULL;
+		mOwnsData = false;
+		mDataSize = 0;
+		mStart = NULL;
+		mEnd = NULL;
+		mStatus = MESSAGE_STREAM_OK;
+
+		// We must have data.
+		if (NULL == data || dataSize < 3)
+		{
+			return;
+		}
+
 		// Check that we have the "ms:" prefix.
 		if (data[0] != 'm') { return; }
 		if (data[1] != 's') { return; }
@@ -231,8 +489,6 @@ namespace Wormhole
 
 		mData = data;
 		mDataSize = dataSize;
-		mStart = NULL;
-		mEnd = NULL;
 	}
 
 } // namespace
@@ -40,6 +40,100 @@ MA 02110-1301, USA.
 namespace Wormhole
 {
 
+/**
+ * Status of a message stream after the last read.
+ * Errors are negative.
+ */
+enum MessageStreamStatus
+{
+	/**
+	 * The last read succeeded.
+	 */
+	MESSAGE_STREAM_OK = 0,
+
+	/**
+	 * There are no more values in the stream.
+	 */
+	MESSAGE_STREAM_END = 1,
+
+	/**
+	 * A length contains a character outside of the
+	 * digit range 33..126, or has no digits.
+	 */
+	MESSAGE_STREAM_ERROR_INVALID_DIGIT = -1,
+
+	/**
+	 * A length has more digits than allowed.
+	 */
+	MESSAGE_STREAM_ERROR_LENGTH_TOO_LONG = -2,
+
+	/**
+	 * A length or string extends past the end of the data.
+	 */
+	MESSAGE_STREAM_ERROR_TRUNCATED = -3
+};
+
+/**
+ * Maximum number of digits in the length of a string in
+ * a text message stream.
+ */
+#define MESSAGE_STREAM_MAX_LENGTH_DIGITS 5
+
+/**
+ * A view of a string in a message stream. The view points
+ * into the message data and carries the length of the string,
+ * the data is not copied and not zero terminated.
+ */
+class MessageView
+{
+public:
+	/**
+	 * Constructor. Creates an empty view.
+	 */
+	MessageView();
+
+	/**
+	 * Constructor.
+	 * @param data Pointer to the first character of the string.
+	 * @param length Length of the string.
+	 */
+	MessageView(const char* data, int length);
+
+	/**
+	 * @return true if the view does not refer to any string.
+	 */
+	bool isNull() const;
+
+	/**
+	 * @return Pointer to the first character of the string.
+	 * Note that the string is not zero terminated.
+	 */
+	const char* getData() const;
+
+	/**
+	 * @return Length of the string.
+	 */
+	int getLength() const;
+
+	/**
+	 * Compare the view to a zero terminated string.
+	 * @return true if the strings are equal.
+	 */
+	bool equals(const char* s) const;
+
+	/**
+	 * Parse the string as a decimal integer, the same way
+	 * as stringToInteger. Parsing stops at the first
+	 * character that is not a digit.
+	 * @return The integer value, 0 if the view is empty.
+	 */
+	int toInt() const;
+
+private:
+	const char* mData;
+	int mLength;
+};
+
 /**
  * Class that parses messages in the form of a message stream sent from a
  * WebView in a MAW_EVENT_WEB_VIEW_HOOK_INVOKED event.
@@ -48,16 +142,35 @@ namespace Wormhole
  *
  *   ms:<4-byte opcode><optional string params>
  *
+ * The stream can either read the data object itself, or parse
+ * data that has already been read into memory, such as the
+ * contents of a MessageBuffer. In the latter case the stream
+ * does not copy or allocate anything.
+ *
  * TODO: Add copy constructor and assignment operator.
  */
 class MessageStream
 {
 public:
 	/**
-	 * Constructor.
+	 * Constructor. Reads the data object into memory
+	 * owned by the stream.
 	 */
 	MessageStream(NativeUI::WebView* webView, MAHandle dataHandle);
 
+	/**
+	 * Constructor. Parses data that is already in memory.
+	 * The data is not copied, it must stay valid for the
+	 * lifetime of the stream, and must be writable since
+	 * getNext zero terminates strings in place.
+	 *
+	 * @param webView The WebView that sent the message.
+	 * @param data Message data, including the "ms:" prefix.
+	 * @param dataSize Size of the data, not including
+	 * any terminating zero.
+	 */
+	MessageStream(NativeUI::WebView* webView, char* data, int dataSize);
+
 	/**
 	 * Destructor.
 	 */
@@ -68,6 +181,78 @@ public:
 	 */
 	bool isValid();
 
+	/**
+	 * Get the status of the last read. When getNext returns
+	 * NULL, this tells whether the end of the stream was
+	 * reached or the stream is malformed.
+	 *
+	 * @return MESSAGE_STREAM_OK, MESSAGE_STREAM_END or one of
+	 * the MESSAGE_STREAM_ERROR codes.
+	 */
+	int getStatus();
+
+	/**
+	 * Decode the length of a string in a text message stream.
+	 *
+	 * The length is written with base 93 digits, least
+	 * significant first, each digit being a character in the
+	 * range 33..126, and is terminated by a space. This is the
+	 * format written by mosync.encoder.itox.
+	 *
+	 * Lengths of up to four digits that end before the end of
+	 * the data, which are nearly all lengths, are decoded by an
+	 * inline loop. Other lengths and errors are handled by
+	 * decodeLengthChecked.
+	 *
+	 * @param s Start of the length.
+	 * @param end End of the data, the length and the space
+	 * must come before this position.
+	 * @param length The decoded length is returned here.
+	 * @param newPos Position of the terminating space is
+	 * returned here.
+	 * @return MESSAGE_STREAM_OK on success, else one of the
+	 * MESSAGE_STREAM_ERROR codes.
+	 */
+	static int decodeLength(
+		const char* s,
+		const char* end,
+		int* length,
+		const char** newPos);
+
+	/**
+	 * Decode a length like decodeLength, checking every digit
+	 * against the end of the data and the length against
+	 * overflow.
+	 */
+	static int decodeLengthChecked(
+		const char* s,
+		const char* end,
+		int* length,
+		const char** newPos);
+
+	/**
+	 * @return true if integers and message names are sent
+	 * as fixed-width binary values, see MessageStreamBinary.
+	 * A text stream returns false.
+	 */
+	virtual bool isBinary();
+
+	/**
+	 * @return true if there are more bytes to read in the
+	 * stream. The next string is not decoded, so a read can
+	 * still fail if the stream is malformed.
+	 */
+	virtual bool hasNext();
+
+	/**
+	 * Move to the start of the next message. Only binary
+	 * streams mark where messages end, a text stream does
+	 * nothing and returns hasNext().
+	 *
+	 * @return true if there is a message to read.
+	 */
+	virtual bool nextMessage();
+
 	/**
 	 * Get the WebView widget associated with this message.
 	 * @return Pointer to WebView object.
@@ -78,6 +263,9 @@ public:
 	 * Get a pointer to the next string in the message stream,
 	 * and optionally get the length of the string.
 	 *
+	 * The string is zero terminated in place, by overwriting
+	 * the space that separates it from the next string.
+	 *
 	 * @param length Length of the string is returned in this
 	 * parameter. Can be set to NULL (default value) in which
 	 * case it is not used.
@@ -85,23 +273,50 @@ public:
 	 * @return Pointer to the string, NULL if there are no more
 	 * strings in the message.
 	 */
-	const char* getNext(int* length = NULL);
+	virtual const char* getNext(int* length = NULL);
+
+	/**
+	 * Get a view of the next string in the message stream.
+	 * The message data is not modified.
+	 *
+	 * @return View of the string, a null view if there are
+	 * no more strings in the message.
+	 */
+	virtual MessageView getNextView();
+
+	/**
+	 * Get the next value in the stream as an integer.
+	 * In a text stream the value is sent as a decimal string.
+	 *
+	 * @return The integer value, 0 if there are no more
+	 * values in the stream.
+	 */
+	virtual int getNextInt();
 
 protected:
+	/**
+	 * Constructor for subclasses that initialise the
+	 * data themselves.
+	 */
+	MessageStream(NativeUI::WebView* webView);
+
 	/**
 	 * Read data and initialise the stream.
 	 */
-	void MessageStream::initialize(MAHandle dataHandle);
+	void initialize(MAHandle dataHandle);
 
 	/**
-	 * TODO: Add error handling.
+	 * Initialise the stream with data in memory.
 	 */
-	int xtoi(char* s, char** newPos);
+	void initialize(char* data, int dataSize);
 
 	/**
-	 * TODO: Add error handling.
+	 * Move to the next string in the stream, setting
+	 * mStart and mEnd.
+	 * @return true if there is a next string,
+	 * false if there are no more strings.
 	 */
-	int raise(int base, int e);
+	bool advance();
 
 protected:
 	/**
@@ -109,6 +324,16 @@ protected:
 	 */
 	NativeUI::WebView* mWebView;
 
+	/**
+	 * true if mData was allocated by the stream.
+	 */
+	bool mOwnsData;
+
+	/**
+	 * Status of the last read.
+	 */
+	int mStatus;
+
 public:
 	char* mData;
 	int mDataSize;
@@ -116,6 +341,50 @@ public:
 	char* mEnd;
 };
 
+inline int MessageStream::decodeLength(
+	const char* s,
+	const char* end,
+	int* length,
+	const char** newPos)
+{
+	// With more bytes left than the longest length, the first
+	// four digits and the character after them can be read
+	// without checking the end of the data. Any character
+	// outside 33..126, the space included, is not a digit.
+	if (end - s > MESSAGE_STREAM_MAX_LENGTH_DIGITS)
+	{
+		// Most strings are shorter than 93 characters, so
+		// their length is a single digit.
+		unsigned int digit = (unsigned char) s[0] - 33u;
+		if (digit <= 126u - 33u && ' ' == s[1])
+		{
+			*length = (int) digit;
+			*newPos = s + 1;
+			return MESSAGE_STREAM_OK;
+		}
+
+		const char* p = s;
+		int n = 0;
+		int scale = 1;
+		while (digit <= 126u - 33u
+			&& p - s < MESSAGE_STREAM_MAX_LENGTH_DIGITS - 1)
+		{
+			n += (int) digit * scale;
+			scale *= 126 - 33;
+			digit = (unsigned char) *++p - 33u;
+		}
+
+		if (' ' == *p && p != s)
+		{
+			*length = n;
+			*newPos = p;
+			return MESSAGE_STREAM_OK;
+		}
+	}
+
+	return decodeLengthChecked(s, end, length, newPos);
+}
+
 } // namespace
 
 #endif
@@ -0,0 +1,302 @@
+/*
+Copyright (C) 2012 MoSync AB
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License,
+version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+*/
+
+/**
+ * @file MessageStreamBinary.cpp
+ *
+ * Class for parsing a binary stream of messages from a WebView.
+ */
+
+#include <ma.h>				// MoSync API
+#include <conprint.h>
+
+#include "MessageStreamBinary.h"
+
+// Value of the character that encodes the six bit value 0.
+#define BINARY_DIGIT_BASE '0'
+
+// Number of bits in an integer on the wire.
+#define BINARY_INT_BITS (6 * MESSAGE_BINARY_INT_SIZE)
+
+namespace Wormhole
+{
+	/**
+	 * Constructor.
+	 */
+	MessageStreamBinary::MessageStreamBinary(
+		NativeUI::WebView* webView,
+		char* data,
+		int dataSize) :
+		MessageStream(webView),
+		mPosition(NULL),
+		mMessageEnd(NULL)
+	{
+		// We must have data.
+		if (NULL == data || dataSize < 3)
+		{
+			return;
+		}
+
+		// Check that we have the "mb:" prefix.
+		if (data[0] != 'm') { return; }
+		if (data[1] != 'b') { return; }
+		if (data[2] != ':') { return; }
+
+		mData = data;
+		mDataSize = dataSize;
+		mPosition = data + 3;
+	}
+
+	/**
+	 * Destructor.
+	 */
+	MessageStreamBinary::~MessageStreamBinary()
+	{
+	}
+
+	/**
+	 * @return true, this is a binary stream.
+	 */
+	bool MessageStreamBinary::isBinary()
+	{
+		return true;
+	}
+
+	/**
+	 * @return true if there are more messages in the stream.
+	 */
+	bool MessageStreamBinary::hasNext()
+	{
+		if (NULL == mData)
+		{
+			return false;
+		}
+
+		// The next message starts at the end of the current
+		// one, even if the current one failed.
+		if (NULL != mMessageEnd)
+		{
+			return (mMessageEnd - mData) + MESSAGE_BINARY_INT_SIZE
+				<= mDataSize;
+		}
+
+		return mStatus >= 0
+			&& (mPosition - mData) + MESSAGE_BINARY_INT_SIZE <= mDataSize;
+	}
+
+	/**
+	 * Move to the start of the next message.
+	 */
+	bool MessageStreamBinary::nextMessage()
+	{
+		if (NULL == mData)
+		{
+			return false;
+		}
+
+		if (NULL != mMessageEnd)
+		{
+			mPosition = mMessageEnd;
+			mMessageEnd = NULL;
+			mStatus = MESSAGE_STREAM_OK;
+		}
+
+		int length;
+		if (!readInt(&length))
+		{
+			return false;
+		}
+
+		// Without a valid length the following messages
+		// cannot be found.
+		if (length < 0 || length > mDataSize - (mPosition - mData))
+		{
+			fail(MESSAGE_STREAM_ERROR_TRUNCATED);
+			return false;
+		}
+
+		mMessageEnd = mPosition + length;
+		return true;
+	}
+
+	/**
+	 * Get a pointer to the next string in the stream.
+	 */
+	const char* MessageStreamBinary::getNext(int* length)
+	{
+		if (!advanceString())
+		{
+			return NULL;
+		}
+
+		if (NULL != length)
+		{
+			*length = mEnd - mStart;
+		}
+
+		// Zero terminate the string, overwriting the separator.
+		*mEnd = 0;
+
+		return mStart;
+	}
+
+	/**
+	 * Get a view of the next string in the stream.
+	 */
+	MessageView MessageStreamBinary::getNextView()
+	{
+		if (!advanceString())
+		{
+			return MessageView();
+		}
+
+		return MessageView(mStart, mEnd - mStart);
+	}
+
+	/**
+	 * Get the next integer in the stream.
+	 */
+	int MessageStreamBinary::getNextInt()
+	{
+		int value;
+
+		if (!readInt(&value))
+		{
+			return 0;
+		}
+
+		mStatus = MESSAGE_STREAM_OK;
+
+		return value;
+	}
+
+	/**
+	 * Read a string at the current position.
+	 */
+	bool MessageStreamBinary::advanceString()
+	{
+		int length;
+
+		if (!readInt(&length))
+		{
+			return false;
+		}
+
+		char* start = mPosition;
+		char* end = start + length;
+
+		// The separator after the string must be inside
+		// the message.
+		if (length < 0 || end >= getLimit())
+		{
+			fail(MESSAGE_STREAM_ERROR_TRUNCATED);
+			return false;
+		}
+
+		mStart = start;
+		mEnd = end;
+
+		// Move past the separator.
+		mPosition = end + 1;
+		mStatus = MESSAGE_STREAM_OK;
+
+		return true;
+	}
+
+	/**
+	 * Read an integer at the current position.
+	 */
+	bool MessageStreamBinary::readInt(int* value)
+	{
+		if (NULL == mData || mStatus < 0)
+		{
+			return false;
+		}
+
+		int remaining = getLimit() - mPosition;
+		if (0 == remaining)
+		{
+			mStatus = MESSAGE_STREAM_END;
+			return false;
+		}
+
+		if (remaining < MESSAGE_BINARY_INT_SIZE)
+		{
+			fail(MESSAGE_STREAM_ERROR_TRUNCATED);
+			return false;
+		}
+
+		if (!decodeInt(mPosition, value))
+		{
+			fail(MESSAGE_STREAM_ERROR_INVALID_DIGIT);
+			return false;
+		}
+
+		mPosition += MESSAGE_BINARY_INT_SIZE;
+
+		return true;
+	}
+
+	/**
+	 * @return End of the current message, or of the data.
+	 */
+	char* MessageStreamBinary::getLimit()
+	{
+		return NULL != mMessageEnd ? mMessageEnd : mData + mDataSize;
+	}
+
+	/**
+	 * Stop reading the stream because of an error.
+	 */
+	void MessageStreamBinary::fail(int status)
+	{
+		// Move to the end, so that following reads fail as well.
+		mPosition = mData + mDataSize;
+		mStatus = status;
+	}
+
+	/**
+	 * Decode an integer at the given position.
+	 */
+	bool MessageStreamBinary::decodeInt(const char* p, int* value)
+	{
+		unsigned int n = 0;
+
+		// Least significant six bits first.
+		for (int i = MESSAGE_BINARY_INT_SIZE - 1; i >= 0; --i)
+		{
+			int digit = p[i] - BINARY_DIGIT_BASE;
+			if (digit < 0 || digit > 63)
+			{
+				return false;
+			}
+			n = (n << 6) | digit;
+		}
+
+		// Sign extend.
+		if (n & (1 << (BINARY_INT_BITS - 1)))
+		{
+			n |= ~((1u << BINARY_INT_BITS) - 1);
+		}
+
+		*value = (int) n;
+
+		return true;
+	}
+
+} // namespace
@@ -0,0 +1,205 @@
+/*
+Copyright (C) 2012 MoSync AB
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License,
+version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+*/
+
+/*! \addtogroup WormHoleGroup
+ *  @{
+ */
+
+/** @defgroup WormHoleGroup Wormhole Library
+ *  @{
+ */
+
+/**
+ * @file MessageStreamBinary.h
+ *
+ * Class for parsing a binary stream of messages from a WebView.
+ */
+
+#ifndef MESSAGE_STREAM_BINARY_H_
+#define MESSAGE_STREAM_BINARY_H_
+
+#include <ma.h>
+#include <NativeUI/WebView.h>
+#include "MessageStream.h"
+
+namespace Wormhole
+{
+
+/**
+ * Number of characters used for an integer in a binary stream.
+ */
+#define MESSAGE_BINARY_INT_SIZE 4
+
+/**
+ * Class that parses messages in the form of a binary message
+ * stream sent from a WebView in a MAW_EVENT_WEB_VIEW_HOOK_INVOKED
+ * event. The stream is written by mosync.bridge.sendBinary.
+ *
+ * Messages used with this class has the format:
+ *
+ *   mb:<message><message>...
+ *
+ * Each message is an integer holding the number of bytes in
+ * the rest of the message, followed by its values. The length
+ * lets nextMessage skip a message that is unknown, or that its
+ * handler did not read to the end, so that the following
+ * messages are still read correctly.
+ *
+ * There are two kinds of values, and the receiver must know
+ * which kind to read next:
+ *
+ *   Integers (module and action opcodes, widget handles, counts
+ *   and indexes) are 24 bit two's complement numbers, written as
+ *   four characters of six bits each, least significant first.
+ *   Each character is the six bit value plus '0' (48).
+ *
+ *   Strings are an integer holding the length of the string
+ *   in bytes, followed by the bytes of the string and a
+ *   separator byte.
+ *
+ * Integers are written in printable characters because the data
+ * from the WebView is passed as a string, and byte values
+ * outside of the ASCII range do not survive the transfer.
+ *
+ * The separator byte after a string is overwritten with a zero
+ * by getNext, so that strings can be passed to the syscalls
+ * without being copied.
+ */
+class MessageStreamBinary : public MessageStream
+{
+public:
+	/**
+	 * Constructor. Parses data that is already in memory.
+	 * The data is not copied, it must stay valid for the
+	 * lifetime of the stream.
+	 *
+	 * @param webView The WebView that sent the message.
+	 * @param data Message data, including the "mb:" prefix.
+	 * @param dataSize Size of the data, not including
+	 * any terminating zero.
+	 */
+	MessageStreamBinary(
+		NativeUI::WebView* webView,
+		char* data,
+		int dataSize);
+
+	/**
+	 * Destructor.
+	 */
+	virtual ~MessageStreamBinary();
+
+	/**
+	 * @return true, this is a binary stream.
+	 */
+	virtual bool isBinary();
+
+	/**
+	 * @return true if there are more messages in the stream.
+	 */
+	virtual bool hasNext();
+
+	/**
+	 * Move to the start of the next message, skipping any
+	 * part of the current message that has not been read.
+	 * An error inside a message only affects that message.
+	 *
+	 * @return true on success, false at the end of the stream
+	 * or if the length of the message is invalid.
+	 */
+	virtual bool nextMessage();
+
+	/**
+	 * Get a pointer to the next string in the stream.
+	 *
+	 * @param length Length of the string is returned in this
+	 * parameter. Can be set to NULL.
+	 *
+	 * @return Pointer to the zero terminated string, NULL if
+	 * there are no more strings in the message.
+	 */
+	virtual const char* getNext(int* length = NULL);
+
+	/**
+	 * Get a view of the next string in the stream.
+	 * The message data is not modified.
+	 *
+	 * @return View of the string, a null view if there are
+	 * no more strings in the message.
+	 */
+	virtual MessageView getNextView();
+
+	/**
+	 * Get the next integer in the stream.
+	 *
+	 * @return The integer value, 0 if there are no more
+	 * values in the stream.
+	 */
+	virtual int getNextInt();
+
+protected:
+	/**
+	 * Read a string at the current position, setting
+	 * mStart and mEnd.
+	 * @return true on success, false if there are no
+	 * more values or the string is malformed.
+	 */
+	bool advanceString();
+
+	/**
+	 * Read an integer at the current position and move past it.
+	 * @return true on success, false at the end of the stream
+	 * or if the stream is malformed.
+	 */
+	bool readInt(int* value);
+
+	/**
+	 * Stop reading the stream because of an error.
+	 * @param status The error code.
+	 */
+	void fail(int status);
+
+	/**
+	 * Decode an integer at the given position.
+	 * @return true on success, false if the characters
+	 * are not valid integer digits.
+	 */
+	static bool decodeInt(const char* p, int* value);
+
+	/**
+	 * @return End of the current message, or of the data
+	 * before the first message.
+	 */
+	char* getLimit();
+
+protected:
+	/**
+	 * Position of the next value in the stream.
+	 */
+	char* mPosition;
+
+	/**
+	 * End of the current message, NULL before the first one.
+	 */
+	char* mMessageEnd;
+};
+
+} // namespace
+
+#endif
+
+/*! @} */
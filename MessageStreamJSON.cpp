@@ -44,22 +44,54 @@ namespace Wormhole
 		MAHandle dataHandle)
 	{
 		mWebView = webView;
+		mStreaming = false;
+		mArena = &mOwnArena;
+		mMessageMark = mArena->getMark();
+		mPosition = NULL;
+		mDataEnd = NULL;
+		mCurrentMessage = NULL;
+		mMessageName = NULL;
+		mMessageNameLength = 0;
+		mParamCacheSize = 0;
+		mJSONRoot = NULL;
 		mCurrentMessageIndex = -1;
 		parse(dataHandle);
 	}
 
 	/**
-	 * Destructor. Here we delete the JSON tree.
+	 * Constructor. Here we parse message data in memory.
+	 */
+	MessageStreamJSON::MessageStreamJSON(
+		NativeUI::WebView* webView,
+		const char* data,
+		int dataSize,
+		bool streaming,
+		MessageArena* arena)
+	{
+		mWebView = webView;
+		mStreaming = streaming;
+		mArena = NULL != arena ? arena : &mOwnArena;
+		mMessageMark = mArena->getMark();
+		mPosition = NULL;
+		mDataEnd = NULL;
+		mCurrentMessage = NULL;
+		mMessageName = NULL;
+		mMessageNameLength = 0;
+		mParamCacheSize = 0;
+		mJSONRoot = NULL;
+		mCurrentMessageIndex = -1;
+		parse(data, dataSize);
+	}
+
+	/**
+	 * Destructor. Here we free the JSON trees, all at once
+	 * by resetting the arena.
 	 */
 	MessageStreamJSON::~MessageStreamJSON()
 	{
-		// The root must not be NULL or Value::NUL.
-		if (NULL != mJSONRoot && YAJLDom::Value::NUL != mJSONRoot->getType())
-		{
-			// Delete the JSON tree.
-			YAJLDom::deleteValue(mJSONRoot);
-			mJSONRoot = NULL;
-		}
+		mCurrentMessage = NULL;
+		mJSONRoot = NULL;
+		mArena->reset();
 	}
 
 	/**
@@ -81,10 +113,21 @@ namespace Wormhole
 	 */
 	bool MessageStreamJSON::next()
 	{
-		if (NULL != mJSONRoot && YAJLDom::Value::ARRAY == mJSONRoot->getType())
+		if (mStreaming)
+		{
+			return parseNextMessage();
+		}
+
+		if (NULL != mJSONRoot && MessageJSONValue::ARRAY == mJSONRoot->getType())
 		{
+			// Follow the list of messages instead of looking
+			// each one up by index.
+			MessageJSONValue* message = mCurrentMessageIndex < 0
+				? mJSONRoot->getFirstChild()
+				: (NULL != mCurrentMessage ? mCurrentMessage->getNext() : NULL);
 			++mCurrentMessageIndex;
-			return mCurrentMessageIndex < mJSONRoot->getNumChildValues();
+			beginMessage(message);
+			return NULL != message;
 		}
 		return false;
 	}
@@ -94,17 +137,13 @@ namespace Wormhole
 	 */
 	bool MessageStreamJSON::is(const char* paramName)
 	{
-		YAJLDom::Value* value = getParamNode("messageName");
-		if (NULL != value && YAJLDom::Value::STRING == value->getType());
+		// The name is looked up once per message, by next().
+		if (NULL == mMessageName)
 		{
-//			YAJLDom::StringValue* stringValue = (YAJLDom::StringValue*) value;
-//			return 0 == strncmp(
-//				paramName,
-//				stringValue->getCharPointer(),
-//				stringValue->getLength());
-			return value->toString() == paramName;
+			return false;
 		}
-		return false;
+		return 0 == strncmp(paramName, mMessageName, mMessageNameLength)
+			&& 0 == paramName[mMessageNameLength];
 	}
 
 	/**
@@ -113,12 +152,33 @@ namespace Wormhole
 	 */
 	String MessageStreamJSON::getParam(const char* paramName)
 	{
-		YAJLDom::Value* value = getParamNode(paramName);
-		if (NULL != value && YAJLDom::Value::STRING == value->getType());
+		MessageJSONValue* value = getParamNode(paramName);
+		if (NULL == value)
 		{
-			return value->toString();
+			return "";
 		}
-		return "";
+		return value->toString();
+	}
+
+	/**
+	 * Returns a pointer to the string value of a message
+	 * parameter, without copying it.
+	 */
+	const char* MessageStreamJSON::getParamPointer(
+		const char* paramName,
+		int* length)
+	{
+		MessageJSONValue* value = getParamNode(paramName);
+		if (NULL == value || MessageJSONValue::STRING != value->getType())
+		{
+			return NULL;
+		}
+
+		if (NULL != length)
+		{
+			*length = value->getLength();
+		}
+		return value->getCharPointer();
 	}
 
 	/**
@@ -127,12 +187,12 @@ namespace Wormhole
 	 */
 	int MessageStreamJSON::getParamInt(const char* paramName)
 	{
-		YAJLDom::Value* value = getParamNode(paramName);
-		if (NULL != value && YAJLDom::Value::NUMBER == value->getType());
+		MessageJSONValue* value = getParamNode(paramName);
+		if (NULL == value)
 		{
-			return value->toInt();
+			return 0;
 		}
-		return 0;
+		return value->toInt();
 	}
 
 	/**
@@ -140,24 +200,67 @@ namespace Wormhole
 	 */
 	bool MessageStreamJSON::hasParam(const char* paramName)
 	{
-		YAJLDom::Value* value = getParamNode(paramName);
-		return (NULL != value && YAJLDom::Value::NUL != value->getType());
+		MessageJSONValue* value = getParamNode(paramName);
+		return (NULL != value && MessageJSONValue::NUL != value->getType());
 	}
 
 	/**
 	 * Get the node of a parameter in the current message.
 	 */
-	YAJLDom::Value* MessageStreamJSON::getParamNode(const char* paramName)
+	MessageJSONValue* MessageStreamJSON::getParamNode(const char* paramName)
 	{
-		if (NULL != mJSONRoot && YAJLDom::Value::ARRAY == mJSONRoot->getType())
+		if (NULL == mCurrentMessage
+			|| MessageJSONValue::MAP != mCurrentMessage->getType())
 		{
-			YAJLDom::Value* message = mJSONRoot->getValueByIndex(mCurrentMessageIndex);
-			if (YAJLDom::Value::MAP == message->getType())
+			return NULL;
+		}
+
+		// The name may live in a buffer the caller reuses,
+		// so compare by content, never by address.
+		int nameLength = strlen(paramName);
+		for (int i = 0; i < mParamCacheSize; ++i)
+		{
+			if (nameLength == mParamCache[i].mNameLength
+				&& 0 == memcmp(paramName, mParamCache[i].mName, nameLength))
 			{
-				return message->getValueForKey(paramName);
+				return mParamCache[i].mValue;
 			}
 		}
-		return NULL;
+
+		MessageJSONValue* value =
+			mCurrentMessage->getValueForKey(paramName, nameLength);
+
+		// Only found nodes are cached, keyed by the node's own
+		// key so the entry stays valid for the whole message.
+		if (NULL != value
+			&& mParamCacheSize < MESSAGE_STREAM_JSON_PARAM_CACHE_SIZE)
+		{
+			mParamCache[mParamCacheSize].mName = value->getKey();
+			mParamCache[mParamCacheSize].mNameLength = value->getKeyLength();
+			mParamCache[mParamCacheSize].mValue = value;
+			++mParamCacheSize;
+		}
+
+		return value;
+	}
+
+	/**
+	 * Called when moving to a new message. Clears the
+	 * parameter cache and looks up the message name.
+	 */
+	void MessageStreamJSON::beginMessage(MessageJSONValue* message)
+	{
+		mCurrentMessage = message;
+		mParamCacheSize = 0;
+		mMessageName = NULL;
+		mMessageNameLength = 0;
+
+		MessageJSONValue* name = getParamNode("messageName");
+		if (NULL != name && MessageJSONValue::STRING == name->getType())
+		{
+			mMessageName = name->getCharPointer();
+			mMessageNameLength = name->getLength();
+		}
 	}
 
 	/**
@@ -169,7 +272,7 @@ namespace Wormhole
 		//lprintfln("@@@ MessageStreamJSON::parse %i", dataHandle);
 
 		// We must have data.
-		if (NULL == dataHandle)
+		if (0 == dataHandle)
 		{
 			return;
 		}
@@ -177,8 +280,15 @@ namespace Wormhole
 		// Get length of the data, it is not zero terminated.
 		int dataSize = maGetDataSize(dataHandle);
 
-		// Allocate buffer for string data.
-		char* stringData = (char*) malloc(dataSize + 1);
+		// Allocate buffer for string data. It is in the
+		// arena, so in streaming mode it stays valid while
+		// the messages are parsed from it, and is freed with
+		// the trees.
+		char* stringData = (char*) mArena->alloc(dataSize + 1);
+		if (NULL == stringData)
+		{
+			return;
+		}
 
 		// Get the data.
 		maReadData(dataHandle, stringData, 0, dataSize);
@@ -188,22 +298,171 @@ namespace Wormhole
 
 		//maWriteLog(stringData, dataSize);
 
+		parse(stringData, dataSize);
+	}
+
+	/**
+	 * Parse message data that is already in memory.
+	 */
+	void MessageStreamJSON::parse(const char* data, int dataSize)
+	{
+		// We must have data.
+		if (NULL == data || dataSize < 4)
+		{
+			return;
+		}
+
 		// Check that we have the "ma:" prefix,
 		// followed by the JSON array.
-		if (stringData[0] != 'm') { return; }
-		if (stringData[1] != 'a') { return; }
-		if (stringData[2] != ':') { return; }
-		if (stringData[3] != '[') { return; }
+		if (data[0] != 'm') { return; }
+		if (data[1] != 'a') { return; }
+		if (data[2] != ':') { return; }
+		if (data[3] != '[') { return; }
 
 		// Pointer to the start of the JSOn array at the
 		// opening '[' character.
-		char* jsonData = stringData + 3;
+		const char* jsonData = data + 3;
+
+		if (mStreaming)
+		{
+			// Messages are parsed by next(), starting
+			// after the '[' character. Each message tree
+			// replaces the previous one in the arena.
+			mPosition = jsonData + 1;
+			mDataEnd = data + dataSize;
+			mMessageMark = mArena->getMark();
+			return;
+		}
+
+		mJSONRoot = MessageJSON::parse(
+			jsonData,
+			dataSize - 3,
+			*mArena);
+	}
+
+	/**
+	 * @return true if messages are parsed one at a time.
+	 */
+	bool MessageStreamJSON::isStreaming()
+	{
+		return mStreaming;
+	}
+
+	/**
+	 * Parse the next message in streaming mode.
+	 */
+	bool MessageStreamJSON::parseNextMessage()
+	{
+		// Free the previous message first, so that only
+		// one message tree exists at a time.
+		beginMessage(NULL);
+		mArena->rewind(mMessageMark);
+
+		while (NULL != mPosition)
+		{
+			// Skip whitespace and the comma between messages.
+			const char* p = mPosition;
+			while (p < mDataEnd
+				&& (' ' == *p || '\t' == *p || '\r' == *p
+					|| '\n' == *p || ',' == *p))
+			{
+				++p;
+			}
+
+			// End of the array.
+			if (p >= mDataEnd || ']' == *p)
+			{
+				mPosition = NULL;
+				return false;
+			}
+
+			const char* end = findValueEnd(p);
+			if (NULL == end)
+			{
+				lprintfln("@@@ MessageStreamJSON: unterminated message");
+				mPosition = NULL;
+				return false;
+			}
+			mPosition = end;
+
+			MessageJSONValue* message = MessageJSON::parse(
+				p,
+				end - p,
+				*mArena);
+			++mCurrentMessageIndex;
+
+			if (NULL != message && MessageJSONValue::NUL != message->getType())
+			{
+				beginMessage(message);
+				return true;
+			}
+
+			// A malformed message only affects itself,
+			// continue with the next one.
+			lprintfln("@@@ MessageStreamJSON: could not parse message %d",
+				mCurrentMessageIndex);
+			mArena->rewind(mMessageMark);
+		}
+
+		return false;
+	}
+
+	/**
+	 * Find the end of the JSON value that starts at the
+	 * given position. Strings are skipped, so that brackets
+	 * inside them are not counted.
+	 */
+	const char* MessageStreamJSON::findValueEnd(const char* p)
+	{
+		int depth = 0;
 
-		mJSONRoot = YAJLDom::parse(
-			(const unsigned char*)jsonData,
-			dataSize - 3);
+		while (p < mDataEnd)
+		{
+			char c = *p;
+			if ('"' == c)
+			{
+				// Skip the string, including escaped quotes.
+				++p;
+				while (p < mDataEnd && '"' != *p)
+				{
+					if ('\\' == *p)
+					{
+						++p;
+					}
+					++p;
+				}
+				if (p >= mDataEnd)
+				{
+					return NULL;
+				}
+			}
+			else if ('{' == c || '[' == c)
+			{
+				++depth;
+			}
+			else if ('}' == c || ']' == c)
+			{
+				// A ']' at depth zero ends the array,
+				// following a value that is not a map
+				// or array.
+				if (0 == depth)
+				{
+					return p;
+				}
+				--depth;
+				if (0 == depth)
+				{
+					return p + 1;
+				}
+			}
+			else if (',' == c && 0 == depth)
+			{
+				return p;
+			}
+			++p;
+		}
 
-		free(stringData);
+		return NULL;
 	}
 
 } // namespace
@@ -38,7 +38,13 @@ MA 02110-1301, USA.
 #include <MAUtil/String.h>
 #include <MAUtil/HashMap.h>
 #include <NativeUI/WebView.h>
-#include <yajl/YAJLDom.h>
+#include "MessageArena.h"
+#include "MessageJSON.h"
+
+/**
+ * Number of parameter nodes cached per message.
+ */
+#define MESSAGE_STREAM_JSON_PARAM_CACHE_SIZE 8
 
 namespace Wormhole
 {
@@ -51,7 +57,21 @@ namespace Wormhole
  *
  *   ma:[{"messageName":"message1",...},{"messageName":"message2",...},...]
  *
- * TODO: Add copy constructor and assignment operator.
+ * In streaming mode, only the message at the current position
+ * is parsed. Each call to next() finds the end of the next
+ * message in the array and replaces the tree of the previous
+ * message with the tree of the next one, so memory use is
+ * bounded by the largest message rather than by the whole
+ * array. The message data must then stay valid while the
+ * stream is in use. Otherwise the whole array is parsed up
+ * front.
+ *
+ * The message trees, and the copy of the data read from a data
+ * object, are allocated in a MessageArena that is reset when the
+ * stream is destroyed. An arena can be given to the constructor
+ * and reused for every stream, then nothing is allocated once it
+ * has grown to the size of the largest stream. Otherwise the
+ * stream uses an arena of its own.
  */
 class MessageStreamJSON
 {
@@ -61,6 +81,29 @@ public:
 	 */
 	MessageStreamJSON(NativeUI::WebView* webView, MAHandle dataHandle);
 
+	/**
+	 * Constructor. Parses message data that is already in
+	 * memory, for example in a MessageBuffer. The data is
+	 * not copied.
+	 *
+	 * @param webView The WebView that sent the message.
+	 * @param data Message data, including the "ma:" prefix.
+	 * @param dataSize Size of the data.
+	 * @param streaming If true, messages are parsed one at a
+	 * time by next(), and the data must stay valid until the
+	 * stream is destroyed.
+	 * @param arena Arena to allocate the message trees in,
+	 * NULL to use an arena owned by the stream. The arena is
+	 * reset when the stream is destroyed, so it can only be
+	 * used by one stream at a time.
+	 */
+	MessageStreamJSON(
+		NativeUI::WebView* webView,
+		const char* data,
+		int dataSize,
+		bool streaming = false,
+		MessageArena* arena = NULL);
+
 	/**
 	 * Destructor.
 	 */
@@ -93,6 +136,19 @@ public:
 	 */
 	MAUtil::String getParam(const char* paramName);
 
+	/**
+	 * Returns a pointer to the string value of a message
+	 * parameter, without copying it. The pointer is valid
+	 * until the next call to next().
+	 *
+	 * @param paramName The parameter name.
+	 * @param length If not NULL, the length of the string
+	 * is returned here.
+	 * @return Pointer to the string, NULL if the parameter
+	 * is missing or not a string.
+	 */
+	const char* getParamPointer(const char* paramName, int* length);
+
 	/**
 	 * Returns the integer value of a message parameter.
 	 * @return The param value as an int.
@@ -106,8 +162,11 @@ public:
 
 	/**
 	 * Get the node of a parameter in the current message.
+	 * Found nodes are cached per message. The cache compares
+	 * names by length and content against the key stored in
+	 * the node, so names built in a reused buffer are safe.
 	 */
-	MAUtil::YAJLDom::Value* getParamNode(const char* paramName);
+	MessageJSONValue* getParamNode(const char* paramName);
 
 	/**
 	 * Parse the message. This finds the message name and
@@ -115,17 +174,126 @@ public:
 	 */
 	void parse(MAHandle dataHandle);
 
+	/**
+	 * Parse message data that is already in memory.
+	 */
+	void parse(const char* data, int dataSize);
+
+	/**
+	 * @return true if messages are parsed one at a time.
+	 */
+	bool isStreaming();
+
+private:
+	/**
+	 * Called when moving to a new message. Clears the
+	 * parameter cache and looks up the message name.
+	 */
+	void beginMessage(MessageJSONValue* message);
+
+	/**
+	 * Parse the next message in streaming mode.
+	 * @return true if a message was parsed, false if there
+	 * are no more messages or the data is malformed.
+	 */
+	bool parseNextMessage();
+
+	/**
+	 * Find the end of the JSON value that starts at the
+	 * given position.
+	 * @return Pointer to the character following the value,
+	 * NULL if the value is not terminated.
+	 */
+	const char* findValueEnd(const char* p);
+
+	/**
+	 * Not copyable.
+	 */
+	MessageStreamJSON(const MessageStreamJSON&);
+	MessageStreamJSON& operator=(const MessageStreamJSON&);
+
 private:
 	/**
 	 * The WebView of this message.
 	 */
 	NativeUI::WebView* mWebView;
 
+	/**
+	 * True if messages are parsed one at a time.
+	 */
+	bool mStreaming;
+
+	/**
+	 * Arena used when none is given to the constructor.
+	 */
+	MessageArena mOwnArena;
+
+	/**
+	 * Arena the message trees are allocated in.
+	 */
+	MessageArena* mArena;
+
+	/**
+	 * Position in the arena after the message data, where
+	 * each message tree starts in streaming mode.
+	 */
+	MessageArenaMark mMessageMark;
+
+	/**
+	 * Position of the next message in streaming mode.
+	 */
+	const char* mPosition;
+
+	/**
+	 * End of the message data in streaming mode.
+	 */
+	const char* mDataEnd;
+
+	/**
+	 * The current message, a node in mJSONRoot, or in
+	 * streaming mode the root of the current message tree.
+	 */
+	MessageJSONValue* mCurrentMessage;
+
+	/**
+	 * The name of the current message, NULL if missing.
+	 * Points into the message tree.
+	 */
+	const char* mMessageName;
+
+	/**
+	 * Length of the message name.
+	 */
+	int mMessageNameLength;
+
+	/**
+	 * Parameter node cache entry.
+	 */
+	struct ParamCacheEntry
+	{
+		/**
+		 * Key of the node, owned by the message arena.
+		 */
+		const char* mName;
+		int mNameLength;
+		MessageJSONValue* mValue;
+	};
+
+	/**
+	 * Nodes of the parameters looked up in the current message.
+	 */
+	ParamCacheEntry mParamCache[MESSAGE_STREAM_JSON_PARAM_CACHE_SIZE];
+
+	/**
+	 * Number of entries in the parameter cache.
+	 */
+	int mParamCacheSize;
+
 public:
 	/**
-	 * Table for message parameters.
+	 * Table for message parameters. NULL in streaming mode.
 	 */
-	MAUtil::YAJLDom::Value* mJSONRoot;
+	MessageJSONValue* mJSONRoot;
 
 	/**
 	 * Index of current message.
@@ -0,0 +1,169 @@
+/*
+Copyright (C) 2012 MoSync AB
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License,
+version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+*/
+
+/**
+ * @file MessageTrace.cpp
+ *
+ * Ring buffer of binary trace records.
+ */
+
+#ifdef MESSAGE_TRACE
+
+#include <ma.h>				// MoSync API
+#include <mastring.h>		// C string functions
+#include <conprint.h>
+
+#include <MAUtil/String.h>
+
+#include "MessageTrace.h"
+
+namespace Wormhole
+{
+	/**
+	 * The records. Static, so that recording never allocates.
+	 */
+	static MessageTraceRecord sRecords[MESSAGE_TRACE_SIZE];
+
+	/**
+	 * Index of the next record to write.
+	 */
+	static int sNext = 0;
+
+	/**
+	 * Number of records in the buffer.
+	 */
+	static int sCount = 0;
+
+	/**
+	 * Add a record, overwriting the oldest one if the buffer
+	 * is full.
+	 */
+	void MessageTrace::record(int module, int opcode, int handle, int result)
+	{
+		MessageTraceRecord& r = sRecords[sNext];
+		r.mTime = maGetMilliSecondCount();
+		r.mModule = (short) module;
+		r.mOpcode = (short) opcode;
+		r.mHandle = handle;
+		r.mResult = result;
+
+		sNext = (sNext + 1) % MESSAGE_TRACE_SIZE;
+		if (sCount < MESSAGE_TRACE_SIZE)
+		{
+			++sCount;
+		}
+	}
+
+	/**
+	 * Write the records to a file, oldest first.
+	 */
+	int MessageTrace::dump(const char* fileName)
+	{
+		char localPath[1024];
+		int size = maGetSystemProperty(
+			"mosync.path.local",
+			localPath,
+			sizeof(localPath));
+		if (size <= 0 || size > (int) sizeof(localPath))
+		{
+			return MA_FERR_GENERIC;
+		}
+
+		MAUtil::String path = localPath;
+		path += fileName;
+
+		MAHandle file = maFileOpen(path.c_str(), MA_ACCESS_READ_WRITE);
+		if (file < 0)
+		{
+			return file;
+		}
+
+		int result = maFileExists(file)
+			? maFileTruncate(file, 0)
+			: maFileCreate(file);
+
+		int header[3] =
+		{
+			MESSAGE_TRACE_MAGIC,
+			sizeof(MessageTraceRecord),
+			sCount
+		};
+		if (result >= 0)
+		{
+			result = maFileWrite(file, header, sizeof(header));
+		}
+
+		// The oldest record is at sNext once the buffer has
+		// wrapped, and at 0 before that. Write the part up to
+		// the end of the array, then the part from the start.
+		int first = 0;
+		int tail = sCount;
+		if (MESSAGE_TRACE_SIZE == sCount)
+		{
+			first = sNext;
+			tail = MESSAGE_TRACE_SIZE - sNext;
+		}
+		if (result >= 0)
+		{
+			result = maFileWrite(
+				file,
+				sRecords + first,
+				tail * sizeof(MessageTraceRecord));
+		}
+		if (result >= 0 && sCount > tail)
+		{
+			result = maFileWrite(
+				file,
+				sRecords,
+				(sCount - tail) * sizeof(MessageTraceRecord));
+		}
+
+		maFileClose(file);
+
+		if (result < 0)
+		{
+			lprintfln("@@@ MessageTrace: could not write %s, %d",
+				path.c_str(), result);
+			return result;
+		}
+
+		lprintfln("@@@ MessageTrace: wrote %d records to %s",
+			sCount, path.c_str());
+		return sCount;
+	}
+
+	/**
+	 * @return Number of records in the buffer.
+	 */
+	int MessageTrace::getCount()
+	{
+		return sCount;
+	}
+
+	/**
+	 * Remove all records.
+	 */
+	void MessageTrace::clear()
+	{
+		sNext = 0;
+		sCount = 0;
+	}
+
+} // namespace
+
+#endif // MESSAGE_TRACE
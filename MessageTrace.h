@@ -0,0 +1,186 @@
+/*
+Copyright (C) 2012 MoSync AB
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License,
+version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+*/
+
+/*! \addtogroup WormHoleGroup
+ *  @{
+ */
+
+/** @defgroup WormHoleGroup Wormhole Library
+ *  @{
+ */
+
+/**
+ * @file MessageTrace.h
+ *
+ * Ring buffer of binary trace records, used instead of logging
+ * on the hot paths of the message handlers. Tracing is compiled
+ * only when MESSAGE_TRACE is defined, which the Debug build
+ * configuration does. Otherwise MESSAGE_TRACE_RECORD expands to
+ * nothing and MESSAGE_TRACE_DUMP to MESSAGE_TRACE_ERROR_DISABLED.
+ *
+ * Usage:
+ *
+ *   MESSAGE_TRACE_RECORD(
+ *       MESSAGE_TRACE_NATIVEUI,
+ *       NATIVEUI_OP_WIDGET_SET_PROPERTY,
+ *       widget,
+ *       res);
+ *   ...
+ *   MESSAGE_TRACE_DUMP("message-trace.bin");
+ */
+
+#ifndef MESSAGE_TRACE_H_
+#define MESSAGE_TRACE_H_
+
+/**
+ * Result of MESSAGE_TRACE_DUMP when tracing is not compiled,
+ * distinct from the MA_FERR error codes.
+ */
+#define MESSAGE_TRACE_ERROR_DISABLED -1000
+
+/**
+ * Modules of the trace records. The values are the module
+ * opcodes of the binary protocol.
+ */
+enum MessageTraceModule
+{
+	MESSAGE_TRACE_MAIN = 0,
+	MESSAGE_TRACE_NATIVEUI = 1,
+	MESSAGE_TRACE_RESOURCE = 2
+};
+
+#ifdef MESSAGE_TRACE
+
+#include <ma.h>
+
+/**
+ * Number of records kept. When the buffer is full, the
+ * oldest record is overwritten.
+ */
+#define MESSAGE_TRACE_SIZE 4096
+
+/**
+ * First bytes of a trace file, "MTR1".
+ */
+#define MESSAGE_TRACE_MAGIC 0x3152544D
+
+/**
+ * Record a trace event.
+ */
+#define MESSAGE_TRACE_RECORD(module, opcode, handle, result) \
+	Wormhole::MessageTrace::record(module, opcode, handle, result)
+
+/**
+ * Write the trace to a file in the local files directory.
+ */
+#define MESSAGE_TRACE_DUMP(fileName) \
+	Wormhole::MessageTrace::dump(fileName)
+
+namespace Wormhole
+{
+
+/**
+ * A trace record, 16 bytes.
+ */
+struct MessageTraceRecord
+{
+	/**
+	 * Time of the event, from maGetMilliSecondCount.
+	 */
+	int mTime;
+
+	/**
+	 * A MessageTraceModule.
+	 */
+	short mModule;
+
+	/**
+	 * Opcode of the action in the module, 0 for the
+	 * message itself.
+	 */
+	short mOpcode;
+
+	/**
+	 * Widget or other handle the action works on.
+	 */
+	int mHandle;
+
+	/**
+	 * Result code of the action.
+	 */
+	int mResult;
+};
+
+/**
+ * Fixed size ring buffer of trace records. Recording a record
+ * only copies four numbers, so it can be done for every message
+ * without slowing the application down like logging does.
+ *
+ * All methods are static, there is one trace for the whole
+ * application.
+ */
+class MessageTrace
+{
+public:
+	/**
+	 * Add a record, overwriting the oldest one if the buffer
+	 * is full.
+	 *
+	 * @param module A MessageTraceModule.
+	 * @param opcode Opcode of the action.
+	 * @param handle Handle the action works on.
+	 * @param result Result code of the action.
+	 */
+	static void record(int module, int opcode, int handle, int result);
+
+	/**
+	 * Write the records to a file, oldest first. The file has
+	 * a header of three ints, MESSAGE_TRACE_MAGIC, the size of
+	 * a record and the number of records, followed by the
+	 * records, all in the byte order of the device.
+	 *
+	 * @param fileName Name of the file in the local files
+	 * directory. The file is replaced.
+	 * @return The number of records written, or a negative
+	 * MA_FERR error code.
+	 */
+	static int dump(const char* fileName);
+
+	/**
+	 * @return Number of records in the buffer.
+	 */
+	static int getCount();
+
+	/**
+	 * Remove all records.
+	 */
+	static void clear();
+};
+
+} // namespace
+
+#else
+
+#define MESSAGE_TRACE_RECORD(module, opcode, handle, result)
+#define MESSAGE_TRACE_DUMP(fileName) (MESSAGE_TRACE_ERROR_DISABLED)
+
+#endif // MESSAGE_TRACE
+
+#endif
+
+/*! @} */
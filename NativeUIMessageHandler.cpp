@@ -25,9 +25,11 @@ MA 02110-1301, USA.
 
 
 #include <mastdlib.h> // C string conversion functions
+#include <maheap.h> // C memory allocation
 #include <conprint.h>
 #include "NativeUIMessageHandler.h"
 #include "MAHeaders.h"
+#include "MessageTrace.h"
 
 
 // NameSpaces we want to access.
@@ -35,22 +37,145 @@ using namespace MAUtil; // Class Moblet, String
 using namespace NativeUI; // WebView widget
 using namespace Wormhole; // Class WebAppMoblet
 
+/**
+ * Names of the widget event types in JavaScript.
+ */
+struct WidgetEventType
+{
+	int mType;
+	const char* mName;
+};
+
+static const WidgetEventType sWidgetEventTypes[] =
+{
+	{ MAW_EVENT_POINTER_PRESSED, "PointerPressed" },
+	{ MAW_EVENT_POINTER_RELEASED, "PointerReleased" },
+	{ MAW_EVENT_CONTENT_LOADED, "ContentLoaded" },
+	{ MAW_EVENT_CLICKED, "Clicked" },
+	{ MAW_EVENT_ITEM_CLICKED, "ItemClicked" },
+	{ MAW_EVENT_TAB_CHANGED, "TabChanged" },
+	{ MAW_EVENT_GL_VIEW_READY, "GLViewReady" },
+	{ MAW_EVENT_WEB_VIEW_URL_CHANGED, "WebViewURLChanged" },
+	{ MAW_EVENT_STACK_SCREEN_POPPED, "StackScreenPopped" },
+	{ MAW_EVENT_SLIDER_VALUE_CHANGED, "SliderValueChanged" },
+	{ MAW_EVENT_DATE_PICKER_VALUE_CHANGED, "DatePickerValueChanged" },
+	{ MAW_EVENT_NUMBER_PICKER_VALUE_CHANGED, "NumberPickerValueChanged" },
+	{ MAW_EVENT_VIDEO_STATE_CHANGED, "VideoStateChanged" },
+	{ MAW_EVENT_EDIT_BOX_EDITING_DID_BEGIN, "EditBoxEditingDidBegin" },
+	{ MAW_EVENT_EDIT_BOX_EDITING_DID_END, "EditBoxEditingDidEnd" },
+	{ MAW_EVENT_EDIT_BOX_TEXT_CHANGED, "EditBoxTextChanged" },
+	{ MAW_EVENT_EDIT_BOX_RETURN, "EditBoxReturn" },
+	{ MAW_EVENT_WEB_VIEW_CONTENT_LOADING, "WebViewContentLoading" },
+	{ MAW_EVENT_WEB_VIEW_HOOK_INVOKED, "WebViewHookInvoked" },
+	{ MAW_EVENT_DIALOG_DISMISSED, "DialogDismissed" }
+};
+
+static const int sNumWidgetEventTypes =
+	sizeof(sWidgetEventTypes) / sizeof(sWidgetEventTypes[0]);
+
+/**
+ * Widget properties whose value is an image handle, which are
+ * kept in use while the widget shows them.
+ */
+static const char* sImageProperties[NATIVEUI_NUM_IMAGE_PROPERTIES] =
+{
+	"image",
+	"backgroundImage",
+	"icon"
+};
+
 /**
  * Constructor.
  */
-NativeUIMessageHandler::NativeUIMessageHandler(NativeUI::WebView* webView) :
-	mWebView(webView)
+NativeUIMessageHandler::NativeUIMessageHandler(
+	NativeUI::WebView* webView,
+	Wormhole::ScriptBatch* scripts) :
+	mWebView(webView),
+	mScripts(scripts),
+	mDispatcher(this),
+	mStats(NULL),
+	mImageCache(NULL),
+	mEventCoalescingWindow(NATIVEUI_EVENT_COALESCING_WINDOW),
+	mEventTimerRunning(false)
 {
 	//We have added this class as a custom event listener so it
 	//can forward all of the custom events to JavaScript
-	Environment::getEnvironment().addCustomEventListener(this);}
+	Environment::getEnvironment().addCustomEventListener(this);
+
+	// Register the handlers for the actions sent from JavaScript.
+	// To add an action, write a handler and register it here.
+	mDispatcher.add(
+		"maWidgetCreate",
+		NATIVEUI_OP_WIDGET_CREATE,
+		&NativeUIMessageHandler::widgetCreate);
+	mDispatcher.add(
+		"maWidgetDestroy",
+		NATIVEUI_OP_WIDGET_DESTROY,
+		&NativeUIMessageHandler::widgetDestroy);
+	mDispatcher.add(
+		"maWidgetAddChild",
+		NATIVEUI_OP_WIDGET_ADD_CHILD,
+		&NativeUIMessageHandler::widgetAddChild);
+	mDispatcher.add(
+		"maWidgetInsertChild",
+		NATIVEUI_OP_WIDGET_INSERT_CHILD,
+		&NativeUIMessageHandler::widgetInsertChild);
+	mDispatcher.add(
+		"maWidgetRemoveChild",
+		NATIVEUI_OP_WIDGET_REMOVE_CHILD,
+		&NativeUIMessageHandler::widgetRemoveChild);
+	mDispatcher.add(
+		"maWidgetModalDialogShow",
+		NATIVEUI_OP_WIDGET_MODAL_DIALOG_SHOW,
+		&NativeUIMessageHandler::widgetModalDialogShow);
+	mDispatcher.add(
+		"maWidgetModalDialogHide",
+		NATIVEUI_OP_WIDGET_MODAL_DIALOG_HIDE,
+		&NativeUIMessageHandler::widgetModalDialogHide);
+	mDispatcher.add(
+		"maWidgetScreenShow",
+		NATIVEUI_OP_WIDGET_SCREEN_SHOW,
+		&NativeUIMessageHandler::widgetScreenShow);
+	mDispatcher.add(
+		"maWidgetStackScreenPush",
+		NATIVEUI_OP_WIDGET_STACK_SCREEN_PUSH,
+		&NativeUIMessageHandler::widgetStackScreenPush);
+	mDispatcher.add(
+		"maWidgetStackScreenPop",
+		NATIVEUI_OP_WIDGET_STACK_SCREEN_POP,
+		&NativeUIMessageHandler::widgetStackScreenPop);
+	mDispatcher.add(
+		"maWidgetSetProperty",
+		NATIVEUI_OP_WIDGET_SET_PROPERTY,
+		&NativeUIMessageHandler::widgetSetProperty);
+	mDispatcher.add(
+		"maWidgetGetProperty",
+		NATIVEUI_OP_WIDGET_GET_PROPERTY,
+		&NativeUIMessageHandler::widgetGetProperty);
+	mDispatcher.add(
+		"maWidgetCreateTree",
+		NATIVEUI_OP_WIDGET_CREATE_TREE,
+		&NativeUIMessageHandler::widgetCreateTree);
+	mDispatcher.add(
+		"maWidgetSubscribeEvent",
+		NATIVEUI_OP_WIDGET_SUBSCRIBE_EVENT,
+		&NativeUIMessageHandler::widgetSubscribeEvent);
+	mDispatcher.add(
+		"maWidgetUnsubscribeEvent",
+		NATIVEUI_OP_WIDGET_UNSUBSCRIBE_EVENT,
+		&NativeUIMessageHandler::widgetUnsubscribeEvent);
+}
 
 /**
  * Destructor.
  */
 NativeUIMessageHandler::~NativeUIMessageHandler()
 {
-	// Nothing needs to be explicitly destroyed.
+	Environment::getEnvironment().removeCustomEventListener(this);
+	if(mEventTimerRunning)
+	{
+		Environment::getEnvironment().removeTimer(this);
+	}
 }
 
 /**
@@ -62,268 +187,835 @@ NativeUIMessageHandler::~NativeUIMessageHandler()
  */
 bool NativeUIMessageHandler::handleMessage(Wormhole::MessageStream& stream)
 {
+	bool handled = mDispatcher.dispatchNext(stream);
 
-	char buffer[128];
-	const char * action = stream.getNext();
-	// Widget Handling Calls
-	if(0 == strcmp("maWidgetCreate", action))
-	{
-		const char* widgetType = stream.getNext();
-		const char* widgetID = stream.getNext();
-		const char* callbackID = stream.getNext();
-		int numParams = stringToInteger(stream.getNext());
+	// Tell the WebView that we have processed the stream, so that
+	// it can send the next one.
 
-		MAWidgetHandle widget =
-				maWidgetCreate(widgetType);
-		if(widget <= 0)
+	if(stream.isBinary())
+	{
+		// The binary protocol always sends the callback id,
+		// 0 means that there is no callback.
+		int mosyncCallBackId = stream.getNextInt();
+		if(mosyncCallBackId != 0)
 		{
-			sprintf(buffer,"'%s', %d", callbackID, widget);
-			sendNativeUIError(buffer);
-		}
-		else
-		{
-			if(numParams > 0)
-			{
-				for(int i = 0; i < numParams/2; i++)
-				{
-					const char* property = stream.getNext();
-					const char* value = stream.getNext();
-					int res = maWidgetSetProperty(widget, property, value);
-				}
-			}
-			//We use a special callback for widget creation
-			sprintf(
-					buffer,
-					"mosync.nativeui.createCallback('%s', '%s', %d)",
-					callbackID,
-					widgetID,
-					widget);
-			mWebView->callJS(buffer);
+			mScripts->add(mScripts->newScript()
+				.append("mosync.bridge.reply(")
+				.append(mosyncCallBackId)
+				.append(")"));
 		}
+		return handled;
+	}
 
+	const char * mosyncCallBackId = stream.getNext();
+	if(mosyncCallBackId != NULL)
+	{
+		// The id is a number, and is sent as it is.
+		mScripts->add(mScripts->newScript()
+			.append("mosync.bridge.reply(")
+			.append(mosyncCallBackId)
+			.append(")"));
 	}
-	else if(0 == strcmp("maWidgetDestroy", action))
+
+	return handled;
+}
+
+/**
+ * @return The number of messages with an unknown action.
+ */
+int NativeUIMessageHandler::getUnknownActionCount()
+{
+	return mDispatcher.getUnknownCount();
+}
+
+/**
+ * Set the statistics that the actions are counted in.
+ */
+void NativeUIMessageHandler::setStats(Wormhole::MessageStats* stats)
+{
+	mStats = stats;
+	mDispatcher.setStats(stats);
+}
+
+/**
+ * @return The cache of widget property values.
+ */
+WidgetPropertyCache& NativeUIMessageHandler::getPropertyCache()
+{
+	return mPropertyCache;
+}
+
+/**
+ * Set the cache of the images that are loaded from JavaScript.
+ */
+void NativeUIMessageHandler::setImageCache(ImageCache* imageCache)
+{
+	mImageCache = imageCache;
+}
+
+/**
+ * Get the native handle of a widget reference sent from JavaScript.
+ * Positive references are native handles, negative ones are IDs
+ * assigned by JavaScript.
+ */
+MAWidgetHandle NativeUIMessageHandler::getWidgetHandle(int widgetRef)
+{
+	if(widgetRef >= 0)
 	{
-		MAWidgetHandle widget = stringToInteger(stream.getNext());
-		const char* callbackID = stream.getNext();
+		return widgetRef;
+	}
 
-		int res = maWidgetDestroy(widget);
-		if(res < 0)
-		{
-			sprintf(buffer,"'%s', %d", callbackID, res);
-			sendNativeUIError(buffer);
-		}
-		else
-		{
-			sprintf(buffer,"'%s', %d", callbackID, res);
-			sendNativeUISuccess(buffer);
-		}
+	// Written this way so that the most negative int
+	// does not overflow.
+	int index = -(widgetRef + 1);
+	if(index >= mClientWidgets.size() || mClientWidgets[index] == 0)
+	{
+		return MAW_RES_INVALID_HANDLE;
+	}
+	return mClientWidgets[index];
+}
 
+/**
+ * Store the result of creating a widget that JavaScript
+ * assigned an ID to.
+ */
+MAWidgetHandle NativeUIMessageHandler::setClientWidget(
+	int widgetRef,
+	MAWidgetHandle widget)
+{
+	if(widgetRef >= 0)
+	{
+		return widget;
 	}
-	else if(0 == strcmp("maWidgetAddChild", action) )
+
+	int index = -(widgetRef + 1);
+	if(index >= NATIVEUI_MAX_CLIENT_WIDGETS)
 	{
-		MAWidgetHandle parent = stringToInteger(stream.getNext());
-		MAWidgetHandle child = stringToInteger(stream.getNext());
-		const char* callbackID = stream.getNext();
-		int res = maWidgetAddChild(parent, child);
-		if(res < 0)
-		{
-			sprintf(buffer,"'%s', %d", callbackID, res);
-			sendNativeUIError(buffer);
-		}
-		else
+		lprintfln("@@@ NativeUI: widget ID %d out of range", widgetRef);
+		if(widget > 0)
 		{
-			sprintf(buffer,"'%s', %d", callbackID, res);
-			sendNativeUISuccess(buffer);
+			maWidgetDestroy(widget);
+			forgetWidgetTree(widget);
 		}
+		return MAW_RES_ERROR;
 	}
-	else if(0 == strcmp("maWidgetInsertChild", action))
+
+	// Make room for the ID, JavaScript assigns the IDs in
+	// order so this seldom adds more than one element.
+	while(mClientWidgets.size() <= index)
 	{
-		MAWidgetHandle parent = stringToInteger(stream.getNext());
-		MAWidgetHandle child = stringToInteger(stream.getNext());
-		int index = stringToInteger(stream.getNext());
-		const char* callbackID = stream.getNext();
-		int res = maWidgetInsertChild(parent, child, index);
-		if(res < 0)
-		{
-			sprintf(buffer,"'%s', %d", callbackID, res);
-			sendNativeUIError(buffer);
-		}
-		else
+		mClientWidgets.add(0);
+	}
+	mClientWidgets[index] = widget;
+
+	// Remember the ID of the widget, so that it can be
+	// invalidated when the widget is destroyed.
+	if(widget >= 0)
+	{
+		while(mWidgetRefs.size() <= widget)
 		{
-			sprintf(buffer,"'%s', %d", callbackID, res);
-			sendNativeUISuccess(buffer);
+			mWidgetRefs.add(0);
 		}
+		mWidgetRefs[widget] = widgetRef;
 	}
-	else if(0 == strcmp("maWidgetRemoveChild", action))
+	return widget;
+}
+
+/**
+ * Remember the parent of a widget.
+ */
+void NativeUIMessageHandler::setWidgetParent(
+	MAWidgetHandle widget,
+	MAWidgetHandle parent)
+{
+	if(widget < 0)
 	{
-		MAWidgetHandle child = stringToInteger(stream.getNext());
-		const char* callbackID = stream.getNext();
+		return;
+	}
 
-		int res = maWidgetRemoveChild(child);
-		if(res < 0)
+	// Make room for the handle, widgets without a parent
+	// need no element.
+	if(widget >= mWidgetParents.size())
+	{
+		if(parent < 0)
 		{
-			sprintf(buffer,"'%s', %d", callbackID, res);
-			sendNativeUIError(buffer);
+			return;
 		}
-		else
+		while(mWidgetParents.size() <= widget)
 		{
-			sprintf(buffer,"'%s', %d", callbackID, res);
-			sendNativeUISuccess(buffer);
+			mWidgetParents.add(-1);
 		}
 	}
-	else if(0 == strcmp("maWidgetModalDialogShow", action))
+	mWidgetParents[widget] = parent;
+}
+
+/**
+ * Drop the state kept for a destroyed widget and the widgets
+ * below it.
+ */
+void NativeUIMessageHandler::forgetWidgetTree(MAWidgetHandle widget)
+{
+	if(widget < 0)
+	{
+		return;
+	}
+
+	setWidgetParent(widget, -1);
+
+	// Visit the tree breadth first, each visited widget adds
+	// its children to the end of the list.
+	mDestroyedWidgets.clear();
+	mDestroyedWidgets.add(widget);
+	for(int i = 0; i < mDestroyedWidgets.size(); i++)
 	{
-		MAWidgetHandle dialogHandle =
-				stringToInteger(stream.getNext());
-		const char* callbackID = stream.getNext();
-		int res = maWidgetModalDialogShow(dialogHandle);
-		if(res < 0)
+		MAWidgetHandle parent = mDestroyedWidgets[i];
+		for(int child = 0; child < mWidgetParents.size(); child++)
 		{
-			sprintf(buffer,"'%s', %d", callbackID, res);
-			sendNativeUIError(buffer);
-		}
-		else
-		{
-			sprintf(buffer,"'%s', %d", callbackID, res);
-			sendNativeUISuccess(buffer);
+			if(mWidgetParents[child] == parent)
+			{
+				mWidgetParents[child] = -1;
+				mDestroyedWidgets.add(child);
+			}
 		}
-	}
-	else if(0 == strcmp("maWidgetModalDialogHide", action))
-	{
-		MAWidgetHandle dialogHandle =
-				stringToInteger(stream.getNext());
-		const char* callbackID = stream.getNext();
-		int res = maWidgetModalDialogHide(dialogHandle);
-		if(res < 0)
+
+		mPropertyCache.removeWidget(parent);
+		releaseWidgetImages(parent);
+		if(parent < mEventSubscriptions.size())
 		{
-			sprintf(buffer,"'%s', %d", callbackID, res);
-			sendNativeUIError(buffer);
+			mEventSubscriptions[parent] = 0;
 		}
-		else
+
+		// Later operations on the ID fail.
+		if(parent < mWidgetRefs.size() && mWidgetRefs[parent] < 0)
 		{
-			sprintf(buffer,"'%s', %d", callbackID, res);
-			sendNativeUISuccess(buffer);
+			mClientWidgets[-(mWidgetRefs[parent] + 1)] =
+				MAW_RES_INVALID_HANDLE;
+			mWidgetRefs[parent] = 0;
 		}
 	}
-	else if(0 == strcmp("maWidgetScreenShow", action))
+}
+
+/**
+ * Keep the image set as a property of a widget in use, and
+ * release the image the property had before.
+ */
+void NativeUIMessageHandler::setWidgetImage(
+	MAWidgetHandle widget,
+	const char* property,
+	const char* value)
+{
+	if(NULL == mImageCache || NULL == property || NULL == value
+		|| widget < 0)
+	{
+		return;
+	}
+
+	int index = 0;
+	while(index < NATIVEUI_NUM_IMAGE_PROPERTIES
+		&& 0 != strcmp(property, sImageProperties[index]))
 	{
-		MAWidgetHandle screenHandle =
-				stringToInteger(stream.getNext());
-		const char* callbackID = stream.getNext();
-		int res = maWidgetScreenShow(screenHandle);
-		if(res < 0)
-		{
-			sprintf(buffer,"'%s', %d", callbackID, res);
-			sendNativeUIError(buffer);
-		}
-		else
-		{
-			sprintf(buffer,"'%s', %d", callbackID, res);
-			sendNativeUISuccess(buffer);
-		}
+		index++;
+	}
+	if(index == NATIVEUI_NUM_IMAGE_PROPERTIES)
+	{
+		return;
 	}
-	else if(0 == strcmp("maWidgetStackScreenPush", action))
+
+	// Make room for the handle.
+	while(mWidgetImages.size() <= widget)
 	{
-		MAWidgetHandle stackScreen =
-				stringToInteger(stream.getNext());
-		MAWidgetHandle newScreen =
-				stringToInteger(stream.getNext());
-		const char* callbackID = stream.getNext();
-		int res = maWidgetStackScreenPush(stackScreen, newScreen);
-		if(res < 0)
+		WidgetImages none;
+		for(int i = 0; i < NATIVEUI_NUM_IMAGE_PROPERTIES; i++)
 		{
-			sprintf(buffer,"'%s', %d", callbackID, res);
-			sendNativeUIError(buffer);
+			none.mImages[i] = 0;
 		}
-		else
+		mWidgetImages.add(none);
+	}
+
+	// Images that are not in the cache, like downloaded ones,
+	// are not kept. The new image is retained first, in case it
+	// is the same as the old one.
+	MAHandle image = atoi(value);
+	if(image <= 0 || !mImageCache->retain(image))
+	{
+		image = 0;
+	}
+	MAHandle oldImage = mWidgetImages[widget].mImages[index];
+	mWidgetImages[widget].mImages[index] = image;
+	if(oldImage > 0)
+	{
+		mImageCache->release(oldImage);
+	}
+}
+
+/**
+ * Release the images shown by a widget.
+ */
+void NativeUIMessageHandler::releaseWidgetImages(MAWidgetHandle widget)
+{
+	if(widget < 0 || widget >= mWidgetImages.size())
+	{
+		return;
+	}
+
+	for(int i = 0; i < NATIVEUI_NUM_IMAGE_PROPERTIES; i++)
+	{
+		MAHandle image = mWidgetImages[widget].mImages[i];
+		mWidgetImages[widget].mImages[i] = 0;
+		if(image > 0 && NULL != mImageCache)
 		{
-			sprintf(buffer,"'%s', %d", callbackID, res);
-			sendNativeUISuccess(buffer);
+			mImageCache->release(image);
 		}
 	}
-	else if(0 == strcmp("maWidgetStackScreenPop", action))
+}
+
+/**
+ * Creates a widget. The message has the widget type, the
+ * JavaScript ID of the widget, the widget reference assigned by
+ * JavaScript (0 for none), the callback ID and the number of
+ * property strings, followed by the property name/value pairs.
+ */
+void NativeUIMessageHandler::widgetCreate(Wormhole::MessageStream& stream)
+{
+	const char* widgetType = stream.getNext();
+	const char* widgetID = stream.getNext();
+	int widgetRef = stream.getNextInt();
+	const char* callbackID = stream.getNext();
+	int numParams = stream.getNextInt();
+
+	MAWidgetHandle widget = MAW_RES_ERROR;
+	if(widgetType != NULL)
+	{
+		MessageStatsTimer timer(mStats, MESSAGE_TIME_NATIVE);
+		widget = maWidgetCreate(widgetType);
+	}
+	widget = setClientWidget(widgetRef, widget);
+	MESSAGE_TRACE_RECORD(
+		MESSAGE_TRACE_NATIVEUI,
+		NATIVEUI_OP_WIDGET_CREATE,
+		widgetRef,
+		widget);
+
+	// Read the properties also when they are not used,
+	// to get to the end of the message.
+	for(int i = 0; i < numParams/2; i++)
 	{
-		MAWidgetHandle stackScreen =
-				stringToInteger(stream.getNext());
-		const char* callbackID = stream.getNext();
-		int res = maWidgetStackScreenPop(stackScreen);
-		if(res < 0)
+		const char* property = stream.getNext();
+		const char* value = stream.getNext();
+		if(widget > 0)
 		{
-			sprintf(buffer,"'%s', %d", callbackID, res);
-			sendNativeUIError(buffer);
+			int res;
+			{
+				MessageStatsTimer timer(mStats, MESSAGE_TIME_NATIVE);
+				res = maWidgetSetProperty(widget, property, value);
+			}
+			if(res >= 0)
+			{
+				mPropertyCache.put(widget, property, value);
+				setWidgetImage(widget, property, value);
+			}
 		}
-		else
+	}
+
+	if(widget <= 0)
+	{
+		// This is the only report of the failure, later
+		// operations on the reference fail with this code.
+		sendNativeUIError(callbackID, widget);
+	}
+	else
+	{
+		//We use a special callback for widget creation
+		MessageStatsTimer timer(mStats, MESSAGE_TIME_FORMAT);
+		mScripts->add(mScripts->newScript()
+			.append("mosync.nativeui.createCallback(")
+			.appendString(callbackID)
+			.append(", ")
+			.appendString(widgetID)
+			.append(", ")
+			.append(widget)
+			.append(")"));
+	}
+}
+
+void NativeUIMessageHandler::widgetDestroy(Wormhole::MessageStream& stream)
+{
+	int widgetRef = stream.getNextInt();
+	const char* callbackID = stream.getNext();
+
+	MAWidgetHandle widget = getWidgetHandle(widgetRef);
+	if(widget < 0)
+	{
+		sendNativeUIError(callbackID, widget);
+		return;
+	}
+
+	int res;
+	{
+		MessageStatsTimer timer(mStats, MESSAGE_TIME_NATIVE);
+		res = maWidgetDestroy(widget);
+	}
+	MESSAGE_TRACE_RECORD(
+		MESSAGE_TRACE_NATIVEUI,
+		NATIVEUI_OP_WIDGET_DESTROY,
+		widget,
+		res);
+	if(res >= 0)
+	{
+		// The handles can be reused by new widgets.
+		forgetWidgetTree(widget);
+	}
+
+	sendNativeUIResult(callbackID, res);
+}
+
+void NativeUIMessageHandler::widgetAddChild(Wormhole::MessageStream& stream)
+{
+	MAWidgetHandle parent = getWidgetHandle(stream.getNextInt());
+	MAWidgetHandle child = getWidgetHandle(stream.getNextInt());
+	const char* callbackID = stream.getNext();
+
+	if(parent < 0 || child < 0)
+	{
+		sendNativeUIError(callbackID, parent < 0 ? parent : child);
+		return;
+	}
+
+	int res;
+	{
+		MessageStatsTimer timer(mStats, MESSAGE_TIME_NATIVE);
+		res = maWidgetAddChild(parent, child);
+	}
+	MESSAGE_TRACE_RECORD(
+		MESSAGE_TRACE_NATIVEUI,
+		NATIVEUI_OP_WIDGET_ADD_CHILD,
+		child,
+		res);
+	if(res >= 0)
+	{
+		setWidgetParent(child, parent);
+	}
+	sendNativeUIResult(callbackID, res);
+}
+
+void NativeUIMessageHandler::widgetInsertChild(Wormhole::MessageStream& stream)
+{
+	MAWidgetHandle parent = getWidgetHandle(stream.getNextInt());
+	MAWidgetHandle child = getWidgetHandle(stream.getNextInt());
+	int index = stream.getNextInt();
+	const char* callbackID = stream.getNext();
+
+	if(parent < 0 || child < 0)
+	{
+		sendNativeUIError(callbackID, parent < 0 ? parent : child);
+		return;
+	}
+
+	int res;
+	{
+		MessageStatsTimer timer(mStats, MESSAGE_TIME_NATIVE);
+		res = maWidgetInsertChild(parent, child, index);
+	}
+	MESSAGE_TRACE_RECORD(
+		MESSAGE_TRACE_NATIVEUI,
+		NATIVEUI_OP_WIDGET_INSERT_CHILD,
+		child,
+		res);
+	if(res >= 0)
+	{
+		setWidgetParent(child, parent);
+	}
+	sendNativeUIResult(callbackID, res);
+}
+
+void NativeUIMessageHandler::widgetRemoveChild(Wormhole::MessageStream& stream)
+{
+	MAWidgetHandle child = getWidgetHandle(stream.getNextInt());
+	const char* callbackID = stream.getNext();
+
+	if(child < 0)
+	{
+		sendNativeUIError(callbackID, child);
+		return;
+	}
+
+	int res;
+	{
+		MessageStatsTimer timer(mStats, MESSAGE_TIME_NATIVE);
+		res = maWidgetRemoveChild(child);
+	}
+	MESSAGE_TRACE_RECORD(
+		MESSAGE_TRACE_NATIVEUI,
+		NATIVEUI_OP_WIDGET_REMOVE_CHILD,
+		child,
+		res);
+	if(res >= 0)
+	{
+		setWidgetParent(child, -1);
+	}
+	sendNativeUIResult(callbackID, res);
+}
+
+void NativeUIMessageHandler::widgetModalDialogShow(Wormhole::MessageStream& stream)
+{
+	MAWidgetHandle dialogHandle = getWidgetHandle(stream.getNextInt());
+	const char* callbackID = stream.getNext();
+
+	if(dialogHandle < 0)
+	{
+		sendNativeUIError(callbackID, dialogHandle);
+		return;
+	}
+
+	int res;
+	{
+		MessageStatsTimer timer(mStats, MESSAGE_TIME_NATIVE);
+		res = maWidgetModalDialogShow(dialogHandle);
+	}
+	MESSAGE_TRACE_RECORD(
+		MESSAGE_TRACE_NATIVEUI,
+		NATIVEUI_OP_WIDGET_MODAL_DIALOG_SHOW,
+		dialogHandle,
+		res);
+	sendNativeUIResult(callbackID, res);
+}
+
+void NativeUIMessageHandler::widgetModalDialogHide(Wormhole::MessageStream& stream)
+{
+	MAWidgetHandle dialogHandle = getWidgetHandle(stream.getNextInt());
+	const char* callbackID = stream.getNext();
+
+	if(dialogHandle < 0)
+	{
+		sendNativeUIError(callbackID, dialogHandle);
+		return;
+	}
+
+	int res;
+	{
+		MessageStatsTimer timer(mStats, MESSAGE_TIME_NATIVE);
+		res = maWidgetModalDialogHide(dialogHandle);
+	}
+	MESSAGE_TRACE_RECORD(
+		MESSAGE_TRACE_NATIVEUI,
+		NATIVEUI_OP_WIDGET_MODAL_DIALOG_HIDE,
+		dialogHandle,
+		res);
+	sendNativeUIResult(callbackID, res);
+}
+
+void NativeUIMessageHandler::widgetScreenShow(Wormhole::MessageStream& stream)
+{
+	MAWidgetHandle screenHandle = getWidgetHandle(stream.getNextInt());
+	const char* callbackID = stream.getNext();
+
+	if(screenHandle < 0)
+	{
+		sendNativeUIError(callbackID, screenHandle);
+		return;
+	}
+
+	int res;
+	{
+		MessageStatsTimer timer(mStats, MESSAGE_TIME_NATIVE);
+		res = maWidgetScreenShow(screenHandle);
+	}
+	MESSAGE_TRACE_RECORD(
+		MESSAGE_TRACE_NATIVEUI,
+		NATIVEUI_OP_WIDGET_SCREEN_SHOW,
+		screenHandle,
+		res);
+	sendNativeUIResult(callbackID, res);
+}
+
+void NativeUIMessageHandler::widgetStackScreenPush(Wormhole::MessageStream& stream)
+{
+	MAWidgetHandle stackScreen = getWidgetHandle(stream.getNextInt());
+	MAWidgetHandle newScreen = getWidgetHandle(stream.getNextInt());
+	const char* callbackID = stream.getNext();
+
+	if(stackScreen < 0 || newScreen < 0)
+	{
+		sendNativeUIError(
+			callbackID,
+			stackScreen < 0 ? stackScreen : newScreen);
+		return;
+	}
+
+	int res;
+	{
+		MessageStatsTimer timer(mStats, MESSAGE_TIME_NATIVE);
+		res = maWidgetStackScreenPush(stackScreen, newScreen);
+	}
+	MESSAGE_TRACE_RECORD(
+		MESSAGE_TRACE_NATIVEUI,
+		NATIVEUI_OP_WIDGET_STACK_SCREEN_PUSH,
+		newScreen,
+		res);
+	sendNativeUIResult(callbackID, res);
+}
+
+void NativeUIMessageHandler::widgetStackScreenPop(Wormhole::MessageStream& stream)
+{
+	MAWidgetHandle stackScreen = getWidgetHandle(stream.getNextInt());
+	const char* callbackID = stream.getNext();
+
+	if(stackScreen < 0)
+	{
+		sendNativeUIError(callbackID, stackScreen);
+		return;
+	}
+
+	int res;
+	{
+		MessageStatsTimer timer(mStats, MESSAGE_TIME_NATIVE);
+		res = maWidgetStackScreenPop(stackScreen);
+	}
+	MESSAGE_TRACE_RECORD(
+		MESSAGE_TRACE_NATIVEUI,
+		NATIVEUI_OP_WIDGET_STACK_SCREEN_POP,
+		stackScreen,
+		res);
+	sendNativeUIResult(callbackID, res);
+}
+
+void NativeUIMessageHandler::widgetSetProperty(Wormhole::MessageStream& stream)
+{
+	MAWidgetHandle widget = getWidgetHandle(stream.getNextInt());
+	const char *property = stream.getNext();
+	const char *value = stream.getNext();
+	const char* callbackID = stream.getNext();
+
+	if(widget < 0)
+	{
+		sendNativeUIError(callbackID, widget);
+		return;
+	}
+
+	// Skip the call if the property already has the value.
+	if(mPropertyCache.hasValue(widget, property, value))
+	{
+		sendNativeUIResult(callbackID, MAW_RES_OK);
+		return;
+	}
+
+	int res;
+	{
+		MessageStatsTimer timer(mStats, MESSAGE_TIME_NATIVE);
+		res = maWidgetSetProperty(widget, property, value);
+	}
+	MESSAGE_TRACE_RECORD(
+		MESSAGE_TRACE_NATIVEUI,
+		NATIVEUI_OP_WIDGET_SET_PROPERTY,
+		widget,
+		res);
+	if(res < 0)
+	{
+		mPropertyCache.remove(widget, property);
+	}
+	else
+	{
+		mPropertyCache.put(widget, property, value);
+		setWidgetImage(widget, property, value);
+	}
+	sendNativeUIResult(callbackID, res);
+}
+
+void NativeUIMessageHandler::widgetGetProperty(Wormhole::MessageStream& stream)
+{
+	char value[1024];
+	MAWidgetHandle widget = getWidgetHandle(stream.getNextInt());
+	const char* property = stream.getNext();
+	const char* callbackID = stream.getNext();
+
+	if(widget < 0)
+	{
+		sendNativeUIError(callbackID, widget);
+		return;
+	}
+
+	const char* cachedValue = mPropertyCache.get(widget, property);
+	if(cachedValue != NULL)
+	{
+		sendNativeUISuccess(callbackID, property, cachedValue);
+		return;
+	}
+
+	int res;
+	char* longValue = NULL;
+	{
+		MessageStatsTimer timer(mStats, MESSAGE_TIME_NATIVE);
+		res = maWidgetGetProperty(widget, property, value, sizeof(value));
+
+		// A value that does not fit is read again into a larger
+		// buffer, instead of being lost.
+		for(int size = 2 * sizeof(value);
+			res == MAW_RES_INVALID_STRING_BUFFER_SIZE
+				&& size <= NATIVEUI_MAX_PROPERTY_LENGTH;
+			size *= 2)
 		{
-			sprintf(buffer,"'%s', %d", callbackID, res);
-			sendNativeUISuccess(buffer);
+			char* buffer = (char*) realloc(longValue, size);
+			if(buffer == NULL)
+			{
+				break;
+			}
+			longValue = buffer;
+			res = maWidgetGetProperty(widget, property, longValue, size);
 		}
 	}
-	else if(0 == strcmp("maWidgetSetProperty", action))
+	MESSAGE_TRACE_RECORD(
+		MESSAGE_TRACE_NATIVEUI,
+		NATIVEUI_OP_WIDGET_GET_PROPERTY,
+		widget,
+		res);
+	const char* result = longValue != NULL ? longValue : value;
+
+	if(res >= 0)
+	{
+		mPropertyCache.put(widget, property, result);
+	}
+	if(res < 0)
+	{
+		sendNativeUIError(callbackID, res);
+	}
+	else
+	{
+		sendNativeUISuccess(callbackID, property, result);
+	}
+
+	free(longValue);
+}
+
+/**
+ * Creates a tree of widgets in one message. The nodes are sent
+ * in preorder, so a parent is always created before its
+ * children. Each node has a widget type, the JavaScript ID of
+ * the widget, the widget reference assigned by JavaScript (0 for
+ * none), the index of its parent node (-1 for none) and the
+ * number of property strings, followed by the property
+ * name/value pairs.
+ *
+ * The handles of all widgets are returned in a single call to
+ * mosync.nativeui.createTreeCallback, in node order. A node
+ * that could not be created gets an error code instead of a
+ * handle, and so do all the nodes below it.
+ */
+void NativeUIMessageHandler::widgetCreateTree(Wormhole::MessageStream& stream)
+{
+	const char* callbackID = stream.getNext();
+	int numNodes = stream.getNextInt();
+
+	if(numNodes < 0 || numNodes > NATIVEUI_MAX_TREE_NODES)
+	{
+		lprintfln("@@@ maWidgetCreateTree: bad node count %d", numNodes);
+		sendNativeUIResult(callbackID, MAW_RES_ERROR);
+		return;
+	}
+
+	mTreeHandles.clear();
+	for(int i = 0; i < numNodes; i++)
 	{
-		MAWidgetHandle widget =
-				stringToInteger(stream.getNext());
-		const char *property = stream.getNext();
-		const char *value = stream.getNext();
-		const char* callbackID = stream.getNext();
-		int res = maWidgetSetProperty(widget, property, value);
-		lprintfln("SetProperty: %d, %s, %s\n", widget, property, value);
-		if(res < 0)
+		const char* widgetType = stream.getNext();
+		// The JavaScript ID of the widget, only used by
+		// createTreeCallback.
+		stream.getNext();
+		int widgetRef = stream.getNextInt();
+		int parentIndex = stream.getNextInt();
+		int numParams = stream.getNextInt();
+
+		// The parent must come before the child.
+		MAWidgetHandle parent = 0;
+		MAWidgetHandle widget = 0;
+		if(parentIndex >= i || widgetType == NULL)
 		{
-			sprintf(buffer,"'%s', %d", callbackID, res);
-			sendNativeUIError(buffer);
+			widget = MAW_RES_ERROR;
 		}
-		else
+		else if(parentIndex >= 0)
 		{
-			sprintf(buffer,"'%s', %d", callbackID, res);
-			sendNativeUISuccess(buffer);
+			parent = mTreeHandles[parentIndex];
+			if(parent <= 0)
+			{
+				// Pass the error of the parent on.
+				widget = parent;
+			}
+		}
+
+		if(widget == 0)
+		{
+			MessageStatsTimer timer(mStats, MESSAGE_TIME_NATIVE);
+			widget = maWidgetCreate(widgetType);
 		}
-	}
-	else if(0 == strcmp("maWidgetGetProperty", action))
-	{
-		char value[1024];
-		MAWidgetHandle widget =
-				stringToInteger(stream.getNext());
-		const char* property = stream.getNext();
-		const char* callbackID = stream.getNext();
 
-		int res = maWidgetGetProperty(widget, property, value, 1024);
-		if(res < 0)
+		// Read the properties also when they are not used,
+		// to get to the next node.
+		for(int j = 0; j < numParams/2; j++)
 		{
-			sprintf(buffer,"'%s', %d", callbackID, res);
-			sendNativeUIError(buffer);
+			const char* property = stream.getNext();
+			const char* value = stream.getNext();
+			if(widget > 0)
+			{
+				int res;
+				{
+					MessageStatsTimer timer(mStats, MESSAGE_TIME_NATIVE);
+					res = maWidgetSetProperty(widget, property, value);
+				}
+				if(res >= 0)
+				{
+					mPropertyCache.put(widget, property, value);
+					setWidgetImage(widget, property, value);
+				}
+			}
 		}
-		else
+
+		if(widget > 0 && parent > 0)
 		{
-			sprintf(buffer,"'%s', '%s', '%s'", callbackID, property, value);
-			sendNativeUISuccess(buffer);
+			MessageStatsTimer timer(mStats, MESSAGE_TIME_NATIVE);
+			int res = maWidgetAddChild(parent, widget);
+			if(res < 0)
+			{
+				maWidgetDestroy(widget);
+				forgetWidgetTree(widget);
+				widget = res;
+			}
+			else
+			{
+				setWidgetParent(widget, parent);
+			}
 		}
-	}
 
-	// Tell the WebView that we have processed the stream, so that
-	// it can send the next one.
+		widget = setClientWidget(widgetRef, widget);
+		MESSAGE_TRACE_RECORD(
+			MESSAGE_TRACE_NATIVEUI,
+			NATIVEUI_OP_WIDGET_CREATE_TREE,
+			widgetRef,
+			widget);
 
-	char replyScript[256];
-	const char * mosyncCallBackId = stream.getNext();
-	if(mosyncCallBackId != NULL)
-	{
-		sprintf(
-				replyScript,
-				"mosync.bridge.reply(%s)",
-				mosyncCallBackId);
-		mWebView->callJS(replyScript);
+		mTreeHandles.add(widget);
 	}
 
+	// Send all handles in one callback.
+	MessageStatsTimer timer(mStats, MESSAGE_TIME_FORMAT);
+	ScriptBuilder& script = mScripts->newScript()
+		.append("mosync.nativeui.createTreeCallback(")
+		.appendString(callbackID)
+		.append(", [");
+	for(int i = 0; i < mTreeHandles.size(); i++)
+	{
+		if(i > 0)
+		{
+			script.append(",", 1);
+		}
+		script.append(mTreeHandles[i]);
+	}
+	script.append("])", 2);
+	mScripts->add(script);
 }
 
-
 /**
  * Handles custom events generated by NativeUI Widgets.
  */
 void NativeUIMessageHandler::customEvent(const MAEvent& event)
 {
-	char buffer[128];
-
 	if(event.type == EVENT_TYPE_WIDGET)
 	{
 		MAWidgetEventData *data = (MAWidgetEventData*)event.data;
@@ -333,98 +1025,369 @@ void NativeUIMessageHandler::customEvent(const MAEvent& event)
 		{
 			return;
 		}
+
+		// The user may have changed a property value.
+		mPropertyCache.invalidateForEvent(widget, data->eventType);
+
+		// Drop the event early if nothing listens to it.
+		if(!isEventSubscribed(widget, data->eventType))
+		{
+			return;
+		}
+
 		int firstParameter = data->dayOfMonth;
 		int secondParameter = data->month;
 		int thirdParameter = data->year;
 
-		char *eventType;
 		// Translate the event type to JavaScript eventTypes
-		switch(data->eventType)
+		const char* eventType = getEventTypeName(data->eventType);
+
+		// High frequency events are collected, and only the
+		// latest one for each widget and type is sent.
+		if(mEventCoalescingWindow > 0 && isCoalescedEvent(data->eventType))
 		{
-			case MAW_EVENT_POINTER_PRESSED:
-				eventType = "PointerPressed";
-				break;
-			case MAW_EVENT_POINTER_RELEASED:
-				eventType = "PointerReleased";
-				break;
-			case MAW_EVENT_CONTENT_LOADED:
-				eventType = "ContentLoaded";
-				break;
-			case MAW_EVENT_CLICKED:
-				eventType = "Clicked";
-				break;
-			case MAW_EVENT_ITEM_CLICKED:
-				eventType = "ItemClicked";
-				break;
-			case MAW_EVENT_TAB_CHANGED:
-				eventType = "TabChanged";
-				break;
-			case MAW_EVENT_GL_VIEW_READY:
-				eventType = "GLViewReady";
-				break;
-			case MAW_EVENT_WEB_VIEW_URL_CHANGED:
-				eventType = "WebViewURLChanged";
-				break;
-			case MAW_EVENT_STACK_SCREEN_POPPED:
-				eventType = "StackScreenPopped";
-				break;
-			case MAW_EVENT_SLIDER_VALUE_CHANGED:
-				eventType = "SliderValueChanged";
-				break;
-			case MAW_EVENT_DATE_PICKER_VALUE_CHANGED:
-				eventType = "DatePickerValueChanged";
-				break;
-			case MAW_EVENT_NUMBER_PICKER_VALUE_CHANGED:
-				eventType = "NumberPickerValueChanged";
-				break;
-			case MAW_EVENT_VIDEO_STATE_CHANGED:
-				eventType = "VideoStateChanged";
-				break;
-			case MAW_EVENT_EDIT_BOX_EDITING_DID_BEGIN:
-				eventType = "EditBoxEditingDidBegin";
-				break;
-			case MAW_EVENT_EDIT_BOX_EDITING_DID_END:
-				eventType = "EditBoxEditingDidEnd";
-				break;
-			case MAW_EVENT_EDIT_BOX_TEXT_CHANGED:
-				eventType = "EditBoxTextChanged";
-				break;
-			case MAW_EVENT_EDIT_BOX_RETURN:
-				eventType = "EditBoxReturn";
-				break;
-			case MAW_EVENT_WEB_VIEW_CONTENT_LOADING:
-				eventType = "WebViewContentLoading";
-				break;
-			case MAW_EVENT_WEB_VIEW_HOOK_INVOKED:
-				eventType = "WebViewHookInvoked";
-				break;
-			case MAW_EVENT_DIALOG_DISMISSED:
-				eventType = "DialogDismissed";
-				break;
+			for(int i = 0; i < mPendingEvents.size(); i++)
+			{
+				PendingEvent& pending = mPendingEvents[i];
+				if(pending.mWidget == widget
+					&& pending.mEventType == data->eventType)
+				{
+					pending.mFirstParameter = firstParameter;
+					pending.mSecondParameter = secondParameter;
+					pending.mThirdParameter = thirdParameter;
+					return;
+				}
+			}
+
+			PendingEvent pending;
+			pending.mWidget = widget;
+			pending.mEventType = data->eventType;
+			pending.mEventTypeName = eventType;
+			pending.mFirstParameter = firstParameter;
+			pending.mSecondParameter = secondParameter;
+			pending.mThirdParameter = thirdParameter;
+			mPendingEvents.add(pending);
+
+			if(!mEventTimerRunning)
+			{
+				mEventTimerRunning = true;
+				Environment::getEnvironment().addTimer(
+					this,
+					mEventCoalescingWindow,
+					1);
+			}
+			return;
 		}
-		sprintf(buffer,
-				"mosync.nativeui.event(%d, \"%s\", %d, %d, %d)",
-				widget,
-				eventType,
-				firstParameter,
-				secondParameter,
-				thirdParameter);
-		mWebView->callJS(buffer);
+
+		// Keep the order of events, collected events that
+		// arrived before this one are sent first.
+		mScripts->begin();
+		flushWidgetEvents();
+		sendWidgetEvent(
+			widget,
+			eventType,
+			firstParameter,
+			secondParameter,
+			thirdParameter);
+		mScripts->end();
+	}
+}
+
+/**
+ * Subscribes to an event type of a widget. Events that no one
+ * has subscribed to are not sent to JavaScript.
+ */
+void NativeUIMessageHandler::widgetSubscribeEvent(Wormhole::MessageStream& stream)
+{
+	MAWidgetHandle widget = getWidgetHandle(stream.getNextInt());
+	const char* eventTypeName = stream.getNext();
+	const char* callbackID = stream.getNext();
+
+	int eventType = getEventType(eventTypeName);
+	if(widget < 0)
+	{
+		sendNativeUIError(callbackID, widget);
+		return;
+	}
+	if(eventType < 0)
+	{
+		sendNativeUIResult(callbackID, MAW_RES_ERROR);
+		return;
+	}
+
+	// Make room for the handle.
+	while(mEventSubscriptions.size() <= widget)
+	{
+		mEventSubscriptions.add(0);
+	}
+
+	// Types that do not fit in the mask are always sent.
+	if(eventType < 32)
+	{
+		mEventSubscriptions[widget] |= 1 << eventType;
+	}
+
+	sendNativeUIResult(callbackID, MAW_RES_OK);
+}
+
+/**
+ * Unsubscribes from an event type of a widget, when the last
+ * JavaScript listener for it has been removed.
+ */
+void NativeUIMessageHandler::widgetUnsubscribeEvent(Wormhole::MessageStream& stream)
+{
+	MAWidgetHandle widget = getWidgetHandle(stream.getNextInt());
+	const char* eventTypeName = stream.getNext();
+	const char* callbackID = stream.getNext();
+
+	int eventType = getEventType(eventTypeName);
+	if(widget < 0)
+	{
+		sendNativeUIError(callbackID, widget);
+		return;
+	}
+	if(eventType < 0)
+	{
+		sendNativeUIResult(callbackID, MAW_RES_ERROR);
+		return;
+	}
+
+	if(eventType < 32 && widget < mEventSubscriptions.size())
+	{
+		mEventSubscriptions[widget] &= ~(1 << eventType);
 	}
+
+	sendNativeUIResult(callbackID, MAW_RES_OK);
 }
 
+/**
+ * @return true if JavaScript listens to the event type of
+ * the widget.
+ */
+bool NativeUIMessageHandler::isEventSubscribed(
+	MAWidgetHandle widget,
+	int eventType)
+{
+	if(eventType < 0 || eventType >= 32)
+	{
+		return true;
+	}
+	if(widget < 0 || widget >= mEventSubscriptions.size())
+	{
+		return false;
+	}
+	return 0 != (mEventSubscriptions[widget] & (1 << eventType));
+}
+
+/**
+ * @return The JavaScript name of a MAW_EVENT type.
+ */
+const char* NativeUIMessageHandler::getEventTypeName(int eventType)
+{
+	for(int i = 0; i < sNumWidgetEventTypes; i++)
+	{
+		if(sWidgetEventTypes[i].mType == eventType)
+		{
+			return sWidgetEventTypes[i].mName;
+		}
+	}
+	return "Unknown";
+}
 
-void NativeUIMessageHandler::sendNativeUIError(const char *data)
+/**
+ * @return The MAW_EVENT type with the given JavaScript name,
+ * -1 if there is none.
+ */
+int NativeUIMessageHandler::getEventType(const char* eventTypeName)
 {
-	char script[1024];
-	sprintf(script, "mosync.nativeui.error(%s)", data);
-	mWebView->callJS(script);
+	if(eventTypeName == NULL)
+	{
+		return -1;
+	}
+	for(int i = 0; i < sNumWidgetEventTypes; i++)
+	{
+		if(0 == strcmp(sWidgetEventTypes[i].mName, eventTypeName))
+		{
+			return sWidgetEventTypes[i].mType;
+		}
+	}
+	return -1;
 }
 
-void NativeUIMessageHandler::sendNativeUISuccess(const char *data)
+/**
+ * Sends the coalesced widget events when the coalescing
+ * window has passed.
+ */
+void NativeUIMessageHandler::runTimerEvent()
 {
-	char script[1024];
-	sprintf(script, "mosync.nativeui.success(%s)", data);
-	mWebView->callJS(script);
+	// The timer runs once.
+	mEventTimerRunning = false;
+	flushWidgetEvents();
 }
 
+/**
+ * Set the time during which high frequency events are
+ * collected before they are sent to JavaScript.
+ */
+void NativeUIMessageHandler::setEventCoalescingWindow(int milliseconds)
+{
+	mEventCoalescingWindow = milliseconds;
+	if(milliseconds <= 0)
+	{
+		flushWidgetEvents();
+	}
+}
+
+/**
+ * Send the collected widget events to JavaScript.
+ */
+void NativeUIMessageHandler::flushWidgetEvents()
+{
+	if(mEventTimerRunning)
+	{
+		Environment::getEnvironment().removeTimer(this);
+		mEventTimerRunning = false;
+	}
+
+	if(mPendingEvents.size() == 0)
+	{
+		return;
+	}
+
+	// All events are evaluated with one call.
+	mScripts->begin();
+	for(int i = 0; i < mPendingEvents.size(); i++)
+	{
+		PendingEvent& pending = mPendingEvents[i];
+		sendWidgetEvent(
+			pending.mWidget,
+			pending.mEventTypeName,
+			pending.mFirstParameter,
+			pending.mSecondParameter,
+			pending.mThirdParameter);
+	}
+	mPendingEvents.clear();
+	mScripts->end();
+}
+
+/**
+ * Send a widget event to JavaScript.
+ */
+void NativeUIMessageHandler::sendWidgetEvent(
+	MAWidgetHandle widget,
+	const char* eventType,
+	int firstParameter,
+	int secondParameter,
+	int thirdParameter)
+{
+	MessageStatsTimer timer(mStats, MESSAGE_TIME_FORMAT);
+	mScripts->add(mScripts->newScript()
+		.append("mosync.nativeui.event(")
+		.append(widget)
+		.append(", \"")
+		.append(eventType)
+		.append("\", ")
+		.append(firstParameter)
+		.append(", ")
+		.append(secondParameter)
+		.append(", ")
+		.append(thirdParameter)
+		.append(")"));
+}
+
+/**
+ * @return true if events of the given MAW_EVENT type are
+ * collected and only the latest one is sent.
+ */
+bool NativeUIMessageHandler::isCoalescedEvent(int eventType)
+{
+	switch(eventType)
+	{
+		case MAW_EVENT_POINTER_PRESSED:
+		case MAW_EVENT_SLIDER_VALUE_CHANGED:
+		case MAW_EVENT_DATE_PICKER_VALUE_CHANGED:
+		case MAW_EVENT_NUMBER_PICKER_VALUE_CHANGED:
+		case MAW_EVENT_EDIT_BOX_TEXT_CHANGED:
+			return true;
+		default:
+			return false;
+	}
+}
+
+
+void NativeUIMessageHandler::sendNativeUIError(
+	const char* callbackID,
+	int res)
+{
+	MessageStatsTimer timer(mStats, MESSAGE_TIME_FORMAT);
+	mScripts->add(mScripts->newScript()
+		.append("mosync.nativeui.error(")
+		.appendString(callbackID)
+		.append(", ")
+		.append(res)
+		.append(")"));
+}
+
+/**
+ * @return true if the callback ID has the "!" prefix, which
+ * JavaScript adds when there is no success callback, so only
+ * failures are reported.
+ */
+bool NativeUIMessageHandler::isNoAck(const char* callbackID)
+{
+	return callbackID != NULL && callbackID[0] == '!';
+}
+
+void NativeUIMessageHandler::sendNativeUISuccess(
+	const char* callbackID,
+	int res)
+{
+	if(isNoAck(callbackID))
+	{
+		return;
+	}
+
+	MessageStatsTimer timer(mStats, MESSAGE_TIME_FORMAT);
+	mScripts->add(mScripts->newScript()
+		.append("mosync.nativeui.success(")
+		.appendString(callbackID)
+		.append(", ")
+		.append(res)
+		.append(")"));
+}
+
+void NativeUIMessageHandler::sendNativeUISuccess(
+	const char* callbackID,
+	const char* property,
+	const char* value)
+{
+	if(isNoAck(callbackID))
+	{
+		return;
+	}
+
+	MessageStatsTimer timer(mStats, MESSAGE_TIME_FORMAT);
+
+	// The value can be long and contain any characters, it
+	// is escaped and appended in one go.
+	mScripts->add(mScripts->newScript()
+		.append("mosync.nativeui.success(")
+		.appendString(callbackID)
+		.append(", ")
+		.appendString(property)
+		.append(", ")
+		.appendString(value)
+		.append(")"));
+}
+
+void NativeUIMessageHandler::sendNativeUIResult(const char* callbackID, int res)
+{
+	if(res < 0)
+	{
+		sendNativeUIError(callbackID, res);
+	}
+	else
+	{
+		sendNativeUISuccess(callbackID, res);
+	}
+}
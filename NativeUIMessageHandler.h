@@ -29,20 +29,84 @@ MA 02110-1301, USA.
 #include <Wormhole/WebViewMessage.h>
 #include <NativeUI/WebView.h>
 #include <MAUtil/String.h>
+#include <MAUtil/Vector.h>
 #include "MessageStream.h"
+#include "MessageDispatcher.h"
+#include "MessageStats.h"
+#include "ScriptBatch.h"
+#include "WidgetPropertyCache.h"
+#include "ImageCache.h"
+
+/**
+ * Opcodes of the NativeUI actions, used instead of the action
+ * names in binary message streams. Must match the table
+ * mosync.nativeui.opcodes in mosync-nativeui.js.
+ */
+enum NativeUIOpcode
+{
+	NATIVEUI_OP_WIDGET_CREATE = 1,
+	NATIVEUI_OP_WIDGET_DESTROY = 2,
+	NATIVEUI_OP_WIDGET_ADD_CHILD = 3,
+	NATIVEUI_OP_WIDGET_INSERT_CHILD = 4,
+	NATIVEUI_OP_WIDGET_REMOVE_CHILD = 5,
+	NATIVEUI_OP_WIDGET_MODAL_DIALOG_SHOW = 6,
+	NATIVEUI_OP_WIDGET_MODAL_DIALOG_HIDE = 7,
+	NATIVEUI_OP_WIDGET_SCREEN_SHOW = 8,
+	NATIVEUI_OP_WIDGET_STACK_SCREEN_PUSH = 9,
+	NATIVEUI_OP_WIDGET_STACK_SCREEN_POP = 10,
+	NATIVEUI_OP_WIDGET_SET_PROPERTY = 11,
+	NATIVEUI_OP_WIDGET_GET_PROPERTY = 12,
+	NATIVEUI_OP_WIDGET_CREATE_TREE = 13,
+	NATIVEUI_OP_WIDGET_SUBSCRIBE_EVENT = 14,
+	NATIVEUI_OP_WIDGET_UNSUBSCRIBE_EVENT = 15
+};
+
+/**
+ * Maximum number of widgets created by one maWidgetCreateTree.
+ */
+#define NATIVEUI_MAX_TREE_NODES 4096
+
+/**
+ * Maximum number of widget IDs assigned by JavaScript, see
+ * NativeUIMessageHandler::getWidgetHandle().
+ */
+#define NATIVEUI_MAX_CLIENT_WIDGETS (64 * 1024)
+
+/**
+ * Number of widget properties whose value is an image handle.
+ */
+#define NATIVEUI_NUM_IMAGE_PROPERTIES 3
+
+/**
+ * Maximum length of a property value read by maWidgetGetProperty.
+ */
+#define NATIVEUI_MAX_PROPERTY_LENGTH (64 * 1024)
+
+/**
+ * Default time in milliseconds during which high frequency
+ * widget events are collected before they are sent to
+ * JavaScript, see setEventCoalescingWindow().
+ */
+#define NATIVEUI_EVENT_COALESCING_WINDOW 50
+
 /**
  * Class that implements JavaScript calls.
  *
  * The JavaScript side is in file extendedbridge.js.
  */
 class NativeUIMessageHandler:
-	public MAUtil::CustomEventListener
+	public MAUtil::CustomEventListener,
+	public MAUtil::TimerListener
 {
 public:
 	/**
 	 * Constructor.
+	 * @param webView The WebView that runs the JavaScript code.
+	 * @param scripts Batch used for all calls to JavaScript.
 	 */
-	NativeUIMessageHandler(NativeUI::WebView* webView);
+	NativeUIMessageHandler(
+		NativeUI::WebView* webView,
+		Wormhole::ScriptBatch* scripts);
 
 	/**
 	 * Destructor.
@@ -60,30 +124,333 @@ public:
 	 */
 	virtual void customEvent(const MAEvent&);
 
+	/**
+	 * Sends the coalesced widget events when the coalescing
+	 * window has passed.
+	 */
+	virtual void runTimerEvent();
+
+	/**
+	 * Set the time during which high frequency events, like
+	 * SliderValueChanged and EditBoxTextChanged, are collected
+	 * before they are sent to JavaScript. Only the latest event
+	 * of each type for each widget is sent. Other events are
+	 * sent at once, after any collected events.
+	 *
+	 * @param milliseconds The window, 0 sends all events at once.
+	 */
+	void setEventCoalescingWindow(int milliseconds);
+
+	/**
+	 * Send the collected widget events to JavaScript.
+	 */
+	void flushWidgetEvents();
+
+	/**
+	 * @return The number of messages with an unknown action.
+	 */
+	int getUnknownActionCount();
+
+	/**
+	 * Set the statistics that the actions are counted in. The
+	 * time spent in maWidget* calls and building replies is
+	 * also added to the statistics.
+	 * @param stats The statistics, NULL for none.
+	 */
+	void setStats(Wormhole::MessageStats* stats);
+
+	/**
+	 * @return The cache of widget property values, which
+	 * holds the hit and miss counters.
+	 */
+	WidgetPropertyCache& getPropertyCache();
 
+	/**
+	 * Set the cache of the images that are loaded from
+	 * JavaScript. An image that is set as the image, icon or
+	 * background image of a widget is kept in use until the
+	 * property is set to another image or the widget is
+	 * destroyed.
+	 * @param imageCache The cache, NULL for none.
+	 */
+	void setImageCache(ImageCache* imageCache);
 
 private:
+	/**
+	 * Handlers for the NativeUI actions. Each handler reads the
+	 * parameters of its action from the stream.
+	 */
+	void widgetCreate(Wormhole::MessageStream& stream);
+	void widgetDestroy(Wormhole::MessageStream& stream);
+	void widgetAddChild(Wormhole::MessageStream& stream);
+	void widgetInsertChild(Wormhole::MessageStream& stream);
+	void widgetRemoveChild(Wormhole::MessageStream& stream);
+	void widgetModalDialogShow(Wormhole::MessageStream& stream);
+	void widgetModalDialogHide(Wormhole::MessageStream& stream);
+	void widgetScreenShow(Wormhole::MessageStream& stream);
+	void widgetStackScreenPush(Wormhole::MessageStream& stream);
+	void widgetStackScreenPop(Wormhole::MessageStream& stream);
+	void widgetSetProperty(Wormhole::MessageStream& stream);
+	void widgetGetProperty(Wormhole::MessageStream& stream);
+	void widgetCreateTree(Wormhole::MessageStream& stream);
+	void widgetSubscribeEvent(Wormhole::MessageStream& stream);
+	void widgetUnsubscribeEvent(Wormhole::MessageStream& stream);
+
+	/**
+	 * Get the native handle of a widget reference sent from
+	 * JavaScript. A reference is either a native handle, or a
+	 * negative ID that JavaScript assigned to the widget when it
+	 * asked for it to be created, so that it can use the widget
+	 * without waiting for the handle.
+	 *
+	 * @param widgetRef The widget reference.
+	 * @return The native handle, or a negative error code if the
+	 * widget could not be created or does not exist.
+	 */
+	MAWidgetHandle getWidgetHandle(int widgetRef);
+
+	/**
+	 * Store the result of creating a widget that JavaScript
+	 * assigned an ID to.
+	 *
+	 * @param widgetRef The ID assigned by JavaScript, nothing is
+	 * stored if it is not negative.
+	 * @param widget The handle of the widget, or the error code
+	 * if it could not be created.
+	 * @return The handle of the widget, or a negative error code.
+	 */
+	MAWidgetHandle setClientWidget(int widgetRef, MAWidgetHandle widget);
+
+	/**
+	 * Remember the parent of a widget, so that its state can be
+	 * dropped when the parent is destroyed.
+	 *
+	 * @param widget The child widget.
+	 * @param parent The parent, -1 if the widget was removed
+	 * from its parent.
+	 */
+	void setWidgetParent(MAWidgetHandle widget, MAWidgetHandle parent);
+
+	/**
+	 * Drop the state kept for a widget that has been destroyed,
+	 * and for all widgets below it, which the platform destroys
+	 * with it. Must be called since handles are reused.
+	 *
+	 * @param widget The destroyed widget.
+	 */
+	void forgetWidgetTree(MAWidgetHandle widget);
+
+	/**
+	 * Keep the image set as a property of a widget in use, and
+	 * release the image the property had before. Call after the
+	 * property has been set successfully. Does nothing if the
+	 * value of the property is not an image.
+	 */
+	void setWidgetImage(
+		MAWidgetHandle widget,
+		const char* property,
+		const char* value);
+
+	/**
+	 * Release the images shown by a widget.
+	 */
+	void releaseWidgetImages(MAWidgetHandle widget);
+
+	/**
+	 * Send the result of an operation to the success callback
+	 * if res is not negative, else to the error callback.
+	 *
+	 * @param callbackID JavaScript ID of the callback.
+	 * @param res The result code of the operation.
+	 */
+	void sendNativeUIResult(const char* callbackID, int res);
+
+	/**
+	 * Send a widget event to JavaScript.
+	 */
+	void sendWidgetEvent(
+		MAWidgetHandle widget,
+		const char* eventType,
+		int firstParameter,
+		int secondParameter,
+		int thirdParameter);
+
+	/**
+	 * @return true if events of the given MAW_EVENT type are
+	 * collected and only the latest one is sent.
+	 */
+	static bool isCoalescedEvent(int eventType);
+
+	/**
+	 * @return true if JavaScript listens to the event type of
+	 * the widget.
+	 */
+	bool isEventSubscribed(MAWidgetHandle widget, int eventType);
+
+	/**
+	 * @return The JavaScript name of a MAW_EVENT type.
+	 */
+	static const char* getEventTypeName(int eventType);
+
+	/**
+	 * @return The MAW_EVENT type with the given JavaScript name,
+	 * -1 if there is none.
+	 */
+	static int getEventType(const char* eventTypeName);
+
 	/**
 	 * A Pointer to the main webview
 	 * Used for communicating with NativeUI
 	 */
 	NativeUI::WebView* mWebView;
 
+	/**
+	 * Batch used for all calls to JavaScript, so that the
+	 * replies to a message stream are evaluated together.
+	 */
+	Wormhole::ScriptBatch* mScripts;
+
+	/**
+	 * Maps action names to the handler methods.
+	 */
+	Wormhole::MessageDispatcher<NativeUIMessageHandler> mDispatcher;
+
+	/**
+	 * Statistics of the actions, NULL if none.
+	 */
+	Wormhole::MessageStats* mStats;
+
+	/**
+	 * Last known values of widget properties, used to skip
+	 * sets that do not change anything and to answer gets.
+	 */
+	WidgetPropertyCache mPropertyCache;
+
+	/**
+	 * Cache of the images loaded from JavaScript, NULL if none.
+	 */
+	ImageCache* mImageCache;
+
+	/**
+	 * The cached images a widget shows, one for each property
+	 * whose value is an image handle, 0 for none.
+	 */
+	struct WidgetImages
+	{
+		MAHandle mImages[NATIVEUI_NUM_IMAGE_PROPERTIES];
+	};
+
+	/**
+	 * The images of the widgets, indexed by widget handle.
+	 */
+	MAUtil::Vector<WidgetImages> mWidgetImages;
+
+	/**
+	 * Handles of the widgets that JavaScript assigned IDs to,
+	 * indexed by -1 - ID. An element holds the error code if the
+	 * widget could not be created or has been destroyed, and 0 if
+	 * no widget has been created with the ID.
+	 */
+	MAUtil::Vector<MAWidgetHandle> mClientWidgets;
+
+	/**
+	 * IDs that JavaScript assigned to the widgets, indexed by
+	 * widget handle, so that the IDs of destroyed widgets can be
+	 * found. An element is 0 if the widget has no ID.
+	 */
+	MAUtil::Vector<int> mWidgetRefs;
+
+	/**
+	 * Handles of the widgets created by maWidgetCreateTree,
+	 * in the order of the nodes. Reused between calls.
+	 */
+	MAUtil::Vector<MAWidgetHandle> mTreeHandles;
+
+	/**
+	 * Parents of the widgets, indexed by widget handle. An
+	 * element is -1 if the widget has no parent.
+	 */
+	MAUtil::Vector<MAWidgetHandle> mWidgetParents;
+
+	/**
+	 * Handles of the widgets below a destroyed widget, used by
+	 * forgetWidgetTree(). Reused between calls.
+	 */
+	MAUtil::Vector<MAWidgetHandle> mDestroyedWidgets;
+
+	/**
+	 * Event types that JavaScript listens to, indexed by widget
+	 * handle. Bit n is set if there is a listener for the
+	 * MAW_EVENT type n.
+	 */
+	MAUtil::Vector<int> mEventSubscriptions;
+
+	/**
+	 * A widget event waiting to be sent.
+	 */
+	struct PendingEvent
+	{
+		MAWidgetHandle mWidget;
+		int mEventType;
+		const char* mEventTypeName;
+		int mFirstParameter;
+		int mSecondParameter;
+		int mThirdParameter;
+	};
+
+	/**
+	 * Collected high frequency events, in the order in which
+	 * the first event of each widget and type arrived.
+	 */
+	MAUtil::Vector<PendingEvent> mPendingEvents;
+
+	/**
+	 * Time in milliseconds during which events are collected.
+	 */
+	int mEventCoalescingWindow;
+
+	/**
+	 * True while the timer that flushes the events is running.
+	 */
+	bool mEventTimerRunning;
+
+	/**
+	 * @return true if the callback ID asks for failures only.
+	 */
+	static bool isNoAck(const char* callbackID);
+
 	/**
 	 * General wrapper for NativeUI success callback.
 	 * If an operation is successful this function should be called.
+	 * Nothing is sent if the callback ID starts with "!".
 	 *
-	 * @param data the data that should be passed to the callback function
+	 * @param callbackID JavaScript ID of the callback.
+	 * @param res The result code of the operation.
 	 */
-	void sendNativeUISuccess(const char* data);
+	void sendNativeUISuccess(const char* callbackID, int res);
+
+	/**
+	 * General wrapper for NativeUI success callback, for
+	 * operations that return a property value.
+	 * Nothing is sent if the callback ID starts with "!".
+	 *
+	 * @param callbackID JavaScript ID of the callback.
+	 * @param property Name of the property.
+	 * @param value Value of the property.
+	 */
+	void sendNativeUISuccess(
+		const char* callbackID,
+		const char* property,
+		const char* value);
 
 	/**
 	 * General wrapper for NativeUI error callback.
-	 * If an operation is successful this function should be called.
+	 * If an operation fails this function should be called.
 	 *
-	 * @param data the data that should be passed to the callback function
+	 * @param callbackID JavaScript ID of the callback.
+	 * @param res The error code of the operation.
 	 */
-	void sendNativeUIError(const char* data);
+	void sendNativeUIError(const char* callbackID, int res);
 
 };
 
@@ -25,6 +25,8 @@ MA 02110-1301, USA.
 
 
 #include <mastdlib.h> // C string conversion functions
+#include <mastring.h> // C string functions
+#include <maheap.h> // C memory allocation
 #include <conprint.h>
 #include "ResourceMessageHandler.h"
 #include "MAHeaders.h"
@@ -37,12 +39,32 @@ using namespace Wormhole; // Class WebAppMoblet
 /**
  * Constructor.
  */
-ResourceMessageHandler::ResourceMessageHandler(NativeUI::WebView* webView) :
-	mWebView(webView)
+ResourceMessageHandler::ResourceMessageHandler(
+	NativeUI::WebView* webView,
+	Wormhole::ScriptBatch* scripts) :
+	mDispatcher(this),
+	mDownloadPool(this),
+	mFileLoader(this, &mDataPool),
+	mWebView(webView),
+	mScripts(scripts)
 {
-    // A new instance of ImageDownloader is created.
-      mImageDownloader = new ImageDownloader();
-      mImageDownloader->addDownloadListener(this);
+	// Register the handlers for the actions sent from JavaScript.
+	mDispatcher.add(
+		"loadImage",
+		RESOURCE_OP_LOAD_IMAGE,
+		&ResourceMessageHandler::loadImage);
+	mDispatcher.add(
+		"loadRemoteImage",
+		RESOURCE_OP_LOAD_REMOTE_IMAGE,
+		&ResourceMessageHandler::loadRemoteImage);
+	mDispatcher.add(
+		"releaseImage",
+		RESOURCE_OP_RELEASE_IMAGE,
+		&ResourceMessageHandler::releaseImage);
+	mDispatcher.add(
+		"loadImageAsync",
+		RESOURCE_OP_LOAD_IMAGE_ASYNC,
+		&ResourceMessageHandler::loadImageAsync);
 }
 
 /**
@@ -62,36 +84,293 @@ ResourceMessageHandler::~ResourceMessageHandler()
  */
 bool ResourceMessageHandler::handleMessage(Wormhole::MessageStream& stream)
 {
+	return mDispatcher.dispatchNext(stream);
+}
 
-	char buffer[128];
-	const char * action = stream.getNext();
-	if(0 == strcmp("loadImage", action))
+/**
+ * Start loading the images listed in a manifest file into
+ * the image cache, in the background.
+ */
+int ResourceMessageHandler::preloadImages(const char* manifestPath)
+{
+	const char* localPath = getLocalPath();
+	if(NULL == localPath)
 	{
-		const char *imagePath = stream.getNext();
-		const char* imageID = stream.getNext();
-		//Call for loading an Image resource
-		MAHandle imageHandle =
-				loadImageResource(imagePath);
+		return MA_FERR_GENERIC;
+	}
 
-		sprintf(buffer,
-				"mosync.resource.imageLoaded(\"%s\", %d)",
-				imageID,
-				imageHandle);
-		mWebView->callJS(buffer);
+	String path = localPath;
+	path += manifestPath;
+	MAHandle file = maFileOpen(path.c_str(), MA_ACCESS_READ);
+	if(file < 0)
+	{
+		return file;
 	}
-	else if(0 == strcmp("loadRemoteImage", action))
+
+	int size = maFileExists(file) ? maFileSize(file) : MA_FERR_NOTFOUND;
+	if(size <= 0)
 	{
-		const char* imageURL = stream.getNext();
-		const char* imageID = stream.getNext();
+		maFileClose(file);
+		return size;
+	}
 
-		MAHandle imageHandle = maCreatePlaceholder();
-		mImageDownloader->beginDownloading(imageURL,imageHandle);
+	char* manifest = (char*) malloc(size + 1);
+	if(NULL == manifest)
+	{
+		maFileClose(file);
+		return MA_FERR_GENERIC;
+	}
+	int res = maFileRead(file, manifest, size);
+	maFileClose(file);
+	if(res < 0)
+	{
+		free(manifest);
+		return res;
+	}
+	manifest[size] = 0;
+
+	// Collect the images, ordered by priority. The loader
+	// reads files in the order they are queued.
+	Vector<String> imagePaths;
+	Vector<int> priorities;
+	char* line = manifest;
+	while(*line)
+	{
+		char* lineEnd = line;
+		while(*lineEnd && *lineEnd != '\n')
+		{
+			++lineEnd;
+		}
+		char* next = *lineEnd ? lineEnd + 1 : lineEnd;
+
+		// Trim whitespace, including the \r of DOS line ends.
+		while(line < lineEnd && (*line == ' ' || *line == '\t'))
+		{
+			++line;
+		}
+		while(lineEnd > line
+			&& (lineEnd[-1] == ' '
+				|| lineEnd[-1] == '\t'
+				|| lineEnd[-1] == '\r'))
+		{
+			--lineEnd;
+		}
+		*lineEnd = 0;
+
+		if(line < lineEnd && *line != '#')
+		{
+			// An optional priority follows the last space.
+			int priority = 0;
+			char* separator = strrchr(line, ' ');
+			if(NULL == separator)
+			{
+				separator = strrchr(line, '\t');
+			}
+			if(NULL != separator
+				&& ((separator[1] >= '0' && separator[1] <= '9')
+					|| separator[1] == '-'))
+			{
+				priority = atoi(separator + 1);
+				while(separator > line
+					&& (separator[-1] == ' ' || separator[-1] == '\t'))
+				{
+					--separator;
+				}
+				*separator = 0;
+			}
+
+			int index = priorities.size();
+			while(index > 0 && priorities[index - 1] < priority)
+			{
+				--index;
+			}
+			imagePaths.insert(index, line);
+			priorities.insert(index, priority);
+		}
+
+		line = next;
+	}
+	free(manifest);
 
-		sprintf(buffer,
-				"mosync.resource.imageDownloadStarted(\"%s\", %d)",
-				imageID,
-				imageHandle);
-		mWebView->callJS(buffer);
+	char completePath[2048];
+	for(int i = 0; i < imagePaths.size(); ++i)
+	{
+		sprintf(completePath,
+				"%s%s",
+				localPath,
+				imagePaths[i].c_str());
+		mFileLoader.load(imagePaths[i].c_str(), completePath, NULL);
+	}
+
+	lprintfln("@@@ Preloading %d images", imagePaths.size());
+	return imagePaths.size();
+}
+
+/**
+ * @return The number of messages with an unknown action.
+ */
+int ResourceMessageHandler::getUnknownActionCount()
+{
+	return mDispatcher.getUnknownCount();
+}
+
+/**
+ * Set the statistics that the actions are counted in.
+ */
+void ResourceMessageHandler::setStats(Wormhole::MessageStats* stats)
+{
+	mDispatcher.setStats(stats);
+}
+
+/**
+ * @return The cache of images loaded from local files.
+ */
+ImageCache& ResourceMessageHandler::getImageCache()
+{
+	return mImageCache;
+}
+
+/**
+ * @return The pool that downloads remote images.
+ */
+ImageDownloadPool& ResourceMessageHandler::getDownloadPool()
+{
+	return mDownloadPool;
+}
+
+/**
+ * @return The cache of downloaded image files.
+ */
+ImageDiskCache& ResourceMessageHandler::getDiskCache()
+{
+	return mDiskCache;
+}
+
+/**
+ * @return The data objects image files are read into.
+ */
+ScratchDataPool& ResourceMessageHandler::getDataPool()
+{
+	return mDataPool;
+}
+
+void ResourceMessageHandler::loadImage(Wormhole::MessageStream& stream)
+{
+	const char *imagePath = stream.getNext();
+	const char* imageID = stream.getNext();
+	// Use the cached image if the file has been loaded before,
+	// else load the image and add it to the cache.
+	MAHandle imageHandle = mImageCache.acquire(imagePath);
+	if(imageHandle == 0 && mFileLoader.isLoading(imagePath))
+	{
+		// The image is being preloaded, wait for it instead of
+		// reading the file twice.
+		mFileLoader.load(imagePath, "", imageID);
+		return;
+	}
+	if(imageHandle == 0)
+	{
+		imageHandle = loadImageResource(imagePath);
+		if(imageHandle > 0)
+		{
+			mImageCache.add(imagePath, imageHandle);
+		}
+	}
+
+	mScripts->add(mScripts->newScript()
+		.append("mosync.resource.imageLoaded(")
+		.appendString(imageID)
+		.append(", ")
+		.append(imageHandle)
+		.append(")"));
+}
+
+void ResourceMessageHandler::loadRemoteImage(Wormhole::MessageStream& stream)
+{
+	const char* imageURL = stream.getNext();
+	const char* imageID = stream.getNext();
+	int priority = stream.getNextInt();
+
+	// An image in memory or in the disk cache is ready at
+	// once, the disk cache revalidates it in the background.
+	// JavaScript releases the image when the callbacks have
+	// run.
+	MAHandle cachedImage = loadCachedImage(imageURL);
+	if(cachedImage > 0)
+	{
+		mScripts->add(mScripts->newScript()
+			.append("mosync.resource.imageDownloadStarted(")
+			.appendString(imageID)
+			.append(", ")
+			.append(cachedImage)
+			.append(")"));
+		mScripts->add(mScripts->newScript()
+			.append("mosync.resource.imageDownloadFinished(")
+			.append(cachedImage)
+			.append(")"));
+		return;
+	}
+
+	// Requests for a URL that is being downloaded get the
+	// handle of that download, JavaScript maps the handle
+	// to all the image IDs waiting for it. The handle is a
+	// negative error code if the download could not start.
+	MAHandle imageHandle = mDownloadPool.request(imageURL, priority);
+
+	mScripts->add(mScripts->newScript()
+		.append("mosync.resource.imageDownloadStarted(")
+		.appendString(imageID)
+		.append(", ")
+		.append(imageHandle)
+		.append(")"));
+}
+
+/**
+ * Loads an image like loadImage, but reads the file between
+ * events, so that other messages are handled while the file
+ * is read. Requests for a file that is being read share the
+ * read.
+ */
+void ResourceMessageHandler::loadImageAsync(Wormhole::MessageStream& stream)
+{
+	const char *imagePath = stream.getNext();
+	const char* imageID = stream.getNext();
+
+	MAHandle imageHandle = mImageCache.acquire(imagePath);
+	if(imageHandle == 0)
+	{
+		const char* localPath = getLocalPath();
+		if(NULL != localPath)
+		{
+			char completePath[2048];
+			sprintf(completePath,
+					"%s%s",
+					localPath,
+					imagePath);
+			mFileLoader.load(imagePath, completePath, imageID);
+			return;
+		}
+		imageHandle = MA_FERR_GENERIC;
+	}
+
+	mScripts->add(mScripts->newScript()
+		.append("mosync.resource.imageLoaded(")
+		.appendString(imageID)
+		.append(", ")
+		.append(imageHandle)
+		.append(")"));
+}
+
+/**
+ * Marks an image loaded with loadImage as no longer used, so
+ * that the cache can destroy it when it needs the memory.
+ */
+void ResourceMessageHandler::releaseImage(Wormhole::MessageStream& stream)
+{
+	MAHandle imageHandle = stream.getNextInt();
+	if(!mImageCache.release(imageHandle))
+	{
+		lprintfln("@@@ releaseImage: unknown image %d", imageHandle);
 	}
 }
 
@@ -102,72 +381,229 @@ bool ResourceMessageHandler::handleMessage(Wormhole::MessageStream& stream)
  */
 MAHandle ResourceMessageHandler::loadImageResource(const char *imagePath)
 {
-
-	int bufferSize = 1024;
-	char buffer[bufferSize];
-
 	//Get the local path which is the same path as the root of HTML apps
-	int size = maGetSystemProperty(
-		"mosync.path.local",
-		buffer,
-		bufferSize);
+	const char* localPath = getLocalPath();
+	if(NULL == localPath)
+	{
+		return MA_FERR_GENERIC;
+	}
 
 	//Construct a full path by concatenating the relative path and local path
 	char completePath[2048];
 
 	sprintf(completePath,
 			"%s%s",
-			buffer,
+			localPath,
 			imagePath);
 
 	//Load the image and create a data handle from it
 	MAHandle imageFile = maFileOpen(completePath, MA_ACCESS_READ);
+	if(imageFile < 0)
+	{
+		return imageFile;
+	}
 
 	int fileSize = maFileSize(imageFile);
+	if(fileSize < 0)
+	{
+		maFileClose(imageFile);
+		return fileSize;
+	}
 
-	MAHandle fileData = maCreatePlaceholder();
-
-	int res = maCreateData(fileData, fileSize);
+	//Read the file into a reused data object, the pool rejects
+	//empty and unreasonably large files
+	MAHandle fileData = mDataPool.acquire(fileSize);
+	if(fileData < 0)
+	{
+		maFileClose(imageFile);
+		return fileData;
+	}
 
-	res = maFileReadToData(imageFile, fileData, 0, fileSize);
+	int res = maFileReadToData(imageFile, fileData, 0, fileSize);
 	maFileClose(imageFile);
+	if(res < 0)
+	{
+		mDataPool.release(fileData);
+		return res;
+	}
 
 	MAHandle imageHandle = maCreatePlaceholder();
 
+	//The data object can be larger than the file
 	res = maCreateImageFromData(
 			imageHandle,
 			fileData,
 			0,
-			maGetDataSize(fileData));
-	maDestroyObject(fileData);
+			fileSize);
+	mDataPool.release(fileData);
+	if(res != RES_OK)
+	{
+		maDestroyObject(imageHandle);
+		return res;
+	}
+
 	//return the handle to the loaded image
 	return imageHandle;
 }
 
+/**
+ * Called when an image requested with loadImageAsync has
+ * been loaded, sends it to all the waiting image IDs.
+ */
+void ResourceMessageHandler::imageFileLoaded(
+	const char* key,
+	MAHandle image,
+	const MAUtil::Vector<MAUtil::String>& ids)
+{
+	// Each waiting ID is a user of the image. A preloaded
+	// image that no one has asked for yet is not in use.
+	if(image > 0)
+	{
+		mImageCache.add(key, image, ids.size());
+	}
+
+	if(0 == ids.size())
+	{
+		return;
+	}
+
+	mScripts->begin();
+	for(int i = 0; i < ids.size(); ++i)
+	{
+		mScripts->add(mScripts->newScript()
+			.append("mosync.resource.imageLoaded(")
+			.appendString(ids[i].c_str())
+			.append(", ")
+			.append(image)
+			.append(")"));
+	}
+	mScripts->end();
+}
 
 /**
- * Is called if the downloads is canceled.
+ * Gets an image from the image cache, or loads it from the
+ * disk cache and adds it to the image cache.
+ *
+ * @param imageURL URL of the image.
+ * @return The image handle, marked as in use. 0 if the image
+ * is in neither cache.
  */
-void ResourceMessageHandler::downloadCancelled(Downloader* downloader)
+MAHandle ResourceMessageHandler::loadCachedImage(const char* imageURL)
 {
-	lprintfln("Cancelled");
+	MAHandle imageHandle = mImageCache.acquire(imageURL);
+	if(imageHandle > 0)
+	{
+		return imageHandle;
+	}
+
+	if(!mDiskCache.isOpen())
+	{
+		const char* localPath = getLocalPath();
+		if(NULL == localPath)
+		{
+			return 0;
+		}
+		String path = localPath;
+		path += "imagecache/";
+		if(!mDiskCache.open(path.c_str()))
+		{
+			return 0;
+		}
+	}
+
+	MAHandle fileData = mDiskCache.read(imageURL);
+	if(0 == fileData)
+	{
+		return 0;
+	}
+
+	imageHandle = maCreatePlaceholder();
+	int res = maCreateImageFromData(
+			imageHandle,
+			fileData,
+			0,
+			maGetDataSize(fileData));
+	maDestroyObject(fileData);
+	if(res != RES_OK)
+	{
+		maDestroyObject(imageHandle);
+		return 0;
+	}
+
+	mImageCache.add(imageURL, imageHandle);
+	return imageHandle;
 }
 
 /**
- * Called if an error occurs when downloading
+ * @return The local path, NULL if it cannot be read.
  */
-void ResourceMessageHandler::error(Downloader* downloader, int code)
+const char* ResourceMessageHandler::getLocalPath()
 {
-	lprintfln("Error: %d", code);
+	// Read once, the path does not change.
+	if(mLocalPath.length() == 0)
+	{
+		int bufferSize = 1024;
+		char buffer[bufferSize];
+		int size = maGetSystemProperty(
+			"mosync.path.local",
+			buffer,
+			bufferSize);
+		if(size <= 0 || size > bufferSize)
+		{
+			return NULL;
+		}
+		mLocalPath = buffer;
+	}
+
+	return mLocalPath.c_str();
 }
 
+
 /**
  * On successful download completion, send the event to the JavaScript side.
  */
-void ResourceMessageHandler::finishedDownloading(Downloader* downloader,
-		MAHandle data) {
-	char buffer[256];
-	sprintf(buffer, "mosync.resource.imageDownloadFinished(%d)", data);
-	mWebView->callJS(buffer);
+void ResourceMessageHandler::imageDownloadFinished(
+	const char* url,
+	MAHandle image,
+	MAHandle data,
+	const char* etag,
+	const char* lastModified)
+{
+	// Keep the bytes and validators, so that the image is not
+	// downloaded again when the app is restarted, and can be
+	// revalidated when it is stale.
+	if(mDiskCache.isOpen())
+	{
+		mDiskCache.write(url, data, etag, lastModified);
+	}
+
+	// Later requests for the URL get the decoded image, and
+	// JavaScript releases it when the callbacks have run.
+	mImageCache.add(url, image);
+
+	mScripts->add(mScripts->newScript()
+		.append("mosync.resource.imageDownloadFinished(")
+		.append(image)
+		.append(")"));
+}
+
+/**
+ * Called if an error occurs when downloading, sends the
+ * error to the JavaScript side.
+ */
+void ResourceMessageHandler::imageDownloadFailed(
+	const char* url,
+	MAHandle image,
+	int code)
+{
+	mScripts->add(mScripts->newScript()
+		.append("mosync.resource.imageDownloadFailed(")
+		.append(image)
+		.append(", ")
+		.append(code)
+		.append(")"));
 
+	// The placeholder was never filled, JavaScript only
+	// uses the handle to find the waiting image IDs.
+	maDestroyObject(image);
 }
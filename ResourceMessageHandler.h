@@ -31,8 +31,26 @@ MA 02110-1301, USA.
 #include <Wormhole/WebViewMessage.h>
 #include <NativeUI/WebView.h>
 #include <MAUtil/String.h>
-#include <MAUtil/Downloader.h>
 #include "MessageStream.h"
+#include "MessageDispatcher.h"
+#include "ScriptBatch.h"
+#include "ImageCache.h"
+#include "ImageDownloadPool.h"
+#include "ImageDiskCache.h"
+#include "ImageFileLoader.h"
+#include "ScratchDataPool.h"
+
+/**
+ * Opcodes of the Resource actions, used instead of the action
+ * names in binary message streams.
+ */
+enum ResourceOpcode
+{
+	RESOURCE_OP_LOAD_IMAGE = 1,
+	RESOURCE_OP_LOAD_REMOTE_IMAGE = 2,
+	RESOURCE_OP_RELEASE_IMAGE = 3,
+	RESOURCE_OP_LOAD_IMAGE_ASYNC = 4
+};
 
 /**
  * Class that implements JavaScript calls.
@@ -40,13 +58,18 @@ MA 02110-1301, USA.
  * The JavaScript side is in file extendedbridge.js.
  */
 class ResourceMessageHandler:
-	public MAUtil::DownloadListener
+	public ImageDownloadPoolListener,
+	public ImageFileLoaderListener
 {
 public:
 	/**
 	 * Constructor.
+	 * @param webView The WebView that runs the JavaScript code.
+	 * @param scripts Batch used for all calls to JavaScript.
 	 */
-	ResourceMessageHandler(NativeUI::WebView* webView);
+	ResourceMessageHandler(
+		NativeUI::WebView* webView,
+		Wormhole::ScriptBatch* scripts);
 
 	/**
 	 * Destructor.
@@ -60,38 +83,161 @@ public:
 	bool handleMessage(Wormhole::MessageStream& message);
 
 	/**
-	 * Is called if the downloads is canceled.
+	 * Start loading the images listed in a manifest file into
+	 * the image cache, in the background. Each line of the
+	 * manifest holds the path of an image relative to the local
+	 * path, optionally followed by a priority. Images with a
+	 * higher priority are loaded first. Empty lines and lines
+	 * starting with # are ignored.
+	 *
+	 * @param manifestPath Path of the manifest relative to the
+	 * local path.
+	 * @return The number of images queued, or a negative error
+	 * code if the manifest could not be read.
 	 */
-	void downloadCancelled(MAUtil::Downloader* downloader);
+	int preloadImages(const char* manifestPath);
 
 	/**
-	 * Called if an error occurs when downloading
+	 * On successful download completion, send the event to the JavaScript side.
 	 */
-	void error(MAUtil::Downloader* downloader, int code);
+	void imageDownloadFinished(
+		const char* url,
+		MAHandle image,
+		MAHandle data,
+		const char* etag,
+		const char* lastModified);
 
 	/**
-	 * On successful download completion, send the event to the JavaScript side.
+	 * Called if an error occurs when downloading, sends the
+	 * error to the JavaScript side.
+	 */
+	void imageDownloadFailed(
+		const char* url,
+		MAHandle image,
+		int code);
+
+	/**
+	 * @return The number of messages with an unknown action.
+	 */
+	int getUnknownActionCount();
+
+	/**
+	 * Set the statistics that the actions are counted in.
+	 * @param stats The statistics, NULL for none.
+	 */
+	void setStats(Wormhole::MessageStats* stats);
+
+	/**
+	 * @return The cache of images loaded from local files.
+	 */
+	ImageCache& getImageCache();
+
+	/**
+	 * @return The pool that downloads remote images.
+	 */
+	ImageDownloadPool& getDownloadPool();
+
+	/**
+	 * @return The cache of downloaded image files.
 	 */
-	void finishedDownloading(MAUtil::Downloader* downloader, MAHandle data);
+	ImageDiskCache& getDiskCache();
+
+	/**
+	 * @return The data objects image files are read into.
+	 */
+	ScratchDataPool& getDataPool();
+
+	/**
+	 * Called when an image requested with loadImageAsync has
+	 * been loaded, sends it to all the waiting image IDs.
+	 */
+	void imageFileLoaded(
+		const char* key,
+		MAHandle image,
+		const MAUtil::Vector<MAUtil::String>& ids);
 
 private:
+	/**
+	 * Handlers for the Resource actions.
+	 */
+	void loadImage(Wormhole::MessageStream& stream);
+	void loadRemoteImage(Wormhole::MessageStream& stream);
+	void releaseImage(Wormhole::MessageStream& stream);
+	void loadImageAsync(Wormhole::MessageStream& stream);
+
+	/**
+	 * Maps action names to the handler methods.
+	 */
+	Wormhole::MessageDispatcher<ResourceMessageHandler, 16> mDispatcher;
 
 	/**
-	 * An instance of ImageDownloader that will be used for downloading image resources
+	 * Downloads remote images, several at a time.
 	 */
-	MAUtil::ImageDownloader* mImageDownloader;
+	ImageDownloadPool mDownloadPool;
+
+	/**
+	 * Downloaded image files, in a directory under the
+	 * local path. Opened when the first remote image is
+	 * loaded.
+	 */
+	ImageDiskCache mDiskCache;
+
+	/**
+	 * Data objects that image files are read into before
+	 * they are decoded, reused between images. Declared
+	 * before the loader that uses it.
+	 */
+	ScratchDataPool mDataPool;
+
+	/**
+	 * Reads the files of loadImageAsync between events.
+	 */
+	ImageFileLoader mFileLoader;
 
 	/**
 	 * Loads an image from a file and returns the handle to it.
 	 *
 	 * @param imagePath relative path to the image file.
+	 * @return The image handle, or a negative error code.
 	 */
 	MAHandle loadImageResource(const char *imagePath);
+
+	/**
+	 * Gets an image from the image cache, or loads it from
+	 * the disk cache and adds it to the image cache.
+	 *
+	 * @param imageURL URL of the image.
+	 * @return The image handle, marked as in use. 0 if the
+	 * image is in neither cache.
+	 */
+	MAHandle loadCachedImage(const char* imageURL);
+
+	/**
+	 * @return The local path, NULL if it cannot be read.
+	 */
+	const char* getLocalPath();
+
+	/**
+	 * Images loaded from local files, keyed by path.
+	 */
+	ImageCache mImageCache;
+
+	/**
+	 * The local path, which is the root of the HTML app.
+	 * Read once, when the first image is loaded.
+	 */
+	MAUtil::String mLocalPath;
 	/**
 	 * A Pointer to the main webview
 	 * Used for communicating with NativeUI
 	 */
 	NativeUI::WebView* mWebView;
+
+	/**
+	 * Batch used for all calls to JavaScript, so that the
+	 * replies to a message stream are evaluated together.
+	 */
+	Wormhole::ScriptBatch* mScripts;
 };
 
 #endif
@@ -0,0 +1,245 @@
+/*
+Copyright (C) 2012 MoSync AB
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License,
+version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+*/
+
+/**
+ * @file ScratchDataPool.cpp
+ *
+ * Reusable data objects for temporary data, such as the bytes
+ * of an image file before it is decoded.
+ */
+
+#include <conprint.h>
+
+#include "ScratchDataPool.h"
+
+using namespace Wormhole;
+
+/**
+ * Constructor.
+ */
+ScratchDataPool::ScratchDataPool(int maxCount, int maxSize) :
+	mMaxCount(maxCount),
+	mMaxSize(maxSize),
+	mByteCount(0),
+	mHighWaterMark(0),
+	mCreateCount(0),
+	mReuseCount(0),
+	mRejectCount(0)
+{
+}
+
+/**
+ * Destructor.
+ */
+ScratchDataPool::~ScratchDataPool()
+{
+	for (int i = 0; i < mBuffers.size(); ++i)
+	{
+		if (!mBuffers[i].mInUse)
+		{
+			maDestroyObject(mBuffers[i].mData);
+		}
+	}
+}
+
+/**
+ * Get a data object of at least the given size.
+ */
+MAHandle ScratchDataPool::acquire(int size)
+{
+	// Check the size before allocating, a bad file size
+	// must not allocate a huge data object.
+	if (size <= 0 || size > mMaxSize)
+	{
+		++mRejectCount;
+		lprintfln("@@@ ScratchDataPool: rejected size %d", size);
+		return RES_OUT_OF_MEMORY;
+	}
+
+	// Use the smallest free data object that is large enough,
+	// and remember the smallest free one in case none is.
+	int best = -1;
+	int smallest = -1;
+	for (int i = 0; i < mBuffers.size(); ++i)
+	{
+		const Buffer& buffer = mBuffers[i];
+		if (buffer.mInUse)
+		{
+			continue;
+		}
+		if (buffer.mSize >= size
+			&& (best < 0 || buffer.mSize < mBuffers[best].mSize))
+		{
+			best = i;
+		}
+		if (smallest < 0 || buffer.mSize < mBuffers[smallest].mSize)
+		{
+			smallest = i;
+		}
+	}
+
+	if (best >= 0)
+	{
+		++mReuseCount;
+		mBuffers[best].mInUse = true;
+		return mBuffers[best].mData;
+	}
+
+	// Replace a free data object that is too small, or add
+	// one if the pool is not full.
+	if (smallest >= 0 || mBuffers.size() < mMaxCount)
+	{
+		MAHandle data = create(size);
+		if (data < 0)
+		{
+			return data;
+		}
+
+		if (smallest >= 0)
+		{
+			maDestroyObject(mBuffers[smallest].mData);
+			mByteCount -= mBuffers[smallest].mSize;
+			mBuffers.remove(smallest);
+		}
+
+		Buffer buffer;
+		buffer.mData = data;
+		buffer.mSize = size;
+		buffer.mInUse = true;
+		mBuffers.add(buffer);
+
+		mByteCount += size;
+		if (mByteCount > mHighWaterMark)
+		{
+			mHighWaterMark = mByteCount;
+		}
+
+		return data;
+	}
+
+	// All data objects are in use, this one is not kept.
+	return create(size);
+}
+
+/**
+ * Return a data object to the pool.
+ */
+void ScratchDataPool::release(MAHandle data)
+{
+	for (int i = 0; i < mBuffers.size(); ++i)
+	{
+		if (data == mBuffers[i].mData)
+		{
+			mBuffers[i].mInUse = false;
+			return;
+		}
+	}
+
+	// Not kept by the pool.
+	maDestroyObject(data);
+}
+
+/**
+ * @return Largest number of bytes the data objects of
+ * the pool have held at the same time.
+ */
+int ScratchDataPool::getHighWaterMark()
+{
+	return mHighWaterMark;
+}
+
+/**
+ * @return Number of bytes held by the data objects of
+ * the pool.
+ */
+int ScratchDataPool::getByteCount()
+{
+	return mByteCount;
+}
+
+/**
+ * @return Number of data objects created.
+ */
+int ScratchDataPool::getCreateCount()
+{
+	return mCreateCount;
+}
+
+/**
+ * @return Number of calls to acquire that reused a
+ * data object.
+ */
+int ScratchDataPool::getReuseCount()
+{
+	return mReuseCount;
+}
+
+/**
+ * @return Number of calls to acquire that were rejected
+ * because of the size.
+ */
+int ScratchDataPool::getRejectCount()
+{
+	return mRejectCount;
+}
+
+/**
+ * Write the counters as a JSON object.
+ */
+void ScratchDataPool::writeStats(ScriptBuilder& json)
+{
+	json.append("{");
+	MessageStats::appendKey(json, "bytes");
+	json.append(mByteCount).append(",");
+	MessageStats::appendKey(json, "highWaterMark");
+	json.append(mHighWaterMark).append(",");
+	MessageStats::appendKey(json, "created");
+	json.append(mCreateCount).append(",");
+	MessageStats::appendKey(json, "reused");
+	json.append(mReuseCount).append(",");
+	MessageStats::appendKey(json, "rejected");
+	json.append(mRejectCount).append("}");
+}
+
+/**
+ * Set the counters to zero.
+ */
+void ScratchDataPool::resetStats()
+{
+	mHighWaterMark = mByteCount;
+	mCreateCount = 0;
+	mReuseCount = 0;
+	mRejectCount = 0;
+}
+
+/**
+ * Create a data object.
+ */
+MAHandle ScratchDataPool::create(int size)
+{
+	MAHandle data = maCreatePlaceholder();
+	int result = maCreateData(data, size);
+	if (RES_OK != result)
+	{
+		maDestroyObject(data);
+		return result;
+	}
+
+	++mCreateCount;
+	return data;
+}
@@ -0,0 +1,189 @@
+/*
+Copyright (C) 2012 MoSync AB
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License,
+version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+*/
+
+/**
+ * @file ScratchDataPool.h
+ *
+ * Reusable data objects for temporary data, such as the bytes
+ * of an image file before it is decoded.
+ */
+
+#ifndef SCRATCH_DATA_POOL_H_
+#define SCRATCH_DATA_POOL_H_
+
+#include <ma.h>
+#include <MAUtil/Vector.h>
+#include "MessageStats.h"
+
+/**
+ * Default number of data objects kept by the pool.
+ */
+#define SCRATCH_DATA_POOL_DEFAULT_COUNT 2
+
+/**
+ * Default largest size of a data object from the pool.
+ */
+#define SCRATCH_DATA_POOL_DEFAULT_MAX_SIZE (8 * 1024 * 1024)
+
+/**
+ * Keeps a few data objects that are reused for temporary data,
+ * instead of creating and destroying a data object each time.
+ *
+ * A data object cannot be resized, so when a larger one is
+ * needed than the pool has, a free data object is replaced by
+ * one of the requested size. The data objects thus grow to the
+ * largest size used, and a data object can be larger than
+ * requested.
+ *
+ * When all data objects of the pool are in use, acquire creates
+ * a data object that is destroyed when it is released.
+ *
+ * The counters are written with the message statistics, as a
+ * MessageStatsSource.
+ */
+class ScratchDataPool :
+	public Wormhole::MessageStatsSource
+{
+public:
+	/**
+	 * Constructor.
+	 * @param maxCount Number of data objects kept.
+	 * @param maxSize Largest size that can be acquired.
+	 */
+	ScratchDataPool(
+		int maxCount = SCRATCH_DATA_POOL_DEFAULT_COUNT,
+		int maxSize = SCRATCH_DATA_POOL_DEFAULT_MAX_SIZE);
+
+	/**
+	 * Destructor. Destroys the data objects that are not
+	 * in use.
+	 */
+	virtual ~ScratchDataPool();
+
+	/**
+	 * Get a data object of at least the given size.
+	 *
+	 * @param size Number of bytes needed.
+	 * @return The data object, or a negative error code if
+	 * the size is not positive or larger than the largest
+	 * size, or if the data object could not be created.
+	 */
+	MAHandle acquire(int size);
+
+	/**
+	 * Return a data object to the pool.
+	 * @param data A data object returned by acquire.
+	 */
+	void release(MAHandle data);
+
+	/**
+	 * @return Largest number of bytes the data objects of
+	 * the pool have held at the same time.
+	 */
+	int getHighWaterMark();
+
+	/**
+	 * @return Number of bytes held by the data objects of
+	 * the pool.
+	 */
+	int getByteCount();
+
+	/**
+	 * @return Number of data objects created.
+	 */
+	int getCreateCount();
+
+	/**
+	 * @return Number of calls to acquire that reused a
+	 * data object.
+	 */
+	int getReuseCount();
+
+	/**
+	 * @return Number of calls to acquire that were rejected
+	 * because of the size.
+	 */
+	int getRejectCount();
+
+	/**
+	 * Write the counters as a JSON object:
+	 * {"bytes":262144,"highWaterMark":524288,"created":3,
+	 *  "reused":41,"rejected":0}
+	 */
+	virtual void writeStats(Wormhole::ScriptBuilder& json);
+
+	/**
+	 * Set the counters to zero. The high water mark is set to
+	 * the bytes held now.
+	 */
+	virtual void resetStats();
+
+private:
+	/**
+	 * A data object of the pool.
+	 */
+	struct Buffer
+	{
+		MAHandle mData;
+		int mSize;
+		bool mInUse;
+	};
+
+	/**
+	 * Create a data object.
+	 * @return The data object, or a negative error code.
+	 */
+	MAHandle create(int size);
+
+	/**
+	 * Not copyable.
+	 */
+	ScratchDataPool(const ScratchDataPool&);
+	ScratchDataPool& operator=(const ScratchDataPool&);
+
+private:
+	/**
+	 * The data objects of the pool.
+	 */
+	MAUtil::Vector<Buffer> mBuffers;
+
+	/**
+	 * Number of data objects kept.
+	 */
+	int mMaxCount;
+
+	/**
+	 * Largest size that can be acquired.
+	 */
+	int mMaxSize;
+
+	/**
+	 * Bytes held by the data objects of the pool.
+	 */
+	int mByteCount;
+
+	/**
+	 * Statistics.
+	 */
+	int mHighWaterMark;
+	int mCreateCount;
+	int mReuseCount;
+	int mRejectCount;
+};
+
+#endif
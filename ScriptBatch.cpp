@@ -0,0 +1,282 @@
+/*
+Copyright (C) 2012 MoSync AB
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License,
+version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+*/
+
+/**
+ * @file ScriptBatch.cpp
+ *
+ * Collects JavaScript calls to a WebView and evaluates them
+ * in one call.
+ */
+
+#include <ma.h>				// MoSync API
+#include <mastring.h>		// C string functions
+
+#include "ScriptBatch.h"
+
+// Wrapper used for each script when a batch holds more than one
+// script. An exception is rethrown from a timer, so that it is
+// reported by the WebView but does not abort the rest of the batch.
+#define SCRIPT_TRY "try{"
+#define SCRIPT_CATCH "}catch(e){setTimeout(function(){throw e;},0);}\n"
+
+namespace Wormhole
+{
+	/**
+	 * Constructor.
+	 */
+	ScriptBatch::ScriptBatch(NativeUI::WebView* webView) :
+		mWebView(webView),
+		mDepth(0),
+		mNumScripts(0),
+		mScriptStart(0),
+		mScriptCount(0),
+		mEvaluationCount(0),
+		mByteCount(0),
+		mStats(NULL),
+		mCapture(NULL)
+	{
+		mScript.reserve(1024);
+	}
+
+	/**
+	 * Destructor.
+	 */
+	ScriptBatch::~ScriptBatch()
+	{
+	}
+
+	/**
+	 * Start collecting scripts.
+	 */
+	void ScriptBatch::begin()
+	{
+		++mDepth;
+	}
+
+	/**
+	 * Stop collecting scripts.
+	 */
+	void ScriptBatch::end()
+	{
+		if (mDepth > 0)
+		{
+			--mDepth;
+		}
+
+		if (0 == mDepth)
+		{
+			flush();
+		}
+	}
+
+	/**
+	 * Add a script.
+	 */
+	void ScriptBatch::add(const char* script)
+	{
+		add(script, strlen(script));
+	}
+
+	/**
+	 * Add a script built with a ScriptBuilder.
+	 */
+	void ScriptBatch::add(const ScriptBuilder& script)
+	{
+		add(script.c_str(), script.length());
+	}
+
+	/**
+	 * Get the builder used for the next script.
+	 */
+	ScriptBuilder& ScriptBatch::newScript()
+	{
+		return mBuilder.clear();
+	}
+
+	/**
+	 * Add a script of known length.
+	 */
+	void ScriptBatch::add(const char* script, int length)
+	{
+		++mScriptCount;
+
+		// Not collecting, evaluate at once.
+		if (0 == mDepth)
+		{
+			evaluate(script, length);
+			return;
+		}
+
+		if (0 == mNumScripts)
+		{
+			// The first script is added after its try prefix,
+			// so that a second script does not have to move it.
+			// A batch with a single script is evaluated from
+			// mScriptStart, without the wrapper.
+			mScript.append(SCRIPT_TRY, sizeof(SCRIPT_TRY) - 1);
+			mScript.append(script, length);
+			mScriptStart = sizeof(SCRIPT_TRY) - 1;
+		}
+		else
+		{
+			if (1 == mNumScripts)
+			{
+				// Close the wrapper of the first script now that
+				// there is a second.
+				mScript.append(SCRIPT_CATCH, sizeof(SCRIPT_CATCH) - 1);
+				mScriptStart = 0;
+			}
+
+			mScript.append(SCRIPT_TRY, sizeof(SCRIPT_TRY) - 1);
+			mScript.append(script, length);
+			mScript.append(SCRIPT_CATCH, sizeof(SCRIPT_CATCH) - 1);
+		}
+
+		++mNumScripts;
+	}
+
+	/**
+	 * Evaluate the scripts collected so far.
+	 */
+	void ScriptBatch::flush()
+	{
+		if (0 == mNumScripts)
+		{
+			return;
+		}
+
+		evaluate(
+			mScript.c_str() + mScriptStart,
+			mScript.length() - mScriptStart);
+
+		// Keep the allocated memory for the next batch.
+		mScript.clear();
+		mScriptStart = 0;
+		mNumScripts = 0;
+	}
+
+	/**
+	 * @return The WebView the scripts are evaluated in.
+	 */
+	NativeUI::WebView* ScriptBatch::getWebView()
+	{
+		return mWebView;
+	}
+
+	/**
+	 * Set the WebView the scripts are evaluated in.
+	 */
+	void ScriptBatch::setWebView(NativeUI::WebView* webView)
+	{
+		mWebView = webView;
+	}
+
+	/**
+	 * @return Number of scripts added.
+	 */
+	int ScriptBatch::getScriptCount()
+	{
+		return mScriptCount;
+	}
+
+	/**
+	 * @return Number of calls to callJS.
+	 */
+	int ScriptBatch::getEvaluationCount()
+	{
+		return mEvaluationCount;
+	}
+
+	/**
+	 * @return Number of bytes of JavaScript evaluated.
+	 */
+	int ScriptBatch::getByteCount()
+	{
+		return mByteCount;
+	}
+
+	/**
+	 * Set the counters to zero.
+	 */
+	void ScriptBatch::resetCounters()
+	{
+		mScriptCount = 0;
+		mEvaluationCount = 0;
+		mByteCount = 0;
+	}
+
+	/**
+	 * Set the statistics that the evaluations are counted in.
+	 */
+	void ScriptBatch::setStats(MessageStats* stats)
+	{
+		mStats = stats;
+	}
+
+	/**
+	 * Set the capture that the evaluated scripts are added to.
+	 */
+	void ScriptBatch::setCapture(MessageCapture* capture)
+	{
+		mCapture = capture;
+	}
+
+	/**
+	 * @return The capture the evaluated scripts are added to.
+	 */
+	MessageCapture* ScriptBatch::getCapture()
+	{
+		return mCapture;
+	}
+
+	/**
+	 * Evaluate a script in the WebView, and count it.
+	 */
+	void ScriptBatch::evaluate(const char* script, int length)
+	{
+		++mEvaluationCount;
+		mByteCount += length;
+
+		if (NULL != mCapture)
+		{
+			mCapture->addScript(script, length);
+		}
+
+		int start = NULL != mStats ? maGetMilliSecondCount() : 0;
+
+		if (NULL != mWebView)
+		{
+			// WebView::callJS takes a String and builds the URL
+			// in another one. Building the URL in a reused buffer
+			// allocates nothing once the buffer has grown.
+			mURL.clear()
+				.append("javascript:", 11)
+				.append(script, length);
+			maWidgetSetProperty(
+				mWebView->getWidgetHandle(),
+				MAW_WEB_VIEW_URL,
+				mURL.c_str());
+		}
+
+		if (NULL != mStats)
+		{
+			mStats->addEvaluation(length, maGetMilliSecondCount() - start);
+		}
+	}
+
+} // namespace
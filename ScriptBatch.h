@@ -0,0 +1,280 @@
+/*
+Copyright (C) 2012 MoSync AB
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License,
+version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+*/
+
+/*! \addtogroup WormHoleGroup
+ *  @{
+ */
+
+/** @defgroup WormHoleGroup Wormhole Library
+ *  @{
+ */
+
+/**
+ * @file ScriptBatch.h
+ *
+ * Collects JavaScript calls to a WebView and evaluates them
+ * in one call.
+ */
+
+#ifndef SCRIPT_BATCH_H_
+#define SCRIPT_BATCH_H_
+
+#include <ma.h>
+#include <MAUtil/String.h>
+#include <NativeUI/WebView.h>
+#include "ScriptBuilder.h"
+#include "MessageStats.h"
+#include "MessageCapture.h"
+
+namespace Wormhole
+{
+
+/**
+ * Accumulates scripts sent to a WebView while a message is
+ * being processed, and evaluates them with a single callJS
+ * when processing is done. Evaluating JavaScript is expensive,
+ * and a message stream of many operations would otherwise
+ * result in one or two evaluations per operation.
+ *
+ * Scripts are built with the builder returned by newScript,
+ * which is reused for every script.
+ *
+ * Usage:
+ *
+ *   batch.begin();
+ *   batch.add("mosync.nativeui.success('id1', 0)");
+ *   batch.add("mosync.bridge.reply(12)");
+ *   batch.end(); // Evaluates both scripts, in order.
+ *
+ * Scripts added outside of begin/end, for example from event
+ * listeners, are evaluated at once, with one callJS each. Code
+ * that adds several scripts must open a batch to have them
+ * evaluated together. Calls to begin and end can be nested,
+ * the scripts are evaluated by the outermost end.
+ *
+ * When a batch holds more than one script, each script is
+ * wrapped in a try/catch, so that an exception thrown by one
+ * callback does not prevent the following callbacks from being
+ * called, just as when the scripts are evaluated one by one.
+ *
+ * The batch counts the scripts and bytes it evaluates, and also
+ * reports the evaluations to a MessageStats object if one has
+ * been set with setStats. A batch
+ * created without a WebView only counts them, which is used to
+ * measure the message layer without a WebView.
+ *
+ * Every evaluated script is also given to the MessageCapture set
+ * with setCapture, if any, which is used to record the traffic
+ * to the WebView and to compare it when it is replayed.
+ */
+class ScriptBatch
+{
+public:
+	/**
+	 * Constructor.
+	 * @param webView The WebView to evaluate the scripts in,
+	 * NULL to discard the scripts.
+	 */
+	ScriptBatch(NativeUI::WebView* webView);
+
+	/**
+	 * Destructor.
+	 */
+	virtual ~ScriptBatch();
+
+	/**
+	 * Start collecting scripts.
+	 */
+	void begin();
+
+	/**
+	 * Stop collecting scripts. If this matches the outermost
+	 * call to begin, the collected scripts are evaluated.
+	 */
+	void end();
+
+	/**
+	 * Add a script. The script is evaluated at once, with its
+	 * own callJS, if no batch is open.
+	 * @param script The JavaScript code to evaluate.
+	 */
+	void add(const char* script);
+
+	/**
+	 * Add a script of known length. The script is evaluated
+	 * at once, with its own callJS, if no batch is open.
+	 * @param script The JavaScript code to evaluate.
+	 * @param length Length of the script in bytes.
+	 */
+	void add(const char* script, int length);
+
+	/**
+	 * Add a script built with a ScriptBuilder. The script is
+	 * evaluated at once, with its own callJS, if no batch is
+	 * open.
+	 * @param script The script.
+	 */
+	void add(const ScriptBuilder& script);
+
+	/**
+	 * Get the builder used for the next script. The builder
+	 * is cleared, and is cleared again by the next call, so
+	 * a script must be added before the next one is started.
+	 * @return The builder.
+	 */
+	ScriptBuilder& newScript();
+
+	/**
+	 * Evaluate the scripts collected so far, without closing
+	 * the batch.
+	 */
+	void flush();
+
+	/**
+	 * @return The WebView the scripts are evaluated in.
+	 */
+	NativeUI::WebView* getWebView();
+
+	/**
+	 * Set the WebView the scripts are evaluated in.
+	 * @param webView The WebView, NULL to discard the scripts.
+	 */
+	void setWebView(NativeUI::WebView* webView);
+
+	/**
+	 * @return Number of scripts added since the counters
+	 * were reset.
+	 */
+	int getScriptCount();
+
+	/**
+	 * @return Number of calls to callJS since the counters
+	 * were reset.
+	 */
+	int getEvaluationCount();
+
+	/**
+	 * @return Number of bytes of JavaScript evaluated since
+	 * the counters were reset, including the try/catch
+	 * wrappers.
+	 */
+	int getByteCount();
+
+	/**
+	 * Set the script, evaluation and byte counters to zero.
+	 */
+	void resetCounters();
+
+	/**
+	 * Set the statistics that the evaluations are counted in.
+	 * @param stats The statistics, NULL for none.
+	 */
+	void setStats(MessageStats* stats);
+
+	/**
+	 * Set the capture that the evaluated scripts are added to.
+	 * @param capture The capture, NULL for none.
+	 */
+	void setCapture(MessageCapture* capture);
+
+	/**
+	 * @return The capture the evaluated scripts are added to.
+	 */
+	MessageCapture* getCapture();
+
+private:
+	/**
+	 * Evaluate a script in the WebView, and count it.
+	 */
+	void evaluate(const char* script, int length);
+
+	/**
+	 * Not copyable.
+	 */
+	ScriptBatch(const ScriptBatch&);
+	ScriptBatch& operator=(const ScriptBatch&);
+
+private:
+	/**
+	 * The WebView to evaluate the scripts in.
+	 */
+	NativeUI::WebView* mWebView;
+
+	/**
+	 * Nesting level of begin calls.
+	 */
+	int mDepth;
+
+	/**
+	 * Number of scripts in the batch.
+	 */
+	int mNumScripts;
+
+	/**
+	 * Offset of the script to evaluate in mScript. This skips
+	 * the try prefix of a batch that holds a single script.
+	 */
+	int mScriptStart;
+
+	/**
+	 * The collected scripts, reused between batches.
+	 */
+	MAUtil::String mScript;
+
+	/**
+	 * Builder returned by newScript, reused between scripts.
+	 */
+	ScriptBuilder mBuilder;
+
+	/**
+	 * The javascript: URL a script is evaluated with, reused
+	 * between evaluations.
+	 */
+	ScriptBuilder mURL;
+
+	/**
+	 * Number of scripts added.
+	 */
+	int mScriptCount;
+
+	/**
+	 * Number of calls to callJS.
+	 */
+	int mEvaluationCount;
+
+	/**
+	 * Number of bytes evaluated.
+	 */
+	int mByteCount;
+
+	/**
+	 * Statistics the evaluations are counted in, NULL if none.
+	 */
+	MessageStats* mStats;
+
+	/**
+	 * Capture the evaluated scripts are added to, NULL if none.
+	 */
+	MessageCapture* mCapture;
+};
+
+} // namespace
+
+#endif
+
+/*! @} */
@@ -0,0 +1,283 @@
+/*
+Copyright (C) 2012 MoSync AB
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License,
+version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+*/
+
+/**
+ * @file ScriptBuilder.cpp
+ *
+ * Growable buffer for building JavaScript calls.
+ */
+
+#include <ma.h>				// MoSync API
+#include <maheap.h>			// C memory allocation
+#include <mastring.h>		// C string functions
+
+#include "ScriptBuilder.h"
+
+namespace Wormhole
+{
+	/**
+	 * Hexadecimal digits for \x escapes.
+	 */
+	static const char sHexDigits[] = "0123456789abcdef";
+
+	/**
+	 * @return true if a byte cannot be written as it is in
+	 * a single quoted string literal. 0xE2 is the first byte
+	 * of the line and paragraph separators, which end a line
+	 * in JavaScript, it is checked further by appendString.
+	 * '%' is escaped because scripts are run as javascript:
+	 * URLs, which are percent-decoded before they are run.
+	 */
+	static inline bool needsEscape(unsigned char c)
+	{
+		return c < 0x20 || '\'' == c || '\\' == c || '%' == c
+			|| 0xE2 == c;
+	}
+
+	/**
+	 * Constructor.
+	 */
+	ScriptBuilder::ScriptBuilder(int initialCapacity) :
+		mData(NULL),
+		mLength(0),
+		mCapacity(0)
+	{
+		reserve(initialCapacity);
+	}
+
+	/**
+	 * Destructor.
+	 */
+	ScriptBuilder::~ScriptBuilder()
+	{
+		if (NULL != mData)
+		{
+			free(mData);
+			mData = NULL;
+		}
+	}
+
+	/**
+	 * Remove the contents, keeping the buffer.
+	 */
+	ScriptBuilder& ScriptBuilder::clear()
+	{
+		mLength = 0;
+		if (NULL != mData)
+		{
+			mData[0] = 0;
+		}
+		return *this;
+	}
+
+	/**
+	 * Append JavaScript code as it is.
+	 */
+	ScriptBuilder& ScriptBuilder::append(const char* code)
+	{
+		return append(code, strlen(code));
+	}
+
+	/**
+	 * Append JavaScript code as it is.
+	 */
+	ScriptBuilder& ScriptBuilder::append(const char* code, int length)
+	{
+		if (!reserve(mLength + length))
+		{
+			return *this;
+		}
+
+		memcpy(mData + mLength, code, length);
+		mLength += length;
+		mData[mLength] = 0;
+
+		return *this;
+	}
+
+	/**
+	 * Append an integer in decimal.
+	 */
+	ScriptBuilder& ScriptBuilder::append(int value)
+	{
+		// Digits are produced backwards, at the end of a
+		// buffer that fits the longest int with its sign.
+		char digits[12];
+		char* p = digits + sizeof(digits);
+
+		// Work on the unsigned value, so that the most
+		// negative int does not overflow.
+		unsigned int n = value < 0
+			? 0u - (unsigned int) value
+			: (unsigned int) value;
+		do
+		{
+			*--p = (char) ('0' + n % 10);
+			n /= 10;
+		}
+		while (n > 0);
+
+		if (value < 0)
+		{
+			*--p = '-';
+		}
+
+		return append(p, digits + sizeof(digits) - p);
+	}
+
+	/**
+	 * Append a string as a single quoted string literal.
+	 */
+	ScriptBuilder& ScriptBuilder::appendString(const char* s)
+	{
+		return appendString(s, NULL != s ? strlen(s) : 0);
+	}
+
+	/**
+	 * Append a string as a single quoted string literal.
+	 */
+	ScriptBuilder& ScriptBuilder::appendString(const char* s, int length)
+	{
+		// Most strings need no escapes, reserving for the
+		// plain string and the quotes avoids growing twice.
+		if (!reserve(mLength + length + 2))
+		{
+			return *this;
+		}
+
+		append("'", 1);
+
+		const unsigned char* p = (const unsigned char*) s;
+		const unsigned char* end = p + length;
+		while (p < end)
+		{
+			// Copy the run of bytes that need no escape in
+			// one go.
+			const unsigned char* run = p;
+			while (p < end && !needsEscape(*p))
+			{
+				++p;
+			}
+			if (p > run)
+			{
+				append((const char*) run, p - run);
+			}
+			if (p >= end)
+			{
+				break;
+			}
+
+			unsigned char c = *p++;
+			switch (c)
+			{
+				case '\'': append("\\'", 2); break;
+				case '\\': append("\\\\", 2); break;
+				case '\n': append("\\n", 2); break;
+				case '\r': append("\\r", 2); break;
+				case '\t': append("\\t", 2); break;
+				case 0xE2:
+					// U+2028 and U+2029 are E2 80 A8 and E2 80 A9
+					// in UTF-8, other characters are kept.
+					if (end - p >= 2 && 0x80 == p[0]
+						&& (0xA8 == p[1] || 0xA9 == p[1]))
+					{
+						append(0xA8 == p[1] ? "\\u2028" : "\\u2029", 6);
+						p += 2;
+					}
+					else
+					{
+						append((const char*) p - 1, 1);
+					}
+					break;
+				default:
+				{
+					char escape[4] = {
+						'\\',
+						'x',
+						sHexDigits[c >> 4],
+						sHexDigits[c & 15]
+					};
+					append(escape, 4);
+					break;
+				}
+			}
+		}
+
+		return append("'", 1);
+	}
+
+	/**
+	 * @return The script, zero terminated.
+	 */
+	const char* ScriptBuilder::c_str() const
+	{
+		return NULL != mData ? mData : "";
+	}
+
+	/**
+	 * @return Length of the script in bytes.
+	 */
+	int ScriptBuilder::length() const
+	{
+		return mLength;
+	}
+
+	/**
+	 * @return Number of bytes allocated for the buffer.
+	 */
+	int ScriptBuilder::getCapacity() const
+	{
+		return mCapacity;
+	}
+
+	/**
+	 * Make sure the buffer can hold size bytes plus
+	 * a terminating zero.
+	 */
+	bool ScriptBuilder::reserve(int size)
+	{
+		// One extra byte for the terminating zero.
+		if (size + 1 <= mCapacity)
+		{
+			return true;
+		}
+
+		// Grow by doubling, like MessageBuffer.
+		int capacity = mCapacity > 0 ? mCapacity : 256;
+		while (capacity < size + 1)
+		{
+			capacity *= 2;
+		}
+
+		char* data = (char*) realloc(mData, capacity);
+		if (NULL == data)
+		{
+			return false;
+		}
+
+		if (NULL == mData)
+		{
+			data[0] = 0;
+		}
+		mData = data;
+		mCapacity = capacity;
+
+		return true;
+	}
+
+} // namespace
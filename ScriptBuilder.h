@@ -0,0 +1,174 @@
+/*
+Copyright (C) 2012 MoSync AB
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License,
+version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+*/
+
+/*! \addtogroup WormHoleGroup
+ *  @{
+ */
+
+/** @defgroup WormHoleGroup Wormhole Library
+ *  @{
+ */
+
+/**
+ * @file ScriptBuilder.h
+ *
+ * Growable buffer for building JavaScript calls.
+ */
+
+#ifndef SCRIPT_BUILDER_H_
+#define SCRIPT_BUILDER_H_
+
+#include <ma.h>
+
+namespace Wormhole
+{
+
+/**
+ * Builds a JavaScript call in a buffer that grows as needed
+ * and is reused between scripts, so that building a script
+ * neither truncates long values nor allocates memory once the
+ * buffer has grown to the size of the longest script.
+ *
+ * Strings from outside, such as property values and IDs, are
+ * added with appendString, which quotes and escapes them, so
+ * that any value results in a valid string literal, also when
+ * the script is run as a percent-decoded javascript: URL.
+ *
+ * Usage:
+ *
+ *   ScriptBuilder& script = batch.newScript();
+ *   script.append("mosync.nativeui.success(")
+ *       .appendString(callbackID)
+ *       .append(", ")
+ *       .append(result)
+ *       .append(")");
+ *   batch.add(script);
+ *
+ * The data in the buffer is always zero terminated.
+ */
+class ScriptBuilder
+{
+public:
+	/**
+	 * Constructor.
+	 * @param initialCapacity Initial size of the buffer in bytes.
+	 */
+	ScriptBuilder(int initialCapacity = 256);
+
+	/**
+	 * Destructor.
+	 */
+	virtual ~ScriptBuilder();
+
+	/**
+	 * Remove the contents, keeping the buffer.
+	 * @return This builder.
+	 */
+	ScriptBuilder& clear();
+
+	/**
+	 * Append JavaScript code as it is.
+	 * @param code Zero terminated code.
+	 * @return This builder.
+	 */
+	ScriptBuilder& append(const char* code);
+
+	/**
+	 * Append JavaScript code as it is.
+	 * @param code The code.
+	 * @param length Length of the code in bytes.
+	 * @return This builder.
+	 */
+	ScriptBuilder& append(const char* code, int length);
+
+	/**
+	 * Append an integer in decimal.
+	 * @param value The integer.
+	 * @return This builder.
+	 */
+	ScriptBuilder& append(int value);
+
+	/**
+	 * Append a string as a single quoted JavaScript string
+	 * literal, escaping the characters that need it.
+	 * @param s Zero terminated string, NULL is appended
+	 * as an empty string.
+	 * @return This builder.
+	 */
+	ScriptBuilder& appendString(const char* s);
+
+	/**
+	 * Append a string as a single quoted JavaScript string
+	 * literal, escaping the characters that need it.
+	 * @param s The string.
+	 * @param length Length of the string in bytes.
+	 * @return This builder.
+	 */
+	ScriptBuilder& appendString(const char* s, int length);
+
+	/**
+	 * @return The script, zero terminated.
+	 */
+	const char* c_str() const;
+
+	/**
+	 * @return Length of the script in bytes.
+	 */
+	int length() const;
+
+	/**
+	 * @return Number of bytes allocated for the buffer.
+	 */
+	int getCapacity() const;
+
+private:
+	/**
+	 * Make sure the buffer can hold size bytes plus
+	 * a terminating zero.
+	 * @return true on success, false if out of memory.
+	 */
+	bool reserve(int size);
+
+	/**
+	 * Not copyable.
+	 */
+	ScriptBuilder(const ScriptBuilder&);
+	ScriptBuilder& operator=(const ScriptBuilder&);
+
+private:
+	/**
+	 * The buffer.
+	 */
+	char* mData;
+
+	/**
+	 * Length of the script.
+	 */
+	int mLength;
+
+	/**
+	 * Allocated size of the buffer.
+	 */
+	int mCapacity;
+};
+
+} // namespace
+
+#endif
+
+/*! @} */
@@ -0,0 +1,93 @@
+/*
+Copyright (C) 2012 MoSync AB
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License,
+version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+*/
+
+/**
+ * @file StringHash.h
+ *
+ * FNV-1a hashing of strings, and lookup of an entry by a
+ * string key and its hash. Used by the image caches, the
+ * download pool and the message dispatchers.
+ */
+
+#ifndef STRING_HASH_H_
+#define STRING_HASH_H_
+
+#include <ma.h>
+#include <mastring.h>
+#include <MAUtil/String.h>
+#include <MAUtil/Vector.h>
+
+/**
+ * FNV-1a hash of a zero terminated string.
+ */
+inline unsigned int hashString(const char* s)
+{
+	unsigned int h = 2166136261u;
+	while (*s)
+	{
+		h ^= (unsigned char) *s++;
+		h *= 16777619u;
+	}
+	return h;
+}
+
+/**
+ * FNV-1a hash of a string of a given length. Gives the same
+ * hash as hashString(const char*) for the same characters.
+ */
+inline unsigned int hashString(const char* s, int length)
+{
+	unsigned int h = 2166136261u;
+	for (int i = 0; i < length; ++i)
+	{
+		h ^= (unsigned char) s[i];
+		h *= 16777619u;
+	}
+	return h;
+}
+
+/**
+ * Find the entry with a given key in a vector. The entries
+ * must have the hash of their key in a member named mHash.
+ *
+ * @param entries The entries to search.
+ * @param keyMember The member of the entries with the key.
+ * @param key The key to find.
+ * @param hash The hash of the key, see hashString.
+ * @return Index of the entry, -1 if there is none.
+ */
+template <class Entry>
+int findHashedString(
+	const MAUtil::Vector<Entry>& entries,
+	MAUtil::String Entry::*keyMember,
+	const char* key,
+	unsigned int hash)
+{
+	for (int i = 0; i < entries.size(); ++i)
+	{
+		// Compare the hashes first, it is cheaper.
+		if (hash == entries[i].mHash
+			&& 0 == strcmp(key, (entries[i].*keyMember).c_str()))
+		{
+			return i;
+		}
+	}
+	return -1;
+}
+
+#endif
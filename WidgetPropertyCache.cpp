@@ -0,0 +1,355 @@
+/*
+Copyright (C) 2012 MoSync AB
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License,
+version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+*/
+
+/**
+ * @file WidgetPropertyCache.cpp
+ *
+ * Shadow copy of the widget property values set from JavaScript.
+ */
+
+#include <mastring.h>		// C string functions
+
+#include "WidgetPropertyCache.h"
+
+using namespace MAUtil;
+using namespace Wormhole;
+
+/**
+ * Properties that can be cached. A cached property must keep
+ * the value it was set to until it is set again, or until the
+ * widget sends one of the events in invalidateForEvent(). It
+ * must also have no side effect when set to the same value.
+ *
+ * Layout properties like "width" and "left" are not cached,
+ * since reading them can give the actual size rather than the
+ * value that was set. Nor are properties whose value is an
+ * image handle, like "image" and "icon", since a handle can be
+ * destroyed and reused for another image, and setting it again
+ * must then reach the widget.
+ */
+static const char* sCacheableProperties[] =
+{
+	"text",
+	"fontColor",
+	"fontSize",
+	"backgroundColor",
+	"visible",
+	"enabled",
+	"title",
+	"placeholder",
+	"textHorizontalAlignment",
+	"textVerticalAlignment",
+	"checked",
+	"value",
+	"maxValue",
+	"progress"
+};
+
+static const int sNumCacheableProperties =
+	sizeof(sCacheableProperties) / sizeof(sCacheableProperties[0]);
+
+/**
+ * Constructor.
+ */
+WidgetPropertyCache::WidgetPropertyCache() :
+	mHitCount(0),
+	mMissCount(0),
+	mSkippedSetCount(0)
+{
+}
+
+/**
+ * Destructor.
+ */
+WidgetPropertyCache::~WidgetPropertyCache()
+{
+	for (int i = 0; i < mWidgets.size(); ++i)
+	{
+		delete mWidgets[i];
+	}
+}
+
+/**
+ * @return true if the value of the property can be cached.
+ */
+bool WidgetPropertyCache::isCacheable(const char* property)
+{
+	return findCacheable(property) >= 0;
+}
+
+/**
+ * Get the cached value of a property.
+ */
+const char* WidgetPropertyCache::get(
+	MAWidgetHandle widget,
+	const char* property)
+{
+	int index = findCacheable(property);
+	if (index < 0)
+	{
+		return NULL;
+	}
+
+	CachedProperty* cached = find(widget, index);
+	if (NULL == cached)
+	{
+		++mMissCount;
+		return NULL;
+	}
+
+	++mHitCount;
+	return cached->mValue.c_str();
+}
+
+/**
+ * Check if a property is cached with the given value.
+ */
+bool WidgetPropertyCache::hasValue(
+	MAWidgetHandle widget,
+	const char* property,
+	const char* value)
+{
+	int index = findCacheable(property);
+	if (index < 0 || NULL == value)
+	{
+		return false;
+	}
+
+	CachedProperty* cached = find(widget, index);
+	if (NULL == cached || 0 != strcmp(cached->mValue.c_str(), value))
+	{
+		return false;
+	}
+
+	++mSkippedSetCount;
+	return true;
+}
+
+/**
+ * Store the value of a property.
+ */
+void WidgetPropertyCache::put(
+	MAWidgetHandle widget,
+	const char* property,
+	const char* value)
+{
+	int index = findCacheable(property);
+	if (index < 0 || widget < 0 || NULL == value)
+	{
+		return;
+	}
+
+	CachedProperty* cached = find(widget, index);
+	if (NULL != cached)
+	{
+		cached->mValue = value;
+		return;
+	}
+
+	// Make room for the handle.
+	while (mWidgets.size() <= widget)
+	{
+		mWidgets.add(NULL);
+	}
+
+	if (NULL == mWidgets[widget])
+	{
+		mWidgets[widget] = new PropertyList(4);
+	}
+
+	CachedProperty entry;
+	entry.mIndex = index;
+	entry.mValue = value;
+	mWidgets[widget]->add(entry);
+}
+
+/**
+ * Remove a property from the cache.
+ */
+void WidgetPropertyCache::remove(
+	MAWidgetHandle widget,
+	const char* property)
+{
+	int index = findCacheable(property);
+	PropertyList* properties = getProperties(widget);
+	if (index < 0 || NULL == properties)
+	{
+		return;
+	}
+
+	for (int i = 0; i < properties->size(); ++i)
+	{
+		if (index == (*properties)[i].mIndex)
+		{
+			properties->remove(i);
+			return;
+		}
+	}
+}
+
+/**
+ * Remove all properties of a widget from the cache.
+ */
+void WidgetPropertyCache::removeWidget(MAWidgetHandle widget)
+{
+	if (NULL != getProperties(widget))
+	{
+		delete mWidgets[widget];
+		mWidgets[widget] = NULL;
+	}
+}
+
+/**
+ * Remove the properties of a widget that an event
+ * tells might have changed.
+ */
+void WidgetPropertyCache::invalidateForEvent(
+	MAWidgetHandle widget,
+	int eventType)
+{
+	switch (eventType)
+	{
+		// Events that tell that the user changed the
+		// state of the widget.
+		case MAW_EVENT_CLICKED:
+		case MAW_EVENT_TAB_CHANGED:
+		case MAW_EVENT_SLIDER_VALUE_CHANGED:
+		case MAW_EVENT_DATE_PICKER_VALUE_CHANGED:
+		case MAW_EVENT_NUMBER_PICKER_VALUE_CHANGED:
+		case MAW_EVENT_VIDEO_STATE_CHANGED:
+		case MAW_EVENT_EDIT_BOX_EDITING_DID_END:
+		case MAW_EVENT_EDIT_BOX_TEXT_CHANGED:
+		case MAW_EVENT_EDIT_BOX_RETURN:
+		case MAW_EVENT_WEB_VIEW_URL_CHANGED:
+		case MAW_EVENT_WEB_VIEW_CONTENT_LOADING:
+		case MAW_EVENT_STACK_SCREEN_POPPED:
+			removeWidget(widget);
+			break;
+	}
+}
+
+/**
+ * @return Number of gets served from the cache.
+ */
+int WidgetPropertyCache::getHitCount()
+{
+	return mHitCount;
+}
+
+/**
+ * @return Number of gets of cacheable properties that
+ * were not in the cache.
+ */
+int WidgetPropertyCache::getMissCount()
+{
+	return mMissCount;
+}
+
+/**
+ * @return Number of sets skipped because the property
+ * already had the value.
+ */
+int WidgetPropertyCache::getSkippedSetCount()
+{
+	return mSkippedSetCount;
+}
+
+/**
+ * Write the counters as a JSON object.
+ */
+void WidgetPropertyCache::writeStats(ScriptBuilder& json)
+{
+	json.append("{");
+	MessageStats::appendKey(json, "hits");
+	json.append(mHitCount).append(",");
+	MessageStats::appendKey(json, "misses");
+	json.append(mMissCount).append(",");
+	MessageStats::appendKey(json, "skippedSets");
+	json.append(mSkippedSetCount).append("}");
+}
+
+/**
+ * Set the counters to zero.
+ */
+void WidgetPropertyCache::resetStats()
+{
+	mHitCount = 0;
+	mMissCount = 0;
+	mSkippedSetCount = 0;
+}
+
+/**
+ * @return Index of the property in the table of cacheable
+ * properties, -1 if it is not cacheable.
+ */
+int WidgetPropertyCache::findCacheable(const char* property)
+{
+	if (NULL == property)
+	{
+		return -1;
+	}
+
+	for (int i = 0; i < sNumCacheableProperties; ++i)
+	{
+		if (0 == strcmp(property, sCacheableProperties[i]))
+		{
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+/**
+ * @return The cached properties of a widget, NULL if
+ * there are none.
+ */
+WidgetPropertyCache::PropertyList* WidgetPropertyCache::getProperties(
+	MAWidgetHandle widget)
+{
+	if (widget < 0 || widget >= mWidgets.size())
+	{
+		return NULL;
+	}
+	return mWidgets[widget];
+}
+
+/**
+ * @return The cached property with the given index,
+ * NULL if it is not cached.
+ */
+WidgetPropertyCache::CachedProperty* WidgetPropertyCache::find(
+	MAWidgetHandle widget,
+	int index)
+{
+	PropertyList* properties = getProperties(widget);
+	if (NULL == properties)
+	{
+		return NULL;
+	}
+
+	for (int i = 0; i < properties->size(); ++i)
+	{
+		if (index == (*properties)[i].mIndex)
+		{
+			return &(*properties)[i];
+		}
+	}
+
+	return NULL;
+}
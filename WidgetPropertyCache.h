@@ -0,0 +1,219 @@
+/*
+Copyright (C) 2012 MoSync AB
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License,
+version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+*/
+
+/**
+ * @file WidgetPropertyCache.h
+ *
+ * Shadow copy of the widget property values set from JavaScript.
+ */
+
+#ifndef WIDGET_PROPERTY_CACHE_H_
+#define WIDGET_PROPERTY_CACHE_H_
+
+#include <ma.h>
+#include <MAUtil/String.h>
+#include <MAUtil/Vector.h>
+#include "MessageStats.h"
+
+/**
+ * Remembers the last value of widget properties, so that
+ * setting a property to the value it already has does not
+ * reach the platform, and getting a property does not need a
+ * call to the widget.
+ *
+ * Only properties that keep the value they are set to are
+ * cached, see isCacheable(). Properties that the user can
+ * change, like the text of an edit box or the value of a
+ * slider, must be invalidated when the widget sends an event,
+ * see invalidateForEvent().
+ *
+ * The hit, miss and skipped set counters are written with the
+ * message statistics, as a MessageStatsSource.
+ */
+class WidgetPropertyCache :
+	public Wormhole::MessageStatsSource
+{
+public:
+	/**
+	 * Constructor.
+	 */
+	WidgetPropertyCache();
+
+	/**
+	 * Destructor.
+	 */
+	virtual ~WidgetPropertyCache();
+
+	/**
+	 * @return true if the value of the property can be cached.
+	 */
+	static bool isCacheable(const char* property);
+
+	/**
+	 * Get the cached value of a property. Counts a hit or
+	 * a miss if the property is cacheable.
+	 *
+	 * @return The value, NULL if it is not in the cache.
+	 * The pointer is valid until the cache is changed.
+	 */
+	const char* get(MAWidgetHandle widget, const char* property);
+
+	/**
+	 * Check if a property is cached with the given value, in
+	 * which case setting it can be skipped. Counts a skipped
+	 * set if it is.
+	 *
+	 * @return true if the property already has the value.
+	 */
+	bool hasValue(
+		MAWidgetHandle widget,
+		const char* property,
+		const char* value);
+
+	/**
+	 * Store the value of a property. Call after the property
+	 * has been set or read successfully. Does nothing if the
+	 * property is not cacheable.
+	 */
+	void put(
+		MAWidgetHandle widget,
+		const char* property,
+		const char* value);
+
+	/**
+	 * Remove a property from the cache, for example after
+	 * setting it failed.
+	 */
+	void remove(MAWidgetHandle widget, const char* property);
+
+	/**
+	 * Remove all properties of a widget from the cache.
+	 * Must be called when the widget is destroyed, since
+	 * handles are reused.
+	 */
+	void removeWidget(MAWidgetHandle widget);
+
+	/**
+	 * Remove the properties of a widget that an event
+	 * tells might have changed.
+	 *
+	 * @param widget The widget that sent the event.
+	 * @param eventType The MAW_EVENT type of the event.
+	 */
+	void invalidateForEvent(MAWidgetHandle widget, int eventType);
+
+	/**
+	 * @return Number of gets served from the cache.
+	 */
+	int getHitCount();
+
+	/**
+	 * @return Number of gets of cacheable properties that
+	 * were not in the cache.
+	 */
+	int getMissCount();
+
+	/**
+	 * @return Number of sets skipped because the property
+	 * already had the value.
+	 */
+	int getSkippedSetCount();
+
+	/**
+	 * Write the counters as a JSON object:
+	 * {"hits":210,"misses":12,"skippedSets":48}
+	 */
+	virtual void writeStats(Wormhole::ScriptBuilder& json);
+
+	/**
+	 * Set the counters to zero.
+	 */
+	virtual void resetStats();
+
+private:
+	/**
+	 * A cached property value.
+	 */
+	struct CachedProperty
+	{
+		/**
+		 * Index of the property name in the table of
+		 * cacheable properties.
+		 */
+		int mIndex;
+
+		/**
+		 * The property value.
+		 */
+		MAUtil::String mValue;
+	};
+
+	/**
+	 * The cached properties of a widget.
+	 */
+	typedef MAUtil::Vector<CachedProperty> PropertyList;
+
+	/**
+	 * @return Index of the property in the table of cacheable
+	 * properties, -1 if it is not cacheable.
+	 */
+	static int findCacheable(const char* property);
+
+	/**
+	 * @return The cached properties of a widget, NULL if
+	 * there are none.
+	 */
+	PropertyList* getProperties(MAWidgetHandle widget);
+
+	/**
+	 * @return The cached property with the given index,
+	 * NULL if it is not cached.
+	 */
+	CachedProperty* find(MAWidgetHandle widget, int index);
+
+	/**
+	 * Not copyable.
+	 */
+	WidgetPropertyCache(const WidgetPropertyCache&);
+	WidgetPropertyCache& operator=(const WidgetPropertyCache&);
+
+private:
+	/**
+	 * Cached properties indexed by widget handle. Handles
+	 * are small integers that are reused, so a vector is
+	 * used rather than a map.
+	 */
+	MAUtil::Vector<PropertyList*> mWidgets;
+
+	/**
+	 * Number of gets served from the cache.
+	 */
+	int mHitCount;
+
+	/**
+	 * Number of gets not in the cache.
+	 */
+	int mMissCount;
+
+	/**
+	 * Number of skipped sets.
+	 */
+	int mSkippedSetCount;
+};
+
+#endif
@@ -0,0 +1,449 @@
+/*
+Copyright (C) 2012 MoSync AB
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License,
+version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+*/
+
+/**
+ * @file HostLibraries.cpp
+ *
+ * Stub of the MAUtil, NativeUI and Wormhole classes used by
+ * the message layer, for the host build. There is no event
+ * loop and no network, HTTP requests of file:// URLs are
+ * answered by hostRunDownloads.
+ */
+
+#include <ma.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <MAUtil/Connection.h>
+#include <MAUtil/Environment.h>
+#include <MAUtil/Moblet.h>
+#include <NativeUI/WebView.h>
+#include <Wormhole/WebAppMoblet.h>
+
+#include "HostSyscalls.h"
+
+/**
+ * Remove a listener from a list, if it is there.
+ */
+template<class Listener>
+static void removeListener(MAUtil::Vector<Listener*>& listeners, Listener* listener)
+{
+	for (int i = 0; i < listeners.size(); ++i)
+	{
+		if (listener == listeners[i])
+		{
+			listeners.remove(i);
+			return;
+		}
+	}
+}
+
+namespace MAUtil
+{
+	/**
+	 * The environment of the moblet, or a default one if
+	 * there is no moblet.
+	 */
+	static Environment* sEnvironment = NULL;
+
+	Environment::Environment()
+	{
+		sEnvironment = this;
+	}
+
+	Environment::~Environment()
+	{
+		if (this == sEnvironment)
+		{
+			sEnvironment = NULL;
+		}
+	}
+
+	Environment& Environment::getEnvironment()
+	{
+		if (NULL == sEnvironment)
+		{
+			static Environment sDefaultEnvironment;
+			return sDefaultEnvironment;
+		}
+		return *sEnvironment;
+	}
+
+	void Environment::addCustomEventListener(CustomEventListener* listener)
+	{
+		mCustomEventListeners.add(listener);
+	}
+
+	void Environment::removeCustomEventListener(CustomEventListener* listener)
+	{
+		removeListener(mCustomEventListeners, listener);
+	}
+
+	void Environment::addTimer(TimerListener* listener, int period, int numTimes)
+	{
+		mTimerListeners.add(listener);
+	}
+
+	void Environment::removeTimer(TimerListener* listener)
+	{
+		removeListener(mTimerListeners, listener);
+	}
+
+	void Environment::addIdleListener(IdleListener* listener)
+	{
+		mIdleListeners.add(listener);
+	}
+
+	void Environment::removeIdleListener(IdleListener* listener)
+	{
+		removeListener(mIdleListeners, listener);
+	}
+
+	void Environment::fireCustomEvent(const MAEvent& event)
+	{
+		// Listeners may remove themselves, iterate over a copy.
+		Vector<CustomEventListener*> listeners = mCustomEventListeners;
+		for (int i = 0; i < listeners.size(); ++i)
+		{
+			listeners[i]->customEvent(event);
+		}
+	}
+
+	void Environment::runTimers()
+	{
+		Vector<TimerListener*> listeners = mTimerListeners;
+		for (int i = 0; i < listeners.size(); ++i)
+		{
+			listeners[i]->runTimerEvent();
+		}
+	}
+
+	void Environment::runIdle()
+	{
+		Vector<IdleListener*> listeners = mIdleListeners;
+		for (int i = 0; i < listeners.size(); ++i)
+		{
+			listeners[i]->idle();
+		}
+	}
+
+	void Moblet::run(Moblet* moblet)
+	{
+		// There are no events on the host, the moblet has done
+		// its work when its constructor returns.
+	}
+
+	void Moblet::close()
+	{
+	}
+
+	Connection::Connection(ConnectionListener* listener) :
+		mListener(listener),
+		mOpen(false),
+		mBodyRead(0)
+	{
+	}
+
+	Connection::~Connection()
+	{
+	}
+
+	bool Connection::isOpen() const
+	{
+		return mOpen;
+	}
+
+	void Connection::close()
+	{
+		mOpen = false;
+		mBody.clear();
+		mBodyRead = 0;
+	}
+
+	void Connection::recv(void* dst, int maxSize)
+	{
+		mListener->connRecvFinished(this, CONNERR_GENERIC);
+	}
+
+	void Connection::read(void* dst, int size)
+	{
+		mListener->connReadFinished(this, CONNERR_GENERIC);
+	}
+
+	void Connection::readToData(MAHandle data, int offset, int size)
+	{
+		if (!mOpen || size <= 0 || size > mBody.size() - mBodyRead)
+		{
+			mListener->connReadFinished(this, CONNERR_GENERIC);
+			return;
+		}
+
+		maWriteData(data, mBody.c_str() + mBodyRead, offset, size);
+		mBodyRead += size;
+		mListener->connReadFinished(this, size);
+	}
+
+	/**
+	 * Requests that have been finished and not answered,
+	 * oldest first.
+	 */
+	static Vector<HttpConnection*> sRequests;
+
+	/**
+	 * @return The name in lower case.
+	 */
+	static String lowerCase(const char* name)
+	{
+		String result(name);
+		for (int i = 0; i < result.size(); ++i)
+		{
+			if ('A' <= result[i] && result[i] <= 'Z')
+			{
+				result[i] = result[i] - 'A' + 'a';
+			}
+		}
+		return result;
+	}
+
+	/**
+	 * @return Index of the value of a header in a list of
+	 * names and values, -1 if the header is not there.
+	 */
+	static int findHeader(const Vector<String>& headers, const char* name)
+	{
+		String key = lowerCase(name);
+		for (int i = 0; i + 1 < headers.size(); i += 2)
+		{
+			if (key == headers[i])
+			{
+				return i + 1;
+			}
+		}
+		return -1;
+	}
+
+	/**
+	 * Read a file.
+	 * @return false if the file could not be opened.
+	 */
+	static bool readFile(const char* path, String& bytes)
+	{
+		FILE* file = fopen(path, "rb");
+		if (NULL == file)
+		{
+			return false;
+		}
+
+		char buffer[4096];
+		size_t count;
+		while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0)
+		{
+			bytes.append(buffer, (int) count);
+		}
+		fclose(file);
+		return true;
+	}
+
+	HttpConnection::HttpConnection(HttpConnectionListener* listener) :
+		Connection(listener)
+	{
+	}
+
+	HttpConnection::~HttpConnection()
+	{
+		removeListener(sRequests, this);
+	}
+
+	int HttpConnection::create(const char* url, int method)
+	{
+		static const char scheme[] = "file://";
+		if (mOpen || NULL == url
+			|| 0 != strncmp(url, scheme, sizeof(scheme) - 1))
+		{
+			return CONNERR_GENERIC;
+		}
+
+		mPath = url + sizeof(scheme) - 1;
+		mRequestHeaders.clear();
+		mResponseHeaders.clear();
+		mOpen = true;
+		return 1;
+	}
+
+	void HttpConnection::setRequestHeader(const char* key, const char* value)
+	{
+		mRequestHeaders.add(lowerCase(key));
+		mRequestHeaders.add(value);
+	}
+
+	int HttpConnection::getResponseHeader(const char* key, String* value)
+	{
+		int index = findHeader(mResponseHeaders, key);
+		if (index < 0)
+		{
+			return CONNERR_GENERIC;
+		}
+		*value = mResponseHeaders[index];
+		return value->length();
+	}
+
+	void HttpConnection::finish()
+	{
+		sRequests.add(this);
+	}
+
+	void HttpConnection::respond()
+	{
+		if (!mOpen)
+		{
+			return;
+		}
+
+		// A missing file is what a missing resource would be.
+		int status = 200;
+		if (!readFile(mPath.c_str(), mBody))
+		{
+			status = 404;
+		}
+
+		String headers;
+		if (200 == status)
+		{
+			readFile((mPath + ".headers").c_str(), headers);
+		}
+		int line = 0;
+		while (line < headers.size())
+		{
+			int end = headers.find("\n", line);
+			if (end < 0)
+			{
+				end = headers.size();
+			}
+			int colon = headers.find(":", line);
+			if (colon > line && colon < end)
+			{
+				int value = colon + 1;
+				while (value < end && ' ' == headers[value])
+				{
+					++value;
+				}
+				mResponseHeaders.add(lowerCase(
+					headers.substr(line, colon - line).c_str()));
+				mResponseHeaders.add(headers.substr(value, end - value));
+			}
+			line = end + 1;
+		}
+
+		char length[16];
+		sprintf(length, "%d", mBody.size());
+		mResponseHeaders.add("content-length");
+		mResponseHeaders.add(length);
+
+		int etag = findHeader(mResponseHeaders, "etag");
+		int match = findHeader(mRequestHeaders, "if-none-match");
+		if (etag >= 0 && match >= 0
+			&& mResponseHeaders[etag] == mRequestHeaders[match])
+		{
+			status = 304;
+			mBody.clear();
+		}
+
+		((HttpConnectionListener*) mListener)->httpFinished(this, status);
+	}
+}
+
+namespace NativeUI
+{
+	WebView::WebView() :
+		mWidgetHandle(maWidgetCreate("WebView"))
+	{
+	}
+
+	WebView::~WebView()
+	{
+		maWidgetDestroy(mWidgetHandle);
+	}
+
+	MAWidgetHandle WebView::getWidgetHandle() const
+	{
+		return mWidgetHandle;
+	}
+
+	void WebView::callJS(const MAUtil::String& script)
+	{
+		MAUtil::String url = "javascript:";
+		url += script;
+		maWidgetSetProperty(mWidgetHandle, MAW_WEB_VIEW_URL, url.c_str());
+	}
+
+	void WebView::enableZoom()
+	{
+	}
+
+	void WebView::disableZoom()
+	{
+	}
+
+	void WebView::setVisible(bool visible)
+	{
+	}
+}
+
+namespace Wormhole
+{
+	WebAppMoblet::WebAppMoblet() :
+		mWebView(new NativeUI::WebView())
+	{
+	}
+
+	WebAppMoblet::~WebAppMoblet()
+	{
+		delete mWebView;
+	}
+
+	NativeUI::WebView* WebAppMoblet::getWebView()
+	{
+		return mWebView;
+	}
+
+	void WebAppMoblet::enableWebViewMessages()
+	{
+	}
+
+	void WebAppMoblet::showPage(const char* url)
+	{
+	}
+
+	void WebAppMoblet::callJS(const MAUtil::String& script)
+	{
+		mWebView->callJS(script);
+	}
+}
+
+int hostRunDownloads(int maxCount)
+{
+	int count = 0;
+	while (count < maxCount && MAUtil::sRequests.size() > 0)
+	{
+		MAUtil::HttpConnection* connection = MAUtil::sRequests[0];
+		MAUtil::sRequests.remove(0);
+		connection->respond();
+		++count;
+	}
+	return count;
+}
@@ -0,0 +1,52 @@
+/*
+Copyright (C) 2012 MoSync AB
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License,
+version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+*/
+
+/**
+ * @file HostMain.cpp
+ *
+ * Driver of the host build. Runs the application's MAMain
+ * against the stub MoSync API: the moblet's constructor runs
+ * the message benchmarks and replays the newest capture, since
+ * the host build defines MESSAGE_BENCHMARK and MESSAGE_HOST.
+ *
+ * Usage: messagebench [local files directory]
+ *
+ * Captures are read from the local files directory, the
+ * default is the current directory. Copy the captures written
+ * by a MESSAGE_CAPTURE build on a device there.
+ */
+
+#include <ma.h>
+#include <conprint.h>
+
+#include "HostSyscalls.h"
+
+extern "C" int MAMain();
+
+int main(int argc, char** argv)
+{
+	hostSetLocalPath(argc > 1 ? argv[1] : ".");
+
+	int result = MAMain();
+
+	lprintfln("@@@ Host: %d widgets, %d scripts, %d bytes of JavaScript",
+		hostGetWidgetCount(),
+		hostGetScriptCount(),
+		hostGetScriptBytes());
+	return result;
+}
@@ -0,0 +1,749 @@
+/*
+Copyright (C) 2012 MoSync AB
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License,
+version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+*/
+
+/**
+ * @file HostSyscalls.cpp
+ *
+ * Stub of the MoSync syscalls for the host build. Data objects
+ * are kept in memory, files are the files of the host, and
+ * widgets are records of their type, properties and children.
+ * Nothing is drawn: a widget call succeeds when the handles
+ * are valid, so that the message layer does the same work as
+ * on a device and gives the same replies every run.
+ */
+
+#include <ma.h>
+#include <conprint.h>
+
+#include <dirent.h>
+#include <fnmatch.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "HostSyscalls.h"
+
+// Size of the screen returned by maGetScrSize.
+#define HOST_SCREEN_WIDTH 320
+#define HOST_SCREEN_HEIGHT 480
+
+// Prefix of the URLs that web views evaluate as scripts.
+#define HOST_SCRIPT_PREFIX "javascript:"
+
+/**
+ * A data object, image or placeholder.
+ */
+struct HostObject
+{
+	enum Type
+	{
+		FREE,
+		PLACEHOLDER,
+		DATA,
+		IMAGE
+	};
+
+	Type mType;
+	std::string mData;
+	MAExtent mSize;
+};
+
+/**
+ * An open file handle.
+ */
+struct HostFile
+{
+	std::string mPath;
+	FILE* mFile;
+	bool mWritable;
+};
+
+/**
+ * A widget.
+ */
+struct HostWidget
+{
+	std::string mType;
+	std::map<std::string, std::string> mProperties;
+	MAWidgetHandle mParent;
+	std::vector<MAWidgetHandle> mChildren;
+};
+
+/**
+ * An open file list.
+ */
+struct HostFileList
+{
+	DIR* mDir;
+	std::string mPath;
+	std::string mFilter;
+};
+
+// Handles are indexes in these tables. Handle 0 is not used.
+static std::vector<HostObject> sObjects(1);
+static std::vector<HostFile*> sFiles(1);
+static std::vector<HostFileList*> sFileLists(1);
+static std::vector<HostWidget*> sWidgets(1);
+
+static std::string sLocalPath = "./";
+static int sScriptCount = 0;
+static int sScriptBytes = 0;
+
+void hostSetLocalPath(const char* path)
+{
+	sLocalPath = path;
+	if (sLocalPath.empty() || '/' != sLocalPath[sLocalPath.length() - 1])
+	{
+		sLocalPath += '/';
+	}
+}
+
+int hostGetWidgetCount()
+{
+	return (int) sWidgets.size() - 1;
+}
+
+int hostGetScriptCount()
+{
+	return sScriptCount;
+}
+
+int hostGetScriptBytes()
+{
+	return sScriptBytes;
+}
+
+/**
+ * @return The object of a handle, NULL if it is not valid.
+ */
+static HostObject* getObject(MAHandle handle)
+{
+	if (handle <= 0 || handle >= (int) sObjects.size()
+		|| HostObject::FREE == sObjects[handle].mType)
+	{
+		return NULL;
+	}
+	return &sObjects[handle];
+}
+
+/**
+ * @return The file of a handle, NULL if it is not valid.
+ */
+static HostFile* getFile(MAHandle handle)
+{
+	if (handle <= 0 || handle >= (int) sFiles.size())
+	{
+		return NULL;
+	}
+	return sFiles[handle];
+}
+
+/**
+ * @return The open stream of a file, opened on first use.
+ */
+static FILE* getStream(HostFile* file)
+{
+	if (NULL == file->mFile)
+	{
+		file->mFile = fopen(file->mPath.c_str(), file->mWritable ? "r+b" : "rb");
+	}
+	return file->mFile;
+}
+
+/**
+ * @return The widget of a handle, NULL if it is not valid.
+ */
+static HostWidget* getWidget(MAWidgetHandle handle)
+{
+	if (handle <= 0 || handle >= (int) sWidgets.size())
+	{
+		return NULL;
+	}
+	return sWidgets[handle];
+}
+
+/**
+ * Read the size of a PNG image. Other formats get a size of
+ * one pixel, the message layer only uses the size to account
+ * for memory.
+ */
+static MAExtent getImageSize(const unsigned char* data, int size)
+{
+	static const unsigned char signature[8] =
+		{ 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	if (size >= 24 && 0 == memcmp(data, signature, sizeof(signature)))
+	{
+		int width = (data[16] << 24) | (data[17] << 16)
+			| (data[18] << 8) | data[19];
+		int height = (data[20] << 24) | (data[21] << 16)
+			| (data[22] << 8) | data[23];
+		return (width << 16) | (height & 0xFFFF);
+	}
+	return (1 << 16) | 1;
+}
+
+extern "C"
+{
+
+MAHandle maCreatePlaceholder()
+{
+	HostObject object;
+	object.mType = HostObject::PLACEHOLDER;
+	object.mSize = 0;
+	for (int i = 1; i < (int) sObjects.size(); ++i)
+	{
+		if (HostObject::FREE == sObjects[i].mType)
+		{
+			sObjects[i] = object;
+			return i;
+		}
+	}
+	sObjects.push_back(object);
+	return (int) sObjects.size() - 1;
+}
+
+void maDestroyPlaceholder(MAHandle handle)
+{
+	HostObject* object = getObject(handle);
+	if (NULL != object)
+	{
+		object->mType = HostObject::FREE;
+		std::string().swap(object->mData);
+	}
+}
+
+int maCreateData(MAHandle placeholder, int size)
+{
+	HostObject* object = getObject(placeholder);
+	if (NULL == object || size < 0)
+	{
+		return RES_OUT_OF_MEMORY;
+	}
+	object->mType = HostObject::DATA;
+	object->mData.assign(size, 0);
+	return RES_OK;
+}
+
+void maDestroyObject(MAHandle handle)
+{
+	// The handle stays a placeholder, as on a device.
+	HostObject* object = getObject(handle);
+	if (NULL != object)
+	{
+		object->mType = HostObject::PLACEHOLDER;
+		std::string().swap(object->mData);
+		object->mSize = 0;
+	}
+}
+
+int maGetDataSize(MAHandle data)
+{
+	HostObject* object = getObject(data);
+	return NULL == object ? 0 : (int) object->mData.size();
+}
+
+void maReadData(MAHandle data, void* dst, int offset, int size)
+{
+	HostObject* object = getObject(data);
+	if (NULL == object || offset < 0 || size < 0
+		|| offset + size > (int) object->mData.size())
+	{
+		lprintfln("@@@ Host: maReadData out of range");
+		abort();
+	}
+	memcpy(dst, object->mData.data() + offset, size);
+}
+
+void maWriteData(MAHandle data, const void* src, int offset, int size)
+{
+	HostObject* object = getObject(data);
+	if (NULL == object || offset < 0 || size < 0
+		|| offset + size > (int) object->mData.size())
+	{
+		lprintfln("@@@ Host: maWriteData out of range");
+		abort();
+	}
+	memcpy(&object->mData[offset], src, size);
+}
+
+int maCreateImageFromData(
+	MAHandle placeholder,
+	MAHandle data,
+	int offset,
+	int size)
+{
+	HostObject* image = getObject(placeholder);
+	HostObject* source = getObject(data);
+	if (NULL == image || NULL == source || size <= 0
+		|| offset < 0 || offset + size > (int) source->mData.size())
+	{
+		return RES_OUT_OF_MEMORY;
+	}
+	image->mSize = getImageSize(
+		(const unsigned char*) source->mData.data() + offset,
+		size);
+	image->mType = HostObject::IMAGE;
+	return RES_OK;
+}
+
+MAExtent maGetImageSize(MAHandle image)
+{
+	HostObject* object = getObject(image);
+	return NULL == object ? 0 : object->mSize;
+}
+
+MAExtent maGetScrSize()
+{
+	return (HOST_SCREEN_WIDTH << 16) | HOST_SCREEN_HEIGHT;
+}
+
+MAHandle maFileOpen(const char* path, int mode)
+{
+	HostFile* file = new HostFile();
+	file->mPath = path;
+	file->mFile = NULL;
+	file->mWritable = MA_ACCESS_READ_WRITE == mode;
+	sFiles.push_back(file);
+	return (int) sFiles.size() - 1;
+}
+
+int maFileExists(MAHandle handle)
+{
+	HostFile* file = getFile(handle);
+	struct stat info;
+	return NULL != file && 0 == stat(file->mPath.c_str(), &info) ? 1 : 0;
+}
+
+int maFileCreate(MAHandle handle)
+{
+	HostFile* file = getFile(handle);
+	if (NULL == file || !file->mWritable || NULL != file->mFile)
+	{
+		return MA_FERR_GENERIC;
+	}
+	file->mFile = fopen(file->mPath.c_str(), "w+b");
+	return NULL == file->mFile ? MA_FERR_GENERIC : 0;
+}
+
+int maFileDelete(MAHandle handle)
+{
+	HostFile* file = getFile(handle);
+	if (NULL == file || !file->mWritable)
+	{
+		return MA_FERR_GENERIC;
+	}
+	if (NULL != file->mFile)
+	{
+		fclose(file->mFile);
+		file->mFile = NULL;
+	}
+	return 0 == remove(file->mPath.c_str()) ? 0 : MA_FERR_NOTFOUND;
+}
+
+int maFileClose(MAHandle handle)
+{
+	HostFile* file = getFile(handle);
+	if (NULL == file)
+	{
+		return MA_FERR_GENERIC;
+	}
+	if (NULL != file->mFile)
+	{
+		fclose(file->mFile);
+	}
+	delete file;
+	sFiles[handle] = NULL;
+	return 0;
+}
+
+int maFileSize(MAHandle handle)
+{
+	HostFile* file = getFile(handle);
+	struct stat info;
+	if (NULL == file || 0 != stat(file->mPath.c_str(), &info))
+	{
+		return MA_FERR_NOTFOUND;
+	}
+	if (NULL != file->mFile)
+	{
+		fflush(file->mFile);
+		stat(file->mPath.c_str(), &info);
+	}
+	return (int) info.st_size;
+}
+
+int maFileTruncate(MAHandle handle, int offset)
+{
+	HostFile* file = getFile(handle);
+	if (NULL == file || !file->mWritable)
+	{
+		return MA_FERR_GENERIC;
+	}
+	if (NULL != file->mFile)
+	{
+		fflush(file->mFile);
+	}
+	return 0 == truncate(file->mPath.c_str(), offset) ? 0 : MA_FERR_GENERIC;
+}
+
+int maFileSeek(MAHandle handle, int offset, int whence)
+{
+	HostFile* file = getFile(handle);
+	FILE* stream = NULL == file ? NULL : getStream(file);
+	if (NULL == stream)
+	{
+		return MA_FERR_GENERIC;
+	}
+	int origin = MA_SEEK_SET == whence ? SEEK_SET
+		: MA_SEEK_CUR == whence ? SEEK_CUR : SEEK_END;
+	if (0 != fseek(stream, offset, origin))
+	{
+		return MA_FERR_GENERIC;
+	}
+	return (int) ftell(stream);
+}
+
+int maFileRead(MAHandle handle, void* dst, int size)
+{
+	HostFile* file = getFile(handle);
+	FILE* stream = NULL == file ? NULL : getStream(file);
+	if (NULL == stream || fread(dst, 1, size, stream) != (size_t) size)
+	{
+		return MA_FERR_GENERIC;
+	}
+	return 0;
+}
+
+int maFileWrite(MAHandle handle, const void* src, int size)
+{
+	HostFile* file = getFile(handle);
+	FILE* stream = NULL == file || !file->mWritable
+		? NULL : getStream(file);
+	if (NULL == stream || fwrite(src, 1, size, stream) != (size_t) size)
+	{
+		return MA_FERR_GENERIC;
+	}
+	return 0;
+}
+
+int maFileReadToData(MAHandle handle, MAHandle data, int offset, int size)
+{
+	HostObject* object = getObject(data);
+	if (NULL == object || offset < 0 || size < 0
+		|| offset + size > (int) object->mData.size())
+	{
+		return MA_FERR_GENERIC;
+	}
+	return maFileRead(handle, &object->mData[offset], size);
+}
+
+int maFileWriteFromData(MAHandle handle, MAHandle data, int offset, int size)
+{
+	HostObject* object = getObject(data);
+	if (NULL == object || offset < 0 || size < 0
+		|| offset + size > (int) object->mData.size())
+	{
+		return MA_FERR_GENERIC;
+	}
+	return maFileWrite(handle, object->mData.data() + offset, size);
+}
+
+MAHandle maFileListStart(const char* path, const char* filter, int sorting)
+{
+	DIR* dir = opendir(path);
+	if (NULL == dir)
+	{
+		return MA_FERR_NOTFOUND;
+	}
+	HostFileList* list = new HostFileList();
+	list->mDir = dir;
+	list->mPath = path;
+	list->mFilter = (NULL == filter || 0 == *filter) ? "*" : filter;
+	sFileLists.push_back(list);
+	return (int) sFileLists.size() - 1;
+}
+
+int maFileListNext(MAHandle handle, char* nameBuf, int bufSize)
+{
+	if (handle <= 0 || handle >= (int) sFileLists.size()
+		|| NULL == sFileLists[handle])
+	{
+		return MA_FERR_GENERIC;
+	}
+	HostFileList* list = sFileLists[handle];
+	struct dirent* entry;
+	while (NULL != (entry = readdir(list->mDir)))
+	{
+		if (0 == strcmp(".", entry->d_name)
+			|| 0 == strcmp("..", entry->d_name)
+			|| 0 != fnmatch(list->mFilter.c_str(), entry->d_name, 0))
+		{
+			continue;
+		}
+
+		// Directories end with a slash, as on a device.
+		std::string name = entry->d_name;
+		struct stat info;
+		if (0 == stat((list->mPath + name).c_str(), &info)
+			&& S_ISDIR(info.st_mode))
+		{
+			name += '/';
+		}
+		int length = (int) name.length();
+		if (length < bufSize)
+		{
+			memcpy(nameBuf, name.c_str(), length + 1);
+		}
+		return length;
+	}
+	return 0;
+}
+
+int maFileListClose(MAHandle handle)
+{
+	if (handle <= 0 || handle >= (int) sFileLists.size()
+		|| NULL == sFileLists[handle])
+	{
+		return MA_FERR_GENERIC;
+	}
+	closedir(sFileLists[handle]->mDir);
+	delete sFileLists[handle];
+	sFileLists[handle] = NULL;
+	return 0;
+}
+
+MAWidgetHandle maWidgetCreate(const char* widgetType)
+{
+	HostWidget* widget = new HostWidget();
+	widget->mType = widgetType;
+	widget->mParent = 0;
+	sWidgets.push_back(widget);
+	return (int) sWidgets.size() - 1;
+}
+
+int maWidgetDestroy(MAWidgetHandle handle)
+{
+	HostWidget* widget = getWidget(handle);
+	if (NULL == widget)
+	{
+		return MAW_RES_INVALID_HANDLE;
+	}
+	maWidgetRemoveChild(handle);
+	for (size_t i = 0; i < widget->mChildren.size(); ++i)
+	{
+		maWidgetDestroy(widget->mChildren[i]);
+	}
+	delete widget;
+	sWidgets[handle] = NULL;
+	return MAW_RES_OK;
+}
+
+int maWidgetInsertChild(
+	MAWidgetHandle parentHandle,
+	MAWidgetHandle childHandle,
+	int index)
+{
+	HostWidget* parent = getWidget(parentHandle);
+	HostWidget* child = getWidget(childHandle);
+	if (NULL == parent || NULL == child || parent == child)
+	{
+		return MAW_RES_INVALID_HANDLE;
+	}
+	if (0 != child->mParent)
+	{
+		return MAW_RES_ERROR;
+	}
+	if (index < 0 || index > (int) parent->mChildren.size())
+	{
+		index = (int) parent->mChildren.size();
+	}
+	parent->mChildren.insert(parent->mChildren.begin() + index, childHandle);
+	child->mParent = parentHandle;
+	return MAW_RES_OK;
+}
+
+int maWidgetAddChild(MAWidgetHandle parent, MAWidgetHandle child)
+{
+	return maWidgetInsertChild(parent, child, -1);
+}
+
+int maWidgetRemoveChild(MAWidgetHandle childHandle)
+{
+	HostWidget* child = getWidget(childHandle);
+	if (NULL == child)
+	{
+		return MAW_RES_INVALID_HANDLE;
+	}
+	HostWidget* parent = getWidget(child->mParent);
+	if (NULL != parent)
+	{
+		for (size_t i = 0; i < parent->mChildren.size(); ++i)
+		{
+			if (childHandle == parent->mChildren[i])
+			{
+				parent->mChildren.erase(parent->mChildren.begin() + i);
+				break;
+			}
+		}
+	}
+	child->mParent = 0;
+	return MAW_RES_OK;
+}
+
+int maWidgetModalDialogShow(MAWidgetHandle dialog)
+{
+	return NULL == getWidget(dialog) ? MAW_RES_INVALID_HANDLE : MAW_RES_OK;
+}
+
+int maWidgetModalDialogHide(MAWidgetHandle dialog)
+{
+	return NULL == getWidget(dialog) ? MAW_RES_INVALID_HANDLE : MAW_RES_OK;
+}
+
+int maWidgetScreenShow(MAWidgetHandle screen)
+{
+	return NULL == getWidget(screen) ? MAW_RES_INVALID_HANDLE : MAW_RES_OK;
+}
+
+int maWidgetStackScreenPush(
+	MAWidgetHandle stackScreen,
+	MAWidgetHandle screen)
+{
+	return NULL == getWidget(stackScreen) || NULL == getWidget(screen)
+		? MAW_RES_INVALID_HANDLE : MAW_RES_OK;
+}
+
+int maWidgetStackScreenPop(MAWidgetHandle stackScreen)
+{
+	return NULL == getWidget(stackScreen)
+		? MAW_RES_INVALID_HANDLE : MAW_RES_OK;
+}
+
+int maWidgetSetProperty(
+	MAWidgetHandle handle,
+	const char* property,
+	const char* value)
+{
+	HostWidget* widget = getWidget(handle);
+	if (NULL == widget)
+	{
+		return MAW_RES_INVALID_HANDLE;
+	}
+
+	// Scripts are counted instead of stored.
+	if ("WebView" == widget->mType
+		&& 0 == strcmp(MAW_WEB_VIEW_URL, property)
+		&& 0 == strncmp(
+			HOST_SCRIPT_PREFIX,
+			value,
+			sizeof(HOST_SCRIPT_PREFIX) - 1))
+	{
+		++sScriptCount;
+		sScriptBytes += strlen(value) - (sizeof(HOST_SCRIPT_PREFIX) - 1);
+		return MAW_RES_OK;
+	}
+
+	widget->mProperties[property] = value;
+	return MAW_RES_OK;
+}
+
+int maWidgetGetProperty(
+	MAWidgetHandle handle,
+	const char* property,
+	char* value,
+	int bufSize)
+{
+	HostWidget* widget = getWidget(handle);
+	if (NULL == widget)
+	{
+		return MAW_RES_INVALID_HANDLE;
+	}
+
+	// Properties that were never set are empty.
+	std::string text;
+	std::map<std::string, std::string>::const_iterator i =
+		widget->mProperties.find(property);
+	if (widget->mProperties.end() != i)
+	{
+		text = i->second;
+	}
+	if ((int) text.length() >= bufSize)
+	{
+		return MAW_RES_INVALID_STRING_BUFFER_SIZE;
+	}
+	memcpy(value, text.c_str(), text.length() + 1);
+	return (int) text.length();
+}
+
+int maGetMilliSecondCount()
+{
+	static long long sStart = -1;
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	long long ms = (long long) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+	if (sStart < 0)
+	{
+		sStart = ms;
+	}
+	return (int) (ms - sStart);
+}
+
+int maTime()
+{
+	return (int) time(NULL);
+}
+
+int maGetSystemProperty(const char* key, char* buf, int size)
+{
+	if (0 != strcmp("mosync.path.local", key))
+	{
+		return -2;
+	}
+	int length = (int) sLocalPath.length() + 1;
+	if (length <= size)
+	{
+		memcpy(buf, sLocalPath.c_str(), length);
+	}
+	return length;
+}
+
+int maWriteLog(const void* src, int size)
+{
+	fwrite(src, 1, size, stdout);
+	return 0;
+}
+
+int lprintfln(const char* format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	int result = vprintf(format, args);
+	va_end(args);
+	putchar('\n');
+	return result;
+}
+
+}
@@ -0,0 +1,62 @@
+/*
+Copyright (C) 2012 MoSync AB
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License,
+version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+*/
+
+/**
+ * @file HostSyscalls.h
+ *
+ * Functions of the stub MoSync API that only the host driver
+ * uses: where local files are kept, and counters of the work
+ * done through the stub widget API.
+ */
+
+#ifndef HOST_SYSCALLS_H_
+#define HOST_SYSCALLS_H_
+
+/**
+ * Set the directory returned as the "mosync.path.local"
+ * system property. The default is the current directory.
+ */
+void hostSetLocalPath(const char* path);
+
+/**
+ * @return Number of widgets created.
+ */
+int hostGetWidgetCount();
+
+/**
+ * @return Number of scripts evaluated by web views.
+ */
+int hostGetScriptCount();
+
+/**
+ * @return Number of bytes of scripts evaluated by web views.
+ */
+int hostGetScriptBytes();
+
+/**
+ * Answer HTTP requests finished on MAUtil::HttpConnection, in
+ * the order they were finished. Requests finished while this
+ * runs, for example by listeners, are answered too if the
+ * count allows.
+ *
+ * @param maxCount Largest number of requests to answer.
+ * @return Number of requests answered.
+ */
+int hostRunDownloads(int maxCount);
+
+#endif
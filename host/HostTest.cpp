@@ -0,0 +1,326 @@
+/*
+Copyright (C) 2012 MoSync AB
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License,
+version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+*/
+
+/**
+ * @file HostTest.cpp
+ *
+ * Tests of the message layer that need the host stubs to
+ * stand in for the platform. Run with "make test".
+ *
+ * ImageDownloadPool is tested with file:// URLs, which the
+ * host HttpConnection reads from a temporary directory when
+ * the test calls hostRunDownloads.
+ */
+
+#include <ma.h>
+#include <conprint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#include "HostSyscalls.h"
+#include "ImageDownloadPool.h"
+#include "ScriptBuilder.h"
+
+/**
+ * Number of failed checks.
+ */
+static int sFailures = 0;
+
+/**
+ * Count and log a failed check.
+ */
+#define CHECK(condition) \
+	do \
+	{ \
+		if (!(condition)) \
+		{ \
+			lprintfln("@@@ Test: %s:%d: %s failed", \
+				__FILE__, __LINE__, #condition); \
+			++sFailures; \
+		} \
+	} while (0)
+
+/**
+ * Directory of the files the downloads read.
+ */
+static std::string sDirectory;
+
+/**
+ * Write a PNG header of the given size to a file in the test
+ * directory.
+ * @return The file:// URL of the file.
+ */
+static std::string writeImage(const char* name, int width, int height)
+{
+	unsigned char header[24] =
+		{ 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	header[16] = (unsigned char) (width >> 24);
+	header[17] = (unsigned char) (width >> 16);
+	header[18] = (unsigned char) (width >> 8);
+	header[19] = (unsigned char) width;
+	header[20] = (unsigned char) (height >> 24);
+	header[21] = (unsigned char) (height >> 16);
+	header[22] = (unsigned char) (height >> 8);
+	header[23] = (unsigned char) height;
+
+	std::string path = sDirectory + "/" + name;
+	FILE* file = fopen(path.c_str(), "wb");
+	fwrite(header, 1, sizeof(header), file);
+	fclose(file);
+	return "file://" + path;
+}
+
+/**
+ * @return The file:// URL of a file that does not exist.
+ */
+static std::string missingImage(const char* name)
+{
+	return "file://" + sDirectory + "/" + name;
+}
+
+/**
+ * Records the results of the downloads of a pool.
+ */
+class PoolRecorder : public ImageDownloadPoolListener
+{
+public:
+	struct Result
+	{
+		std::string mURL;
+		MAHandle mImage;
+		int mCode;
+		int mSize;
+		std::string mETag;
+		std::string mLastModified;
+	};
+
+	void imageDownloadFinished(
+		const char* url,
+		MAHandle image,
+		MAHandle data,
+		const char* etag,
+		const char* lastModified)
+	{
+		Result result =
+			{ url, image, 0, maGetDataSize(data), etag, lastModified };
+		mResults.push_back(result);
+		maDestroyObject(data);
+	}
+
+	void imageDownloadFailed(const char* url, MAHandle image, int code)
+	{
+		Result result = { url, image, code, 0, "", "" };
+		mResults.push_back(result);
+	}
+
+	std::vector<Result> mResults;
+};
+
+/**
+ * Requests for a URL that is queued or downloading share the
+ * download and its handle, and get one result.
+ */
+static void testDownloadSharing()
+{
+	std::string a = writeImage("share-a.png", 10, 20);
+	std::string b = writeImage("share-b.png", 30, 40);
+
+	PoolRecorder recorder;
+	ImageDownloadPool pool(&recorder, 1);
+
+	MAHandle running = pool.request(a.c_str());
+	MAHandle queued = pool.request(b.c_str());
+	CHECK(running > 0);
+	CHECK(queued > 0 && queued != running);
+	CHECK(pool.request(a.c_str()) == running);
+	CHECK(pool.request(b.c_str()) == queued);
+	CHECK(pool.getSharedCount() == 2);
+	CHECK(pool.getQueueLength() == 1);
+
+	CHECK(hostRunDownloads(10) == 2);
+	CHECK(recorder.mResults.size() == 2);
+	CHECK(pool.getFinishedCount() == 2);
+	if (2 == recorder.mResults.size())
+	{
+		CHECK(recorder.mResults[0].mURL == a);
+		CHECK(recorder.mResults[0].mImage == running);
+		CHECK(recorder.mResults[1].mURL == b);
+		CHECK(recorder.mResults[1].mImage == queued);
+		CHECK(EXTENT_X(maGetImageSize(queued)) == 30);
+		CHECK(EXTENT_Y(maGetImageSize(queued)) == 40);
+	}
+
+	// A finished download is not shared, the URL is
+	// downloaded again.
+	MAHandle again = pool.request(a.c_str());
+	CHECK(again > 0);
+	CHECK(pool.getSharedCount() == 2);
+	CHECK(hostRunDownloads(10) == 1);
+}
+
+/**
+ * Queued requests start by priority, highest first, and in
+ * request order within a priority. A shared request raises
+ * the priority of the queued download.
+ */
+static void testPriorityOrder()
+{
+	std::string first = writeImage("order-first.png", 1, 1);
+	std::string low = writeImage("order-low.png", 1, 1);
+	std::string high1 = writeImage("order-high1.png", 1, 1);
+	std::string high2 = writeImage("order-high2.png", 1, 1);
+	std::string raised = writeImage("order-raised.png", 1, 1);
+
+	PoolRecorder recorder;
+	ImageDownloadPool pool(&recorder, 1);
+
+	pool.request(first.c_str(), 0);
+	pool.request(low.c_str(), 1);
+	pool.request(high1.c_str(), 5);
+	pool.request(raised.c_str(), 0);
+	pool.request(high2.c_str(), 5);
+	pool.request(raised.c_str(), 9);
+	CHECK(pool.getQueueLength() == 4);
+	CHECK(pool.getMaxQueueLength() == 4);
+
+	CHECK(hostRunDownloads(10) == 5);
+	CHECK(recorder.mResults.size() == 5);
+	if (5 == recorder.mResults.size())
+	{
+		CHECK(recorder.mResults[0].mURL == first);
+		CHECK(recorder.mResults[1].mURL == raised);
+		CHECK(recorder.mResults[2].mURL == high1);
+		CHECK(recorder.mResults[3].mURL == high2);
+		CHECK(recorder.mResults[4].mURL == low);
+	}
+	CHECK(pool.getMaxActiveCount() == 1);
+}
+
+/**
+ * A failed download gives one failure for the handle that all
+ * requests of the URL share, and the queue goes on with the
+ * next request. A download that cannot start fails at once.
+ */
+static void testFailure()
+{
+	std::string missing = missingImage("fail-missing.png");
+	std::string next = writeImage("fail-next.png", 1, 1);
+
+	PoolRecorder recorder;
+	ImageDownloadPool pool(&recorder, 1);
+
+	MAHandle image = pool.request(missing.c_str());
+	CHECK(pool.request(missing.c_str()) == image);
+	CHECK(pool.request(missing.c_str()) == image);
+	MAHandle nextImage = pool.request(next.c_str());
+
+	CHECK(hostRunDownloads(10) == 2);
+	CHECK(recorder.mResults.size() == 2);
+	if (2 == recorder.mResults.size())
+	{
+		CHECK(recorder.mResults[0].mImage == image);
+		CHECK(recorder.mResults[0].mCode < 0);
+		CHECK(recorder.mResults[1].mImage == nextImage);
+		CHECK(recorder.mResults[1].mCode == 0);
+	}
+	CHECK(pool.getFailedCount() == 1);
+	CHECK(pool.getFinishedCount() == 1);
+
+	// There is no network on the host.
+	CHECK(pool.request("http://localhost/none.png") < 0);
+	CHECK(pool.getFailedCount() == 2);
+	CHECK(recorder.mResults.size() == 2);
+}
+
+/**
+ * The ETag and Last-Modified headers of a download are passed
+ * to the listener, for the disk cache to store. Downloads
+ * without them pass empty strings.
+ */
+static void testValidators()
+{
+	std::string tagged = writeImage("validators-tagged.png", 1, 1);
+	std::string plain = writeImage("validators-plain.png", 1, 1);
+
+	std::string path = tagged.substr(strlen("file://")) + ".headers";
+	FILE* file = fopen(path.c_str(), "wb");
+	fputs("ETag: \"v1\"\n", file);
+	fputs("Last-Modified: Wed, 01 Feb 2012 10:00:00 GMT\n", file);
+	fclose(file);
+
+	PoolRecorder recorder;
+	ImageDownloadPool pool(&recorder, 2);
+
+	pool.request(tagged.c_str());
+	pool.request(plain.c_str());
+	CHECK(hostRunDownloads(10) == 2);
+	CHECK(recorder.mResults.size() == 2);
+	if (2 == recorder.mResults.size())
+	{
+		CHECK(recorder.mResults[0].mCode == 0);
+		CHECK(recorder.mResults[0].mSize == 24);
+		CHECK(recorder.mResults[0].mETag == "\"v1\"");
+		CHECK(recorder.mResults[0].mLastModified
+			== "Wed, 01 Feb 2012 10:00:00 GMT");
+		CHECK(recorder.mResults[1].mCode == 0);
+		CHECK(recorder.mResults[1].mETag.empty());
+		CHECK(recorder.mResults[1].mLastModified.empty());
+	}
+}
+
+/**
+ * Strings are escaped so that the literal survives the percent
+ * decoding of javascript: URLs.
+ */
+static void testScriptEscapes()
+{
+	Wormhole::ScriptBuilder script;
+	script.appendString("50% done\n'a\\b'");
+	CHECK(0 == strcmp(script.c_str(),
+		"'50\\x25 done\\n\\'a\\\\b\\''"));
+}
+
+int main(int argc, char** argv)
+{
+	char directory[] = "/tmp/hosttest-XXXXXX";
+	if (NULL == mkdtemp(directory))
+	{
+		lprintfln("@@@ Test: could not create %s", directory);
+		return 1;
+	}
+	sDirectory = directory;
+
+	testDownloadSharing();
+	testPriorityOrder();
+	testFailure();
+	testValidators();
+	testScriptEscapes();
+
+	std::string command = "rm -rf " + sDirectory;
+	if (0 != system(command.c_str()))
+	{
+		lprintfln("@@@ Test: could not remove %s", directory);
+	}
+
+	lprintfln("@@@ Test: %d failures", sFailures);
+	return 0 == sFailures ? 0 : 1;
+}
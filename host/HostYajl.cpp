@@ -0,0 +1,561 @@
+/*
+Copyright (C) 2012 MoSync AB
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License,
+version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+*/
+
+/**
+ * @file HostYajl.cpp
+ *
+ * JSON parser with the yajl 1.x callback interface, for the
+ * host build. It parses a whole document per call of
+ * yajl_parse, which is how MessageJSON uses yajl. Strings
+ * without escapes are passed to the callbacks in place,
+ * strings with escapes are decoded into a buffer allocated
+ * with the allocation functions of the handle.
+ */
+
+#include <string.h>
+#include <yajl/yajl_parse.h>
+
+// Maximum nesting of maps and arrays.
+#define HOST_YAJL_MAX_DEPTH 128
+
+struct yajl_handle_t
+{
+	yajl_callbacks mCallbacks;
+	yajl_alloc_funcs mAllocFuncs;
+	void* mContext;
+
+	/**
+	 * Position in the document and its end.
+	 */
+	const unsigned char* mPosition;
+	const unsigned char* mEnd;
+
+	/**
+	 * Buffer for decoded strings.
+	 */
+	unsigned char* mBuffer;
+	unsigned int mBufferSize;
+
+	/**
+	 * Status of the last call of yajl_parse.
+	 */
+	yajl_status mStatus;
+};
+
+/**
+ * Skip white space.
+ * @return false at the end of the document.
+ */
+static bool skipSpace(yajl_handle h)
+{
+	while (h->mPosition < h->mEnd)
+	{
+		unsigned char c = *h->mPosition;
+		if (' ' != c && '\t' != c && '\r' != c && '\n' != c)
+		{
+			return true;
+		}
+		++h->mPosition;
+	}
+	return false;
+}
+
+/**
+ * Make the string buffer at least size bytes.
+ */
+static bool reserveBuffer(yajl_handle h, unsigned int size)
+{
+	if (size <= h->mBufferSize)
+	{
+		return true;
+	}
+	unsigned int newSize = h->mBufferSize > 0 ? h->mBufferSize : 64;
+	while (newSize < size)
+	{
+		newSize *= 2;
+	}
+	unsigned char* buffer = (unsigned char*) (NULL == h->mBuffer
+		? h->mAllocFuncs.malloc(h->mAllocFuncs.ctx, newSize)
+		: h->mAllocFuncs.realloc(h->mAllocFuncs.ctx, h->mBuffer, newSize));
+	if (NULL == buffer)
+	{
+		return false;
+	}
+	h->mBuffer = buffer;
+	h->mBufferSize = newSize;
+	return true;
+}
+
+/**
+ * @return The value of a hex digit, -1 if it is not one.
+ */
+static int hexDigit(unsigned char c)
+{
+	if (c >= '0' && c <= '9')
+	{
+		return c - '0';
+	}
+	if (c >= 'a' && c <= 'f')
+	{
+		return c - 'a' + 10;
+	}
+	if (c >= 'A' && c <= 'F')
+	{
+		return c - 'A' + 10;
+	}
+	return -1;
+}
+
+/**
+ * Write a code point as UTF-8.
+ * @return Number of bytes written.
+ */
+static int writeUTF8(unsigned char* dst, unsigned int c)
+{
+	if (c < 0x80)
+	{
+		dst[0] = (unsigned char) c;
+		return 1;
+	}
+	if (c < 0x800)
+	{
+		dst[0] = (unsigned char) (0xC0 | (c >> 6));
+		dst[1] = (unsigned char) (0x80 | (c & 0x3F));
+		return 2;
+	}
+	if (c < 0x10000)
+	{
+		dst[0] = (unsigned char) (0xE0 | (c >> 12));
+		dst[1] = (unsigned char) (0x80 | ((c >> 6) & 0x3F));
+		dst[2] = (unsigned char) (0x80 | (c & 0x3F));
+		return 3;
+	}
+	dst[0] = (unsigned char) (0xF0 | (c >> 18));
+	dst[1] = (unsigned char) (0x80 | ((c >> 12) & 0x3F));
+	dst[2] = (unsigned char) (0x80 | ((c >> 6) & 0x3F));
+	dst[3] = (unsigned char) (0x80 | (c & 0x3F));
+	return 4;
+}
+
+/**
+ * Read four hex digits of a \u escape.
+ * @return The value, -1 on error.
+ */
+static int readHex4(const unsigned char* p, const unsigned char* end)
+{
+	if (end - p < 4)
+	{
+		return -1;
+	}
+	int value = 0;
+	for (int i = 0; i < 4; ++i)
+	{
+		int digit = hexDigit(p[i]);
+		if (digit < 0)
+		{
+			return -1;
+		}
+		value = value * 16 + digit;
+	}
+	return value;
+}
+
+/**
+ * Read a string at the current position, which is at the
+ * opening quote.
+ * @param text Set to the string, in the document or in the
+ * string buffer of the handle.
+ * @param length Set to the length of the string.
+ */
+static yajl_status parseString(
+	yajl_handle h,
+	const unsigned char** text,
+	unsigned int* length)
+{
+	const unsigned char* start = ++h->mPosition;
+	const unsigned char* p = start;
+	bool escaped = false;
+	while (p < h->mEnd && '"' != *p)
+	{
+		if ('\\' == *p)
+		{
+			escaped = true;
+			++p;
+		}
+		++p;
+	}
+	if (p >= h->mEnd)
+	{
+		return yajl_status_insufficient_data;
+	}
+	h->mPosition = p + 1;
+
+	if (!escaped)
+	{
+		*text = start;
+		*length = p - start;
+		return yajl_status_ok;
+	}
+
+	// A decoded string is never longer than the escaped one.
+	if (!reserveBuffer(h, p - start))
+	{
+		return yajl_status_error;
+	}
+	unsigned char* dst = h->mBuffer;
+	const unsigned char* end = p;
+	p = start;
+	while (p < end)
+	{
+		if ('\\' != *p)
+		{
+			*dst++ = *p++;
+			continue;
+		}
+		++p;
+		switch (*p++)
+		{
+			case '"': *dst++ = '"'; break;
+			case '\\': *dst++ = '\\'; break;
+			case '/': *dst++ = '/'; break;
+			case 'b': *dst++ = '\b'; break;
+			case 'f': *dst++ = '\f'; break;
+			case 'n': *dst++ = '\n'; break;
+			case 'r': *dst++ = '\r'; break;
+			case 't': *dst++ = '\t'; break;
+			case 'u':
+			{
+				int c = readHex4(p, end);
+				if (c < 0)
+				{
+					return yajl_status_error;
+				}
+				p += 4;
+				unsigned int codePoint = c;
+				// Surrogate pair.
+				if (c >= 0xD800 && c < 0xDC00
+					&& end - p >= 6 && '\\' == p[0] && 'u' == p[1])
+				{
+					int low = readHex4(p + 2, end);
+					if (low >= 0xDC00 && low < 0xE000)
+					{
+						codePoint = 0x10000
+							+ ((c - 0xD800) << 10) + (low - 0xDC00);
+						p += 6;
+					}
+				}
+				dst += writeUTF8(dst, codePoint);
+				break;
+			}
+			default:
+				return yajl_status_error;
+		}
+	}
+	*text = h->mBuffer;
+	*length = dst - h->mBuffer;
+	return yajl_status_ok;
+}
+
+/**
+ * Read a number at the current position.
+ */
+static yajl_status parseNumber(yajl_handle h)
+{
+	const unsigned char* start = h->mPosition;
+	const unsigned char* p = start;
+	if (p < h->mEnd && '-' == *p)
+	{
+		++p;
+	}
+	const unsigned char* digits = p;
+	while (p < h->mEnd
+		&& ((*p >= '0' && *p <= '9')
+			|| '.' == *p || 'e' == *p || 'E' == *p
+			|| '+' == *p || '-' == *p))
+	{
+		++p;
+	}
+	if (p == digits)
+	{
+		return yajl_status_error;
+	}
+	h->mPosition = p;
+
+	if (NULL != h->mCallbacks.yajl_number
+		&& !h->mCallbacks.yajl_number(
+			h->mContext,
+			(const char*) start,
+			p - start))
+	{
+		return yajl_status_client_canceled;
+	}
+	return yajl_status_ok;
+}
+
+/**
+ * Check for a literal at the current position.
+ */
+static bool matchLiteral(yajl_handle h, const char* literal)
+{
+	int length = strlen(literal);
+	if (h->mEnd - h->mPosition < length
+		|| 0 != memcmp(h->mPosition, literal, length))
+	{
+		return false;
+	}
+	h->mPosition += length;
+	return true;
+}
+
+/**
+ * Read a value at the current position.
+ */
+static yajl_status parseValue(yajl_handle h, int depth)
+{
+	if (!skipSpace(h))
+	{
+		return yajl_status_insufficient_data;
+	}
+	if (depth > HOST_YAJL_MAX_DEPTH)
+	{
+		return yajl_status_error;
+	}
+
+	const yajl_callbacks& callbacks = h->mCallbacks;
+	void* ctx = h->mContext;
+	yajl_status status;
+	unsigned char c = *h->mPosition;
+
+	if ('{' == c)
+	{
+		++h->mPosition;
+		if (NULL != callbacks.yajl_start_map
+			&& !callbacks.yajl_start_map(ctx))
+		{
+			return yajl_status_client_canceled;
+		}
+		if (!skipSpace(h))
+		{
+			return yajl_status_insufficient_data;
+		}
+		if ('}' != *h->mPosition)
+		{
+			for (;;)
+			{
+				if (!skipSpace(h))
+				{
+					return yajl_status_insufficient_data;
+				}
+				if ('"' != *h->mPosition)
+				{
+					return yajl_status_error;
+				}
+				const unsigned char* key;
+				unsigned int keyLength;
+				status = parseString(h, &key, &keyLength);
+				if (yajl_status_ok != status)
+				{
+					return status;
+				}
+				if (NULL != callbacks.yajl_map_key
+					&& !callbacks.yajl_map_key(ctx, key, keyLength))
+				{
+					return yajl_status_client_canceled;
+				}
+				if (!skipSpace(h))
+				{
+					return yajl_status_insufficient_data;
+				}
+				if (':' != *h->mPosition)
+				{
+					return yajl_status_error;
+				}
+				++h->mPosition;
+				status = parseValue(h, depth + 1);
+				if (yajl_status_ok != status)
+				{
+					return status;
+				}
+				if (!skipSpace(h))
+				{
+					return yajl_status_insufficient_data;
+				}
+				if (',' != *h->mPosition)
+				{
+					break;
+				}
+				++h->mPosition;
+			}
+			if ('}' != *h->mPosition)
+			{
+				return yajl_status_error;
+			}
+		}
+		++h->mPosition;
+		if (NULL != callbacks.yajl_end_map
+			&& !callbacks.yajl_end_map(ctx))
+		{
+			return yajl_status_client_canceled;
+		}
+		return yajl_status_ok;
+	}
+
+	if ('[' == c)
+	{
+		++h->mPosition;
+		if (NULL != callbacks.yajl_start_array
+			&& !callbacks.yajl_start_array(ctx))
+		{
+			return yajl_status_client_canceled;
+		}
+		if (!skipSpace(h))
+		{
+			return yajl_status_insufficient_data;
+		}
+		if (']' != *h->mPosition)
+		{
+			for (;;)
+			{
+				status = parseValue(h, depth + 1);
+				if (yajl_status_ok != status)
+				{
+					return status;
+				}
+				if (!skipSpace(h))
+				{
+					return yajl_status_insufficient_data;
+				}
+				if (',' != *h->mPosition)
+				{
+					break;
+				}
+				++h->mPosition;
+			}
+			if (']' != *h->mPosition)
+			{
+				return yajl_status_error;
+			}
+		}
+		++h->mPosition;
+		if (NULL != callbacks.yajl_end_array
+			&& !callbacks.yajl_end_array(ctx))
+		{
+			return yajl_status_client_canceled;
+		}
+		return yajl_status_ok;
+	}
+
+	if ('"' == c)
+	{
+		const unsigned char* text;
+		unsigned int length;
+		status = parseString(h, &text, &length);
+		if (yajl_status_ok != status)
+		{
+			return status;
+		}
+		if (NULL != callbacks.yajl_string
+			&& !callbacks.yajl_string(ctx, text, length))
+		{
+			return yajl_status_client_canceled;
+		}
+		return yajl_status_ok;
+	}
+
+	if (matchLiteral(h, "null"))
+	{
+		if (NULL != callbacks.yajl_null && !callbacks.yajl_null(ctx))
+		{
+			return yajl_status_client_canceled;
+		}
+		return yajl_status_ok;
+	}
+
+	bool isTrue = matchLiteral(h, "true");
+	if (isTrue || matchLiteral(h, "false"))
+	{
+		if (NULL != callbacks.yajl_boolean
+			&& !callbacks.yajl_boolean(ctx, isTrue ? 1 : 0))
+		{
+			return yajl_status_client_canceled;
+		}
+		return yajl_status_ok;
+	}
+
+	return parseNumber(h);
+}
+
+extern "C" yajl_handle yajl_alloc(
+	const yajl_callbacks* callbacks,
+	const yajl_parser_config* config,
+	const yajl_alloc_funcs* allocFuncs,
+	void* ctx)
+{
+	yajl_handle h = (yajl_handle) allocFuncs->malloc(
+		allocFuncs->ctx,
+		sizeof(yajl_handle_t));
+	if (NULL == h)
+	{
+		return NULL;
+	}
+	h->mCallbacks = *callbacks;
+	h->mAllocFuncs = *allocFuncs;
+	h->mContext = ctx;
+	h->mPosition = NULL;
+	h->mEnd = NULL;
+	h->mBuffer = NULL;
+	h->mBufferSize = 0;
+	h->mStatus = yajl_status_ok;
+	return h;
+}
+
+extern "C" void yajl_free(yajl_handle h)
+{
+	if (NULL == h)
+	{
+		return;
+	}
+	if (NULL != h->mBuffer)
+	{
+		h->mAllocFuncs.free(h->mAllocFuncs.ctx, h->mBuffer);
+	}
+	h->mAllocFuncs.free(h->mAllocFuncs.ctx, h);
+}
+
+extern "C" yajl_status yajl_parse(
+	yajl_handle h,
+	const unsigned char* jsonText,
+	unsigned int jsonTextLength)
+{
+	h->mPosition = jsonText;
+	h->mEnd = jsonText + jsonTextLength;
+	h->mStatus = parseValue(h, 0);
+
+	// Only white space may follow the document.
+	if (yajl_status_ok == h->mStatus && skipSpace(h))
+	{
+		h->mStatus = yajl_status_error;
+	}
+	return h->mStatus;
+}
+
+extern "C" yajl_status yajl_parse_complete(yajl_handle h)
+{
+	return yajl_status_insufficient_data == h->mStatus
+		? yajl_status_error : h->mStatus;
+}
@@ -0,0 +1,114 @@
+/*
+Copyright (C) 2012 MoSync AB
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License,
+version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+*/
+
+/**
+ * @file Connection.h
+ *
+ * Stub of MAUtil::Connection for the host build. There is no
+ * network: only file:// URLs can be requested, and they are
+ * answered by hostRunDownloads. A missing file gives status
+ * 404. Response headers are read from "<file>.headers", one
+ * "name: value" per line, and a request whose If-None-Match
+ * header matches the ETag gives status 304.
+ */
+
+#ifndef HOST_MAUTIL_CONNECTION_H_
+#define HOST_MAUTIL_CONNECTION_H_
+
+#include <ma.h>
+#include "String.h"
+#include "Vector.h"
+
+namespace MAUtil
+{
+
+class Connection;
+class HttpConnection;
+
+class ConnectionListener
+{
+public:
+	virtual ~ConnectionListener() {}
+	virtual void connectFinished(Connection* connection, int result) {}
+	virtual void connRecvFinished(Connection* connection, int result) {}
+	virtual void connWriteFinished(Connection* connection, int result) {}
+	virtual void connReadFinished(Connection* connection, int result) {}
+};
+
+class HttpConnectionListener : public ConnectionListener
+{
+public:
+	virtual void httpFinished(HttpConnection* connection, int result) = 0;
+};
+
+class Connection
+{
+public:
+	Connection(ConnectionListener* listener);
+	virtual ~Connection();
+
+	bool isOpen() const;
+	void close();
+	void recv(void* dst, int maxSize);
+	void read(void* dst, int size);
+	void readToData(MAHandle data, int offset, int size);
+
+protected:
+	ConnectionListener* mListener;
+	bool mOpen;
+
+	/**
+	 * Bytes that can be read, and the number already read.
+	 */
+	String mBody;
+	int mBodyRead;
+};
+
+class HttpConnection : public Connection
+{
+public:
+	HttpConnection(HttpConnectionListener* listener);
+	~HttpConnection();
+
+	int create(const char* url, int method);
+	void setRequestHeader(const char* key, const char* value);
+	int getResponseHeader(const char* key, String* value);
+	void finish();
+
+	/**
+	 * Read the file and call httpFinished. Called by
+	 * hostRunDownloads for finished requests.
+	 */
+	void respond();
+
+private:
+	/**
+	 * Path of the requested file.
+	 */
+	String mPath;
+
+	/**
+	 * Header names, in lower case, followed by their values.
+	 */
+	Vector<String> mRequestHeaders;
+	Vector<String> mResponseHeaders;
+};
+
+} // namespace MAUtil
+
+#endif
@@ -0,0 +1,96 @@
+/*
+Copyright (C) 2012 MoSync AB
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License,
+version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+*/
+
+/**
+ * @file Environment.h
+ *
+ * Stub of MAUtil::Environment for the host build. Listeners
+ * are registered but there is no event loop, so they are only
+ * called when the host driver calls fireCustomEvent, runTimers
+ * or runIdle.
+ */
+
+#ifndef HOST_MAUTIL_ENVIRONMENT_H_
+#define HOST_MAUTIL_ENVIRONMENT_H_
+
+#include <ma.h>
+#include "Vector.h"
+
+namespace MAUtil
+{
+
+class CustomEventListener
+{
+public:
+	virtual ~CustomEventListener() {}
+	virtual void customEvent(const MAEvent& event) = 0;
+};
+
+class TimerListener
+{
+public:
+	virtual ~TimerListener() {}
+	virtual void runTimerEvent() = 0;
+};
+
+class IdleListener
+{
+public:
+	virtual ~IdleListener() {}
+	virtual void idle() = 0;
+};
+
+class Environment
+{
+public:
+	Environment();
+	virtual ~Environment();
+
+	static Environment& getEnvironment();
+
+	void addCustomEventListener(CustomEventListener* listener);
+	void removeCustomEventListener(CustomEventListener* listener);
+	void addTimer(TimerListener* listener, int period, int numTimes);
+	void removeTimer(TimerListener* listener);
+	void addIdleListener(IdleListener* listener);
+	void removeIdleListener(IdleListener* listener);
+
+	/**
+	 * Send an event to the custom event listeners.
+	 */
+	void fireCustomEvent(const MAEvent& event);
+
+	/**
+	 * Call every timer listener once.
+	 */
+	void runTimers();
+
+	/**
+	 * Call every idle listener once.
+	 */
+	void runIdle();
+
+private:
+	Vector<CustomEventListener*> mCustomEventListeners;
+	Vector<TimerListener*> mTimerListeners;
+	Vector<IdleListener*> mIdleListeners;
+};
+
+} // namespace MAUtil
+
+#endif
@@ -0,0 +1,44 @@
+/*
+Copyright (C) 2012 MoSync AB
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License,
+version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+*/
+
+/**
+ * @file Moblet.h
+ *
+ * Stub of MAUtil::Moblet for the host build. Moblet::run
+ * returns at once, since there are no events on the host.
+ */
+
+#ifndef HOST_MAUTIL_MOBLET_H_
+#define HOST_MAUTIL_MOBLET_H_
+
+#include "Environment.h"
+
+namespace MAUtil
+{
+
+class Moblet : public Environment
+{
+public:
+	static void run(Moblet* moblet);
+	void close();
+	virtual void keyPressEvent(int keyCode, int nativeCode) {}
+};
+
+} // namespace MAUtil
+
+#endif
@@ -0,0 +1,108 @@
+/*
+Copyright (C) 2012 MoSync AB
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License,
+version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+*/
+
+/**
+ * @file String.h
+ *
+ * Stub of MAUtil::String for the host build, on top of
+ * std::string. Only the members used by the message layer
+ * are provided.
+ */
+
+#ifndef HOST_MAUTIL_STRING_H_
+#define HOST_MAUTIL_STRING_H_
+
+#include <string>
+
+namespace MAUtil
+{
+
+class String
+{
+public:
+	String() {}
+	String(const char* text) : mText(text) {}
+	String(const char* text, int length) : mText(text, length) {}
+
+	const char* c_str() const { return mText.c_str(); }
+	char* pointer() { return &mText[0]; }
+	int length() const { return (int) mText.length(); }
+	int size() const { return (int) mText.size(); }
+	int capacity() const { return (int) mText.capacity(); }
+
+	void resize(int size) { mText.resize(size); }
+	void reserve(int size) { mText.reserve(size); }
+	void clear() { mText.clear(); }
+
+	void append(const char* text, int length)
+	{
+		mText.append(text, length);
+	}
+
+	void insert(int position, const String& text)
+	{
+		mText.insert(position, text.mText);
+	}
+
+	void remove(int position, int length)
+	{
+		mText.erase(position, length);
+	}
+
+	int find(const String& text, int offset = 0) const
+	{
+		std::string::size_type i = mText.find(text.mText, offset);
+		return std::string::npos == i ? -1 : (int) i;
+	}
+
+	String substr(int offset, int length = -1) const
+	{
+		String result;
+		result.mText = mText.substr(
+			offset,
+			length < 0 ? std::string::npos : length);
+		return result;
+	}
+
+	char& operator[](int index) { return mText[index]; }
+	const char& operator[](int index) const { return mText[index]; }
+
+	String& operator+=(const String& text)
+	{
+		mText += text.mText;
+		return *this;
+	}
+
+	String operator+(const String& text) const
+	{
+		String result(*this);
+		result += text;
+		return result;
+	}
+
+	bool operator==(const String& text) const { return mText == text.mText; }
+	bool operator!=(const String& text) const { return mText != text.mText; }
+	bool operator<(const String& text) const { return mText < text.mText; }
+
+private:
+	std::string mText;
+};
+
+} // namespace MAUtil
+
+#endif
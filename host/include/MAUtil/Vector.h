@@ -0,0 +1,73 @@
+/*
+Copyright (C) 2012 MoSync AB
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License,
+version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+*/
+
+/**
+ * @file Vector.h
+ *
+ * Stub of MAUtil::Vector for the host build, on top of
+ * std::vector.
+ */
+
+#ifndef HOST_MAUTIL_VECTOR_H_
+#define HOST_MAUTIL_VECTOR_H_
+
+#include <vector>
+
+namespace MAUtil
+{
+
+template<class Type>
+class Vector
+{
+public:
+	typedef Type* iterator;
+	typedef const Type* const_iterator;
+
+	Vector(int initialCapacity = 4) { mItems.reserve(initialCapacity); }
+
+	void add(const Type& item) { mItems.push_back(item); }
+
+	void insert(int index, const Type& item)
+	{
+		mItems.insert(mItems.begin() + index, item);
+	}
+
+	void remove(int index) { mItems.erase(mItems.begin() + index); }
+
+	int size() const { return (int) mItems.size(); }
+	int capacity() const { return (int) mItems.capacity(); }
+	bool empty() const { return mItems.empty(); }
+
+	void resize(int size) { mItems.resize(size); }
+	void reserve(int size) { mItems.reserve(size); }
+	void clear() { mItems.clear(); }
+
+	Type* pointer() { return mItems.empty() ? NULL : &mItems[0]; }
+	iterator begin() { return pointer(); }
+	iterator end() { return pointer() + mItems.size(); }
+
+	Type& operator[](int index) { return mItems[index]; }
+	const Type& operator[](int index) const { return mItems[index]; }
+
+private:
+	std::vector<Type> mItems;
+};
+
+} // namespace MAUtil
+
+#endif
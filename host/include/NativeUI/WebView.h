@@ -0,0 +1,58 @@
+/*
+Copyright (C) 2012 MoSync AB
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License,
+version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+*/
+
+/**
+ * @file WebView.h
+ *
+ * Stub of NativeUI::WebView for the host build. The web view
+ * is a widget of the stub widget API, scripts set as its URL
+ * are counted but not run.
+ */
+
+#ifndef HOST_NATIVEUI_WEBVIEW_H_
+#define HOST_NATIVEUI_WEBVIEW_H_
+
+#include <ma.h>
+#include <MAUtil/String.h>
+
+// The SDK's NativeUI headers bring in the environment, which
+// the message handlers rely on.
+#include <MAUtil/Environment.h>
+
+namespace NativeUI
+{
+
+class WebView
+{
+public:
+	WebView();
+	virtual ~WebView();
+
+	MAWidgetHandle getWidgetHandle() const;
+	void callJS(const MAUtil::String& script);
+	void enableZoom();
+	void disableZoom();
+	void setVisible(bool visible);
+
+private:
+	MAWidgetHandle mWidgetHandle;
+};
+
+} // namespace NativeUI
+
+#endif
@@ -0,0 +1,57 @@
+/*
+Copyright (C) 2012 MoSync AB
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License,
+version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+*/
+
+/**
+ * @file WebAppMoblet.h
+ *
+ * Stub of Wormhole::WebAppMoblet for the host build. Owns a
+ * stub WebView, pages are not loaded.
+ */
+
+#ifndef HOST_WORMHOLE_WEBAPPMOBLET_H_
+#define HOST_WORMHOLE_WEBAPPMOBLET_H_
+
+#include <mavsprintf.h>
+#include <MAUtil/Moblet.h>
+#include <NativeUI/WebView.h>
+
+namespace Wormhole
+{
+
+class WebAppMoblet : public MAUtil::Moblet
+{
+public:
+	WebAppMoblet();
+	virtual ~WebAppMoblet();
+
+	NativeUI::WebView* getWebView();
+	void enableWebViewMessages();
+	void showPage(const char* url);
+	void callJS(const MAUtil::String& script);
+
+	virtual void handleWebViewMessage(
+		NativeUI::WebView* webView,
+		MAHandle data) {}
+
+private:
+	NativeUI::WebView* mWebView;
+};
+
+} // namespace Wormhole
+
+#endif
@@ -0,0 +1,192 @@
+/*
+Copyright (C) 2012 MoSync AB
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License,
+version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+*/
+
+/**
+ * @file ma.h
+ *
+ * Stub of the MoSync API for the host build. Declares the
+ * types, constants and syscalls the message layer uses. The
+ * syscalls are implemented in HostSyscalls.cpp.
+ */
+
+#ifndef HOST_MA_H_
+#define HOST_MA_H_
+
+#include <stddef.h>
+
+typedef int MAHandle;
+typedef int MAWidgetHandle;
+typedef int MAExtent;
+
+#define EXTENT_X(e) ((int) (((unsigned int) (e)) >> 16))
+#define EXTENT_Y(e) ((int) ((e) & 0xFFFF))
+
+/**
+ * Result codes of data objects.
+ */
+#define RES_OK 1
+#define RES_OUT_OF_MEMORY -1
+
+/**
+ * File access modes, seek modes and errors.
+ */
+#define MA_ACCESS_READ 1
+#define MA_ACCESS_READ_WRITE 3
+#define MA_SEEK_SET 0
+#define MA_SEEK_CUR 1
+#define MA_SEEK_END 2
+#define MA_FL_SORT_NONE 0
+#define MA_FERR_GENERIC -2
+#define MA_FERR_NOTFOUND -3
+
+/**
+ * Connections.
+ */
+#define HTTP_GET 1
+#define CONNERR_GENERIC -2
+
+/**
+ * Widget result codes.
+ */
+#define MAW_RES_OK 0
+#define MAW_RES_ERROR -2
+#define MAW_RES_INVALID_PROPERTY_NAME -3
+#define MAW_RES_INVALID_PROPERTY_VALUE -4
+#define MAW_RES_INVALID_HANDLE -5
+#define MAW_RES_INVALID_STRING_BUFFER_SIZE -6
+
+#define MAW_WEB_VIEW_URL "url"
+
+/**
+ * Widget events.
+ */
+#define EVENT_TYPE_WIDGET 23
+
+#define MAW_EVENT_POINTER_PRESSED 2
+#define MAW_EVENT_POINTER_RELEASED 3
+#define MAW_EVENT_CONTENT_LOADED 4
+#define MAW_EVENT_CLICKED 5
+#define MAW_EVENT_ITEM_CLICKED 6
+#define MAW_EVENT_TAB_CHANGED 7
+#define MAW_EVENT_GL_VIEW_READY 8
+#define MAW_EVENT_WEB_VIEW_URL_CHANGED 9
+#define MAW_EVENT_STACK_SCREEN_POPPED 10
+#define MAW_EVENT_SLIDER_VALUE_CHANGED 11
+#define MAW_EVENT_DATE_PICKER_VALUE_CHANGED 12
+#define MAW_EVENT_NUMBER_PICKER_VALUE_CHANGED 13
+#define MAW_EVENT_VIDEO_STATE_CHANGED 14
+#define MAW_EVENT_EDIT_BOX_EDITING_DID_BEGIN 15
+#define MAW_EVENT_EDIT_BOX_EDITING_DID_END 16
+#define MAW_EVENT_EDIT_BOX_TEXT_CHANGED 17
+#define MAW_EVENT_EDIT_BOX_RETURN 18
+#define MAW_EVENT_WEB_VIEW_CONTENT_LOADING 19
+#define MAW_EVENT_WEB_VIEW_HOOK_INVOKED 20
+#define MAW_EVENT_DIALOG_DISMISSED 21
+
+struct MAEvent
+{
+	int type;
+	void* data;
+};
+
+struct MAWidgetEventData
+{
+	int eventType;
+	MAWidgetHandle widgetHandle;
+	int listItemIndex;
+	int searchBarButton;
+	int dayOfMonth;
+	int month;
+	int year;
+};
+
+extern "C"
+{
+	// Data objects.
+	MAHandle maCreatePlaceholder();
+	void maDestroyPlaceholder(MAHandle handle);
+	int maCreateData(MAHandle placeholder, int size);
+	void maDestroyObject(MAHandle handle);
+	int maGetDataSize(MAHandle data);
+	void maReadData(MAHandle data, void* dst, int offset, int size);
+	void maWriteData(MAHandle data, const void* src, int offset, int size);
+
+	// Images.
+	int maCreateImageFromData(
+		MAHandle placeholder,
+		MAHandle data,
+		int offset,
+		int size);
+	MAExtent maGetImageSize(MAHandle image);
+	MAExtent maGetScrSize();
+
+	// Files.
+	MAHandle maFileOpen(const char* path, int mode);
+	int maFileExists(MAHandle file);
+	int maFileCreate(MAHandle file);
+	int maFileDelete(MAHandle file);
+	int maFileClose(MAHandle file);
+	int maFileSize(MAHandle file);
+	int maFileTruncate(MAHandle file, int offset);
+	int maFileSeek(MAHandle file, int offset, int whence);
+	int maFileRead(MAHandle file, void* dst, int size);
+	int maFileWrite(MAHandle file, const void* src, int size);
+	int maFileReadToData(MAHandle file, MAHandle data, int offset, int size);
+	int maFileWriteFromData(
+		MAHandle file,
+		MAHandle data,
+		int offset,
+		int size);
+	MAHandle maFileListStart(const char* path, const char* filter, int sorting);
+	int maFileListNext(MAHandle list, char* nameBuf, int bufSize);
+	int maFileListClose(MAHandle list);
+
+	// Widgets.
+	MAWidgetHandle maWidgetCreate(const char* widgetType);
+	int maWidgetDestroy(MAWidgetHandle widget);
+	int maWidgetAddChild(MAWidgetHandle parent, MAWidgetHandle child);
+	int maWidgetInsertChild(
+		MAWidgetHandle parent,
+		MAWidgetHandle child,
+		int index);
+	int maWidgetRemoveChild(MAWidgetHandle child);
+	int maWidgetModalDialogShow(MAWidgetHandle dialog);
+	int maWidgetModalDialogHide(MAWidgetHandle dialog);
+	int maWidgetScreenShow(MAWidgetHandle screen);
+	int maWidgetStackScreenPush(
+		MAWidgetHandle stackScreen,
+		MAWidgetHandle screen);
+	int maWidgetStackScreenPop(MAWidgetHandle stackScreen);
+	int maWidgetSetProperty(
+		MAWidgetHandle widget,
+		const char* property,
+		const char* value);
+	int maWidgetGetProperty(
+		MAWidgetHandle widget,
+		const char* property,
+		char* value,
+		int bufSize);
+
+	// System.
+	int maGetMilliSecondCount();
+	int maTime();
+	int maGetSystemProperty(const char* key, char* buf, int size);
+	int maWriteLog(const void* src, int size);
+}
+
+#endif
@@ -0,0 +1,35 @@
+/*
+Copyright (C) 2012 MoSync AB
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License,
+version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+*/
+
+/**
+ * @file mastdlib.h
+ *
+ * Stub of mastdlib.h for the host build, maps to the C library.
+ * Like the SDK's header it also declares the string, heap and
+ * formatting functions.
+ */
+
+#ifndef HOST_MASTDLIB_H_
+#define HOST_MASTDLIB_H_
+
+#include <stdlib.h>
+#include <maheap.h>
+#include <mastring.h>
+#include <mavsprintf.h>
+
+#endif
@@ -0,0 +1,100 @@
+/*
+Copyright (C) 2012 MoSync AB
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License,
+version 2, as published by the Free Software Foundation.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+*/
+
+/**
+ * @file yajl_parse.h
+ *
+ * Stub of the yajl 1.x parser API for the host build, with the
+ * parts MessageJSON uses. The parser is in HostYajl.cpp. It
+ * takes a whole document in one call to yajl_parse.
+ */
+
+#ifndef HOST_YAJL_PARSE_H_
+#define HOST_YAJL_PARSE_H_
+
+extern "C"
+{
+	typedef enum
+	{
+		yajl_status_ok,
+		yajl_status_client_canceled,
+		yajl_status_insufficient_data,
+		yajl_status_error
+	} yajl_status;
+
+	typedef struct yajl_handle_t* yajl_handle;
+
+	typedef struct
+	{
+		int (*yajl_null)(void* ctx);
+		int (*yajl_boolean)(void* ctx, int boolVal);
+		int (*yajl_integer)(void* ctx, long integerVal);
+		int (*yajl_double)(void* ctx, double doubleVal);
+		int (*yajl_number)(
+			void* ctx,
+			const char* numberVal,
+			unsigned int numberLen);
+		int (*yajl_string)(
+			void* ctx,
+			const unsigned char* stringVal,
+			unsigned int stringLen);
+		int (*yajl_start_map)(void* ctx);
+		int (*yajl_map_key)(
+			void* ctx,
+			const unsigned char* key,
+			unsigned int stringLen);
+		int (*yajl_end_map)(void* ctx);
+		int (*yajl_start_array)(void* ctx);
+		int (*yajl_end_array)(void* ctx);
+	} yajl_callbacks;
+
+	typedef struct
+	{
+		unsigned int allowComments;
+		unsigned int checkUTF8;
+	} yajl_parser_config;
+
+	typedef void* (*yajl_malloc_func)(void* ctx, unsigned int sz);
+	typedef void (*yajl_free_func)(void* ctx, void* ptr);
+	typedef void* (*yajl_realloc_func)(void* ctx, void* ptr, unsigned int sz);
+
+	typedef struct
+	{
+		yajl_malloc_func malloc;
+		yajl_realloc_func realloc;
+		yajl_free_func free;
+		void* ctx;
+	} yajl_alloc_funcs;
+
+	yajl_handle yajl_alloc(
+		const yajl_callbacks* callbacks,
+		const yajl_parser_config* config,
+		const yajl_alloc_funcs* allocFuncs,
+		void* ctx);
+
+	void yajl_free(yajl_handle handle);
+
+	yajl_status yajl_parse(
+		yajl_handle handle,
+		const unsigned char* jsonText,
+		unsigned int jsonTextLength);
+
+	yajl_status yajl_parse_complete(yajl_handle handle);
+}
+
+#endif
@@ -7,9 +7,18 @@
 
 #include <Wormhole/WebAppMoblet.h>
 #include <conprint.h>
+#include "MessageBenchmark.h"
+#include "MessageBuffer.h"
+#include "MessageCapture.h"
+#include "MessageDispatcher.h"
 #include "MessageProtocol.h"
+#include "MessageStats.h"
+#include "MessageTrace.h"
 #include "MessageStream.h"
+#include "MessageStreamBinary.h"
 #include "MessageStreamJSON.h"
+#include "ScriptBatch.h"
+#include "ScriptBuilder.h"
 #include "NativeUIMessageHandler.h"
 #include "ResourceMessageHandler.h"
 
@@ -18,18 +27,111 @@ using namespace MAUtil; // Class Moblet
 using namespace NativeUI; // WebView widget.
 using namespace Wormhole; // Class WebAppMoblet
 
+/**
+ * Opcodes of the message stream modules, used instead of the
+ * module names in binary message streams. Must match the
+ * opcodes used in the JavaScript libraries.
+ */
+enum ModuleOpcode
+{
+	MODULE_NATIVEUI = 1,
+	MODULE_RESOURCE = 2,
+	MODULE_CLOSE = 3,
+	MODULE_STATS = 4,
+	MODULE_TRACE = 5
+};
+
 /**
  * The application class.
  */
 class MyMoblet : public WebAppMoblet
 {
 public:
-	MyMoblet()
+	MyMoblet() :
+		mDispatcher(this)
 	{
+		// Register the handlers for the message stream modules.
+		mDispatcher.add(
+			"NativeUI",
+			MODULE_NATIVEUI,
+			&MyMoblet::handleNativeUIMessage);
+		mDispatcher.add(
+			"Resource",
+			MODULE_RESOURCE,
+			&MyMoblet::handleResourceMessage);
+		mDispatcher.add(
+			"close",
+			MODULE_CLOSE,
+			&MyMoblet::handleCloseMessage);
+		mDispatcher.add(
+			"Stats",
+			MODULE_STATS,
+			&MyMoblet::handleStatsMessage);
+		mDispatcher.add(
+			"Trace",
+			MODULE_TRACE,
+			&MyMoblet::handleTraceMessage);
+
+		// Create the batch used for replies to JavaScript.
+		mScriptBatch = new ScriptBatch(getWebView());
+
 		// Create message handler for NativeUI.
-		mNativeUIMessageHandler = new NativeUIMessageHandler(getWebView());
+		mNativeUIMessageHandler = new NativeUIMessageHandler(
+			getWebView(),
+			mScriptBatch);
 		// Create message handler for Resources.
-		mResourceMessageHandler = new ResourceMessageHandler(getWebView());
+		mResourceMessageHandler = new ResourceMessageHandler(
+			getWebView(),
+			mScriptBatch);
+
+		// Widgets keep the images they show in use.
+		mNativeUIMessageHandler->setImageCache(
+			&mResourceMessageHandler->getImageCache());
+
+		// Count and time all messages and replies, JavaScript
+		// reads the statistics with the Stats message.
+		mDispatcher.setStats(&mStats);
+		mScriptBatch->setStats(&mStats);
+		mNativeUIMessageHandler->setStats(&mStats);
+		mResourceMessageHandler->setStats(&mStats);
+		mStats.addSource(
+			"propertyCache",
+			&mNativeUIMessageHandler->getPropertyCache());
+		mStats.addSource(
+			"downloads",
+			&mResourceMessageHandler->getDownloadPool());
+		mStats.addSource(
+			"scratchData",
+			&mResourceMessageHandler->getDataPool());
+
+#ifdef MESSAGE_BENCHMARK
+		// Measure the message layer before the page is loaded.
+		Wormhole::runMessageBenchmarks();
+
+#ifdef MESSAGE_HOST
+		// Replay the traffic of the newest capture, if there is
+		// one. Only the host build replays, where the widget API
+		// is a stub. On a device the replayed messages would
+		// create and show real widgets and screens.
+		char captureName[256];
+		if (Wormhole::MessageCapture::findNewest(
+			captureName,
+			sizeof(captureName)))
+		{
+			replayCapture(captureName);
+		}
+#endif
+		mStats.reset();
+#endif
+
+#ifdef MESSAGE_CAPTURE
+		// Record all messages and replies in a new file, for
+		// replaying them with the host build.
+		if (mCapture.openNew())
+		{
+			mScriptBatch->setCapture(&mCapture);
+		}
+#endif
 
 		// Enable message sending from JavaScript to C++.
 		enableWebViewMessages();
@@ -50,19 +152,24 @@ public:
 		// show when the application starts.
 		showPage("index.html");
 
+		// Start loading the images of the first screen while
+		// the page loads, so that they are ready when the page
+		// asks for them. The manifest is optional.
+		mResourceMessageHandler->preloadImages("preload-images.txt");
+
 		//Send the Device Screen size to JavaScript
 		MAExtent scrSize = maGetScrSize();
 		int width = EXTENT_X(scrSize);
 		int height = EXTENT_Y(scrSize);
-		char buf[512];
-		sprintf(
-				buf,
-				"{mosyncScreenWidth=%d, mosyncScreenHeight = %d;}",
-				width,
-				height);
-
-		lprintfln(buf);
-		callJS(buf);
+		ScriptBuilder& script = mScriptBatch->newScript()
+			.append("{mosyncScreenWidth=")
+			.append(width)
+			.append(", mosyncScreenHeight = ")
+			.append(height)
+			.append(";}");
+
+		lprintfln(script.c_str());
+		mScriptBatch->add(script);
 	}
 
 	/**
@@ -73,14 +180,13 @@ public:
 	 */
 	void keyPressEvent(int keyCode, int nativeCode)
 	{
-		char buffer[256];
 		// forward the event to application
-		sprintf(buffer,
-				"keyPressEvent(%d, %d)",
-				keyCode,
-				nativeCode);
-
-		callJS(buffer);
+		mScriptBatch->add(mScriptBatch->newScript()
+			.append("keyPressEvent(")
+			.append(keyCode)
+			.append(", ")
+			.append(nativeCode)
+			.append(")"));
 	}
 	/**
 	 * This method handles messages sent from the WebView.
@@ -92,56 +198,211 @@ public:
 	 */
 	void handleWebViewMessage(WebView* webView, MAHandle data)
 	{
-		Wormhole::MessageProtocol protocol(data);
+		// Read the message once into the reusable buffer,
+		// the protocol check and the parsers all work on
+		// the buffer contents.
+		if (!mMessageBuffer.read(data))
+		{
+			lprintfln("could not read message data");
+			return;
+		}
+
+#ifdef MESSAGE_CAPTURE
+		mCapture.addMessage(
+			mMessageBuffer.getData(),
+			mMessageBuffer.getSize());
+#endif
+
+		Wormhole::MessageProtocol protocol(
+			mMessageBuffer.getData(),
+			mMessageBuffer.getSize());
+
+		int startTime = maGetMilliSecondCount();
+		int numMessages = 0;
+
+		// Collect all replies to the message and send
+		// them to JavaScript in one call.
+		mScriptBatch->begin();
 
 		if (protocol.isMessageStream())
 		{
-			 handleMessageStream(webView, data);
+			 numMessages = handleMessageStream(webView);
+		}
+		else if (protocol.isMessageBinary())
+		{
+			 numMessages = handleMessageStreamBinary(webView);
 		}
 		else if (protocol.isMessageArrayJSON())
 		{
-			 handleMessageStreamJSON(webView, data);
+			 numMessages = handleMessageStreamJSON(webView);
 		}
 		else
 		{
 			lprintfln("undefined message protocol");
 		}
+
+		mScriptBatch->end();
+
+		mStats.addStream(
+			mMessageBuffer.getSize(),
+			numMessages,
+			maGetMilliSecondCount() - startTime);
+	}
+
+	/**
+	 * @return The number of messages in the stream.
+	 */
+	int handleMessageStream(WebView* webView)
+	{
+		Wormhole::MessageStream stream(
+			webView,
+			mMessageBuffer.getData(),
+			mMessageBuffer.getSize());
+
+		int numMessages = 0;
+		while (stream.hasNext())
+		{
+			mDispatcher.dispatchNext(stream);
+			++numMessages;
+		}
+		return numMessages;
+	}
+
+	/**
+	 * @return The number of messages in the stream.
+	 */
+	int handleMessageStreamBinary(WebView* webView)
+	{
+		Wormhole::MessageStreamBinary stream(
+			webView,
+			mMessageBuffer.getData(),
+			mMessageBuffer.getSize());
+
+		// Every message starts with its length, so a message
+		// that is not read to the end does not affect the next.
+		int numMessages = 0;
+		while (stream.nextMessage())
+		{
+			mDispatcher.dispatchNext(stream);
+			++numMessages;
+		}
+		return numMessages;
+	}
+
+	void handleNativeUIMessage(Wormhole::MessageStream& stream)
+	{
+		MESSAGE_TRACE_RECORD(MESSAGE_TRACE_NATIVEUI, 0, 0, 0);
+		//Forward NativeUI messages to the respective message handler
+		mNativeUIMessageHandler->handleMessage(stream);
+	}
+
+	void handleResourceMessage(Wormhole::MessageStream& stream)
+	{
+		//Forward Resource messages to the respective message handler
+		mResourceMessageHandler->handleMessage(stream);
+	}
+
+	void handleCloseMessage(Wormhole::MessageStream& stream)
+	{
+		// Replayed messages have no WebView, do not close
+		// the application while replaying a capture.
+		if (NULL == stream.getWebView())
+		{
+			return;
+		}
+		close();
+	}
+
+	/**
+	 * Sends the statistics of the messages as a JSON object
+	 * to the callback of the message, and resets them.
+	 * See MessageStats::writeJSON for the format.
+	 */
+	void handleStatsMessage(Wormhole::MessageStream& stream)
+	{
+		// The callback ID is a number in both protocols.
+		int callbackID = stream.getNextInt();
+		if (callbackID != 0)
+		{
+			ScriptBuilder& script = mScriptBatch->newScript()
+				.append("mosync.bridge.reply(")
+				.append(callbackID)
+				.append(",");
+			mStats.writeJSON(script);
+			script.append(")");
+			mScriptBatch->add(script);
+		}
+
+		mStats.reset();
+	}
+
+	/**
+	 * Writes the message trace to a file in the local files
+	 * directory, and sends the number of records written, or
+	 * a negative error code, to the callback of the message.
+	 * Without MESSAGE_TRACE the code is
+	 * MESSAGE_TRACE_ERROR_DISABLED.
+	 */
+	void handleTraceMessage(Wormhole::MessageStream& stream)
+	{
+		int callbackID = stream.getNextInt();
+		int result = MESSAGE_TRACE_DUMP("message-trace.bin");
+		if (callbackID != 0)
+		{
+			mScriptBatch->add(mScriptBatch->newScript()
+				.append("mosync.bridge.reply(")
+				.append(callbackID)
+				.append(",")
+				.append(result)
+				.append(")"));
+		}
 	}
 
-	void handleMessageStream(WebView* webView, MAHandle data)
+#if defined(MESSAGE_BENCHMARK) && defined(MESSAGE_HOST)
+	/**
+	 * Feeds the messages of a capture through the handlers
+	 * and logs the time of each message and the scripts that
+	 * differ from the recording, see Wormhole::MessageReplay.
+	 */
+	void replayCapture(const char* fileName)
 	{
-		Wormhole::MessageStream stream(webView, data);
-
-		const char* p;
-
-		while (p = stream.getNext())
-		{
-			if (0 == strcmp(p, "NativeUI"))
-			{
-				lprintfln("received a NativeUI Message .......");
-				//Forward NativeUI messages to the respective message handler
-				mNativeUIMessageHandler->handleMessage(stream);
-			}
-			else if (0 == strcmp(p, "Resource"))
-			{
-				//Forward Resource messages to the respective message handler
-				mResourceMessageHandler->handleMessage(stream);
-			}
-			else if (0 == strcmp(p, "close"))
-			{
-				close();
-			}
+		Wormhole::MessageReplay replay(mScriptBatch);
+		if (!replay.start(fileName))
+		{
+			return;
+		}
+		while (replay.nextMessage())
+		{
+			handleWebViewMessage(NULL, replay.getMessage());
+			replay.endMessage();
 		}
+		replay.finish();
 	}
+#endif
 
-	void handleMessageStreamJSON(WebView* webView, MAHandle data)
+	/**
+	 * @return The number of messages in the stream.
+	 */
+	int handleMessageStreamJSON(WebView* webView)
 	{
-		Wormhole::MessageStreamJSON message(webView, data);
+		// The buffer outlives the stream, so the messages
+		// can be parsed one at a time. The message trees are
+		// allocated in the arena, which is reused for every
+		// stream.
+		Wormhole::MessageStreamJSON message(
+			webView,
+			mMessageBuffer.getData(),
+			mMessageBuffer.getSize(),
+			true,
+			&mJSONArena);
 
+		int numMessages = 0;
 		while (message.next())
 		{
 			handleJSONMessage(message);
+			++numMessages;
 		}
+		return numMessages;
 	}
 
 	void handleJSONMessage(Wormhole::MessageStreamJSON& message)
@@ -152,11 +413,11 @@ public:
 		}
 		else if (message.is("JSONMessageEnd"))
 		{
-			callJS("JSONMessageEnd()");
+			mScriptBatch->add("JSONMessageEnd()");
 		}
 		else if (message.is("JSONRoundtripMessage"))
 		{
-			callJS("JSONRoundtripCallback()");
+			mScriptBatch->add("JSONRoundtripCallback()");
 		}
 		else
 		{
@@ -164,9 +425,44 @@ public:
 		}
 	}
 private:
+	/**
+	 * Receive buffer for messages from the WebView,
+	 * reused for every message.
+	 */
+	Wormhole::MessageBuffer mMessageBuffer;
+
+	/**
+	 * Memory for the trees of JSON messages, reused
+	 * for every message.
+	 */
+	Wormhole::MessageArena mJSONArena;
+
+	/**
+	 * Maps message stream module names to handler methods.
+	 */
+	Wormhole::MessageDispatcher<MyMoblet, 16> mDispatcher;
+
+	/**
+	 * Collects the replies to a message, so that they are
+	 * evaluated with one call to the WebView.
+	 */
+	ScriptBatch* mScriptBatch;
+
 	NativeUIMessageHandler* mNativeUIMessageHandler;
 	ResourceMessageHandler* mResourceMessageHandler;
 
+	/**
+	 * Statistics of the messages and replies.
+	 */
+	Wormhole::MessageStats mStats;
+
+#ifdef MESSAGE_CAPTURE
+	/**
+	 * Capture of the messages and replies.
+	 */
+	Wormhole::MessageCapture mCapture;
+#endif
+
 };
 
 /**